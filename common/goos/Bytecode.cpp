@@ -0,0 +1,876 @@
+/*!
+ * @file Bytecode.cpp
+ * Compiler and stack machine for GOOS lambda and macro bodies.
+ */
+
+#include <unordered_set>
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "third-party/fmt/core.h"
+
+namespace goos {
+
+namespace {
+
+bool is_keyword(const Object& o) {
+  return o.is_symbol() && o.as_symbol()->name.at(0) == ':';
+}
+
+/*!
+ * Is this a proper list? If so, set count to its length.
+ */
+bool proper_list_length(const Object& list, u32* count) {
+  u32 result = 0;
+  Object current = list;
+  while (current.is_pair()) {
+    result++;
+    current = current.as_pair()->cdr;
+  }
+  *count = result;
+  return current.is_empty_list();
+}
+
+/*!
+ * Is this a proper list of arguments, without any keyword arguments? These are the only arguments
+ * that get_args doesn't need to sort out, so they can be evaluated in order.
+ */
+bool simple_args(const Object& args, u32* count) {
+  if (!proper_list_length(args, count)) {
+    return false;
+  }
+  for (Object current = args; current.is_pair(); current = current.as_pair()->cdr) {
+    if (is_keyword(current.as_pair()->car)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_symbol_named(const Object& o, const char* name) {
+  return o.is_symbol() && o.as_symbol()->name == name;
+}
+
+/*!
+ * Will quasiquote_helper accept this list without an error (other than errors from evaluating
+ * unquotes)?
+ */
+bool valid_quasiquote(const Object& list) {
+  Object current = list;
+  while (current.is_pair()) {
+    auto item = current.as_pair()->car;
+    if (item.is_pair()) {
+      auto item_head = item.as_pair()->car;
+      if (is_symbol_named(item_head, "unquote") || is_symbol_named(item_head, "unquote-splicing")) {
+        auto unquote_arg = item.as_pair()->cdr;
+        if (!unquote_arg.is_pair() || !unquote_arg.as_pair()->cdr.is_empty_list()) {
+          return false;
+        }
+      } else if (!valid_quasiquote(item)) {
+        return false;
+      }
+    }
+    current = current.as_pair()->cdr;
+  }
+  return current.is_empty_list();
+}
+
+/*!
+ * Find the variable at a lexical address. Returns nullptr if the frames aren't laid out as expected,
+ * or if a variable defined at runtime in a frame in between could shadow it. The caller should then
+ * look it up by name.
+ */
+Object* find_local(EnvironmentObject* env, u32 depth, u32 slot, const HeapObject* sym) {
+  for (u32 i = 0; i < depth && env; i++) {
+    if (!env->vars.empty()) {
+      return nullptr;
+    }
+    env = env->parent_env.get();
+  }
+  if (env && env->slot_names && slot < env->slots.size() &&
+      (*env->slot_names)[slot].get() == sym) {
+    return &env->slots[slot];
+  }
+  return nullptr;
+}
+}  // namespace
+
+/*!
+ * Compiles a body to bytecode. Every form is compiled so that it pushes exactly one value.
+ */
+class BytecodeCompiler {
+ public:
+  BytecodeCompiler(Interpreter* interp, Bytecode* bc, std::vector<const FrameLayout*> scopes)
+      : m_interp(interp), m_bc(bc), m_scopes(std::move(scopes)) {}
+
+  void compile_body(const Object& form, const Object& body) {
+    u32 count = 0;
+    if (!proper_list_length(body, &count)) {
+      // eval_list_return_last will evaluate the start of the body, then error.
+      emit(BytecodeOp::EVAL_BODY, add_const(form), add_const(body));
+      return;
+    }
+
+    if (count == 0) {
+      emit(BytecodeOp::PUSH_CONST, add_const(EmptyListObject::make_new()));
+      return;
+    }
+
+    bool first = true;
+    for (Object current = body; current.is_pair(); current = current.as_pair()->cdr) {
+      if (!first) {
+        emit(BytecodeOp::POP);
+      }
+      first = false;
+      compile_form(current.as_pair()->car);
+    }
+  }
+
+ private:
+  u32 emit(BytecodeOp op, u32 a = 0, u32 b = 0, u32 c = 0) {
+    m_bc->code.push_back({op, a, b, c});
+    return m_bc->code.size() - 1;
+  }
+
+  u32 here() const { return m_bc->code.size(); }
+
+  void patch_a(u32 instr, u32 target) { m_bc->code.at(instr).a = target; }
+
+  u32 add_const(const Object& o) {
+    m_bc->consts.push_back(o);
+    return m_bc->consts.size() - 1;
+  }
+
+  /*!
+   * Find the frame and slot of an argument of this lambda or an enclosing one. The frames are
+   * searched the same way as Interpreter::try_symbol_lookup.
+   */
+  bool resolve_local(const Object& sym, u32* depth, u32* slot) const {
+    for (size_t d = 0; d < m_scopes.size(); d++) {
+      if (!m_scopes[d]) {
+        continue;
+      }
+      auto& layout = *m_scopes[d];
+      for (size_t i = layout.size(); i-- > 0;) {
+        if (layout[i] == sym.heap_obj) {
+          *depth = d;
+          *slot = i;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void compile_form(const Object& form) {
+    switch (form.type) {
+      case ObjectType::SYMBOL: {
+        auto& name = form.as_symbol()->name;
+        u32 depth, slot;
+        if (name == "#t" || name == "#f") {
+          emit(BytecodeOp::PUSH_CONST, add_const(form));
+        } else if (resolve_local(form, &depth, &slot)) {
+          emit(BytecodeOp::LOAD_LOCAL, depth, slot, add_const(form));
+        } else {
+          emit(BytecodeOp::LOAD, add_const(form));
+        }
+      } break;
+      case ObjectType::INTEGER:
+      case ObjectType::FLOAT:
+      case ObjectType::STRING:
+      case ObjectType::CHAR:
+        emit(BytecodeOp::PUSH_CONST, add_const(form));
+        break;
+      case ObjectType::PAIR:
+        compile_pair(form);
+        break;
+      default:
+        // an error, let eval report it.
+        emit(BytecodeOp::EVAL_FORM, add_const(form));
+        break;
+    }
+  }
+
+  void compile_pair(const Object& form) {
+    auto head = form.as_pair()->car;
+    auto rest = form.as_pair()->cdr;
+    u32 arg_count = 0;
+
+    if (head.is_symbol()) {
+      auto& name = head.as_symbol()->name;
+      if (m_interp->special_forms.find(name) != m_interp->special_forms.end()) {
+        if (!compile_special_form(name, form, rest)) {
+          emit(BytecodeOp::EVAL_FORM, add_const(form));
+        }
+        return;
+      }
+
+      auto builtin = m_interp->builtin_forms.find(name);
+      if (builtin != m_interp->builtin_forms.end()) {
+        if (!simple_args(rest, &arg_count)) {
+          emit(BytecodeOp::EVAL_FORM, add_const(form));
+          return;
+        }
+        compile_args(rest);
+        m_bc->builtins.push_back(builtin->second);
+        emit(BytecodeOp::BUILTIN, m_bc->builtins.size() - 1, arg_count, add_const(form));
+        return;
+      }
+    }
+
+    if (!simple_args(rest, &arg_count)) {
+      emit(BytecodeOp::EVAL_FORM, add_const(form));
+      return;
+    }
+
+    auto form_const = add_const(form);
+    u32 macro_jump = UINT32_MAX;
+    if (head.is_symbol()) {
+      // this could be a macro, which we can't know until the form is evaluated.
+      macro_jump = emit(BytecodeOp::MACRO_OR_HEAD, form_const);
+    } else {
+      compile_form(head);
+    }
+    auto check_jump = emit(BytecodeOp::CHECK_CALL, form_const, arg_count);
+    compile_args(rest);
+    emit(BytecodeOp::CALL, form_const, arg_count);
+
+    if (macro_jump != UINT32_MAX) {
+      m_bc->code.at(macro_jump).b = here();
+    }
+    m_bc->code.at(check_jump).c = here();
+  }
+
+  void compile_args(const Object& args) {
+    for (Object current = args; current.is_pair(); current = current.as_pair()->cdr) {
+      compile_form(current.as_pair()->car);
+    }
+  }
+
+  /*!
+   * Compile a special form. Returns false if it should be evaluated with eval instead. This is done
+   * for malformed forms, so they fail in exactly the same way.
+   */
+  bool compile_special_form(const std::string& name, const Object& form, const Object& rest) {
+    if (name == "quote") {
+      return compile_quote(rest);
+    } else if (name == "set!" || name == "define") {
+      return compile_set_or_define(name == "define", rest);
+    } else if (name == "lambda") {
+      return compile_lambda(form, rest);
+    } else if (name == "cond") {
+      return compile_cond(rest);
+    } else if (name == "and" || name == "or") {
+      return compile_and_or(name == "and", rest);
+    } else if (name == "quasiquote") {
+      return compile_quasiquote(rest);
+    } else if (name == "while") {
+      return compile_while(rest);
+    }
+    return false;
+  }
+
+  bool compile_quote(const Object& rest) {
+    u32 count = 0;
+    if (!simple_args(rest, &count) || count != 1) {
+      return false;
+    }
+    emit(BytecodeOp::PUSH_CONST, add_const(rest.as_pair()->car));
+    return true;
+  }
+
+  bool compile_set_or_define(bool define, const Object& rest) {
+    u32 count = 0;
+    if (!simple_args(rest, &count) || count != 2) {
+      return false;
+    }
+    auto sym = rest.as_pair()->car;
+    if (!sym.is_symbol()) {
+      return false;
+    }
+    compile_form(rest.as_pair()->cdr.as_pair()->car);
+    u32 depth, slot;
+    if (!define && resolve_local(sym, &depth, &slot)) {
+      emit(BytecodeOp::SET_LOCAL, depth, slot, add_const(sym));
+    } else {
+      emit(define ? BytecodeOp::DEFINE : BytecodeOp::SET, add_const(sym));
+    }
+    return true;
+  }
+
+  bool compile_lambda(const Object& form, const Object& rest) {
+    // check the lambda the same way eval_lambda does. The argument list is only parsed once.
+    if (!rest.is_pair() || !rest.as_pair()->cdr.is_pair()) {
+      return false;
+    }
+    Object arg_list = rest.as_pair()->car;
+    if (!arg_list.is_pair() && !arg_list.is_empty_list()) {
+      return false;
+    }
+
+    auto lambda = std::make_shared<LambdaObject>();
+    try {
+      lambda->args = m_interp->parse_arg_spec(form, arg_list);
+    } catch (std::runtime_error&) {
+      return false;
+    }
+    lambda->body = rest.as_pair()->cdr;
+    // the lambda is created in the frame running this code, so its parent frames are ours.
+    std::vector<const FrameLayout*> scopes = {lambda->args.frame_layout.get()};
+    scopes.insert(scopes.end(), m_scopes.begin(), m_scopes.end());
+    lambda->bytecode = m_interp->compile_body(lambda->body, scopes);
+    m_bc->lambdas.push_back(lambda);
+    emit(BytecodeOp::MAKE_LAMBDA, m_bc->lambdas.size() - 1);
+    return true;
+  }
+
+  bool compile_cond(const Object& rest) {
+    u32 count = 0;
+    if (!rest.is_pair() || !proper_list_length(rest, &count)) {
+      return false;
+    }
+    for (Object current = rest; current.is_pair(); current = current.as_pair()->cdr) {
+      auto clause = current.as_pair()->car;
+      if (!clause.is_pair() || !proper_list_length(clause.as_pair()->cdr, &count)) {
+        return false;
+      }
+    }
+
+    std::vector<u32> end_jumps;
+    for (Object current = rest; current.is_pair(); current = current.as_pair()->cdr) {
+      auto clause = current.as_pair()->car;
+      auto body = clause.as_pair()->cdr;
+      compile_form(clause.as_pair()->car);
+      if (body.is_empty_list()) {
+        // the value of the condition is the result
+        end_jumps.push_back(emit(BytecodeOp::JUMP_IF_TRUE_KEEP));
+      } else {
+        auto next = emit(BytecodeOp::JUMP_IF_FALSE);
+        compile_body(clause, body);
+        end_jumps.push_back(emit(BytecodeOp::JUMP));
+        patch_a(next, here());
+      }
+    }
+    emit(BytecodeOp::PUSH_CONST, add_const(m_interp->intern("#f")));
+    for (auto jump : end_jumps) {
+      patch_a(jump, here());
+    }
+    return true;
+  }
+
+  bool compile_and_or(bool is_and, const Object& rest) {
+    u32 count = 0;
+    if (!rest.is_pair() || !proper_list_length(rest, &count)) {
+      return false;
+    }
+
+    // the only false value is #f, so the value that ends the and/or can always be the result.
+    std::vector<u32> end_jumps;
+    for (Object current = rest; current.is_pair(); current = current.as_pair()->cdr) {
+      compile_form(current.as_pair()->car);
+      if (!current.as_pair()->cdr.is_empty_list()) {
+        end_jumps.push_back(
+            emit(is_and ? BytecodeOp::JUMP_IF_FALSE_KEEP : BytecodeOp::JUMP_IF_TRUE_KEEP));
+      }
+    }
+    for (auto jump : end_jumps) {
+      patch_a(jump, here());
+    }
+    return true;
+  }
+
+  bool compile_quasiquote(const Object& rest) {
+    if (!rest.is_pair() || !rest.as_pair()->cdr.is_empty_list()) {
+      return false;
+    }
+    auto list = rest.as_pair()->car;
+    if (!valid_quasiquote(list)) {
+      return false;
+    }
+    compile_quasiquote_list(list);
+    return true;
+  }
+
+  void compile_quasiquote_list(const Object& list) {
+    emit(BytecodeOp::QQ_BEGIN);
+    for (Object current = list; current.is_pair(); current = current.as_pair()->cdr) {
+      auto item = current.as_pair()->car;
+      if (item.is_pair()) {
+        auto item_head = item.as_pair()->car;
+        if (is_symbol_named(item_head, "unquote")) {
+          compile_form(item.as_pair()->cdr.as_pair()->car);
+          emit(BytecodeOp::QQ_ADD);
+        } else if (is_symbol_named(item_head, "unquote-splicing")) {
+          compile_form(item.as_pair()->cdr.as_pair()->car);
+          emit(BytecodeOp::QQ_SPLICE, add_const(list));
+        } else {
+          compile_quasiquote_list(item);
+          emit(BytecodeOp::QQ_ADD);
+        }
+      } else {
+        emit(BytecodeOp::PUSH_CONST, add_const(item));
+        emit(BytecodeOp::QQ_ADD);
+      }
+    }
+    emit(BytecodeOp::QQ_END);
+  }
+
+  bool compile_while(const Object& rest) {
+    u32 count = 0;
+    if (!rest.is_pair() || !rest.as_pair()->cdr.is_pair() ||
+        !proper_list_length(rest.as_pair()->cdr, &count)) {
+      return false;
+    }
+
+    // the value of the last iteration's body is kept on the stack.
+    emit(BytecodeOp::PUSH_CONST, add_const(m_interp->intern("#f")));
+    auto loop = here();
+    compile_form(rest.as_pair()->car);
+    auto exit = emit(BytecodeOp::JUMP_IF_FALSE);
+    emit(BytecodeOp::POP);
+    compile_body(rest, rest.as_pair()->cdr);
+    emit(BytecodeOp::JUMP, loop);
+    patch_a(exit, here());
+    return true;
+  }
+
+  Interpreter* m_interp = nullptr;
+  Bytecode* m_bc = nullptr;
+  // the layouts of the frames the code runs in, starting with its own. Frames after these are
+  // only known at runtime.
+  std::vector<const FrameLayout*> m_scopes;
+};
+
+/*!
+ * Compile the body of a lambda or macro. scopes are the layouts of the frames it will run in that
+ * are known now, starting with its own.
+ */
+std::shared_ptr<const Bytecode> Interpreter::compile_body(
+    const Object& body,
+    const std::vector<const FrameLayout*>& scopes) {
+  auto bc = std::make_shared<Bytecode>();
+  BytecodeCompiler compiler(this, bc.get(), scopes);
+  compiler.compile_body(body, body);
+  return bc;
+}
+
+/*!
+ * Evaluate the body of a lambda in env, which should already contain the arguments.
+ */
+Object Interpreter::eval_body(LambdaObject& lambda, const std::shared_ptr<EnvironmentObject>& env) {
+  if (!use_bytecode) {
+    return eval_list_return_last(lambda.body, lambda.body, env);
+  }
+  if (!lambda.bytecode) {
+    lambda.bytecode = compile_body(lambda.body, {lambda.args.frame_layout.get()});
+  }
+  return run_bytecode(*lambda.bytecode, env);
+}
+
+/*!
+ * Evaluate the body of a macro in env, which should already contain the arguments. This returns
+ * the expanded code, which has not been evaluated.
+ */
+Object Interpreter::eval_body(MacroObject& macro, const std::shared_ptr<EnvironmentObject>& env) {
+  if (!use_bytecode) {
+    return eval_list_return_last(macro.body, macro.body, env);
+  }
+  if (!macro.bytecode) {
+    macro.bytecode = compile_body(macro.body, {macro.args.frame_layout.get()});
+  }
+  return run_bytecode(*macro.bytecode, env);
+}
+
+/*!
+ * Run compiled code, and return the value it leaves on the stack.
+ */
+Object Interpreter::run_bytecode(const Bytecode& bc,
+                                 const std::shared_ptr<EnvironmentObject>& env) {
+  // the stacks are shared by all running bytecode. Clean up our part, even if there's an error.
+  struct StackRestore {
+    std::vector<Object>* stack;
+    std::vector<std::vector<Object>>* qq_stack;
+    size_t stack_size, qq_size;
+    ~StackRestore() {
+      stack->resize(stack_size);
+      qq_stack->resize(qq_size);
+    }
+  } restore{&vm_stack, &vm_qq_stack, vm_stack.size(), vm_qq_stack.size()};
+  auto& stack = vm_stack;
+
+  u32 pc = 0;
+  while (pc < bc.code.size()) {
+    const auto& instr = bc.code[pc++];
+    switch (instr.op) {
+      case BytecodeOp::PUSH_CONST:
+        stack.push_back(bc.consts[instr.a]);
+        break;
+      case BytecodeOp::LOAD: {
+        Object value;
+        if (!try_symbol_lookup(bc.consts[instr.a], env, &value)) {
+          throw_eval_error(bc.consts[instr.a], "symbol is not defined");
+        }
+        stack.push_back(std::move(value));
+      } break;
+      case BytecodeOp::LOAD_LOCAL: {
+        const auto& sym = bc.consts[instr.c];
+        auto var = find_local(env.get(), instr.a, instr.b, sym.heap_obj.get());
+        if (var) {
+          stack.push_back(*var);
+        } else {
+          Object value;
+          if (!try_symbol_lookup(sym, env, &value)) {
+            throw_eval_error(sym, "symbol is not defined");
+          }
+          stack.push_back(std::move(value));
+        }
+      } break;
+      case BytecodeOp::POP:
+        stack.pop_back();
+        break;
+      case BytecodeOp::JUMP:
+        pc = instr.a;
+        break;
+      case BytecodeOp::JUMP_IF_FALSE: {
+        bool value = truthy(stack.back());
+        stack.pop_back();
+        if (!value) {
+          pc = instr.a;
+        }
+      } break;
+      case BytecodeOp::JUMP_IF_FALSE_KEEP:
+        if (!truthy(stack.back())) {
+          pc = instr.a;
+        } else {
+          stack.pop_back();
+        }
+        break;
+      case BytecodeOp::JUMP_IF_TRUE_KEEP:
+        if (truthy(stack.back())) {
+          pc = instr.a;
+        } else {
+          stack.pop_back();
+        }
+        break;
+      case BytecodeOp::SET:
+      case BytecodeOp::SET_LOCAL: {
+        const auto& sym_obj = bc.consts[instr.op == BytecodeOp::SET ? instr.a : instr.c];
+        Object* var = nullptr;
+        if (instr.op == BytecodeOp::SET_LOCAL) {
+          var = find_local(env.get(), instr.a, instr.b, sym_obj.heap_obj.get());
+        }
+        auto sym = sym_obj.as_symbol();
+        for (auto search_env = env.get(); search_env && !var;
+             search_env = search_env->parent_env.get()) {
+          var = search_env->find_var(sym);
+        }
+        if (!var) {
+          throw_eval_error(sym_obj, "symbol is not defined");
+        }
+        *var = stack.back();
+      } break;
+      case BytecodeOp::DEFINE:
+        env->set_var(bc.consts[instr.a].as_symbol(), stack.back());
+        break;
+      case BytecodeOp::BUILTIN: {
+        Arguments args;
+        args.unnamed.assign(std::make_move_iterator(stack.end() - instr.b),
+                            std::make_move_iterator(stack.end()));
+        stack.resize(stack.size() - instr.b);
+        stack.push_back(((*this).*(bc.builtins[instr.a]))(bc.consts[instr.c], args, env));
+      } break;
+      case BytecodeOp::MACRO_OR_HEAD: {
+        const auto& form = bc.consts[instr.a];
+        const auto& head = form.as_pair()->car;
+        Object value;
+        if (!try_symbol_lookup(head, env, &value)) {
+          throw_eval_error(head, "symbol is not defined");
+        }
+        if (value.is_macro()) {
+          // same as eval_pair.
+          auto macro = value.as_macro();
+          Arguments args = get_args(form, form.as_pair()->cdr, macro->args);
+          auto mac_env_obj = EnvironmentObject::make_new();
+          auto mac_env = mac_env_obj.as_env();
+          mac_env->parent_env = env;
+          set_args_in_env(form, args, macro->args, mac_env);
+          stack.push_back(eval_with_rewind(eval_body(*macro, mac_env), env));
+          pc = instr.b;
+        } else {
+          stack.push_back(std::move(value));
+        }
+      } break;
+      case BytecodeOp::CHECK_CALL: {
+        const auto& form = bc.consts[instr.a];
+        if (stack.back().type != ObjectType::LAMBDA) {
+          throw_eval_error(form, "head of form didn't evaluate to lambda");
+        }
+        auto lam = stack.back().as_lambda();
+        const auto& spec = lam->args;
+        if (!spec.named.empty() || instr.b < spec.unnamed.size() ||
+            (instr.b > spec.unnamed.size() && spec.rest.empty())) {
+          // let get_args handle key arguments and report errors, and evaluate as eval_pair would.
+          Arguments args = get_args(form, form.as_pair()->cdr, spec);
+          eval_args(&args, env);
+          auto lam_env_obj = EnvironmentObject::make_new();
+          auto lam_env = lam_env_obj.as_env();
+          lam_env->parent_env = lam->parent_env;
+          set_args_in_env(form, args, spec, lam_env);
+          stack.back() = eval_body(*lam, lam_env);
+          pc = instr.c;
+        }
+      } break;
+      case BytecodeOp::CALL: {
+        auto lam = (stack.end() - instr.b - 1)->as_lambda();
+        const auto& spec = lam->args;
+        Arguments args;
+        auto unnamed_end = stack.end() - (instr.b - spec.unnamed.size());
+        args.unnamed.assign(std::make_move_iterator(stack.end() - instr.b),
+                            std::make_move_iterator(unnamed_end));
+        args.rest.assign(std::make_move_iterator(unnamed_end),
+                         std::make_move_iterator(stack.end()));
+        stack.resize(stack.size() - instr.b - 1);
+        auto lam_env_obj = EnvironmentObject::make_new();
+        auto lam_env = lam_env_obj.as_env();
+        lam_env->parent_env = lam->parent_env;
+        set_args_in_env(bc.consts[instr.a], args, spec, lam_env);
+        stack.push_back(eval_body(*lam, lam_env));
+      } break;
+      case BytecodeOp::MAKE_LAMBDA: {
+        const auto& templ = bc.lambdas[instr.a];
+        auto obj = LambdaObject::make_new();
+        auto lam = obj.as_lambda();
+        lam->args = templ->args;
+        lam->body = templ->body;
+        lam->bytecode = templ->bytecode;
+        lam->parent_env = env;
+        stack.push_back(std::move(obj));
+      } break;
+      case BytecodeOp::QQ_BEGIN:
+        vm_qq_stack.emplace_back();
+        break;
+      case BytecodeOp::QQ_ADD:
+        vm_qq_stack.back().push_back(std::move(stack.back()));
+        stack.pop_back();
+        break;
+      case BytecodeOp::QQ_SPLICE: {
+        Object to_add = std::move(stack.back());
+        stack.pop_back();
+        auto& list = vm_qq_stack.back();
+        for (;;) {
+          if (to_add.is_pair()) {
+            list.push_back(to_add.as_pair()->car);
+            to_add = to_add.as_pair()->cdr;
+          } else if (to_add.is_empty_list()) {
+            break;
+          } else {
+            throw_eval_error(bc.consts[instr.a], "malformed unquote-splicing result");
+          }
+        }
+      } break;
+      case BytecodeOp::QQ_END:
+        stack.push_back(build_list(vm_qq_stack.back()));
+        vm_qq_stack.pop_back();
+        break;
+      case BytecodeOp::EVAL_FORM:
+        stack.push_back(eval_with_rewind(bc.consts[instr.a], env));
+        break;
+      case BytecodeOp::EVAL_BODY:
+        stack.push_back(eval_list_return_last(bc.consts[instr.a], bc.consts[instr.b], env));
+        break;
+      default:
+        assert(false);
+    }
+  }
+
+  return stack.back();
+}
+
+namespace {
+// macros that use other macros to build their expansion are only checked this deep.
+constexpr int MAX_PURITY_DEPTH = 8;
+
+/*!
+ * Built-in forms that have no side effects, and whose result only depends on their arguments.
+ * error is allowed because a macro expansion that fails is never reused.
+ */
+bool is_pure_builtin(const std::string& name) {
+  static const std::unordered_set<std::string> pure_builtins = {
+      "begin", "eq?", "cons", "car", "cdr", "+", "-", "*", "/", "=", "<", ">", "<=", ">=", "null?",
+      "type?", "error"};
+  return pure_builtins.find(name) != pure_builtins.end();
+}
+
+bool is_argument(const Object& sym, const ArgumentSpec& args) {
+  if (!args.frame_layout) {
+    return false;
+  }
+  for (auto& arg : *args.frame_layout) {
+    if (arg == sym.heap_obj) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+/*!
+ * Can we prove that expanding this macro has no side effects, and that the expansion only depends
+ * on the arguments? Macros marked with set-macro-pure! always are. Otherwise the compiled body may
+ * only read its arguments, build lists and use the built-in forms in is_pure_builtin. Other macros
+ * (like if) may be used if they are pure too, and what they expand to is also checked.
+ *
+ * The result depends on the definitions of these other macros, so their names and the macros are
+ * added to used_macros. If any of these are redefined, the macro must be checked again.
+ */
+bool Interpreter::macro_is_pure(MacroObject& macro,
+                                std::vector<std::pair<Object, Object>>* used_macros) {
+  return macro_is_pure(macro, 0, used_macros);
+}
+
+bool Interpreter::macro_is_pure(MacroObject& macro,
+                                int depth,
+                                std::vector<std::pair<Object, Object>>* used_macros) {
+  if (macro.pure) {
+    return true;
+  }
+  if (depth > MAX_PURITY_DEPTH) {
+    return false;
+  }
+  if (!macro.bytecode) {
+    macro.bytecode = compile_body(macro.body, {macro.args.frame_layout.get()});
+  }
+  return bytecode_is_pure(*macro.bytecode, macro.args, depth, used_macros);
+}
+
+bool Interpreter::bytecode_is_pure(const Bytecode& bc,
+                                   const ArgumentSpec& args,
+                                   int depth,
+                                   std::vector<std::pair<Object, Object>>* used_macros) {
+  u32 pc = 0;
+  while (pc < bc.code.size()) {
+    const auto& instr = bc.code[pc++];
+    switch (instr.op) {
+      case BytecodeOp::PUSH_CONST:
+      case BytecodeOp::POP:
+      case BytecodeOp::JUMP:
+      case BytecodeOp::JUMP_IF_FALSE:
+      case BytecodeOp::JUMP_IF_FALSE_KEEP:
+      case BytecodeOp::JUMP_IF_TRUE_KEEP:
+      case BytecodeOp::QQ_BEGIN:
+      case BytecodeOp::QQ_ADD:
+      case BytecodeOp::QQ_SPLICE:
+      case BytecodeOp::QQ_END:
+        break;
+      case BytecodeOp::LOAD:
+        if (!is_argument(bc.consts[instr.a], args)) {
+          return false;
+        }
+        break;
+      case BytecodeOp::LOAD_LOCAL:
+        // only the arguments of the macro itself.
+        if (instr.a != 0 || !is_argument(bc.consts[instr.c], args)) {
+          return false;
+        }
+        break;
+      case BytecodeOp::BUILTIN:
+        if (!is_pure_builtin(bc.consts[instr.c].as_pair()->car.as_symbol()->name)) {
+          return false;
+        }
+        break;
+      case BytecodeOp::MACRO_OR_HEAD: {
+        // only a macro from the global environment, which will be expanded on every evaluation.
+        const auto& form = bc.consts[instr.a];
+        const auto& head = form.as_pair()->car;
+        if (is_argument(head, args)) {
+          return false;
+        }
+        auto value = global_environment.as_env()->find_var(head.as_symbol());
+        if (!value || !value->is_macro()) {
+          return false;
+        }
+        auto macro = value->as_macro();
+        if (!macro_is_pure(*macro, depth + 1, used_macros)) {
+          return false;
+        }
+        used_macros->emplace_back(head, *value);
+
+        // the macro is pure, so it always expands this form to the same code. Check that code.
+        Object expansion;
+        try {
+          Arguments macro_args = get_args(form, form.as_pair()->cdr, macro->args);
+          auto mac_env_obj = EnvironmentObject::make_new();
+          auto mac_env = mac_env_obj.as_env();
+          mac_env->parent_env = global_environment.as_env();
+          set_args_in_env(form, macro_args, macro->args, mac_env);
+          expansion = eval_body(*macro, mac_env);
+        } catch (std::runtime_error&) {
+          return false;
+        }
+        auto expansion_code =
+            compile_body(PairObject::make_new(expansion, EmptyListObject::make_new()));
+        if (!bytecode_is_pure(*expansion_code, args, depth + 1, used_macros)) {
+          return false;
+        }
+        // skip the code for calling a lambda.
+        pc = instr.b;
+      } break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * Disassemble, for debugging.
+ */
+std::string Bytecode::print() const {
+  static const char* names[] = {"push-const",
+                                 "load",
+                                 "load-local",
+                                 "pop",
+                                 "jump",
+                                 "jump-if-false",
+                                 "jump-if-false-keep",
+                                 "jump-if-true-keep",
+                                 "set",
+                                 "set-local",
+                                 "define",
+                                 "builtin",
+                                 "macro-or-head",
+                                 "check-call",
+                                 "call",
+                                 "make-lambda",
+                                 "qq-begin",
+                                 "qq-add",
+                                 "qq-splice",
+                                 "qq-end",
+                                 "eval-form",
+                                 "eval-body"};
+  std::string result;
+  for (size_t i = 0; i < code.size(); i++) {
+    auto& instr = code[i];
+    result += fmt::format("{:4d} {} {} {} {}", i, names[(int)instr.op], instr.a, instr.b, instr.c);
+    switch (instr.op) {
+      case BytecodeOp::PUSH_CONST:
+      case BytecodeOp::LOAD:
+      case BytecodeOp::SET:
+      case BytecodeOp::DEFINE:
+      case BytecodeOp::MACRO_OR_HEAD:
+      case BytecodeOp::EVAL_FORM:
+      case BytecodeOp::EVAL_BODY:
+        result += " ; " + consts.at(instr.a).print();
+        break;
+      case BytecodeOp::LOAD_LOCAL:
+      case BytecodeOp::SET_LOCAL:
+        result += " ; " + consts.at(instr.c).print();
+        break;
+      default:
+        break;
+    }
+    result += "\n";
+  }
+  return result;
+}
+
+}  // namespace goos
@@ -0,0 +1,83 @@
+#pragma once
+
+/*!
+ * @file Bytecode.h
+ * Compiled form of GOOS lambda and macro bodies.
+ *
+ * The first time a lambda or macro is called, its body is compiled into a list of instructions for
+ * a small stack machine (see Interpreter::compile_body and Interpreter::run_bytecode). This does
+ * the work of finding special forms and built-in forms, checking the shape of special forms and
+ * parsing the argument lists of nested lambdas once, instead of on every evaluation.
+ *
+ * Arguments of the lambda, and of the lambdas it is nested in, are found by their (depth, slot)
+ * address, which is resolved when the body is compiled. Other variables, and any variable that a
+ * define at runtime could shadow, are looked up by name.
+ *
+ * The result is the same as evaluating the body with Interpreter::eval, including which errors
+ * happen and when. Anything that the compiler doesn't handle (malformed forms, keyword arguments,
+ * rare special forms) is compiled to EVAL_FORM, which uses eval. Macro expansions are always
+ * evaluated with eval.
+ */
+
+#include <memory>
+#include <vector>
+#include "Object.h"
+
+namespace goos {
+
+class Interpreter;
+
+enum class BytecodeOp : u8 {
+  PUSH_CONST,          // push consts[a]
+  LOAD,                // push the value of the symbol consts[a]
+  LOAD_LOCAL,          // push slot b of the frame a levels up, which should be the symbol consts[c]
+  POP,                 // pop and discard
+  JUMP,                // jump to a
+  JUMP_IF_FALSE,       // pop, jump to a if false
+  JUMP_IF_FALSE_KEEP,  // jump to a if the top is false, otherwise pop
+  JUMP_IF_TRUE_KEEP,   // jump to a if the top is true, otherwise pop
+  SET,                 // set! the symbol consts[a] to the top
+  SET_LOCAL,           // set! slot b of the frame a levels up, which should be the symbol consts[c]
+  DEFINE,              // define the symbol consts[a] as the top, in the current environment
+  BUILTIN,             // pop b arguments and call builtins[a] for the form consts[c]
+  MACRO_OR_HEAD,       // expand the form consts[a] and jump to b if its head is a macro, otherwise
+                       // push the value of the head
+  CHECK_CALL,          // check the lambda call consts[a] with b arguments. If it can't use CALL,
+                       // replace the head with the result of calling it with eval and jump to c
+  CALL,                // pop b arguments and a lambda, and call it for the form consts[a]
+  MAKE_LAMBDA,         // push a new lambda from lambdas[a]
+  QQ_BEGIN,            // start a new list for quasiquote
+  QQ_ADD,              // pop and add to the current list
+  QQ_SPLICE,           // pop a list and add its elements to the current list. consts[a] is the
+                       // quasiquoted list, for errors
+  QQ_END,              // push the current list
+  EVAL_FORM,           // push the result of eval on the form consts[a]
+  EVAL_BODY,           // push the result of eval_list_return_last on the body consts[b] of the
+                       // form consts[a]
+};
+
+struct BytecodeInstr {
+  BytecodeOp op;
+  u32 a = 0;
+  u32 b = 0;
+  u32 c = 0;
+};
+
+// the argument symbols of a lambda or macro, in the order of the slots of its frames.
+using FrameLayout = std::vector<std::shared_ptr<SymbolObject>>;
+
+using BuiltinFunction = Object (Interpreter::*)(const Object& form,
+                                                 Arguments& args,
+                                                 const std::shared_ptr<EnvironmentObject>& env);
+
+struct Bytecode {
+  std::vector<BytecodeInstr> code;
+  std::vector<Object> consts;
+  std::vector<BuiltinFunction> builtins;
+  // lambdas created in this body. The parent_env is set when they are created.
+  std::vector<std::shared_ptr<const LambdaObject>> lambdas;
+
+  std::string print() const;
+};
+
+}  // namespace goos
@@ -68,7 +68,8 @@ Interpreter::Interpreter() {
                    {"type?", &Interpreter::eval_type},
                    {"current-method-type", &Interpreter::eval_current_method_type},
                    {"fmt", &Interpreter::eval_format},
-                   {"error", &Interpreter::eval_error}};
+                   {"error", &Interpreter::eval_error},
+                   {"set-macro-pure!", &Interpreter::eval_set_macro_pure}};
 
   string_to_type = {{"empty-list", ObjectType::EMPTY_LIST},
                     {"integer", ObjectType::INTEGER},
@@ -100,6 +101,15 @@ void Interpreter::disable_printfs() {
   disable_printing = true;
 }
 
+/*!
+ * Save or load the global and goal environments (and everything defined in them).
+ */
+void Interpreter::serialize_state(ObjectSerializer& ser) {
+  ser.from_object(&global_environment);
+  ser.from_object(&goal_env);
+  ser.ser().from_pod(&gensym_id);
+}
+
 /*!
  * Load the goos library, by interpreting (load-file "goal_src/goos-lib.gs") in the global env.
  */
@@ -368,6 +378,7 @@ ArgumentSpec Interpreter::parse_arg_spec(const Object& form, Object& rest) {
 
     current = current.as_pair()->cdr;
   }
+  spec.build_frame_layout(reader.symbolTable);
   return spec;
 }
 
@@ -439,39 +450,31 @@ Object Interpreter::eval(Object obj, const std::shared_ptr<EnvironmentObject>& e
   }
 }
 
-namespace {
-
 /*!
  * Try to find a symbol in an env or parent env. If successful, set dest and return true. Otherwise
  * return false.
  */
-bool try_symbol_lookup(const Object& sym,
-                       const std::shared_ptr<EnvironmentObject>& env,
-                       Object* dest) {
+bool Interpreter::try_symbol_lookup(const Object& sym,
+                                    const std::shared_ptr<EnvironmentObject>& env,
+                                    Object* dest) {
+  auto symbol = sym.as_symbol();
   // booleans are hard-coded here
-  if (sym.as_symbol()->name == "#t" || sym.as_symbol()->name == "#f") {
+  const auto& name = symbol->name;
+  if (name.size() == 2 && name[0] == '#' && (name[1] == 't' || name[1] == 'f')) {
     *dest = sym;
     return true;
   }
 
-  // loop up envs until we find it.
-  std::shared_ptr<EnvironmentObject> search_env = env;
-  for (;;) {
-    auto kv = search_env->vars.find(sym.as_symbol());
-    if (kv != search_env->vars.end()) {
-      *dest = kv->second;
+  // loop up envs until we find it. Lambda and macro frames are checked by slot before the map.
+  for (auto search_env = env.get(); search_env; search_env = search_env->parent_env.get()) {
+    auto var = search_env->find_var(symbol);
+    if (var) {
+      *dest = *var;
       return true;
     }
-
-    auto pe = search_env->parent_env;
-    if (pe) {
-      search_env = pe;
-    } else {
-      return false;
-    }
   }
+  return false;
 }
-}  // namespace
 
 /*!
  * Evaluate a symbol by finding the closest scoped variable with matching name.
@@ -522,7 +525,7 @@ Object Interpreter::eval_pair(const Object& obj, const std::shared_ptr<Environme
       mac_env->parent_env = env;  // not 100% clear that this is right
       set_args_in_env(obj, args, macro->args, mac_env);
       // expand the macro!
-      return eval_with_rewind(eval_list_return_last(macro->body, macro->body, mac_env), env);
+      return eval_with_rewind(eval_body(*macro, mac_env), env);
     }
   }
 
@@ -539,7 +542,7 @@ Object Interpreter::eval_pair(const Object& obj, const std::shared_ptr<Environme
   auto lam_env = lam_env_obj.as_env();
   lam_env->parent_env = lam->parent_env;
   set_args_in_env(obj, args, lam->args, lam_env);
-  return eval_list_return_last(lam->body, lam->body, lam_env);
+  return eval_body(*lam, lam_env);
 }
 
 /*!
@@ -560,20 +563,25 @@ void Interpreter::set_args_in_env(const Object& form,
                                std::to_string(arg_spec.unnamed.size()) + ")");
   }
 
+  // the arguments are stored in slots, in the order of the spec's frame layout.
+  const auto& layout = *arg_spec.frame_layout;
+  env->slot_names = arg_spec.frame_layout;
+  env->slots.reserve(layout.size());
+
   // unnamed args
   for (size_t i = 0; i < arg_spec.unnamed.size(); i++) {
-    env->vars[intern(arg_spec.unnamed.at(i)).as_symbol()] = args.unnamed.at(i);
+    env->slots.push_back(args.unnamed.at(i));
   }
 
   // named args
-  for (const auto& kv : arg_spec.named) {
-    env->vars[intern(kv.first).as_symbol()] = args.named.at(kv.first);
+  for (size_t i = 0; i < arg_spec.named.size(); i++) {
+    env->slots.push_back(args.named.at(layout.at(arg_spec.unnamed.size() + i)->name));
   }
 
   // rest args
   if (!arg_spec.rest.empty()) {
     // will correctly handle the '() case
-    env->vars[intern(arg_spec.rest).as_symbol()] = build_list(args.rest);
+    env->slots.push_back(build_list(args.rest));
   } else {
     if (!args.rest.empty()) {
       throw_eval_error(form, "got too many arguments");
@@ -598,7 +606,7 @@ Object Interpreter::eval_define(const Object& form,
   }
 
   Object value = eval_with_rewind(args.unnamed[1], env);
-  define_env->vars[args.unnamed[0].as_symbol()] = value;
+  define_env->set_var(args.unnamed[0].as_symbol(), value);
   return value;
 }
 
@@ -614,21 +622,16 @@ Object Interpreter::eval_set(const Object& form,
   auto to_define = args.unnamed.at(0);
   Object to_set = eval_with_rewind(args.unnamed.at(1), env);
 
-  std::shared_ptr<EnvironmentObject> search_env = env;
-  for (;;) {
-    auto kv = search_env->vars.find(to_define.as_symbol());
-    if (kv != search_env->vars.end()) {
-      kv->second = to_set;
-      return kv->second;
-    }
-
-    auto pe = search_env->parent_env;
-    if (pe) {
-      search_env = pe;
-    } else {
-      throw_eval_error(to_define, "symbol is not defined");
+  auto sym = to_define.as_symbol();
+  for (auto search_env = env.get(); search_env; search_env = search_env->parent_env.get()) {
+    auto var = search_env->find_var(sym);
+    if (var) {
+      *var = to_set;
+      return to_set;
     }
   }
+  throw_eval_error(to_define, "symbol is not defined");
+  return Object();
 }
 
 /*!
@@ -1517,4 +1520,17 @@ Object Interpreter::eval_error(const Object& form,
   throw_eval_error(form, "Error: " + args.unnamed.at(0).as_string()->data);
   return EmptyListObject::make_new();
 }
+
+/*!
+ * Promise that a macro has no side effects, and that its expansion only depends on its arguments.
+ * This lets the compiler reuse expansions of the same arguments. Returns the macro.
+ */
+Object Interpreter::eval_set_macro_pure(const Object& form,
+                                        Arguments& args,
+                                        const std::shared_ptr<EnvironmentObject>& env) {
+  (void)env;
+  vararg_check(form, args, {ObjectType::MACRO}, {});
+  args.unnamed.at(0).as_macro()->pure = true;
+  return args.unnamed.at(0);
+}
 }  // namespace goos
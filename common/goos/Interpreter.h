@@ -9,6 +9,8 @@
 #include <optional>
 #include "Object.h"
 #include "Reader.h"
+#include "ObjectSerializer.h"
+#include "Bytecode.h"
 
 namespace goos {
 class Interpreter {
@@ -31,7 +33,12 @@ class Interpreter {
   Object eval_list_return_last(const Object& form,
                                Object rest,
                                const std::shared_ptr<EnvironmentObject>& env);
+  Object eval_body(LambdaObject& lambda, const std::shared_ptr<EnvironmentObject>& env);
+  Object eval_body(MacroObject& macro, const std::shared_ptr<EnvironmentObject>& env);
+  void set_bytecode_enabled(bool enabled) { use_bytecode = enabled; }
+  bool macro_is_pure(MacroObject& macro, std::vector<std::pair<Object, Object>>* used_macros);
   bool truthy(const Object& o);
+  void serialize_state(ObjectSerializer& ser);
 
   Reader reader;
   Object global_environment;
@@ -46,6 +53,7 @@ class Interpreter {
 
  private:
   friend class Goal;
+  friend class BytecodeCompiler;
   void load_goos_library();
   void define_var_in_env(Object& env, Object& var, const std::string& name);
   void expect_env(const Object& form, const Object& o);
@@ -56,6 +64,19 @@ class Interpreter {
       const std::unordered_map<std::string, std::pair<bool, std::optional<ObjectType>>>& named);
 
   Object eval_pair(const Object& o, const std::shared_ptr<EnvironmentObject>& env);
+  bool try_symbol_lookup(const Object& sym,
+                         const std::shared_ptr<EnvironmentObject>& env,
+                         Object* dest);
+  std::shared_ptr<const Bytecode> compile_body(const Object& body,
+                                               const std::vector<const FrameLayout*>& scopes = {});
+  Object run_bytecode(const Bytecode& bc, const std::shared_ptr<EnvironmentObject>& env);
+  bool macro_is_pure(MacroObject& macro,
+                     int depth,
+                     std::vector<std::pair<Object, Object>>* used_macros);
+  bool bytecode_is_pure(const Bytecode& bc,
+                        const ArgumentSpec& args,
+                        int depth,
+                        std::vector<std::pair<Object, Object>>* used_macros);
   void eval_args(Arguments* args, const std::shared_ptr<EnvironmentObject>& env);
   ArgumentSpec parse_arg_spec(const Object& form, Object& rest);
 
@@ -183,6 +204,9 @@ class Interpreter {
   Object eval_error(const Object& form,
                     Arguments& args,
                     const std::shared_ptr<EnvironmentObject>& env);
+  Object eval_set_macro_pure(const Object& form,
+                            Arguments& args,
+                            const std::shared_ptr<EnvironmentObject>& env);
 
   // specials
   Object eval_define(const Object& form,
@@ -218,6 +242,10 @@ class Interpreter {
 
   bool want_exit = false;
   bool disable_printing = false;
+  // if false, lambda and macro bodies are evaluated directly with eval instead of compiled.
+  bool use_bytecode = true;
+  std::vector<Object> vm_stack;
+  std::vector<std::vector<Object>> vm_qq_stack;
 
   std::unordered_map<std::string,
                      Object (Interpreter::*)(const Object& form,
@@ -124,13 +124,32 @@ std::string fixed_to_string(char x) {
 /*!
  * Create a new symbol object by interning
  */
-Object SymbolObject::make_new(SymbolTable& st, const std::string& name) {
+Object SymbolObject::make_new(SymbolTable& st, std::string_view name) {
   Object obj;
   obj.type = ObjectType::SYMBOL;
   obj.heap_obj = st.intern(name);
   return obj;
 }
 
+/*!
+ * Move the symbols from another table into this one. If this table already has a symbol with the
+ * same name, the symbol from the other table is replaced by it. Returns the replacements, which
+ * must be applied to everything that uses the other table's symbols.
+ */
+SymbolTable::Replacements SymbolTable::merge(SymbolTable&& other) {
+  Replacements replacements;
+  for (auto& kv : other.table) {
+    auto existing = table.find(kv.first);
+    if (existing == table.end()) {
+      table.insert(kv);
+    } else {
+      replacements[kv.second.get()] = existing->second;
+    }
+  }
+  other.table.clear();
+  return replacements;
+}
+
 /*!
  * Build a list of objects from a vector of objects.
  */
@@ -177,8 +196,19 @@ bool Object::operator==(const Object& other) const {
 
     case ObjectType::EMPTY_LIST:
       return true;
-    case ObjectType::PAIR:
-      return as_pair()->car == other.as_pair()->car && as_pair()->cdr == other.as_pair()->cdr;
+    case ObjectType::PAIR: {
+      // walk down the list, recursing on each cdr would overflow the stack on long lists.
+      const Object* a = this;
+      const Object* b = &other;
+      while (a->is_pair() && b->is_pair()) {
+        if (!(a->as_pair()->car == b->as_pair()->car)) {
+          return false;
+        }
+        a = &a->as_pair()->cdr;
+        b = &b->as_pair()->cdr;
+      }
+      return *a == *b;
+    }
     case ObjectType::ARRAY: {
       auto a = as_array();
       auto b = other.as_array();
@@ -231,6 +261,24 @@ std::string ArgumentSpec::print() const {
   return result;
 }
 
+/*!
+ * Intern the argument names, in the order used for the slots of a lambda or macro call frame.
+ */
+void ArgumentSpec::build_frame_layout(SymbolTable& symbols) {
+  auto layout = std::make_shared<std::vector<std::shared_ptr<SymbolObject>>>();
+  layout->reserve(unnamed.size() + named.size() + (rest.empty() ? 0 : 1));
+  for (auto& arg : unnamed) {
+    layout->push_back(symbols.intern(arg));
+  }
+  for (auto& arg : named) {
+    layout->push_back(symbols.intern(arg.first));
+  }
+  if (!rest.empty()) {
+    layout->push_back(symbols.intern(rest));
+  }
+  frame_layout = std::move(layout);
+}
+
 std::string Arguments::print() const {
   std::string result = "  unnamed args:\n";
   for (auto& arg : unnamed) {
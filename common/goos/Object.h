@@ -7,7 +7,7 @@
  * An "Object" is an efficient wrapper around any of these types.
  * Some types are "heap allocated", and have reference semantics, and others are
  * "fixed" and have value semantics.  Heap allocated objects implement reference counting with
- * std::shared_ptr.
+ * std::shared_ptr, and are allocated from the pools in ObjectHeap.h.
  *
  * To create a new Object for a heap allocated type, use the make_new static method of the type of
  * object you want to make. This will return a correctly setup Object. For fixed objects, use
@@ -41,6 +41,7 @@
  */
 
 #include <string>
+#include <string_view>
 #include <cassert>
 #include <memory>
 #include <unordered_map>
@@ -50,6 +51,7 @@
 #include <stdexcept>
 #include <map>
 #include "common/common_types.h"
+#include "ObjectHeap.h"
 
 namespace goos {
 
@@ -225,14 +227,14 @@ class Object {
       throw std::runtime_error("as_pair called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<PairObject>(heap_obj);
+    return std::static_pointer_cast<PairObject>(heap_obj);
   }
 
   std::shared_ptr<EnvironmentObject> as_env() const {
     if (type != ObjectType::ENVIRONMENT) {
       throw std::runtime_error("as_env called on a " + object_type_to_string(type) + " " + print());
     }
-    return std::dynamic_pointer_cast<EnvironmentObject>(heap_obj);
+    return std::static_pointer_cast<EnvironmentObject>(heap_obj);
   }
 
   std::shared_ptr<SymbolObject> as_symbol() const {
@@ -240,7 +242,7 @@ class Object {
       throw std::runtime_error("as_symbol called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<SymbolObject>(heap_obj);
+    return std::static_pointer_cast<SymbolObject>(heap_obj);
   }
 
   std::shared_ptr<StringObject> as_string() const {
@@ -248,7 +250,7 @@ class Object {
       throw std::runtime_error("as_string called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<StringObject>(heap_obj);
+    return std::static_pointer_cast<StringObject>(heap_obj);
   }
 
   std::shared_ptr<LambdaObject> as_lambda() const {
@@ -256,7 +258,7 @@ class Object {
       throw std::runtime_error("as_lambda called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<LambdaObject>(heap_obj);
+    return std::static_pointer_cast<LambdaObject>(heap_obj);
   }
 
   std::shared_ptr<MacroObject> as_macro() const {
@@ -264,7 +266,7 @@ class Object {
       throw std::runtime_error("as_macro called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<MacroObject>(heap_obj);
+    return std::static_pointer_cast<MacroObject>(heap_obj);
   }
 
   std::shared_ptr<ArrayObject> as_array() const {
@@ -272,7 +274,7 @@ class Object {
       throw std::runtime_error("as_array called on a " + object_type_to_string(type) + " " +
                                print());
     }
-    return std::dynamic_pointer_cast<ArrayObject>(heap_obj);
+    return std::static_pointer_cast<ArrayObject>(heap_obj);
   }
 
   IntType& as_int() {
@@ -367,7 +369,7 @@ class SymbolObject : public HeapObject {
  public:
   std::string name;
   explicit SymbolObject(std::string _name) : name(std::move(_name)) {}
-  static Object make_new(SymbolTable& st, const std::string& name);
+  static Object make_new(SymbolTable& st, std::string_view name);
 
   std::string print() const override { return name; }
 
@@ -381,20 +383,27 @@ class SymbolObject : public HeapObject {
  */
 class SymbolTable {
  public:
-  std::shared_ptr<SymbolObject> intern(const std::string& name) {
+  // symbol that was replaced, symbol with the same name that replaces it
+  using Replacements = std::unordered_map<const SymbolObject*, std::shared_ptr<SymbolObject>>;
+
+  std::shared_ptr<SymbolObject> intern(std::string_view name) {
     auto kv = table.find(name);
     if (kv == table.end()) {
-      auto iter = table.insert({name, std::make_shared<SymbolObject>(name)});
-      return (*iter.first).second;
+      // the name is only copied the first time. The key refers to the symbol's copy.
+      auto sym = heap::make_object<SymbolObject>(std::string(name));
+      table.insert({sym->name, sym});
+      return sym;
     } else {
       return kv->second;
     }
   }
 
+  Replacements merge(SymbolTable&& other);
+
   ~SymbolTable() = default;
 
  private:
-  std::unordered_map<std::string, std::shared_ptr<SymbolObject>> table;
+  std::unordered_map<std::string_view, std::shared_ptr<SymbolObject>> table;
 };
 
 class StringObject : public HeapObject {
@@ -405,7 +414,7 @@ class StringObject : public HeapObject {
   static Object make_new(const std::string& text) {
     Object obj;
     obj.type = ObjectType::STRING;
-    obj.heap_obj = std::make_shared<StringObject>(text);
+    obj.heap_obj = heap::make_object<StringObject>(text);
     return obj;
   }
 
@@ -416,16 +425,22 @@ class StringObject : public HeapObject {
   ~StringObject() override = default;
 };
 
+// a pair linked to the source text with this id was destroyed, see TextDb.
+void unlink_source_text(u32 text_id);
+
 class PairObject : public HeapObject {
  public:
   Object car, cdr;
+  // where the list starting with this pair was read from, see TextDb. 0 if it wasn't read.
+  u32 text_id = 0;
+  u32 text_offset = 0;
 
   PairObject(Object car_, Object cdr_) : car(car_), cdr(cdr_) {}
 
   static Object make_new(Object a, Object b) {
     Object obj;
     obj.type = ObjectType::PAIR;
-    obj.heap_obj = std::make_shared<PairObject>(a, b);
+    obj.heap_obj = heap::make_object<PairObject>(a, b);
     return obj;
   }
 
@@ -448,9 +463,9 @@ class PairObject : public HeapObject {
 
     for (;;) {
       if (to_print.type == ObjectType::PAIR) {
-        Object to_print_car = std::dynamic_pointer_cast<PairObject>(to_print.heap_obj)->car;
+        Object to_print_car = std::static_pointer_cast<PairObject>(to_print.heap_obj)->car;
         result += to_print_car.print();
-        to_print = std::dynamic_pointer_cast<PairObject>(to_print.heap_obj)->cdr;
+        to_print = std::static_pointer_cast<PairObject>(to_print.heap_obj)->cdr;
         if (to_print.type == ObjectType::EMPTY_LIST) {
           result += ")";
           return result;
@@ -468,21 +483,71 @@ class PairObject : public HeapObject {
 
   std::string inspect() const override { return "[pair] " + print() + "\n"; }
 
-  ~PairObject() = default;
+  ~PairObject() {
+    if (text_id) {
+      unlink_source_text(text_id);
+    }
+    // free the rest of the list here, destroying cdr would recurse once per element.
+    while (cdr.is_pair() && cdr.heap_obj.use_count() == 1) {
+      auto next = std::move(cdr.heap_obj);
+      auto next_pair = static_cast<PairObject*>(next.get());
+      cdr = next_pair->cdr;
+      next_pair->cdr = Object();
+    }
+  }
 };
 
 class EnvironmentObject : public HeapObject {
  public:
   std::string name;
   std::shared_ptr<EnvironmentObject> parent_env;
+  // arguments of a lambda/macro call, stored by position in the argument spec's frame layout.
+  std::shared_ptr<const std::vector<std::shared_ptr<SymbolObject>>> slot_names;
+  std::vector<Object> slots;
+  // everything else, including all variables of the global environments.
   std::unordered_map<std::shared_ptr<SymbolObject>, Object> vars;
 
   EnvironmentObject() = default;
 
+  /*!
+   * Find a variable defined directly in this environment (not a parent). Returns nullptr if there
+   * is no such variable.
+   */
+  Object* find_var(const std::shared_ptr<SymbolObject>& sym) {
+    if (slot_names) {
+      // search backward so a repeated argument name refers to the last one, like the map did.
+      for (size_t i = slots.size(); i-- > 0;) {
+        if ((*slot_names)[i] == sym) {
+          return &slots[i];
+        }
+      }
+    }
+
+    if (!vars.empty()) {
+      auto kv = vars.find(sym);
+      if (kv != vars.end()) {
+        return &kv->second;
+      }
+    }
+    return nullptr;
+  }
+
+  /*!
+   * Set a variable in this environment, creating it if it doesn't exist.
+   */
+  void set_var(const std::shared_ptr<SymbolObject>& sym, const Object& value) {
+    auto existing = find_var(sym);
+    if (existing) {
+      *existing = value;
+    } else {
+      vars[sym] = value;
+    }
+  }
+
   static Object make_new() {
     Object obj;
     obj.type = ObjectType::ENVIRONMENT;
-    obj.heap_obj = std::make_shared<EnvironmentObject>();
+    obj.heap_obj = heap::make_object<EnvironmentObject>();
     return obj;
   }
 
@@ -490,7 +555,7 @@ class EnvironmentObject : public HeapObject {
                          std::shared_ptr<EnvironmentObject> parent_env = nullptr) {
     Object obj;
     obj.type = ObjectType::ENVIRONMENT;
-    auto env = std::make_shared<EnvironmentObject>();
+    auto env = heap::make_object<EnvironmentObject>();
     env->name = std::move(name);
     env->parent_env = std::move(parent_env);
     obj.heap_obj = std::move(env);
@@ -509,6 +574,9 @@ class EnvironmentObject : public HeapObject {
     std::string result = "[environment]\n  name: " + name +
                          "\n  parent: " + (parent_env ? parent_env->print() : "NONE") +
                          "\n  vars:\n";
+    for (size_t i = 0; i < slots.size(); i++) {
+      result += "    " + (*slot_names)[i]->print() + ": " + slots[i].print() + "\n";
+    }
     for (const auto& kv : vars) {
       result += "    " + kv.first->print() + ": " + kv.second.print() + "\n";
     }
@@ -526,7 +594,11 @@ struct ArgumentSpec {
   std::vector<std::string> unnamed;
   std::unordered_map<std::string, NamedArg> named;
   std::string rest;
+  // symbol for each argument in the order they are stored in a call's frame:
+  // unnamed, then named, then rest.
+  std::shared_ptr<const std::vector<std::shared_ptr<SymbolObject>>> frame_layout;
   std::string print() const;
+  void build_frame_layout(SymbolTable& symbols);
 };
 
 ArgumentSpec make_varargs();
@@ -546,19 +618,22 @@ struct Arguments {
   bool only_contains_named(const std::unordered_set<std::string>& names);
 };
 
+struct Bytecode;  // see Bytecode.h
+
 class LambdaObject : public HeapObject {
  public:
   std::string name;
   std::shared_ptr<EnvironmentObject> parent_env;
   Object body;
   ArgumentSpec args;
+  std::shared_ptr<const Bytecode> bytecode;  // compiled body, created when first needed
 
   LambdaObject() = default;
 
   static Object make_new() {
     Object obj;
     obj.type = ObjectType::LAMBDA;
-    obj.heap_obj = std::make_shared<LambdaObject>();
+    obj.heap_obj = heap::make_object<LambdaObject>();
     return obj;
   }
 
@@ -579,13 +654,15 @@ class MacroObject : public HeapObject {
   std::shared_ptr<EnvironmentObject> parent_env;
   Object body;
   ArgumentSpec args;
+  std::shared_ptr<const Bytecode> bytecode;  // compiled body, created when first needed
+  bool pure = false;  // set by set-macro-pure!, the expansion only depends on the arguments
 
   MacroObject() = default;
 
   static Object make_new() {
     Object obj;
     obj.type = ObjectType::MACRO;
-    obj.heap_obj = std::make_shared<MacroObject>();
+    obj.heap_obj = heap::make_object<MacroObject>();
     return obj;
   }
 
@@ -607,7 +684,7 @@ class ArrayObject : public HeapObject {
   static Object make_new(std::vector<Object> objects) {
     Object obj;
     obj.type = ObjectType::ARRAY;
-    obj.heap_obj = std::make_shared<ArrayObject>(std::move(objects));
+    obj.heap_obj = heap::make_object<ArrayObject>(std::move(objects));
     return obj;
   }
 
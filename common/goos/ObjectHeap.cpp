@@ -0,0 +1,206 @@
+/*!
+ * @file ObjectHeap.cpp
+ * Pooled allocation for GOOS heap objects.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "ObjectHeap.h"
+
+namespace goos {
+namespace heap {
+
+namespace {
+
+constexpr std::size_t SIZE_CLASS_COUNT = MAX_POOLED_SIZE / POOL_ALIGN + 1;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+/*!
+ * Per-thread pool. This must stay trivially destructible: objects may be freed during static
+ * destruction, after the thread's destructors have run.
+ */
+struct LocalPool {
+  FreeBlock* free_lists[SIZE_CLASS_COUNT];
+  u8* bump;
+  u8* bump_end;
+  bool exit_registered;
+};
+
+thread_local LocalPool t_pool;
+
+std::atomic<bool> g_pool_enabled{true};
+
+// all chunks ever allocated. They are never freed, but are kept here so they're still reachable.
+std::mutex g_chunk_mutex;
+std::vector<void*> g_chunks;
+
+/*!
+ * Free lists and unused chunk space left by threads that have exited, to be reused by other
+ * threads. Without this, every short-lived thread that touches GOOS objects would leak its pool.
+ * This is never destroyed, because threads may exit during static destruction.
+ */
+struct Depot {
+  std::mutex mutex;
+  std::vector<FreeBlock*> free_lists[SIZE_CLASS_COUNT];
+  std::vector<std::pair<u8*, u8*>> chunk_ends;  // start, end
+};
+
+Depot& depot() {
+  static Depot* depot = new Depot();
+  return *depot;
+}
+
+/*!
+ * Give the pool of an exiting thread to the depot.
+ */
+struct PoolExitHandler {
+  ~PoolExitHandler() {
+    auto& pool = t_pool;
+    auto& d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    for (std::size_t sc = 0; sc < SIZE_CLASS_COUNT; sc++) {
+      if (pool.free_lists[sc]) {
+        d.free_lists[sc].push_back(pool.free_lists[sc]);
+        pool.free_lists[sc] = nullptr;
+      }
+    }
+    if (pool.bump != pool.bump_end) {
+      d.chunk_ends.emplace_back(pool.bump, pool.bump_end);
+    }
+    pool.bump = nullptr;
+    pool.bump_end = nullptr;
+  }
+};
+
+/*!
+ * Make sure the pool is given to the depot when the calling thread exits. This is only called on
+ * the slow paths, so the fast paths don't have to check a thread_local with a destructor.
+ */
+void register_pool_exit(LocalPool& pool) {
+  if (!pool.exit_registered) {
+    pool.exit_registered = true;
+    static thread_local PoolExitHandler handler;
+    (void)handler;
+  }
+}
+
+std::size_t size_class(std::size_t size) {
+  return (size + POOL_ALIGN - 1) / POOL_ALIGN;
+}
+
+u8* new_chunk() {
+  auto chunk = static_cast<u8*>(::operator new(CHUNK_SIZE));
+  std::lock_guard<std::mutex> lock(g_chunk_mutex);
+  g_chunks.push_back(chunk);
+  return chunk;
+}
+
+/*!
+ * The pool has no free block of this size class and not enough space left in its chunk. Take a
+ * free list or chunk space from the depot, or a new chunk. Returns a free block if one was found,
+ * otherwise the pool's bump space is refilled. The leftover end of the old chunk is wasted, but it's
+ * less than MAX_POOLED_SIZE.
+ */
+FreeBlock* refill(LocalPool& pool, std::size_t sc, std::size_t block_size) {
+  register_pool_exit(pool);
+  auto& d = depot();
+  {
+    std::lock_guard<std::mutex> lock(d.mutex);
+    auto& lists = d.free_lists[sc];
+    if (!lists.empty()) {
+      auto block = lists.back();
+      lists.pop_back();
+      pool.free_lists[sc] = block->next;
+      return block;
+    }
+
+    for (std::size_t i = 0; i < d.chunk_ends.size(); i++) {
+      auto& end = d.chunk_ends[i];
+      if ((std::size_t)(end.second - end.first) >= block_size) {
+        pool.bump = end.first;
+        pool.bump_end = end.second;
+        d.chunk_ends[i] = d.chunk_ends.back();
+        d.chunk_ends.pop_back();
+        return nullptr;
+      }
+    }
+  }
+
+  pool.bump = new_chunk();
+  pool.bump_end = pool.bump + CHUNK_SIZE;
+  return nullptr;
+}
+}  // namespace
+
+/*!
+ * Allocate a block of at least size bytes from the calling thread's pool.
+ */
+void* alloc(std::size_t size) {
+  auto sc = size_class(size);
+  auto& pool = t_pool;
+
+  // reuse a freed block, if there is one
+  auto block = pool.free_lists[sc];
+  if (block) {
+    pool.free_lists[sc] = block->next;
+    return block;
+  }
+
+  // otherwise take a new one from the chunk.
+  std::size_t block_size = sc * POOL_ALIGN;
+  if (!pool.bump || (std::size_t)(pool.bump_end - pool.bump) < block_size) {
+    block = refill(pool, sc, block_size);
+    if (block) {
+      return block;
+    }
+  }
+  auto result = pool.bump;
+  pool.bump += block_size;
+  return result;
+}
+
+/*!
+ * Return a block to the calling thread's pool. The size must be the size it was allocated with.
+ */
+void free(void* ptr, std::size_t size) {
+  auto sc = size_class(size);
+  auto& pool = t_pool;
+  auto block = static_cast<FreeBlock*>(ptr);
+  if (!pool.free_lists[sc]) {
+    register_pool_exit(pool);
+  }
+  block->next = pool.free_lists[sc];
+  pool.free_lists[sc] = block;
+}
+
+/*!
+ * Enable or disable the pool for new objects. Objects that already exist are freed correctly either
+ * way. This is intended for comparing against the normal allocator.
+ */
+void set_pool_enabled(bool enabled) {
+  g_pool_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool pool_enabled() {
+  return g_pool_enabled.load(std::memory_order_relaxed);
+}
+
+PoolStats get_pool_stats() {
+  std::lock_guard<std::mutex> lock(g_chunk_mutex);
+  PoolStats stats;
+  stats.chunk_count = g_chunks.size();
+  stats.chunk_bytes = g_chunks.size() * CHUNK_SIZE;
+  auto& d = depot();
+  std::lock_guard<std::mutex> depot_lock(d.mutex);
+  for (auto& lists : d.free_lists) {
+    stats.depot_free_lists += lists.size();
+  }
+  return stats;
+}
+
+}  // namespace heap
+}  // namespace goos
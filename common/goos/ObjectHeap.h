@@ -0,0 +1,102 @@
+#pragma once
+
+/*!
+ * @file ObjectHeap.h
+ * Pooled allocation for GOOS heap objects.
+ *
+ * Reading and macro expansion create and destroy huge numbers of small objects (mostly pairs).
+ * Instead of a separate malloc per object, heap objects are carved out of large chunks, and freed
+ * objects are kept on a free list per size to be reused. Objects are still owned by
+ * std::shared_ptr (the pool is the allocator passed to std::allocate_shared), so the rest of the
+ * Object API is unchanged.
+ *
+ * Each thread allocates from its own chunks and free lists, so allocation never takes a lock. An
+ * object may be freed from a different thread than the one that allocated it, in which case it is
+ * reused by the freeing thread. When a thread exits, its free lists and the unused part of its chunk
+ * are kept in a shared depot, which other threads take from before allocating new chunks.
+ *
+ * This only replaces the allocator. It is not an arena or a tracing collector: objects are still
+ * freed by their atomic reference counts, and there is no reset between compiles or sweep of
+ * unreachable objects. Chunks are never returned to the system, so the memory used by the pool is
+ * its peak, and freed blocks are only reused by later GOOS objects of the same size.
+ */
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include "common/common_types.h"
+
+namespace goos {
+namespace heap {
+
+// objects larger than this use the normal allocator.
+constexpr std::size_t MAX_POOLED_SIZE = 256;
+// size of the chunks that pooled objects are allocated from.
+constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+// pooled objects are allocated at this alignment.
+constexpr std::size_t POOL_ALIGN = 8;
+
+void* alloc(std::size_t size);
+void free(void* ptr, std::size_t size);
+
+void set_pool_enabled(bool enabled);
+bool pool_enabled();
+
+struct PoolStats {
+  std::size_t chunk_bytes = 0;  // bytes reserved in chunks, by all threads
+  std::size_t chunk_count = 0;
+  std::size_t depot_free_lists = 0;  // free lists left by exited threads, not yet reused
+};
+PoolStats get_pool_stats();
+
+/*!
+ * Allocator for std::allocate_shared, which allocates single objects from the pool.
+ */
+template <typename T>
+struct PoolAllocator {
+  using value_type = T;
+  static_assert(alignof(T) <= POOL_ALIGN, "GOOS heap object is over-aligned for the pool");
+
+  PoolAllocator() = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    if (n == 1 && sizeof(T) <= MAX_POOLED_SIZE) {
+      return static_cast<T*>(alloc(sizeof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    if (n == 1 && sizeof(T) <= MAX_POOLED_SIZE) {
+      free(ptr, sizeof(T));
+    } else {
+      ::operator delete(ptr);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const {
+    return false;
+  }
+};
+
+/*!
+ * Create a heap object. This should be used instead of std::make_shared for all GOOS heap objects.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> make_object(Args&&... args) {
+  if (pool_enabled()) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+  }
+  return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+}  // namespace heap
+}  // namespace goos
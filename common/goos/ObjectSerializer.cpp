@@ -0,0 +1,271 @@
+/*!
+ * @file ObjectSerializer.cpp
+ * Save and load GOOS objects to/from binary data.
+ */
+
+#include <stdexcept>
+#include "ObjectSerializer.h"
+
+namespace goos {
+
+namespace {
+bool is_heap_object_with_contents(ObjectType type) {
+  switch (type) {
+    case ObjectType::STRING:
+    case ObjectType::PAIR:
+    case ObjectType::ARRAY:
+    case ObjectType::LAMBDA:
+    case ObjectType::MACRO:
+    case ObjectType::ENVIRONMENT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*!
+ * Create an object of the given type with no contents yet.
+ */
+Object make_empty_heap_object(ObjectType type) {
+  switch (type) {
+    case ObjectType::STRING:
+      return StringObject::make_new("");
+    case ObjectType::PAIR:
+      return PairObject::make_new(Object(), Object());
+    case ObjectType::ARRAY:
+      return ArrayObject::make_new({});
+    case ObjectType::LAMBDA:
+      return LambdaObject::make_new();
+    case ObjectType::MACRO:
+      return MacroObject::make_new();
+    case ObjectType::ENVIRONMENT:
+      return EnvironmentObject::make_new();
+    default:
+      throw std::runtime_error("make_empty_heap_object: invalid type");
+  }
+}
+}  // namespace
+
+/*!
+ * Save or load an object, and everything it references.
+ */
+void ObjectSerializer::from_object(Object* obj) {
+  auto type = m_ser->save_or_load(obj->type);
+  switch (type) {
+    case ObjectType::INVALID:
+      // used for things like default values of arguments without defaults.
+      if (m_ser->is_loading()) {
+        *obj = Object();
+      }
+      return;
+    case ObjectType::EMPTY_LIST:
+      if (m_ser->is_loading()) {
+        *obj = EmptyListObject::make_new();
+      }
+      return;
+    case ObjectType::INTEGER:
+      if (m_ser->is_loading()) {
+        *obj = Object::make_integer(0);
+      }
+      m_ser->from_pod(&obj->integer_obj.value);
+      return;
+    case ObjectType::FLOAT:
+      if (m_ser->is_loading()) {
+        *obj = Object::make_float(0);
+      }
+      m_ser->from_pod(&obj->float_obj.value);
+      return;
+    case ObjectType::CHAR:
+      if (m_ser->is_loading()) {
+        *obj = Object::make_char(0);
+      }
+      m_ser->from_pod(&obj->char_obj.value);
+      return;
+    case ObjectType::SYMBOL: {
+      std::shared_ptr<SymbolObject> sym;
+      if (m_ser->is_saving()) {
+        sym = obj->as_symbol();
+      }
+      from_symbol(&sym);
+      if (m_ser->is_loading()) {
+        obj->type = ObjectType::SYMBOL;
+        obj->heap_obj = sym;
+      }
+      return;
+    }
+    default:
+      break;
+  }
+
+  if (!is_heap_object_with_contents(type)) {
+    throw std::runtime_error("ObjectSerializer: invalid object type");
+  }
+
+  if (m_ser->is_saving()) {
+    auto kv = m_saved_ids.find(obj->heap_obj.get());
+    if (kv != m_saved_ids.end()) {
+      // already saved, just refer to it.
+      m_ser->save_or_load(kv->second);
+      return;
+    }
+    u32 id = m_saved_ids.size();
+    m_saved_ids[obj->heap_obj.get()] = id;
+    m_ser->save_or_load(id);
+    heap_object_contents(obj);
+  } else {
+    auto id = m_ser->save_or_load<u32>(0);
+    if (id < m_loaded_objects.size()) {
+      if (m_loaded_objects.at(id).type != type) {
+        throw std::runtime_error("ObjectSerializer: object type mismatch");
+      }
+      *obj = m_loaded_objects.at(id);
+      return;
+    }
+
+    if (id != m_loaded_objects.size()) {
+      throw std::runtime_error("ObjectSerializer: invalid object id");
+    }
+    // add it before the contents are loaded, so the contents can refer back to it.
+    *obj = make_empty_heap_object(type);
+    m_loaded_objects.push_back(*obj);
+    heap_object_contents(obj);
+  }
+}
+
+void ObjectSerializer::from_env(std::shared_ptr<EnvironmentObject>* env) {
+  if (!m_ser->save_or_load<bool>(*env != nullptr)) {
+    env->reset();
+    return;
+  }
+
+  Object obj;
+  if (m_ser->is_saving()) {
+    obj.type = ObjectType::ENVIRONMENT;
+    obj.heap_obj = *env;
+  }
+  from_object(&obj);
+  if (m_ser->is_loading()) {
+    *env = obj.as_env();
+  }
+}
+
+void ObjectSerializer::from_symbol(std::shared_ptr<SymbolObject>* sym) {
+  std::string name;
+  if (m_ser->is_saving()) {
+    name = (*sym)->name;
+  }
+  m_ser->from_str(&name);
+  if (m_ser->is_loading()) {
+    *sym = m_symbols->intern(name);
+  }
+}
+
+void ObjectSerializer::from_arg_spec(ArgumentSpec* spec) {
+  m_ser->from_pod(&spec->varargs);
+
+  auto unnamed_count = m_ser->save_or_load<u32>(spec->unnamed.size());
+  if (m_ser->is_loading()) {
+    spec->unnamed.resize(unnamed_count);
+  }
+  for (auto& name : spec->unnamed) {
+    m_ser->from_str(&name);
+  }
+
+  auto named_count = m_ser->save_or_load<u32>(spec->named.size());
+  if (m_ser->is_saving()) {
+    for (auto& kv : spec->named) {
+      auto name = kv.first;
+      m_ser->from_str(&name);
+      m_ser->from_pod(&kv.second.has_default);
+      from_object(&kv.second.default_value);
+    }
+  } else {
+    spec->named.clear();
+    for (u32 i = 0; i < named_count; i++) {
+      std::string name;
+      m_ser->from_str(&name);
+      auto& arg = spec->named[name];
+      m_ser->from_pod(&arg.has_default);
+      from_object(&arg.default_value);
+    }
+  }
+
+  m_ser->from_str(&spec->rest);
+  if (m_ser->is_loading()) {
+    spec->build_frame_layout(*m_symbols);
+  }
+}
+
+/*!
+ * Save or load the contents of a heap object. When loading, obj is an empty object of the right
+ * type.
+ */
+void ObjectSerializer::heap_object_contents(Object* obj) {
+  switch (obj->type) {
+    case ObjectType::STRING:
+      m_ser->from_str(&obj->as_string()->data);
+      break;
+    case ObjectType::PAIR: {
+      auto pair = obj->as_pair();
+      from_object(&pair->car);
+      from_object(&pair->cdr);
+    } break;
+    case ObjectType::ARRAY: {
+      auto array = obj->as_array();
+      auto size = m_ser->save_or_load<u32>(array->size());
+      if (m_ser->is_loading()) {
+        array->data.resize(size);
+      }
+      for (auto& elt : array->data) {
+        from_object(&elt);
+      }
+    } break;
+    case ObjectType::LAMBDA: {
+      auto lambda = obj->as_lambda();
+      m_ser->from_str(&lambda->name);
+      from_env(&lambda->parent_env);
+      from_object(&lambda->body);
+      from_arg_spec(&lambda->args);
+    } break;
+    case ObjectType::MACRO: {
+      auto macro = obj->as_macro();
+      m_ser->from_str(&macro->name);
+      from_env(&macro->parent_env);
+      from_object(&macro->body);
+      from_arg_spec(&macro->args);
+      m_ser->from_pod(&macro->pure);
+    } break;
+    case ObjectType::ENVIRONMENT: {
+      auto env = obj->as_env();
+      m_ser->from_str(&env->name);
+      from_env(&env->parent_env);
+      // variables in lambda/macro frame slots are saved like any other variable and loaded into
+      // the map.
+      auto var_count = m_ser->save_or_load<u32>(env->slots.size() + env->vars.size());
+      if (m_ser->is_saving()) {
+        for (size_t i = 0; i < env->slots.size(); i++) {
+          auto sym = env->slot_names->at(i);
+          from_symbol(&sym);
+          from_object(&env->slots[i]);
+        }
+        for (auto& kv : env->vars) {
+          auto sym = kv.first;
+          from_symbol(&sym);
+          from_object(&kv.second);
+        }
+      } else {
+        for (u32 i = 0; i < var_count; i++) {
+          std::shared_ptr<SymbolObject> sym;
+          from_symbol(&sym);
+          Object value;
+          from_object(&value);
+          env->vars[sym] = value;
+        }
+      }
+    } break;
+    default:
+      assert(false);
+  }
+}
+
+}  // namespace goos
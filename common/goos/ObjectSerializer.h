@@ -0,0 +1,39 @@
+#pragma once
+
+/*!
+ * @file ObjectSerializer.h
+ * Save and load GOOS objects to/from binary data.
+ *
+ * Heap objects that are referenced more than once (like environments shared by many lambdas) are
+ * only stored once, so sharing and cycles are kept when loading. Symbols are stored by name and
+ * interned in the given symbol table when loading.
+ *
+ * The links to source text in the TextDb are not saved.
+ */
+
+#include <unordered_map>
+#include <vector>
+#include "Object.h"
+#include "common/util/Serializer.h"
+
+namespace goos {
+class ObjectSerializer {
+ public:
+  ObjectSerializer(Serializer* ser, SymbolTable* symbols) : m_ser(ser), m_symbols(symbols) {}
+  void from_object(Object* obj);
+  void from_env(std::shared_ptr<EnvironmentObject>* env);
+  void from_symbol(std::shared_ptr<SymbolObject>* sym);
+  Serializer& ser() { return *m_ser; }
+
+ private:
+  void from_arg_spec(ArgumentSpec* spec);
+  void heap_object_contents(Object* obj);
+
+  Serializer* m_ser = nullptr;
+  SymbolTable* m_symbols = nullptr;
+
+  // saving: the ID of each heap object stored so far. loading: each heap object, by ID.
+  std::unordered_map<HeapObject*, u32> m_saved_ids;
+  std::vector<Object> m_loaded_objects;
+};
+}  // namespace goos
@@ -5,59 +5,76 @@
  */
 
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
-#include <utility>
+#include <string_view>
 #include "PrettyPrinter.h"
 #include "Reader.h"
 
 namespace pretty_print {
 
+namespace {
+
 /*!
  * A single token which cannot be split between lines.
  */
 struct FormToken {
-  enum class TokenKind {
+  enum class TokenKind : u8 {
     WHITESPACE,
     STRING,
     OPEN_PAREN,
     DOT,
     CLOSE_PAREN,
     EMPTY_PAIR,
-    SPECIAL_STRING  // has different alignment rules than STRING
   } kind;
-  explicit FormToken(TokenKind _kind, std::string _str = "") : kind(_kind), str(std::move(_str)) {}
-
-  std::string str;
-
-  std::string toString() const {
-    std::string s;
-    switch (kind) {
-      case TokenKind::WHITESPACE:
-        s.push_back(' ');
-        break;
-      case TokenKind::STRING:
-        s.append(str);
-        break;
-      case TokenKind::OPEN_PAREN:
-        s.push_back('(');
-        break;
-      case TokenKind::DOT:
-        s.push_back('.');
-        break;
-      case TokenKind::CLOSE_PAREN:
-        s.push_back(')');
-        break;
-      case TokenKind::EMPTY_PAIR:
-        s.append("()");
-        break;
-      case TokenKind::SPECIAL_STRING:
-        s.append(str);
-        break;
-      default:
-        throw std::runtime_error("toString unknown token kind");
-    }
-    return s;
+  bool break_after = false;  // there is a line break after this token.
+  u32 paren = 0;             // for parens, the index of the matching paren.
+  u32 text_offset = 0;       // for strings, the text is stored in Layout::text.
+  u32 text_size = 0;
+};
+
+/*!
+ * Lays out a form in a single pass over its lines.
+ *
+ * The form is first converted to a list of tokens. Then the lines are visited in order, from the
+ * top. If a line is too long, the lists that start on it are broken (one element per line), one at
+ * a time, until the line fits or there are no more lists to try. A line is never changed after
+ * the line below it is visited, so it can be written out right away.
+ *
+ * Line breaks are only ever added after the current line, and checking if a line fits looks at
+ * no more than line_length tokens, so the whole layout takes linear time.
+ */
+class Layout {
+ public:
+  Layout(const goos::Object& obj, int line_length) : m_line_length(line_length) {
+    add_to_token_list(obj);
+    assert(!m_tokens.empty());
   }
+
+  void run(const std::function<void(const std::string&)>& write);
+
+ private:
+  using TokenKind = FormToken::TokenKind;
+  static constexpr size_t NONE = SIZE_MAX;
+
+  void add_to_token_list(const goos::Object& obj);
+  void add_token(TokenKind kind) { m_tokens.push_back({kind}); }
+  std::string_view text(const FormToken& tok) const;
+  int width(const FormToken& tok) const;
+  void insert_newline_after(size_t idx);
+  void insert_special_breaks();
+  bool continues_line(size_t line_start, size_t idx) const;
+  size_t find_list(size_t line_start, size_t from) const;
+  bool line_too_long(size_t line_start, int indent) const;
+  void break_list(size_t open_paren);
+  size_t write_line(size_t line_start, std::string* line);
+
+  int m_line_length;
+  std::vector<FormToken> m_tokens;
+  std::string m_text;
+  std::vector<int> m_indent_stack = {0};
 };
 
 /*!
@@ -67,50 +84,56 @@ struct FormToken {
  * Note that not all GOOS objects can be pretty printed. Only the ones that can be directly
  * generated by the reader.
  */
-void add_to_token_list(const goos::Object& obj, std::vector<FormToken>* tokens) {
+void Layout::add_to_token_list(const goos::Object& obj) {
   switch (obj.type) {
     case goos::ObjectType::EMPTY_LIST:
-      tokens->emplace_back(FormToken::TokenKind::EMPTY_PAIR);
+      add_token(TokenKind::EMPTY_PAIR);
       break;
       // all of these can just be printed to a string and turned into a 'symbol'
     case goos::ObjectType::INTEGER:
     case goos::ObjectType::FLOAT:
     case goos::ObjectType::CHAR:
     case goos::ObjectType::SYMBOL:
-    case goos::ObjectType::STRING:
-      tokens->emplace_back(FormToken::TokenKind::STRING, obj.print());
-      break;
+    case goos::ObjectType::STRING: {
+      auto str = obj.print();
+      add_token(TokenKind::STRING);
+      m_tokens.back().text_offset = m_text.size();
+      m_tokens.back().text_size = str.size();
+      m_text.append(str);
+    } break;
 
       // it's important to break the pair up into smaller tokens which can then be split
       // across lines.
     case goos::ObjectType::PAIR: {
-      tokens->emplace_back(FormToken::TokenKind::OPEN_PAREN);
+      u32 open_paren = m_tokens.size();
+      add_token(TokenKind::OPEN_PAREN);
       auto* to_print = &obj;
       for (;;) {
         if (to_print->is_pair()) {
           // first print the car into our token list:
-          add_to_token_list(to_print->as_pair()->car, tokens);
+          add_to_token_list(to_print->as_pair()->car);
           // then load up the cdr as the next thing to print
           to_print = &to_print->as_pair()->cdr;
           if (to_print->is_empty_list()) {
             // we're done, add a close paren and finish
-            tokens->emplace_back(FormToken::TokenKind::CLOSE_PAREN);
-            return;
+            break;
           } else {
             // more to print, add whitespace
-            tokens->emplace_back(FormToken::TokenKind::WHITESPACE);
+            add_token(TokenKind::WHITESPACE);
           }
         } else {
           // got an improper list.
           // add a dot, space
-          tokens->emplace_back(FormToken::TokenKind::DOT);
-          tokens->emplace_back(FormToken::TokenKind::WHITESPACE);
+          add_token(TokenKind::DOT);
+          add_token(TokenKind::WHITESPACE);
           // then the thing and a close paren.
-          add_to_token_list(*to_print, tokens);
-          tokens->emplace_back(FormToken::TokenKind::CLOSE_PAREN);
-          return;  // and we're done with this list.
+          add_to_token_list(*to_print);
+          break;  // and we're done with this list.
         }
       }
+      m_tokens.at(open_paren).paren = m_tokens.size();
+      add_token(TokenKind::CLOSE_PAREN);
+      m_tokens.back().paren = open_paren;
     } break;
 
       // these are unsupported by the pretty printer.
@@ -124,408 +147,215 @@ void add_to_token_list(const goos::Object& obj, std::vector<FormToken>* tokens)
   }
 }
 
-/*!
- * Linked list node representing a token in the output (whitespace, paren, newline, etc)
- */
-struct PrettyPrinterNode {
-  FormToken* tok = nullptr;  // if we aren't a newline, we will have a token.
-  int line = -1;             // line that token occurs on. undef for newlines
-  int lineIndent = -1;       // indent of line.  only valid for first token in the line
-  int offset = -1;           // offset of beginning of token from left margin
-  int specialIndentDelta = 0;
-  bool is_line_separator = false;                      // true if line separator (not a token)
-  PrettyPrinterNode *next = nullptr, *prev = nullptr;  // linked list
-  PrettyPrinterNode* paren =
-      nullptr;  // pointer to open paren if in parens.  open paren points to close and vice versa
-  explicit PrettyPrinterNode(FormToken* _tok) { tok = _tok; }
-  PrettyPrinterNode() = default;
-};
-
-/*!
- * Container to track and cleanup all nodes after use.
- */
-struct NodePool {
-  std::vector<PrettyPrinterNode*> nodes;
-  PrettyPrinterNode* allocate(FormToken* x) {
-    auto result = new PrettyPrinterNode(x);
-    nodes.push_back(result);
-    return result;
-  }
-
-  PrettyPrinterNode* allocate() {
-    auto result = new PrettyPrinterNode;
-    nodes.push_back(result);
-    return result;
-  }
-
-  NodePool() = default;
-
-  ~NodePool() {
-    for (auto& x : nodes) {
-      delete x;
-    }
-  }
-
-  // so we don't accidentally copy this.
-  NodePool& operator=(const NodePool&) = delete;
-  NodePool(const NodePool&) = delete;
-};
-
-/*!
- * Splice in a line break after the given node, it there isn't one already and if it isn't the last
- * node.
- */
-void insertNewlineAfter(NodePool& pool, PrettyPrinterNode* node, int specialIndentDelta) {
-  if (node->next && !node->next->is_line_separator) {
-    auto* nl = pool.allocate();
-    auto* next = node->next;
-    node->next = nl;
-    nl->prev = node;
-    nl->next = next;
-    next->prev = nl;
-    nl->is_line_separator = true;
-    nl->specialIndentDelta = specialIndentDelta;
+std::string_view Layout::text(const FormToken& tok) const {
+  switch (tok.kind) {
+    case TokenKind::WHITESPACE:
+      return " ";
+    case TokenKind::STRING:
+      return std::string_view(m_text).substr(tok.text_offset, tok.text_size);
+    case TokenKind::OPEN_PAREN:
+      return "(";
+    case TokenKind::DOT:
+      return ".";
+    case TokenKind::CLOSE_PAREN:
+      return ")";
+    case TokenKind::EMPTY_PAIR:
+      return "()";
+    default:
+      throw std::runtime_error("text unknown token kind");
   }
 }
 
-/*!
- * Splice in a line break before the given node, if there isn't one already and if it isn't the
- * first node.
- */
-void insertNewlineBefore(NodePool& pool, PrettyPrinterNode* node, int specialIndentDelta) {
-  if (node->prev && !node->prev->is_line_separator) {
-    auto* nl = pool.allocate();
-    auto* prev = node->prev;
-    prev->next = nl;
-    nl->prev = prev;
-    nl->next = node;
-    node->prev = nl;
-    nl->is_line_separator = true;
-    nl->specialIndentDelta = specialIndentDelta;
+int Layout::width(const FormToken& tok) const {
+  switch (tok.kind) {
+    case TokenKind::STRING:
+      return tok.text_size;
+    case TokenKind::EMPTY_PAIR:
+      return 2;
+    default:
+      return 1;
   }
 }
 
 /*!
- * Break a list across multiple lines. This is how line lengths are decreased.
- * This does not compute the proper indentation and leaves the list in a bad state.
- * After this has been called, the entire selection should be reformatted with propagate_pretty
+ * Add a line break after the given token, if it isn't the last token.
  */
-void breakList(NodePool& pool, PrettyPrinterNode* leftParen) {
-  assert(!leftParen->is_line_separator);
-  assert(leftParen->tok->kind == FormToken::TokenKind::OPEN_PAREN);
-  auto* rp = leftParen->paren;
-  assert(rp->tok->kind == FormToken::TokenKind::CLOSE_PAREN);
-
-  for (auto* n = leftParen->next; n && n != rp; n = n->next) {
-    if (!n->is_line_separator) {
-      if (n->tok->kind == FormToken::TokenKind::OPEN_PAREN) {
-        n = n->paren;
-        assert(n->tok->kind == FormToken::TokenKind::CLOSE_PAREN);
-        insertNewlineAfter(pool, n, 0);
-      } else if (n->tok->kind != FormToken::TokenKind::WHITESPACE) {
-        assert(n->tok->kind != FormToken::TokenKind::CLOSE_PAREN);
-        insertNewlineAfter(pool, n, 0);
-      }
-    }
+void Layout::insert_newline_after(size_t idx) {
+  if (idx + 1 < m_tokens.size()) {
+    m_tokens[idx].break_after = true;
   }
 }
 
 /*!
- * Compute proper line numbers, offsets, and indents for a list of tokens with newlines
- * Will add newlines for close parens if needed.
+ * Add the line breaks which don't depend on the line length: after the name and arguments of a
+ * deftype, defun or defmethod, and after string constants.
  */
-static PrettyPrinterNode* propagatePretty(NodePool& pool,
-                                          PrettyPrinterNode* list,
-                                          int line_length) {
-  // propagate line numbers
-  PrettyPrinterNode* rv = nullptr;
-  int line = list->line;
-  for (auto* n = list; n; n = n->next) {
-    if (n->is_line_separator) {
-      line++;
-    } else {
-      n->line = line;
-      // add the weird newline.
-      if (n->tok->kind == FormToken::TokenKind::CLOSE_PAREN) {
-        if (n->line != n->paren->line) {
-          if (n->prev && !n->prev->is_line_separator) {
-            insertNewlineBefore(pool, n, 0);
-            line++;
-          }
-          if (n->next && !n->next->is_line_separator) {
-            insertNewlineAfter(pool, n, 0);
-          }
-        }
-      }
+void Layout::insert_special_breaks() {
+  for (size_t i = 0; i < m_tokens.size(); i++) {
+    if (m_tokens[i].kind != TokenKind::STRING) {
+      continue;
     }
-  }
-
-  // compute offsets and indents
-  std::vector<int> indentStack;
-  indentStack.push_back(0);
-  int offset = 0;
-  PrettyPrinterNode* line_start = list;
-  bool previous_line_sep = false;
-  for (auto* n = list; n; n = n->next) {
-    if (n->is_line_separator) {
-      previous_line_sep = true;
-      offset = indentStack.back() += n->specialIndentDelta;
-    } else {
-      if (previous_line_sep) {
-        line_start = n;
-        n->lineIndent = offset;
-        previous_line_sep = false;
-      }
-
-      n->offset = offset;
-      offset += n->tok->toString().length();
-      if (offset > line_length && !rv)
-        rv = line_start;
-      if (n->tok->kind == FormToken::TokenKind::OPEN_PAREN) {
-        if (!n->prev || n->prev->is_line_separator) {
-          indentStack.push_back(offset + 1);
-        } else {
-          indentStack.push_back(offset - 1);
+    auto name = text(m_tokens[i]);
+    if (name == "deftype" || name == "defun" || name == "defmethod") {
+      // the next list, if it comes before a line break.
+      for (size_t j = i + 1; j < m_tokens.size() && !m_tokens[j - 1].break_after; j++) {
+        if (m_tokens[j].kind == TokenKind::OPEN_PAREN) {
+          insert_newline_after(m_tokens[j].paren);
+          break;
         }
       }
+    }
 
-      if (n->tok->kind == FormToken::TokenKind::CLOSE_PAREN) {
-        indentStack.pop_back();
-      }
+    if (name.at(0) == '"') {
+      insert_newline_after(i);
     }
   }
-  return rv;
 }
 
 /*!
- * Get the token on the start of the next line. nullptr if we're the last line.
+ * Is the token at idx on the same line as the one before it, for the line starting at line_start?
+ * A list which doesn't fit on one line has its close paren on a line by itself.
  */
-PrettyPrinterNode* getNextLine(PrettyPrinterNode* start) {
-  assert(!start->is_line_separator);
-  int line = start->line;
-  for (;;) {
-    if (start->is_line_separator || start->line == line) {
-      if (start->next)
-        start = start->next;
-      else
-        return nullptr;
-    } else {
-      break;
-    }
+bool Layout::continues_line(size_t line_start, size_t idx) const {
+  if (m_tokens[idx - 1].break_after || m_tokens[line_start].kind == TokenKind::CLOSE_PAREN) {
+    return false;
   }
-  return start;
+  return m_tokens[idx].kind != TokenKind::CLOSE_PAREN || m_tokens[idx].paren >= line_start;
 }
 
 /*!
- * Get the next open paren on the current line (can start in the middle of line, not inclusive of
- * start) nullptr if there's no open parens on the rest of this line.
+ * Get the first open paren on the line starting at line_start, at or after from.
+ * NONE if there's no open parens on the rest of this line.
  */
-PrettyPrinterNode* getNextListOnLine(PrettyPrinterNode* start) {
-  int line = start->line;
-  assert(!start->is_line_separator);
-  if (!start->next || start->next->is_line_separator)
-    return nullptr;
-  start = start->next;
-  while (!start->is_line_separator && start->line == line) {
-    if (start->tok->kind == FormToken::TokenKind::OPEN_PAREN)
-      return start;
-    if (!start->next)
-      return nullptr;
-    start = start->next;
+size_t Layout::find_list(size_t line_start, size_t from) const {
+  for (size_t i = from; i < m_tokens.size(); i++) {
+    if (i > line_start && !continues_line(line_start, i)) {
+      break;
+    }
+    if (m_tokens[i].kind == TokenKind::OPEN_PAREN) {
+      return i;
+    }
   }
-  return nullptr;
+  return NONE;
 }
 
 /*!
- * Get the first open paren on the current line (can start in the middle of line, inclusive of
- * start) nullptr if there's no open parens on the rest of this line
+ * Does a token on this line start past the line length?
  */
-PrettyPrinterNode* getFirstListOnLine(PrettyPrinterNode* start) {
-  int line = start->line;
-  assert(!start->is_line_separator);
-  while (!start->is_line_separator && start->line == line) {
-    if (start->tok->kind == FormToken::TokenKind::OPEN_PAREN)
-      return start;
-    if (!start->next)
-      return nullptr;
-    start = start->next;
+bool Layout::line_too_long(size_t line_start, int indent) const {
+  int offset = indent;
+  for (size_t i = line_start; i < m_tokens.size(); i++) {
+    if (i > line_start && !continues_line(line_start, i)) {
+      break;
+    }
+    if (offset > m_line_length) {
+      return true;
+    }
+    offset += width(m_tokens[i]);
   }
-  return nullptr;
+  return false;
 }
 
 /*!
- * Get the first token on the first line which exceeds the max length
+ * Break a list across multiple lines, with a line break after each element.
  */
-PrettyPrinterNode* getFirstBadLine(PrettyPrinterNode* start, int line_length) {
-  assert(!start->is_line_separator);
-  int currentLine = start->line;
-  auto* currentLineNode = start;
-  for (;;) {
-    if (start->is_line_separator) {
-      assert(start->next);
-      start = start->next;
-    } else {
-      if (start->line != currentLine) {
-        currentLine = start->line;
-        currentLineNode = start;
-      }
-      if (start->offset > line_length) {
-        return currentLineNode;
-      }
-      if (!start->next) {
-        return nullptr;
-      }
-      start = start->next;
+void Layout::break_list(size_t open_paren) {
+  assert(m_tokens.at(open_paren).kind == TokenKind::OPEN_PAREN);
+  size_t close_paren = m_tokens[open_paren].paren;
+  for (size_t i = open_paren + 1; i < close_paren; i++) {
+    if (m_tokens[i].kind == TokenKind::OPEN_PAREN) {
+      i = m_tokens[i].paren;
+      insert_newline_after(i);
+    } else if (m_tokens[i].kind != TokenKind::WHITESPACE) {
+      assert(m_tokens[i].kind != TokenKind::CLOSE_PAREN);
+      insert_newline_after(i);
     }
   }
 }
 
 /*!
- * Break insertion algorithm.
+ * Write out the line starting at line_start, and track the indentation of the lists started and
+ * ended on it. Returns the start of the next line.
+ *
+ * The tokens of a list are indented to line up with the first element, unless the list starts a
+ * line, in which case they are indented two spaces.
  */
-void insertBreaksAsNeeded(NodePool& pool, PrettyPrinterNode* head, int line_length) {
-  PrettyPrinterNode* last_line_complete = nullptr;
-  PrettyPrinterNode* line_to_start_line_search = head;
-
-  // loop over lines
-  for (;;) {
-    // compute lines as needed
-    propagatePretty(pool, head, line_length);
-
-    // search for a bad line starting at the last line we fixed
-    PrettyPrinterNode* candidate_line = getFirstBadLine(line_to_start_line_search, line_length);
-    // if we got the same line we started on, this means we couldn't fix it.
-    if (candidate_line == last_line_complete) {
-      candidate_line = nullptr;  // so we say our candidate was bad and try to find another
-      PrettyPrinterNode* next_line = getNextLine(line_to_start_line_search);
-      if (next_line) {
-        candidate_line = getFirstBadLine(next_line, line_length);
-      }
-    }
-    if (!candidate_line)
+size_t Layout::write_line(size_t line_start, std::string* line) {
+  int offset = m_indent_stack.back();
+  line->append(offset, ' ');
+  size_t i = line_start;
+  for (; i < m_tokens.size(); i++) {
+    if (i > line_start && !continues_line(line_start, i)) {
       break;
-
-    // okay, we have a line which needs fixing.
-    assert(!candidate_line->prev || candidate_line->prev->is_line_separator);
-    PrettyPrinterNode* form_to_start = getFirstListOnLine(candidate_line);
-    for (;;) {
-      if (!form_to_start) {
-        // this means we failed to hit the desired line length...
-        break;
-      }
-      breakList(pool, form_to_start);
-      propagatePretty(pool, head, line_length);
-      if (getFirstBadLine(candidate_line, line_length) != candidate_line) {
-        break;
-      }
-
-      form_to_start = getNextListOnLine(form_to_start);
-      if (!form_to_start)
-        break;
     }
+    auto& tok = m_tokens[i];
+    // the whitespace between elements goes at the start of the next line, and isn't printed.
+    if (i > line_start || tok.kind != TokenKind::WHITESPACE) {
+      line->append(text(tok));
+    }
+    if (tok.kind == TokenKind::OPEN_PAREN) {
+      m_indent_stack.push_back(i == line_start ? offset + 2 : offset);
+    } else if (tok.kind == TokenKind::CLOSE_PAREN) {
+      m_indent_stack.pop_back();
+    }
+    offset += width(tok);
+  }
 
-    last_line_complete = candidate_line;
-    line_to_start_line_search = candidate_line;
+  if (i < m_tokens.size()) {
+    line->push_back('\n');
   }
+  return i;
 }
 
-void insertSpecialBreaks(NodePool& pool, PrettyPrinterNode* node) {
-  for (; node; node = node->next) {
-    if (!node->is_line_separator && node->tok->kind == FormToken::TokenKind::STRING) {
-      std::string& name = node->tok->str;
-      if (name == "deftype") {  // todo!
-        auto* parent_type_dec = getNextListOnLine(node);
-        if (parent_type_dec) {
-          insertNewlineAfter(pool, parent_type_dec->paren, 0);
-        }
-      }
-
-      if (name == "defun" || name == "defmethod") {
-        auto* parent_type_dec = getNextListOnLine(node);
-        if (parent_type_dec) {
-          insertNewlineAfter(pool, parent_type_dec->paren, 0);
+void Layout::run(const std::function<void(const std::string&)>& write) {
+  insert_special_breaks();
+
+  std::string line;
+  size_t line_start = 0;
+  while (line_start < m_tokens.size()) {
+    int indent = m_indent_stack.back();
+    if (line_too_long(line_start, indent)) {
+      // break lists until it fits. Breaking a list leaves its first element on this line, so if
+      // that is a list, it will be tried next.
+      for (size_t list = find_list(line_start, line_start); list != NONE;
+           list = find_list(line_start, list + 1)) {
+        break_list(list);
+        if (!line_too_long(line_start, indent)) {
+          break;
         }
       }
-
-      if (name.at(0) == '"') {
-        insertNewlineAfter(pool, node, 0);
-      }
     }
+
+    line.clear();
+    line_start = write_line(line_start, &line);
+    write(line);
   }
 }
+}  // namespace
 
 std::string to_string(const goos::Object& obj, int line_length) {
-  NodePool pool;
-  std::vector<FormToken> tokens;
-  add_to_token_list(obj, &tokens);
-  assert(!tokens.empty());
   std::string pretty;
-
-  // build linked list of nodes
-  PrettyPrinterNode* head = pool.allocate(&tokens[0]);
-  PrettyPrinterNode* node = head;
-  head->line = 0;
-  head->offset = 0;
-  head->lineIndent = 0;
-  int offset = head->tok->toString().length();
-  for (size_t i = 1; i < tokens.size(); i++) {
-    node->next = pool.allocate(&tokens[i]);
-    node->next->prev = node;
-    node = node->next;
-    node->line = 0;
-    node->offset = offset;
-    offset += node->tok->toString().length();
-    node->lineIndent = 0;
-  }
-
-  // attach parens.
-  std::vector<PrettyPrinterNode*> parenStack;
-  parenStack.push_back(nullptr);
-  for (PrettyPrinterNode* n = head; n; n = n->next) {
-    if (n->tok->kind == FormToken::TokenKind::OPEN_PAREN) {
-      parenStack.push_back(n);
-    } else if (n->tok->kind == FormToken::TokenKind::CLOSE_PAREN) {
-      n->paren = parenStack.back();
-      parenStack.back()->paren = n;
-      parenStack.pop_back();
-    } else {
-      n->paren = parenStack.back();
-    }
-  }
-  assert(parenStack.size() == 1);
-  assert(!parenStack.back());
-
-  insertSpecialBreaks(pool, head);
-  propagatePretty(pool, head, line_length);
-  insertBreaksAsNeeded(pool, head, line_length);
-
-  // write to string
-  bool newline_prev = true;
-  for (PrettyPrinterNode* n = head; n; n = n->next) {
-    if (n->is_line_separator) {
-      pretty.push_back('\n');
-      newline_prev = true;
-    } else {
-      if (newline_prev) {
-        pretty.append(n->lineIndent, ' ');
-        newline_prev = false;
-        if (n->tok->kind == FormToken::TokenKind::WHITESPACE)
-          continue;
-      }
-      pretty.append(n->tok->toString());
-    }
-  }
-
+  Layout(obj, line_length).run([&](const std::string& line) { pretty.append(line); });
   return pretty;
 }
 
+void to_file(FILE* fp, const goos::Object& obj, int line_length) {
+  Layout(obj, line_length).run([&](const std::string& line) {
+    fwrite(line.data(), 1, line.size(), fp);
+  });
+}
+
 goos::Reader pretty_printer_reader;
 
 goos::Reader& get_pretty_printer_reader() {
   return pretty_printer_reader;
 }
 
+// to_symbol is called from the decompiler's parallel passes, so interning is locked.
+std::mutex pretty_printer_symbol_mutex;
+
 goos::Object to_symbol(const std::string& str) {
+  std::lock_guard<std::mutex> lock(pretty_printer_symbol_mutex);
   return goos::SymbolObject::make_new(pretty_printer_reader.symbolTable, str);
 }
 
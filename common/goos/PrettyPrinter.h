@@ -6,6 +6,7 @@
  * It is not very good, but significantly better than putting everything on one line
  */
 
+#include <cstdio>
 #include <string>
 #include <vector>
 #include "common/goos/Object.h"
@@ -15,6 +16,9 @@ namespace pretty_print {
 // main pretty print function
 std::string to_string(const goos::Object& obj, int line_length = 80);
 
+// pretty print to a file, one line at a time, without building the whole string.
+void to_file(FILE* fp, const goos::Object& obj, int line_length = 80);
+
 // string -> object (as a symbol)
 goos::Object to_symbol(const std::string& str);
 
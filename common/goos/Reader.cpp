@@ -9,9 +9,16 @@
  * launching the compiler or the compiler test.
  */
 
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <future>
 #include "Reader.h"
 #include "third-party/linenoise.h"
 #include "common/util/FileUtil.h"
+#include "common/util/ThreadPool.h"
 #include "third-party/fmt/core.h"
 
 namespace goos {
@@ -41,13 +48,8 @@ bool hex_char(char c) {
 /*!
  * Does the given string contain c?
  */
-bool str_contains(const std::string& str, char c) {
-  for (auto& x : str) {
-    if (x == c) {
-      return true;
-    }
-  }
-  return false;
+bool str_contains(std::string_view str, char c) {
+  return str.find(c) != std::string_view::npos;
 }
 }  // namespace
 
@@ -62,6 +64,7 @@ void TextStream::seek_past_whitespace_and_comments() {
       case ' ':
       case '\t':
       case '\n':
+      case '\r':
         // just a whitespace, eat it!
         read();
         break;
@@ -147,11 +150,10 @@ Object Reader::read_from_stdin(const std::string& prompt_name) {
   // todo, decide if we should keep reading or not.
 
   // create text fragment and add to the DB
-  auto textFrag = std::make_shared<ReplText>(line);
-  db.insert(textFrag);
+  auto textFrag = db.insert(std::make_shared<ReplText>(line));
 
   // perform read
-  auto result = internal_read(textFrag);
+  auto result = internal_read(textFrag, symbolTable);
   db.link(result, textFrag, 0);
   return result;
 }
@@ -161,11 +163,10 @@ Object Reader::read_from_stdin(const std::string& prompt_name) {
  */
 Object Reader::read_from_string(const std::string& str, bool add_top_level) {
   // create text fragment and add to the DB
-  auto textFrag = std::make_shared<ProgramString>(str);
-  db.insert(textFrag);
+  auto textFrag = db.insert(std::make_shared<ProgramString>(str));
 
   // perform read
-  auto result = internal_read(textFrag, add_top_level);
+  auto result = internal_read(textFrag, symbolTable, add_top_level);
   db.link(result, textFrag, 0);
   return result;
 }
@@ -174,20 +175,116 @@ Object Reader::read_from_string(const std::string& str, bool add_top_level) {
  * Read a file
  */
 Object Reader::read_from_file(const std::vector<std::string>& file_path) {
-  auto textFrag = std::make_shared<FileText>(file_util::get_file_path(file_path));
-  db.insert(textFrag);
+  auto textFrag = db.insert(std::make_shared<FileText>(file_util::get_file_path(file_path)));
 
-  auto result = internal_read(textFrag);
+  auto result = internal_read(textFrag, symbolTable);
   db.link(result, textFrag, 0);
   return result;
 }
 
+/*!
+ * Read a file, with a new symbol table instead of the reader's. This can be called from any
+ * thread, at the same time as any other reads.
+ */
+LocalRead Reader::read_from_file_local(const std::vector<std::string>& file_path) {
+  auto textFrag = db.insert(std::make_shared<FileText>(file_util::get_file_path(file_path)));
+
+  LocalRead result;
+  result.code = internal_read(textFrag, result.symbols);
+  db.link(result.code, textFrag, 0);
+  return result;
+}
+
+namespace {
+/*!
+ * Replace each symbol in obj that is in the map with its replacement.
+ */
+void replace_symbols(Object& obj, const SymbolTable::Replacements& replacements) {
+  // long lists are common, so only recurse on the car.
+  Object* current = &obj;
+  for (;;) {
+    switch (current->type) {
+      case ObjectType::SYMBOL: {
+        auto replacement =
+            replacements.find(static_cast<const SymbolObject*>(current->heap_obj.get()));
+        if (replacement != replacements.end()) {
+          current->heap_obj = replacement->second;
+        }
+        return;
+      }
+      case ObjectType::PAIR: {
+        auto pair = current->as_pair();
+        replace_symbols(pair->car, replacements);
+        current = &pair->cdr;
+      } break;
+      case ObjectType::ARRAY:
+        for (auto& elt : current->as_array()->data) {
+          replace_symbols(elt, replacements);
+        }
+        return;
+      default:
+        return;
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * Add the symbols of code from read_from_file_local to the reader's symbol table, and return the
+ * code. Symbols that are already in the reader's table are replaced by the existing symbol, so
+ * the result is the same as read_from_file. Must be called from the thread that uses the reader.
+ */
+Object Reader::merge_symbols(LocalRead&& read) {
+  auto replacements = symbolTable.merge(std::move(read.symbols));
+  if (!replacements.empty()) {
+    replace_symbols(read.code, replacements);
+  }
+  return read.code;
+}
+
+/*!
+ * Read files on the threads of the pool, and return the code in the same order.
+ */
+std::vector<Object> Reader::read_from_files(const std::vector<std::vector<std::string>>& file_paths,
+                                            ThreadPool& pool) {
+  std::vector<std::future<LocalRead>> reads;
+  reads.reserve(file_paths.size());
+  for (auto& path : file_paths) {
+    reads.push_back(pool.submit([this, &path]() { return read_from_file_local(path); }));
+  }
+
+  // wait for all of them before throwing, the jobs refer to file_paths.
+  std::vector<LocalRead> results;
+  std::exception_ptr first_error = nullptr;
+  for (auto& read : reads) {
+    try {
+      results.push_back(read.get());
+    } catch (...) {
+      if (!first_error) {
+        first_error = std::current_exception();
+      }
+    }
+  }
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+
+  std::vector<Object> code;
+  code.reserve(results.size());
+  for (auto& result : results) {
+    code.push_back(merge_symbols(std::move(result)));
+  }
+  return code;
+}
+
 /*!
  * Common read for a SourceText
  */
-Object Reader::internal_read(std::shared_ptr<SourceText> text, bool add_top_level) {
+Object Reader::internal_read(std::shared_ptr<SourceText> text,
+                             SymbolTable& symbols,
+                             bool add_top_level) {
   // first create stream
-  TextStream ts(text);
+  TextStream ts(text, symbols);
 
   // clean up first whitespace
   ts.seek_past_whitespace_and_comments();
@@ -195,7 +292,7 @@ Object Reader::internal_read(std::shared_ptr<SourceText> text, bool add_top_leve
   // read list!
   auto objs = read_list(ts, false);
   if (add_top_level) {
-    return PairObject::make_new(SymbolObject::make_new(symbolTable, "top-level"), objs);
+    return PairObject::make_new(SymbolObject::make_new(symbols, "top-level"), objs);
   } else {
     return objs;
   }
@@ -204,48 +301,53 @@ Object Reader::internal_read(std::shared_ptr<SourceText> text, bool add_top_leve
 /*!
  * Given a stream starting at the first character of a token, get the token. Doesn't consume
  * whitespace at the end and leaves the stream on the first character after the token.
+ * The token's text is not copied.
  */
 Token Reader::get_next_token(TextStream& stream) {
   assert(stream.text_remains());
   Token t;
   t.source_line = stream.line_count;
   t.source_offset = stream.seek;
-  t.source_text = stream.text;
+  auto set_text = [&]() {
+    t.text = std::string_view(stream.text->get_text() + t.source_offset,
+                              stream.seek - t.source_offset);
+    return t;
+  };
 
   char first = stream.read();
-  t.text.push_back(first);
 
   // First - look for special tokens which end early:
 
   // parens, double quotes, quotes, and backticks are tokens.
   if (first == '(' || first == ')' || first == '"' || first == '\'' || first == '`')
-    return t;
+    return set_text();
 
   // ",@" is its own token
   if (first == ',' && stream.text_remains() && stream.peek() == '@') {
-    t.text.push_back(stream.read());
-    return t;
+    stream.read();
+    return set_text();
   } else if (first == ',') {
     // "," is its own token.
-    return t;
+    return set_text();
   } else if (first == '#' && stream.text_remains() && stream.peek() == '(') {
-    t.text.push_back(stream.read());
-    return t;
+    stream.read();
+    return set_text();
   }
 
   // Second - not a special token, so we read until we get a character that ends the token.
-  while (stream.text_remains()) {
-    char next = stream.peek();
-    if (next == ' ' || next == '\n' || next == '\t' || next == ')' || next == ';' || next == '#' ||
-        next == '(') {
-      return t;
-    } else {
-      // not the end, so add to token.
-      t.text.push_back(stream.read());
+  // None of these characters are newlines, so the line count doesn't change.
+  const char* data = stream.text->get_text();
+  int size = stream.text->get_size();
+  while (stream.seek < size) {
+    char next = data[stream.seek];
+    if (next == ' ' || next == '\n' || next == '\t' || next == '\r' || next == ')' || next == ';' ||
+        next == '#' || next == '(') {
+      break;
     }
+    stream.seek++;
   }
 
-  return t;
+  return set_text();
 }
 
 /*!
@@ -254,7 +356,13 @@ Token Reader::get_next_token(TextStream& stream) {
  * These are used to make 'x turn into (quote x) and similar.
  */
 void Reader::add_reader_macro(const std::string& shortcut, std::string replacement) {
-  reader_macros[shortcut] = std::move(replacement);
+  for (auto& macro : reader_macros) {
+    if (macro.first == shortcut) {
+      macro.second = std::move(replacement);
+      return;
+    }
+  }
+  reader_macros.emplace_back(shortcut, std::move(replacement));
 }
 
 /*!
@@ -305,11 +413,11 @@ bool Reader::read_object(Token& tok, TextStream& ts, Object& obj) {
     }
 
     // try as symbol
-    if (try_token_as_symbol(tok, obj)) {
+    if (try_token_as_symbol(tok, ts.symbols, obj)) {
       return true;
     }
   } catch (std::exception& e) {
-    throw_reader_error(ts, "parsing token " + tok.text + " failed: " + e.what(), -1);
+    throw_reader_error(ts, "parsing token " + std::string(tok.text) + " failed: " + e.what(), -1);
   }
 
   return false;
@@ -340,7 +448,8 @@ bool Reader::read_array(TextStream& stream, Object& o) {
         stream.seek_past_whitespace_and_comments();
         objects.push_back(next_obj);
       } else {
-        throw_reader_error(stream, "invalid token encountered in array reader: " + tok.text,
+        throw_reader_error(stream,
+                           "invalid token encountered in array reader: " + std::string(tok.text),
                            -int(tok.text.size()));
       }
     }
@@ -374,12 +483,16 @@ Object Reader::read_list(TextStream& ts, bool expect_close_paren) {
     // reader macro thing:
     bool got_reader_macro = false;
 
-    std::string reader_macro_string;
-    auto kv = reader_macros.find(tok.text);
-    if (kv != reader_macros.end()) {
+    const std::string* reader_macro_string = nullptr;
+    for (auto& macro : reader_macros) {
+      if (macro.first == tok.text) {
+        reader_macro_string = &macro.second;
+        break;
+      }
+    }
+    if (reader_macro_string) {
       // we found a reader macro! Remember this, and get the next token.
       got_reader_macro = true;
-      reader_macro_string = kv->second;
       tok = get_next_token(ts);
     } else {
       // no reader macro
@@ -406,7 +519,7 @@ Object Reader::read_list(TextStream& ts, bool expect_close_paren) {
       // create child list if we got a reader macro (ex 'x -> (quote x))
       if (got_reader_macro) {
         objects.push_back(
-            build_list({SymbolObject::make_new(symbolTable, reader_macro_string), o}));
+            build_list({SymbolObject::make_new(ts.symbols, *reader_macro_string), o}));
       } else {
         objects.push_back(o);
       }
@@ -440,7 +553,7 @@ Object Reader::read_list(TextStream& ts, bool expect_close_paren) {
         ts.seek_past_whitespace_and_comments();
         insert_object(obj);
       } else {
-        throw_reader_error(ts, "invalid token encountered in reader: " + tok.text,
+        throw_reader_error(ts, "invalid token encountered in reader: " + std::string(tok.text),
                            -int(tok.text.size()));
       }
     }
@@ -489,12 +602,12 @@ Object Reader::read_list(TextStream& ts, bool expect_close_paren) {
 /*!
  * Try decoding as symbol. Returns success.
  */
-bool Reader::try_token_as_symbol(const Token& tok, Object& obj) {
+bool Reader::try_token_as_symbol(const Token& tok, SymbolTable& symbols, Object& obj) {
   // check start character is valid:
   assert(!tok.text.empty());
   char start = tok.text[0];
   if (valid_symbols_chars[(int)start]) {
-    obj = SymbolObject::make_new(symbolTable, tok.text);
+    obj = SymbolObject::make_new(symbols, tok.text);
     return true;
   } else {
     return false;
@@ -578,16 +691,26 @@ bool Reader::try_token_as_float(const Token& tok, Object& obj) {
       }
     }
 
-    try {
-      std::size_t end = 0;
-      double v = std::stod(tok.text, &end);
-      if (end != tok.text.size())
-        return false;
-      obj = Object::make_float(v);
-      return true;
-    } catch (std::exception& e) {
+    // strtod needs a null terminated string. Almost all tokens fit in the buffer.
+    char buffer[64];
+    std::string long_text;
+    const char* str = buffer;
+    if (tok.text.size() < sizeof(buffer)) {
+      memcpy(buffer, tok.text.data(), tok.text.size());
+      buffer[tok.text.size()] = '\0';
+    } else {
+      long_text = std::string(tok.text);
+      str = long_text.c_str();
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    double v = strtod(str, &end);
+    if (errno == ERANGE || end != str + tok.text.size()) {
       return false;
     }
+    obj = Object::make_float(v);
+    return true;
   }
   return false;
 }
@@ -609,7 +732,7 @@ bool Reader::try_token_as_binary(const Token& tok, Object& obj) {
 
     for (uint32_t i = 2; i < tok.text.size(); i++) {
       if (value & (0x8000000000000000)) {
-        throw std::runtime_error("overflow in binary constant: " + tok.text);
+        throw std::runtime_error("overflow in binary constant: " + std::string(tok.text));
       }
 
       value <<= 1u;
@@ -641,16 +764,17 @@ bool Reader::try_token_as_hex(const Token& tok, Object& obj) {
     }
 
     uint64_t v = 0;
-    try {
-      std::size_t end = 0;
-      v = std::stoull(tok.text.substr(2), &end, 16);
-      if (end + 2 != tok.text.size())
-        return false;
-      obj = Object::make_integer(v);
-      return true;
-    } catch (std::exception& e) {
-      throw std::runtime_error("The number " + tok.text + " cannot be a hexadecimal constant");
+    auto end = tok.text.data() + tok.text.size();
+    auto result = std::from_chars(tok.text.data() + 2, end, v, 16);
+    if (result.ec == std::errc::result_out_of_range) {
+      throw std::runtime_error("The number " + std::string(tok.text) +
+                               " cannot be a hexadecimal constant");
+    }
+    if (result.ec != std::errc() || result.ptr != end) {
+      return false;
     }
+    obj = Object::make_integer(v);
+    return true;
   }
   return false;
 }
@@ -673,18 +797,18 @@ bool Reader::try_token_as_integer(const Token& tok, Object& obj) {
         return false;
       }
     }
-    uint64_t v = 0;
-    try {
-      std::size_t end = 0;
-      v = std::stoll(tok.text, &end);
-      if (end != tok.text.size()) {
-        return false;
-      }
-      obj = Object::make_integer(v);
-      return true;
-    } catch (std::exception& e) {
-      throw std::runtime_error("The number " + tok.text + " cannot be an integer constant");
+    int64_t v = 0;
+    auto end = tok.text.data() + tok.text.size();
+    auto result = std::from_chars(tok.text.data(), end, v);
+    if (result.ec == std::errc::result_out_of_range) {
+      throw std::runtime_error("The number " + std::string(tok.text) +
+                               " cannot be an integer constant");
+    }
+    if (result.ec != std::errc() || result.ptr != end) {
+      return false;
     }
+    obj = Object::make_integer(v);
+    return true;
   }
   return false;
 }
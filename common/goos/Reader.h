@@ -9,25 +9,33 @@
  *
  * The reader also know where the source folder is, through an environment variable set when
  * launching the compiler or the compiler test.
+ *
+ * Files can also be read on other threads, with a separate symbol table for each file. The symbols
+ * are merged into the reader's symbol table afterward, on the thread that uses the result.
  */
 
 #include <memory>
 #include <cassert>
+#include <string_view>
 #include <utility>
-#include <unordered_map>
+#include <vector>
 
 #include "common/goos/Object.h"
 #include "common/goos/TextDB.h"
 
+class ThreadPool;
+
 namespace goos {
 
 /*!
  * Wrapper around a source of text that allows reading/peeking.
  */
 struct TextStream {
-  explicit TextStream(std::shared_ptr<SourceText> ptr) { text = std::move(ptr); }
+  TextStream(std::shared_ptr<SourceText> ptr, SymbolTable& symbol_table)
+      : text(std::move(ptr)), symbols(symbol_table) {}
 
   std::shared_ptr<SourceText> text;
+  SymbolTable& symbols;  // symbols read from the text are added here
   int seek = 0;
   int line_count = 0;
 
@@ -55,13 +63,21 @@ struct TextStream {
 };
 
 /*!
- * A Token used for parsing.
+ * A Token used for parsing. The text refers to the SourceText being read.
  */
 struct Token {
-  std::shared_ptr<SourceText> source_text;
   int source_offset;
   int source_line;
-  std::string text;
+  std::string_view text;
+};
+
+/*!
+ * Code read with its own symbol table, so it doesn't use the reader's symbol table. Must be passed
+ * to Reader::merge_symbols before the code is used.
+ */
+struct LocalRead {
+  Object code;
+  SymbolTable symbols;
 };
 
 class Reader {
@@ -70,6 +86,10 @@ class Reader {
   Object read_from_string(const std::string& str, bool add_top_level = true);
   Object read_from_stdin(const std::string& prompt_name);
   Object read_from_file(const std::vector<std::string>& file_path);
+  LocalRead read_from_file_local(const std::vector<std::string>& file_path);
+  Object merge_symbols(LocalRead&& read);
+  std::vector<Object> read_from_files(const std::vector<std::vector<std::string>>& file_paths,
+                                      ThreadPool& pool);
 
   std::string get_source_dir();
 
@@ -77,7 +97,9 @@ class Reader {
   TextDb db;
 
  private:
-  Object internal_read(std::shared_ptr<SourceText> text, bool add_top_level = true);
+  Object internal_read(std::shared_ptr<SourceText> text,
+                       SymbolTable& symbols,
+                       bool add_top_level = true);
   Object read_list(TextStream& stream, bool expect_close_paren = true);
   bool read_object(Token& tok, TextStream& ts, Object& obj);
   bool read_array(TextStream& stream, Object& o);
@@ -85,7 +107,7 @@ class Reader {
   void throw_reader_error(TextStream& here, const std::string& err, int seek_offset);
   Token get_next_token(TextStream& stream);
 
-  bool try_token_as_symbol(const Token& tok, Object& obj);
+  bool try_token_as_symbol(const Token& tok, SymbolTable& symbols, Object& obj);
   bool try_token_as_char(const Token& tok, Object& obj);
   bool try_token_as_float(const Token& tok, Object& obj);
   bool try_token_as_binary(const Token& tok, Object& obj);
@@ -96,7 +118,8 @@ class Reader {
 
   char valid_symbols_chars[256];
 
-  std::unordered_map<std::string, std::string> reader_macros;
+  // shortcut, replacement. There are only a few, so this is faster to search than a map.
+  std::vector<std::pair<std::string, std::string>> reader_macros;
 };
 
 std::string get_readable_string(const char* in);
@@ -11,22 +11,73 @@
  *   (+ 1 (+ a b)) ; compute the sum
  */
 
+#include <algorithm>
+#include <atomic>
+#include <shared_mutex>
 #include "common/util/FileUtil.h"
+#include "common/util/MappedFile.h"
 
 #include "TextDB.h"
 
 namespace goos {
 
+namespace {
+u32 next_source_text_id() {
+  static std::atomic<u32> last_id = 0;
+  return ++last_id;
+}
+
+/*!
+ * The linked pair count of every source text that exists, by id. Pairs only know the id of their
+ * text, and may be destroyed on any thread, after their text is gone.
+ */
+struct LinkCounts {
+  std::shared_mutex mutex;
+  std::unordered_map<u32, std::atomic<u32>*> by_id;
+};
+
+LinkCounts& link_counts() {
+  // never destroyed, pairs may be destroyed during static destruction.
+  static auto* counts = new LinkCounts();
+  return *counts;
+}
+
+void register_link_count(u32 id, std::atomic<u32>* count) {
+  auto& counts = link_counts();
+  std::unique_lock<std::shared_mutex> lock(counts.mutex);
+  counts.by_id[id] = count;
+}
+}  // namespace
+
+void unlink_source_text(u32 text_id) {
+  auto& counts = link_counts();
+  std::shared_lock<std::shared_mutex> lock(counts.mutex);
+  auto it = counts.by_id.find(text_id);
+  if (it != counts.by_id.end()) {
+    (*it->second)--;
+  }
+}
+
+SourceText::SourceText() : id(next_source_text_id()) {
+  register_link_count(id, &linked_pairs);
+}
+
 /*!
  * Initialize with the given string
  */
-SourceText::SourceText(std::string r) : text(std::move(r)) {
-  // find line breaks
-  build_offsets();
+SourceText::SourceText(std::string r)
+    : owned_text(std::move(r)), text(owned_text), id(next_source_text_id()) {
+  register_link_count(id, &linked_pairs);
+}
+
+SourceText::~SourceText() {
+  auto& counts = link_counts();
+  std::unique_lock<std::shared_mutex> lock(counts.mutex);
+  counts.by_id.erase(id);
 }
 
 /*!
- * Update line break data. Should be called any time the text is updated.
+ * Find line breaks. This is done the first time a line is needed.
  */
 void SourceText::build_offsets() {
   offset_by_line.clear();
@@ -43,91 +94,168 @@ void SourceText::build_offsets() {
  * Get the text of the line containing the character at position "offset" from this source.
  */
 std::string SourceText::get_line_containing_offset(int offset) {
+  std::call_once(offsets_built, [this]() { build_offsets(); });
   auto range = get_containing_line(offset);
   int start_offset = range.first ? 1 : 0;
-  return text.substr(range.first + start_offset,
-                     std::max(0, range.second - range.first - start_offset));
+  auto line = text.substr(range.first + start_offset,
+                         std::max(0, range.second - range.first - start_offset));
+  // files aren't opened in text mode, so Windows line endings are still there.
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  return std::string(line);
 }
 
 /*!
  * Get the index of the line containing the character at position "offset".
- * O(n_lines) crappy implementation.
  * Error if not found.
  */
 int SourceText::get_line_idx(int offset) {
-  for (uint32_t line = 0; line < offset_by_line.size() - 1; line++) {
-    if (offset >= offset_by_line[line] && offset <= offset_by_line[line + 1]) {
-      return line;
-    }
+  std::call_once(offsets_built, [this]() { build_offsets(); });
+  int line = find_line(offset);
+  if (line < 0) {
+    throw std::runtime_error("Unable to get line index for character at position " +
+                             std::to_string(offset));
   }
-  throw std::runtime_error("Unable to get line index for character at position " +
-                           std::to_string(offset));
+  return line;
+}
+
+/*!
+ * Find the first line that ends at or after offset, or -1 if there isn't one. A newline character
+ * is part of the line it ends.
+ */
+int SourceText::find_line(int offset) {
+  if (offset < 0) {
+    return -1;
+  }
+  auto line_end = std::lower_bound(offset_by_line.begin() + 1, offset_by_line.end(), offset);
+  if (line_end == offset_by_line.end()) {
+    return -1;
+  }
+  return line_end - (offset_by_line.begin() + 1);
 }
 
 /*!
  * Gets the [start, end) character offset of the line containing the given offset.
  */
 std::pair<int, int> SourceText::get_containing_line(int offset) {
-  for (uint32_t line = 0; line < offset_by_line.size() - 1; line++) {
-    if (offset >= offset_by_line[line] && offset <= offset_by_line[line + 1]) {
-      return std::make_pair(offset_by_line[line], offset_by_line[line + 1]);
-    }
+  int line = find_line(offset);
+  if (line < 0) {
+    return std::make_pair(0, text.size());
   }
-  return std::make_pair(0, text.size());
+  return std::make_pair(offset_by_line[line], offset_by_line[line + 1]);
 }
 
 /*!
- * Read text from a file.
+ * Read text from a file. The mapping is closed once the text is copied: a mapping kept open would
+ * show later changes to the file, and reading past the end of a truncated file crashes.
  */
 FileText::FileText(std::string filename_) : filename(std::move(filename_)) {
-  text = file_util::read_text_file(filename);
-  build_offsets();
+  MappedFile file(filename);
+  owned_text = std::string(file.text());
+  text = owned_text;
+}
+
+/*!
+ * Inform the TextDB about a source of text. Returns the text that should be read. If the same file
+ * was already read, and hasn't changed, this is the text from the first time, so reading the same
+ * file over and over doesn't use more memory.
+ */
+std::shared_ptr<SourceText> TextDb::insert(const std::shared_ptr<SourceText>& frag) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (dynamic_cast<FileText*>(frag.get())) {
+    auto& existing = files_by_name[frag->get_description()];
+    if (existing && existing->get_view() == frag->get_view()) {
+      return existing;
+    }
+    if (!existing) {
+      file_names.push_back(frag->get_description());
+    }
+    existing = frag;
+  }
+  fragments_by_id[frag->get_id()] = frag;
+
+  // checking every fragment is only done once their number doubles, so inserting stays O(1).
+  if (fragments_by_id.size() >= std::max(size_t(64), 2 * fragments_after_drop)) {
+    drop_unused_fragments();
+  }
+  return frag;
+}
+
+/*!
+ * Forget fragments that no pair is linked to. A fragment that is still held somewhere else may be
+ * in the middle of being read, and the latest version of a file is held by files_by_name.
+ */
+void TextDb::drop_unused_fragments() {
+  for (auto it = fragments_by_id.begin(); it != fragments_by_id.end();) {
+    if (it->second.use_count() == 1 && it->second->linked_pair_count() == 0) {
+      it = fragments_by_id.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  fragments_after_drop = fragments_by_id.size();
 }
 
 /*!
- * Inform the TextDB about a source of text.
+ * Get the names of all files which have been read.
  */
-void TextDb::insert(const std::shared_ptr<SourceText>& frag) {
-  fragments.push_back(frag);
+std::vector<std::string> TextDb::get_file_names() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return file_names;
+}
+
+/*!
+ * Get the number of text fragments that are kept.
+ */
+size_t TextDb::fragment_count() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return fragments_by_id.size();
 }
 
 /*!
  * Link the GOOS object o to the offset into the given text fragment.
  * The object _must_ be a pair or empty list.
  */
-void TextDb::link(const Object& o, std::shared_ptr<SourceText> frag, int offset) {
+void TextDb::link(const Object& o, const std::shared_ptr<SourceText>& frag, int offset) {
   if (o.is_empty_list())
     return;
   assert(o.is_pair());
-  TextRef ref;
-  ref.offset = offset;
-  ref.frag = std::move(frag);
-  map[o.heap_obj] = ref;
+  auto pair = static_cast<PairObject*>(o.heap_obj.get());
+  if (pair->text_id != frag->get_id()) {
+    if (pair->text_id) {
+      unlink_source_text(pair->text_id);
+    }
+    frag->linked_pairs++;
+    pair->text_id = frag->get_id();
+  }
+  pair->text_offset = offset;
 }
 
 /*!
  * Given an object, get a string representing where it's from. Or "?" if we can't find it.
  */
 std::string TextDb::get_info_for(const Object& o, bool* terminate_compiler_error) {
-  if (o.is_pair()) {
-    auto kv = map.find(o.heap_obj);
-    if (kv != map.end()) {
-      if (terminate_compiler_error) {
-        *terminate_compiler_error = kv->second.frag->terminate_compiler_error();
-      }
-      return get_info_for(kv->second.frag, kv->second.offset);
-    } else {
-      if (terminate_compiler_error) {
-        *terminate_compiler_error = false;
-      }
+  if (terminate_compiler_error) {
+    *terminate_compiler_error = false;
+  }
+  if (!o.is_pair()) {
+    return "?\n";
+  }
+  auto pair = static_cast<const PairObject*>(o.heap_obj.get());
+  std::shared_ptr<SourceText> frag;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto kv = fragments_by_id.find(pair->text_id);
+    if (kv == fragments_by_id.end()) {
       return "?\n";
     }
-  } else {
-    if (terminate_compiler_error) {
-      *terminate_compiler_error = false;
-    }
-    return "?\n";
+    frag = kv->second;
+  }
+  if (terminate_compiler_error) {
+    *terminate_compiler_error = frag->terminate_compiler_error();
   }
+  return get_info_for(frag, pair->text_offset);
 }
 
 /*!
@@ -11,13 +11,24 @@
  * Error on (+ a b): a has invalid type (string)
  * From my-file.gc, line 25:
  *   (+ 1 (+ a b)) ; compute the sum
+ *
+ * The location of a list is stored in its first pair, as the id of the SourceText and an offset.
+ * The line is only found when it's needed for an error message.
+ *
+ * Files may be read on multiple threads at once, so the TextDb is protected by a mutex.
+ *
+ * Each SourceText counts the pairs linked to it. Once no pair refers to a text, and nobody else
+ * holds it, the TextDb drops it. The latest version of each file is always kept.
  */
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
 
 #include "common/goos/Object.h"
 
@@ -28,9 +39,14 @@ namespace goos {
 class SourceText {
  public:
   explicit SourceText(std::string r);
-  SourceText() = default;
-  const char* get_text() { return text.c_str(); }
+  SourceText();
+  SourceText(const SourceText&) = delete;
+  SourceText& operator=(const SourceText&) = delete;
+  const char* get_text() { return text.data(); }
   int get_size() { return text.size(); }
+  std::string_view get_view() const { return text; }
+  u32 get_id() const { return id; }
+  u32 linked_pair_count() const { return linked_pairs; }
   virtual std::string get_description() = 0;
   std::string get_line_containing_offset(int offset);
   int get_line_idx(int offset);
@@ -39,13 +55,21 @@ class SourceText {
   // want
   virtual bool terminate_compiler_error() { return true; }
 
-  virtual ~SourceText(){};
+  virtual ~SourceText();
 
  protected:
+  std::string owned_text;  // the text, unless it's stored somewhere else
+  std::string_view text;   // not null terminated
+
+ private:
   void build_offsets();
-  std::string text;
-  std::vector<int> offset_by_line;
+  int find_line(int offset);
   std::pair<int, int> get_containing_line(int offset);
+  friend class TextDb;
+  u32 id = 0;  // unique, never 0
+  std::atomic<u32> linked_pairs = 0;
+  std::once_flag offsets_built;
+  std::vector<int> offset_by_line;  // only built when needed
 };
 
 /*!
@@ -69,7 +93,8 @@ class ProgramString : public SourceText {
 };
 
 /*!
- * Text from a file.
+ * Text from a file. The text is copied when the file is read, so errors still print the text that
+ * was compiled if the file is changed later.
  */
 class FileText : public SourceText {
  public:
@@ -82,20 +107,22 @@ class FileText : public SourceText {
   std::string filename;
 };
 
-struct TextRef {
-  int offset;
-  std::shared_ptr<SourceText> frag;
-};
-
 class TextDb {
  public:
-  void insert(const std::shared_ptr<SourceText>& frag);
-  void link(const Object& o, std::shared_ptr<SourceText> frag, int offset);
+  std::shared_ptr<SourceText> insert(const std::shared_ptr<SourceText>& frag);
+  void link(const Object& o, const std::shared_ptr<SourceText>& frag, int offset);
   std::string get_info_for(const Object& o, bool* terminate_compiler_error = nullptr);
   std::string get_info_for(const std::shared_ptr<SourceText>& frag, int offset);
+  std::vector<std::string> get_file_names() const;
+  size_t fragment_count() const;
 
  private:
-  std::vector<std::shared_ptr<SourceText>> fragments;
-  std::unordered_map<std::shared_ptr<goos::HeapObject>, TextRef> map;
+  void drop_unused_fragments();
+
+  std::unordered_map<u32, std::shared_ptr<SourceText>> fragments_by_id;
+  std::unordered_map<std::string, std::shared_ptr<SourceText>> files_by_name;  // latest version
+  std::vector<std::string> file_names;  // in the order they were first read
+  size_t fragments_after_drop = 0;
+  mutable std::mutex mutex;
 };
 }  // namespace goos
@@ -28,6 +28,7 @@ struct Logger {
 };
 
 Logger gLogger;
+thread_local LogBuffer* tBuffer = nullptr;
 
 namespace internal {
 const char* log_level_names[] = {"trace", "debug", "info", "warn", "error", "die"};
@@ -35,6 +36,11 @@ const fmt::color log_colors[] = {fmt::color::gray,   fmt::color::turquoise, fmt:
                                  fmt::color::yellow, fmt::color::red,       fmt::color::hot_pink};
 
 void log_message(level log_level, LogTime& now, const char* message) {
+  if (tBuffer && log_level != level::die) {
+    tBuffer->add(log_level, now, message);
+    return;
+  }
+
 #ifdef __linux__
   char date_time_buffer[128];
   time_t now_seconds = now.tv.tv_sec;
@@ -75,6 +81,24 @@ void log_message(level log_level, LogTime& now, const char* message) {
 }
 }  // namespace internal
 
+void LogBuffer::add(level log_level, const LogTime& now, const std::string& message) {
+  m_messages.push_back({log_level, now, message});
+}
+
+/*!
+ * Print and clear the saved messages.
+ */
+void LogBuffer::flush() {
+  for (auto& msg : m_messages) {
+    internal::log_message(msg.log_level, msg.time, msg.text.c_str());
+  }
+  m_messages.clear();
+}
+
+void set_thread_buffer(LogBuffer* buffer) {
+  tBuffer = buffer;
+}
+
 void set_file(const std::string& filename) {
   assert(!gLogger.fp);
   gLogger.fp = fopen(filename.c_str(), "w");
@@ -6,6 +6,7 @@
 #include <sys/time.h>
 #endif
 #include <string>
+#include <vector>
 #include "third-party/fmt/core.h"
 
 namespace lg {
@@ -28,6 +29,30 @@ namespace internal {
 void log_message(level log_level, LogTime& now, const char* message);
 }  // namespace internal
 
+/*!
+ * Messages saved for later, see set_thread_buffer.
+ */
+class LogBuffer {
+ public:
+  void add(level log_level, const LogTime& now, const std::string& message);
+  void flush();
+
+ private:
+  struct Message {
+    level log_level;
+    LogTime time;
+    std::string text;
+  };
+  std::vector<Message> m_messages;
+};
+
+/*!
+ * Save messages logged on this thread in buffer instead of printing them, until this is called
+ * again with nullptr. Flushing the buffers afterward prints the messages in a fixed order, no
+ * matter which threads they were logged from. "die" messages are never buffered.
+ */
+void set_thread_buffer(LogBuffer* buffer);
+
 void set_file(const std::string& filename);
 void set_flush_level(level log_level);
 void set_file_level(level log_level);
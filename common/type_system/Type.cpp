@@ -7,6 +7,7 @@
 #include <cassert>
 #include <third-party/fmt/core.h>
 #include "Type.h"
+#include "common/util/Serializer.h"
 
 namespace {
 std::string reg_kind_to_string(RegClass kind) {
@@ -42,6 +43,13 @@ std::string MethodInfo::print_one_line() const {
   return fmt::format("Method {:3d}: {:20} {}", id, name, type.print());
 }
 
+void MethodInfo::serialize(Serializer& ser) {
+  ser.from_pod(&id);
+  ser.from_str(&name);
+  type.serialize(ser);
+  ser.from_str(&defined_in_type);
+}
+
 Field::Field(std::string name, TypeSpec ts) : m_name(std::move(name)), m_type(std::move(ts)) {}
 Field::Field(std::string name, TypeSpec ts, int offset)
     : m_name(std::move(name)), m_type(std::move(ts)), m_offset(offset) {}
@@ -94,6 +102,17 @@ bool Field::operator==(const Field& other) const {
   // clang-format on
 }
 
+void Field::serialize(Serializer& ser) {
+  ser.from_str(&m_name);
+  m_type.serialize(ser);
+  ser.from_pod(&m_offset);
+  ser.from_pod(&m_inline);
+  ser.from_pod(&m_dynamic);
+  ser.from_pod(&m_array);
+  ser.from_pod(&m_array_size);
+  ser.from_pod(&m_alignment);
+}
+
 /////////////
 // Type
 /////////////
@@ -243,6 +262,26 @@ std::string Type::print_method_info() const {
   return result;
 }
 
+/*!
+ * Save or load the data common to all types.
+ */
+void Type::serialize(Serializer& ser) {
+  auto method_count = ser.save_or_load<u32>(m_methods.size());
+  if (ser.is_loading()) {
+    m_methods.resize(method_count);
+  }
+  for (auto& method : m_methods) {
+    method.serialize(ser);
+  }
+  m_new_method_info.serialize(ser);
+  ser.from_pod(&m_new_method_info_defined);
+  ser.from_str(&m_parent);
+  ser.from_str(&m_name);
+  ser.from_pod(&m_allow_in_runtime);
+  ser.from_str(&m_runtime_name);
+  ser.from_pod(&m_is_boxed);
+}
+
 /////////////
 // NullType
 /////////////
@@ -412,6 +451,14 @@ bool ValueType::operator==(const Type& other) const {
   // clang-format on
 }
 
+void ValueType::serialize(Serializer& ser) {
+  Type::serialize(ser);
+  ser.from_pod(&m_size);
+  ser.from_pod(&m_offset);
+  ser.from_pod(&m_sign_extend);
+  ser.from_pod(&m_reg_kind);
+}
+
 /////////////////
 // ReferenceType
 /////////////////
@@ -502,6 +549,21 @@ bool StructureType::operator==(const Type& other) const {
   // clang-format on
 }
 
+void StructureType::serialize(Serializer& ser) {
+  ReferenceType::serialize(ser);
+  auto field_count = ser.save_or_load<u32>(m_fields.size());
+  if (ser.is_loading()) {
+    m_fields.resize(field_count);
+  }
+  for (auto& field : m_fields) {
+    field.serialize(ser);
+  }
+  ser.from_pod(&m_dynamic);
+  ser.from_pod(&m_size_in_mem);
+  ser.from_pod(&m_pack);
+  ser.from_pod(&m_offset);
+}
+
 bool BitFieldType::operator==(const Type& other) const {
   if (typeid(*this) != typeid(other)) {
     return false;
@@ -511,6 +573,17 @@ bool BitFieldType::operator==(const Type& other) const {
   return other.is_equal(*this) && m_fields == p_other->m_fields;
 }
 
+void BitFieldType::serialize(Serializer& ser) {
+  ValueType::serialize(ser);
+  auto field_count = ser.save_or_load<u32>(m_fields.size());
+  if (ser.is_loading()) {
+    m_fields.resize(field_count);
+  }
+  for (auto& field : m_fields) {
+    field.serialize(ser);
+  }
+}
+
 int StructureType::get_size_in_memory() const {
   return m_size_in_mem;
 }
@@ -591,6 +664,13 @@ bool BitField::operator==(const BitField& other) const {
          other.m_size == m_size;
 }
 
+void BitField::serialize(Serializer& ser) {
+  m_type.serialize(ser);
+  ser.from_str(&m_name);
+  ser.from_pod(&m_offset);
+  ser.from_pod(&m_size);
+}
+
 BitFieldType::BitFieldType(std::string parent, std::string name, int size, bool sign_extend)
     : ValueType(std::move(parent), std::move(name), false, size, sign_extend, RegClass::GPR_64) {}
 
@@ -14,6 +14,7 @@
 #include "TypeSpec.h"
 
 class TypeSystem;
+class Serializer;
 
 struct MethodInfo {
   int id = -1;
@@ -23,6 +24,7 @@ struct MethodInfo {
 
   bool operator==(const MethodInfo& other) const;
   std::string print_one_line() const;
+  void serialize(Serializer& ser);
 };
 
 /*!
@@ -78,6 +80,9 @@ class Type {
 
   void disallow_in_runtime() { m_allow_in_runtime = false; }
 
+  // save or load this type. Child classes with extra data should override this.
+  virtual void serialize(Serializer& ser);
+
   virtual ~Type() = default;
 
  protected:
@@ -136,6 +141,7 @@ class ValueType : public Type {
   int get_inline_array_alignment() const override;
   std::string print() const override;
   bool operator==(const Type& other) const override;
+  void serialize(Serializer& ser) override;
   ~ValueType() = default;
 
   void inherit(const ValueType* parent);
@@ -180,6 +186,7 @@ class Field {
   const std::string& name() const { return m_name; }
   int offset() const { return m_offset; }
   bool operator==(const Field& other) const;
+  void serialize(Serializer& ser);
 
   int alignment() const {
     assert(m_alignment != -1);
@@ -224,6 +231,7 @@ class StructureType : public ReferenceType {
   int get_inline_array_alignment() const override;
   bool lookup_field(const std::string& name, Field* out);
   bool is_dynamic() const { return m_dynamic; }
+  void serialize(Serializer& ser) override;
   ~StructureType() = default;
   void set_pack(bool pack) { m_pack = pack; }
 
@@ -264,6 +272,7 @@ class BitField {
   const TypeSpec& type() const { return m_type; }
   bool operator==(const BitField& other) const;
   std::string print() const;
+  void serialize(Serializer& ser);
 
  private:
   TypeSpec m_type;
@@ -278,6 +287,7 @@ class BitFieldType : public ValueType {
   bool lookup_field(const std::string& name, BitField* out) const;
   std::string print() const override;
   bool operator==(const Type& other) const override;
+  void serialize(Serializer& ser) override;
 
  private:
   friend class TypeSystem;
@@ -3,6 +3,7 @@
  * Reverse field lookup used in the decompiler.
  */
 
+#include <algorithm>
 #include "third-party/fmt/core.h"
 #include "TypeSystem.h"
 
@@ -345,10 +346,86 @@ bool TypeSystem::try_reverse_lookup_inline_array(const FieldReverseLookupInput&
   }
 }
 
+/*!
+ * Precomputed information for finding the fields of a structure that contain an offset.
+ * The offsets are split into ranges where the same fields contain every offset in the range.
+ */
+struct TypeSystem::ReverseFieldIndex {
+  struct Entry {
+    int field_idx;  // in StructureType::fields()
+    FieldLookupInfo deref;
+    int size_in_type;
+  };
+  std::vector<Entry> fields;
+  // range i is [range_starts[i], range_starts[i + 1]). The last range includes everything after it,
+  // for dynamic fields.
+  std::vector<int> range_starts;
+  std::vector<std::vector<int>> range_fields;  // indices into fields, in field order
+
+  const std::vector<int>* fields_at(int offset) const {
+    auto it = std::upper_bound(range_starts.begin(), range_starts.end(), offset);
+    if (it == range_starts.begin()) {
+      return nullptr;
+    }
+    return &range_fields.at(it - range_starts.begin() - 1);
+  }
+};
+
+/*!
+ * Get the reverse field index of a structure, building it the first time. Returns nullptr if it
+ * can't be built, in which case the fields should be checked one at a time.
+ */
+std::shared_ptr<const TypeSystem::ReverseFieldIndex> TypeSystem::get_reverse_field_index(
+    const StructureType* type) const {
+  {
+    std::shared_lock<std::shared_mutex> lock(m_cache_mutex);
+    auto it = m_reverse_field_indices.find(type);
+    if (it != m_reverse_field_indices.end()) {
+      return it->second;
+    }
+  }
+
+  std::shared_ptr<ReverseFieldIndex> index = std::make_shared<ReverseFieldIndex>();
+  try {
+    std::vector<int> boundaries;
+    for (int i = 0; i < (int)type->fields().size(); i++) {
+      auto& field = type->fields().at(i);
+      index->fields.push_back(
+          {i, lookup_field_info(type->get_name(), field.name()), get_size_in_type(field)});
+      boundaries.push_back(field.offset());
+      if (!field.is_dynamic()) {
+        boundaries.push_back(field.offset() + index->fields.back().size_in_type);
+      }
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+    for (auto start : boundaries) {
+      std::vector<int> in_range;
+      for (int i = 0; i < (int)index->fields.size(); i++) {
+        auto& field = type->fields().at(index->fields[i].field_idx);
+        if (field.offset() <= start &&
+            (field.is_dynamic() || start < field.offset() + index->fields[i].size_in_type)) {
+          in_range.push_back(i);
+        }
+      }
+      index->range_starts.push_back(start);
+      index->range_fields.push_back(std::move(in_range));
+    }
+  } catch (std::runtime_error&) {
+    index = nullptr;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(m_cache_mutex);
+  m_reverse_field_indices[type] = index;
+  return index;
+}
+
 /*!
  * Handle a deref for fields of a structure.
  * - Access a field which requires mem deref.
  * - Get address of a field which requires mem deref.
+ * Only the fields that contain the offset are checked, using the reverse field index.
  */
 bool TypeSystem::try_reverse_lookup_other(const FieldReverseLookupInput& input,
                                           std::vector<FieldReverseLookupOutput::Token>* path,
@@ -361,101 +438,132 @@ bool TypeSystem::try_reverse_lookup_other(const FieldReverseLookupInput& input,
   }
 
   auto corrected_offset = input.offset + type_info->get_offset();
-  // loop over fields. We may need to try multiple fields.
-  for (auto& field : structure_type->fields()) {
-    auto field_deref = lookup_field_info(type_info->get_name(), field.name());
+  // how many bytes do we look at? In the case where we're just getting an address, we assume
+  // one byte, so we'll always pass the size check.
+  auto effective_load_size = 1;
+  if (input.deref.has_value()) {
+    effective_load_size = input.deref->size;
+  }
 
-    // how many bytes do we look at? In the case where we're just getting an address, we assume
-    // one byte, so we'll always pass the size check.
-    auto effective_load_size = 1;
-    if (input.deref.has_value()) {
-      effective_load_size = input.deref->size;
+  // the lookup log needs to see the types of all the fields, so don't use the index.
+  std::shared_ptr<const ReverseFieldIndex> index;
+  if (!m_lookup_log && effective_load_size > 0) {
+    index = get_reverse_field_index(structure_type);
+  }
+
+  if (!index) {
+    // loop over fields. We may need to try multiple fields.
+    for (auto& field : structure_type->fields()) {
+      auto field_deref = lookup_field_info(type_info->get_name(), field.name());
+      if (corrected_offset >= field.offset() &&
+          (corrected_offset + effective_load_size <= field.offset() + get_size_in_type(field) ||
+           field.is_dynamic())) {
+        if (try_reverse_lookup_field(input, field, field_deref, corrected_offset - field.offset(),
+                                     path, addr_of, result_type)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  auto candidates = index->fields_at(corrected_offset);
+  if (!candidates) {
+    return false;
+  }
+  for (auto idx : *candidates) {
+    auto& entry = index->fields.at(idx);
+    auto& field = structure_type->fields().at(entry.field_idx);
+    if (corrected_offset + effective_load_size <= field.offset() + entry.size_in_type ||
+        field.is_dynamic()) {
+      if (try_reverse_lookup_field(input, field, entry.deref, corrected_offset - field.offset(),
+                                   path, addr_of, result_type)) {
+        return true;
+      }
     }
+  }
+  return false;
+}
 
-    if (corrected_offset >= field.offset() &&
-        (corrected_offset + effective_load_size <= field.offset() + get_size_in_type(field) ||
-         field.is_dynamic())) {
-      // the field size looks okay.
-      int offset_into_field = corrected_offset - field.offset();
-
-      FieldReverseLookupOutput::Token token;
-      token.kind = FieldReverseLookupOutput::Token::Kind::FIELD;
-      token.name = field.name();
-
-      if (field_deref.needs_deref) {
-        if (offset_into_field == 0) {
-          if (input.deref.has_value()) {
-            // needs deref, offset is 0, did a deref.
-            // Check the deref is right...
-            // (pointer <field-type>)
-            TypeSpec loc_type = make_pointer_typespec(field_deref.type);
-            auto di = get_deref_info(loc_type);
-            bool is_integer = typecheck(TypeSpec("integer"), field_deref.type, "", false, false);
-            if (!deref_matches(di, input.deref.value(), is_integer)) {
-              continue;  // try another field!
-            }
-            // it's a match, just access the field like normal!
-            if (input.stride) {
-              continue;
-            }
-            path->push_back(token);
-            *addr_of = false;
-            *result_type = field_deref.type;
-            return true;
-          } else {
-            // needs a deref, offset is 0, didn't do a deref.
-            // we're taking the address
-            if (input.stride) {
-              continue;
-            }
-            path->push_back(token);
-            *addr_of = true;
-            *result_type = make_pointer_typespec(field_deref.type);
-            return true;
-          }
-        } else {
-          if (input.deref.has_value()) {
-            // needs deref, offset != 0, did a deref.
-            // try a different field.
-            continue;
-          } else {
-            // needs deref, offset != 0, didn't deref.
-            // try a different field
-            continue;
-          }
+/*!
+ * Try to access a field that is the right size for the reverse lookup. Returns false if it isn't
+ * the right kind of access, and another field should be tried.
+ */
+bool TypeSystem::try_reverse_lookup_field(const FieldReverseLookupInput& input,
+                                          const Field& field,
+                                          const FieldLookupInfo& field_deref,
+                                          int offset_into_field,
+                                          std::vector<FieldReverseLookupOutput::Token>* path,
+                                          bool* addr_of,
+                                          TypeSpec* result_type) const {
+  FieldReverseLookupOutput::Token token;
+  token.kind = FieldReverseLookupOutput::Token::Kind::FIELD;
+  token.name = field.name();
+
+  if (field_deref.needs_deref) {
+    if (offset_into_field == 0) {
+      if (input.deref.has_value()) {
+        // needs deref, offset is 0, did a deref.
+        // Check the deref is right...
+        // (pointer <field-type>)
+        TypeSpec loc_type = make_pointer_typespec(field_deref.type);
+        auto di = get_deref_info(loc_type);
+        bool is_integer = typecheck(TypeSpec("integer"), field_deref.type, "", false, false);
+        if (!deref_matches(di, input.deref.value(), is_integer)) {
+          return false;  // try another field!
         }
-      } else {
-        // no deref needed
-        int expected_offset_into_field = 0;
-        if (field.is_inline()) {
-          expected_offset_into_field = lookup_type(field.type())->get_offset();
+        // it's a match, just access the field like normal!
+        if (input.stride) {
+          return false;
         }
-        if (offset_into_field == expected_offset_into_field && !input.deref.has_value()) {
-          // get the inline field.
-          if (input.stride) {
-            continue;
-          }
-          path->push_back(token);
-          *result_type = field_deref.type;
-          *addr_of = false;
-          return true;
-        } else {
-          FieldReverseLookupInput next_input;
-          next_input.deref = input.deref;
-          next_input.offset = offset_into_field - expected_offset_into_field;
-          next_input.stride = input.stride;
-          next_input.base_type = field_deref.type;
-          auto old_path = *path;
-          path->push_back(token);
-          if (try_reverse_lookup(next_input, path, addr_of, result_type)) {
-            return true;
-          } else {
-            *path = old_path;
-            continue;
-          }
+        path->push_back(token);
+        *addr_of = false;
+        *result_type = field_deref.type;
+        return true;
+      } else {
+        // needs a deref, offset is 0, didn't do a deref.
+        // we're taking the address
+        if (input.stride) {
+          return false;
         }
+        path->push_back(token);
+        *addr_of = true;
+        *result_type = make_pointer_typespec(field_deref.type);
+        return true;
+      }
+    } else {
+      // needs deref, offset != 0. Whether or not we did a deref, try a different field.
+      return false;
+    }
+  } else {
+    // no deref needed
+    int expected_offset_into_field = 0;
+    if (field.is_inline()) {
+      expected_offset_into_field = lookup_type(field.type())->get_offset();
+    }
+    if (offset_into_field == expected_offset_into_field && !input.deref.has_value()) {
+      // get the inline field.
+      if (input.stride) {
+        return false;
+      }
+      path->push_back(token);
+      *result_type = field_deref.type;
+      *addr_of = false;
+      return true;
+    } else {
+      FieldReverseLookupInput next_input;
+      next_input.deref = input.deref;
+      next_input.offset = offset_into_field - expected_offset_into_field;
+      next_input.stride = input.stride;
+      next_input.base_type = field_deref.type;
+      auto old_path = *path;
+      path->push_back(token);
+      if (try_reverse_lookup(next_input, path, addr_of, result_type)) {
+        return true;
+      } else {
+        *path = old_path;
+        return false;
       }
     }
   }
-  return false;
-}
\ No newline at end of file
+}
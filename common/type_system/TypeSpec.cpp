@@ -3,66 +3,180 @@
  * A GOAL TypeSpec is a reference to a type or compound type.
  */
 
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 #include "TypeSpec.h"
 #include "Type.h"
+#include "common/util/Hash.h"
+#include "common/util/Serializer.h"
+#include "common/util/StringTable.h"
 
-TypeSpec::TypeSpec(std::string type) : m_type(std::move(type)) {}
+namespace {
+/*!
+ * All type names and TypeSpecs that have ever been created. Lookups only take a shared lock, and
+ * nothing is ever removed, so references to names and TypeSpecData stay valid forever.
+ */
+class TypeSpecTable {
+ public:
+  u32 name_id(const std::string& name) { return m_names.id(name); }
+  const std::string& name(u32 id) const { return m_names.str(id); }
 
-TypeSpec::TypeSpec(std::string type, std::vector<TypeSpec> arguments)
-    : m_type(std::move(type)), m_arguments(std::move(arguments)) {}
+  const TypeSpecData* get(u32 name_id, const std::vector<TypeSpec>& arguments) {
+    if (arguments.empty()) {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      if (name_id < m_simple.size() && m_simple[name_id]) {
+        return m_simple[name_id];
+      }
+    }
 
-std::string TypeSpec::print() const {
-  if (m_arguments.empty()) {
-    return m_type;
-  } else {
-    std::string result = "(" + m_type;
-    for (auto& x : m_arguments) {
-      result += " " + x.print();
+    u64 hash = hash_util::combine(hash_util::FNV_OFFSET, name_id);
+    for (auto& arg : arguments) {
+      hash = hash_util::combine(hash, TypeSpec::hash()(arg));
+    }
+
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      auto existing = find(hash, name_id, arguments);
+      if (existing) {
+        return existing;
+      }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto existing = find(hash, name_id, arguments);
+    if (existing) {
+      return existing;
+    }
+
+    auto data = std::make_unique<TypeSpecData>();
+    data->name_id = name_id;
+    data->name = &m_names.str(name_id);
+    data->arguments = arguments;
+    if (arguments.empty()) {
+      data->printed = *data->name;
+    } else {
+      data->printed = "(" + *data->name;
+      for (auto& arg : arguments) {
+        data->printed += " " + arg.print();
+      }
+      data->printed += ")";
     }
-    return result + ")";
+
+    auto result = data.get();
+    m_data.push_back(std::move(data));
+    m_by_hash.emplace(hash, result);
+    if (arguments.empty()) {
+      if (name_id >= m_simple.size()) {
+        m_simple.resize(name_id + 1, nullptr);
+      }
+      m_simple[name_id] = result;
+    }
+    return result;
+  }
+
+ private:
+  const TypeSpecData* find(u64 hash, u32 name_id, const std::vector<TypeSpec>& arguments) const {
+    auto range = m_by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second->name_id == name_id && it->second->arguments == arguments) {
+        return it->second;
+      }
+    }
+    return nullptr;
   }
+
+  StringTable m_names;
+  std::shared_mutex m_mutex;  // for the TypeSpecData
+  std::vector<std::unique_ptr<TypeSpecData>> m_data;
+  std::unordered_multimap<u64, const TypeSpecData*> m_by_hash;
+  std::vector<const TypeSpecData*> m_simple;  // by name id, for TypeSpecs without arguments
+};
+
+TypeSpecTable& table() {
+  // never destroyed, so TypeSpecs in other static objects are always valid.
+  static auto* table = new TypeSpecTable();
+  return *table;
 }
+}  // namespace
 
-bool TypeSpec::operator!=(const TypeSpec& other) const {
-  return !(other == *this);
+u32 get_type_name_id(const std::string& name) {
+  return table().name_id(name);
 }
 
-bool TypeSpec::operator==(const TypeSpec& other) const {
-  if (other.m_type != m_type || other.m_arguments.size() != m_arguments.size()) {
-    return false;
-  }
+const std::string& get_type_name(u32 id) {
+  return table().name(id);
+}
 
-  for (size_t i = 0; i < m_arguments.size(); i++) {
-    if (other.m_arguments[i] != m_arguments[i]) {
-      return false;
-    }
+const TypeSpecData* TypeSpecData::get(u32 name_id, const std::vector<TypeSpec>& arguments) {
+  return table().get(name_id, arguments);
+}
+
+TypeSpec::TypeSpec() {
+  static const TypeSpecData* empty = TypeSpecData::get(get_type_name_id(""), {});
+  m_data = empty;
+}
+
+TypeSpec::TypeSpec(const std::string& type)
+    : m_data(TypeSpecData::get(get_type_name_id(type), {})) {}
+
+TypeSpec::TypeSpec(const std::string& type, const std::vector<TypeSpec>& arguments)
+    : m_data(TypeSpecData::get(get_type_name_id(type), arguments)) {}
+
+std::string TypeSpec::print() const {
+  return m_data->printed;
+}
+
+void TypeSpec::serialize(Serializer& ser) {
+  std::string name = base_type();
+  std::vector<TypeSpec> arguments = m_data->arguments;
+  ser.from_str(&name);
+  auto arg_count = ser.save_or_load<u32>(arguments.size());
+  if (ser.is_loading()) {
+    arguments.resize(arg_count);
+  }
+  for (auto& arg : arguments) {
+    arg.serialize(ser);
   }
+  if (ser.is_loading()) {
+    *this = TypeSpec(name, arguments);
+  }
+}
 
-  return true;
+void TypeSpec::add_arg(const TypeSpec& ts) {
+  auto arguments = m_data->arguments;
+  arguments.push_back(ts);
+  m_data = TypeSpecData::get(m_data->name_id, arguments);
+}
+
+void TypeSpec::set_arg(int idx, const TypeSpec& ts) {
+  auto arguments = m_data->arguments;
+  arguments.at(idx) = ts;
+  m_data = TypeSpecData::get(m_data->name_id, arguments);
 }
 
 TypeSpec TypeSpec::substitute_for_method_call(const std::string& method_type) const {
-  TypeSpec result;
-  result.m_type = (m_type == "_type_") ? method_type : m_type;
-  for (const auto& x : m_arguments) {
-    result.m_arguments.push_back(x.substitute_for_method_call(method_type));
+  std::vector<TypeSpec> arguments;
+  for (const auto& x : m_data->arguments) {
+    arguments.push_back(x.substitute_for_method_call(method_type));
   }
-  return result;
+  return TypeSpec(base_type() == "_type_" ? method_type : base_type(), arguments);
 }
 
 bool TypeSpec::is_compatible_child_method(const TypeSpec& implementation,
                                           const std::string& child_type) const {
-  bool ok = implementation.m_type == m_type ||
-            (m_type == "_type_" && implementation.m_type == child_type);
-  if (!ok || implementation.m_arguments.size() != m_arguments.size()) {
+  bool ok = implementation.base_type_id() == base_type_id() ||
+            (base_type() == "_type_" && implementation.base_type() == child_type);
+  if (!ok || implementation.arg_count() != arg_count()) {
     return false;
   }
 
-  for (size_t i = 0; i < m_arguments.size(); i++) {
-    if (!m_arguments[i].is_compatible_child_method(implementation.m_arguments[i], child_type)) {
+  for (size_t i = 0; i < arg_count(); i++) {
+    if (!get_arg(i).is_compatible_child_method(implementation.get_arg(i), child_type)) {
       return false;
     }
   }
 
   return true;
-}
\ No newline at end of file
+}
@@ -11,8 +11,19 @@
 #include <vector>
 #include <string>
 #include <cassert>
+#include <functional>
+#include "common/common_types.h"
 
 class Type;
+class Serializer;
+struct TypeSpecData;
+
+/*!
+ * Each type name is given a small integer id, starting at 0, the first time it is used. The ids are
+ * shared by all type systems and never change, so they can be used to index tables of types.
+ */
+u32 get_type_name_id(const std::string& name);
+const std::string& get_type_name(u32 id);
 
 /*!
  * A TypeSpec is a reference to a Type, or possible a compound type.  This is the best way to
@@ -21,46 +32,84 @@ class Type;
  *
  * A compound type contains a "root type", which must by a Type, and a list of "type
  * arguments", which are TypeSpecs.
+ *
+ * TypeSpecs are hash-consed: every different TypeSpec is stored once in a global table, and a
+ * TypeSpec is just a pointer to its entry. Copying and comparing TypeSpecs is a pointer copy or
+ * compare. The table is never freed and is safe to use from multiple threads.
  */
 class TypeSpec {
  public:
   // create a typespec for a single type
-  TypeSpec() = default;
-  TypeSpec(std::string type);
-  TypeSpec(std::string type, std::vector<TypeSpec> arguments);
+  TypeSpec();
+  TypeSpec(const std::string& type);
+  TypeSpec(const std::string& type, const std::vector<TypeSpec>& arguments);
 
-  bool operator!=(const TypeSpec& other) const;
-  bool operator==(const TypeSpec& other) const;
+  bool operator!=(const TypeSpec& other) const { return m_data != other.m_data; }
+  bool operator==(const TypeSpec& other) const { return m_data == other.m_data; }
   bool is_compatible_child_method(const TypeSpec& implementation,
                                   const std::string& child_type) const;
   std::string print() const;
+  void serialize(Serializer& ser);
 
-  void add_arg(const TypeSpec& ts) { m_arguments.push_back(ts); }
+  void add_arg(const TypeSpec& ts);
+  void set_arg(int idx, const TypeSpec& ts);
 
-  const std::string base_type() const { return m_type; }
+  const std::string& base_type() const;
+  u32 base_type_id() const;
 
-  bool has_single_arg() const { return m_arguments.size() == 1; }
+  bool has_single_arg() const { return arg_count() == 1; }
 
   const TypeSpec& get_single_arg() const {
-    assert(m_arguments.size() == 1);
-    return m_arguments.front();
+    assert(arg_count() == 1);
+    return get_arg(0);
   }
 
   TypeSpec substitute_for_method_call(const std::string& method_type) const;
 
-  size_t arg_count() const { return m_arguments.size(); }
+  size_t arg_count() const;
 
-  const TypeSpec& get_arg(int idx) const { return m_arguments.at(idx); }
-  TypeSpec& get_arg(int idx) { return m_arguments.at(idx); }
+  const TypeSpec& get_arg(int idx) const;
   const TypeSpec& last_arg() const {
-    assert(!m_arguments.empty());
-    return m_arguments.back();
+    assert(arg_count() > 0);
+    return get_arg(arg_count() - 1);
   }
 
+  struct hash {
+    auto operator()(const TypeSpec& ts) const { return std::hash<const void*>()(ts.m_data); }
+  };
+
  private:
-  friend class TypeSystem;
-  std::string m_type;
-  std::vector<TypeSpec> m_arguments;
+  explicit TypeSpec(const TypeSpecData* data) : m_data(data) {}
+  friend struct TypeSpecData;
+  const TypeSpecData* m_data;
+};
+
+/*!
+ * The single copy of the contents of a TypeSpec.
+ */
+struct TypeSpecData {
+  u32 name_id;
+  const std::string* name;  // owned by the type name table
+  std::vector<TypeSpec> arguments;
+  std::string printed;
+
+  static const TypeSpecData* get(u32 name_id, const std::vector<TypeSpec>& arguments);
 };
 
+inline const std::string& TypeSpec::base_type() const {
+  return *m_data->name;
+}
+
+inline u32 TypeSpec::base_type_id() const {
+  return m_data->name_id;
+}
+
+inline size_t TypeSpec::arg_count() const {
+  return m_data->arguments.size();
+}
+
+inline const TypeSpec& TypeSpec::get_arg(int idx) const {
+  return m_data->arguments.at(idx);
+}
+
 #endif  // JAK_TYPESPEC_H
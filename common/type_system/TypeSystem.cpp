@@ -5,11 +5,14 @@
  * access types, and reverse type lookups.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <third-party/fmt/core.h>
 #include "TypeSystem.h"
+#include "common/util/Hash.h"
 #include "common/util/math_util.h"
+#include "common/util/Serializer.h"
 
 TypeSystem::TypeSystem() {
   // the "none" and "_type_" types are included by default.
@@ -23,6 +26,7 @@ TypeSystem::TypeSystem() {
  * throw_on_redefine is set. The type should be fully set up (fields, etc) before running this.
  */
 Type* TypeSystem::add_type(const std::string& name, std::unique_ptr<Type> type) {
+  log_lookup(name);
   auto kv = m_types.find(name);
   if (kv != m_types.end()) {
     // exists already
@@ -38,8 +42,9 @@ Type* TypeSystem::add_type(const std::string& name, std::unique_ptr<Type> type)
         // keep the unique_ptr around, just in case somebody references this old type pointer.
         m_old_types.push_back(std::move(m_types[name]));
 
-        // update the type
+        // update the type. Its parent may have changed, so all of the ancestors are out of date.
         m_types[name] = std::move(type);
+        index_all_types();
       } else {
         throw std::runtime_error("Type was redefined with throw_on_redefine set.");
       }
@@ -64,11 +69,106 @@ Type* TypeSystem::add_type(const std::string& name, std::unique_ptr<Type> type)
 
     m_types[name] = std::move(type);
     m_forward_declared_types.erase(name);
+    index_type(name);
   }
 
   return m_types[name].get();
 }
 
+/*!
+ * Update m_types_by_id and m_ancestors_by_id for this type. The type's parents must already be
+ * indexed.
+ */
+void TypeSystem::index_type(const std::string& name) {
+  clear_caches();
+  auto id = get_type_name_id(name);
+  if (id >= m_types_by_id.size()) {
+    m_types_by_id.resize(id + 1, nullptr);
+    m_ancestors_by_id.resize(id + 1);
+  }
+  m_types_by_id[id] = m_types.at(name).get();
+
+  auto& ancestors = m_ancestors_by_id[id];
+  ancestors.clear();
+  std::string current = name;
+  while (true) {
+    auto kv = m_types.find(current);
+    if (kv == m_types.end() || ancestors.size() > m_types.size()) {
+      // parent isn't fully defined (only possible after redefinition), or there's a loop.
+      ancestors.clear();
+      return;
+    }
+    ancestors.push_back(get_type_name_id(current));
+    if (!kv->second->has_parent()) {
+      break;
+    }
+    current = kv->second->get_parent();
+  }
+
+  if (current != "object") {
+    // none, _type_ and _varargs_ aren't part of the type tree.
+    ancestors.clear();
+    return;
+  }
+  std::reverse(ancestors.begin(), ancestors.end());
+}
+
+/*!
+ * Rebuild m_types_by_id and m_ancestors_by_id from m_types.
+ */
+void TypeSystem::index_all_types() {
+  clear_caches();
+  m_types_by_id.clear();
+  m_ancestors_by_id.clear();
+  for (auto& kv : m_types) {
+    index_type(kv.first);
+  }
+}
+
+/*!
+ * Forget all memoized typecheck and lowest common ancestor results, and reverse field indices.
+ * Must be called whenever a type is added, changed, or forward declared.
+ */
+void TypeSystem::clear_caches() {
+  std::unique_lock<std::shared_mutex> lock(m_cache_mutex);
+  m_typecheck_cache.clear();
+  m_lca_cache.clear();
+  m_reverse_field_indices.clear();
+}
+
+TypeSystem::CacheStats TypeSystem::get_cache_stats() const {
+  CacheStats result;
+  result.typecheck_hits = m_cache_stats.typecheck_hits;
+  result.typecheck_misses = m_cache_stats.typecheck_misses;
+  result.lca_hits = m_cache_stats.lca_hits;
+  result.lca_misses = m_cache_stats.lca_misses;
+  return result;
+}
+
+void TypeSystem::reset_cache_stats() {
+  m_cache_stats.typecheck_hits = 0;
+  m_cache_stats.typecheck_misses = 0;
+  m_cache_stats.lca_hits = 0;
+  m_cache_stats.lca_misses = 0;
+}
+
+/*!
+ * Get the ids of this type and all its parents, starting from object. Returns nullptr if the type
+ * isn't fully defined or doesn't have object as a parent.
+ */
+const std::vector<u32>* TypeSystem::get_ancestors(u32 id) const {
+  if (id >= m_ancestors_by_id.size() || m_ancestors_by_id[id].empty()) {
+    return nullptr;
+  }
+  auto& ancestors = m_ancestors_by_id[id];
+  if (m_lookup_log) {
+    for (auto ancestor : ancestors) {
+      log_lookup(get_type_name(ancestor));
+    }
+  }
+  return &ancestors;
+}
+
 /*!
  * Inform the type system that there will eventually be a type named "name".
  * This will allow the type system to generate TypeSpecs for this type, but not access detailed
@@ -77,6 +177,7 @@ Type* TypeSystem::add_type(const std::string& name, std::unique_ptr<Type> type)
 void TypeSystem::forward_declare_type(const std::string& name) {
   if (m_types.find(name) == m_types.end()) {
     m_forward_declared_types[name] = TYPE;
+    clear_caches();
   }
 }
 
@@ -88,6 +189,7 @@ void TypeSystem::forward_declare_type(const std::string& name) {
 void TypeSystem::forward_declare_type_as_basic(const std::string& name) {
   if (m_types.find(name) == m_types.end()) {
     m_forward_declared_types[name] = BASIC;
+    clear_caches();
   }
 }
 
@@ -99,6 +201,7 @@ void TypeSystem::forward_declare_type_as_basic(const std::string& name) {
 void TypeSystem::forward_declare_type_as_structure(const std::string& name) {
   if (m_types.find(name) == m_types.end()) {
     m_forward_declared_types[name] = STRUCTURE;
+    clear_caches();
   }
 }
 
@@ -181,6 +284,7 @@ DerefInfo TypeSystem::get_deref_info(const TypeSpec& ts) const {
  * If you really need a TypeSpec which refers to a non-existent type, just construct your own.
  */
 TypeSpec TypeSystem::make_typespec(const std::string& name) const {
+  log_lookup(name);
   if (m_types.find(name) != m_types.end() ||
       m_forward_declared_types.find(name) != m_forward_declared_types.end()) {
     return TypeSpec(name);
@@ -191,10 +295,12 @@ TypeSpec TypeSystem::make_typespec(const std::string& name) const {
 }
 
 bool TypeSystem::fully_defined_type_exists(const std::string& name) const {
+  log_lookup(name);
   return m_types.find(name) != m_types.end();
 }
 
 bool TypeSystem::partially_defined_type_exists(const std::string& name) const {
+  log_lookup(name);
   return m_forward_declared_types.find(name) != m_forward_declared_types.end();
 }
 
@@ -251,6 +357,7 @@ TypeSpec TypeSystem::make_inline_array_typespec(const TypeSpec& type) const {
  * lookup_type to find the most up-to-date type information.
  */
 Type* TypeSystem::lookup_type(const std::string& name) const {
+  log_lookup(name);
   auto kv = m_types.find(name);
   if (kv != m_types.end()) {
     return kv->second.get();
@@ -271,6 +378,11 @@ Type* TypeSystem::lookup_type(const std::string& name) const {
  * lookup_type to find the most up-to-date type information.
  */
 Type* TypeSystem::lookup_type(const TypeSpec& ts) const {
+  auto id = ts.base_type_id();
+  if (id < m_types_by_id.size() && m_types_by_id[id]) {
+    log_lookup(ts.base_type());
+    return m_types_by_id[id];
+  }
   return lookup_type(ts.base_type());
 }
 
@@ -279,6 +391,11 @@ Type* TypeSystem::lookup_type(const TypeSpec& ts) const {
  * forward defined as a basic or structure, just get basic/structure.
  */
 Type* TypeSystem::lookup_type_allow_partial_def(const TypeSpec& ts) const {
+  auto id = ts.base_type_id();
+  if (id < m_types_by_id.size() && m_types_by_id[id]) {
+    log_lookup(ts.base_type());
+    return m_types_by_id[id];
+  }
   return lookup_type_allow_partial_def(ts.base_type());
 }
 
@@ -287,6 +404,7 @@ Type* TypeSystem::lookup_type_allow_partial_def(const TypeSpec& ts) const {
  * forward defined as a basic or structure, just get basic/structure.
  */
 Type* TypeSystem::lookup_type_allow_partial_def(const std::string& name) const {
+  log_lookup(name);
   // look up fully defined types first:
   auto kv = m_types.find(name);
   if (kv != m_types.end()) {
@@ -437,6 +555,7 @@ MethodInfo TypeSystem::lookup_method(const std::string& type_name, const std::st
  * Like lookup_method, but won't throw or print an error when things go wrong.
  */
 bool TypeSystem::try_lookup_method(const std::string& type_name, int method_id, MethodInfo* info) {
+  log_lookup(type_name);
   auto kv = m_types.find(type_name);
   if (kv == m_types.end()) {
     return false;
@@ -617,6 +736,8 @@ int TypeSystem::add_field_to_type(StructureType* type,
     fmt::print("[TypeSystem] Type {} already has a field named {}\n", type->get_name(), field_name);
     throw std::runtime_error("add_field_to_type duplicate field names");
   }
+  // the type may already be in use.
+  clear_caches();
 
   // first, construct the field
   Field field(field_name, field_type);
@@ -831,6 +952,111 @@ std::string TypeSystem::print_all_type_information() const {
   return result;
 }
 
+namespace {
+// the kind of Type, so the right child class can be created when loading.
+enum class SerializedTypeKind : u8 { NULL_TYPE, VALUE, BITFIELD, STRUCTURE, BASIC };
+
+SerializedTypeKind get_serialized_kind(const Type* type) {
+  if (dynamic_cast<const BitFieldType*>(type)) {
+    return SerializedTypeKind::BITFIELD;
+  }
+  if (dynamic_cast<const ValueType*>(type)) {
+    return SerializedTypeKind::VALUE;
+  }
+  if (dynamic_cast<const BasicType*>(type)) {
+    return SerializedTypeKind::BASIC;
+  }
+  if (dynamic_cast<const StructureType*>(type)) {
+    return SerializedTypeKind::STRUCTURE;
+  }
+  if (dynamic_cast<const NullType*>(type)) {
+    return SerializedTypeKind::NULL_TYPE;
+  }
+  throw std::runtime_error("Unknown type kind in TypeSystem::serialize");
+}
+
+std::unique_ptr<Type> make_empty_type(SerializedTypeKind kind) {
+  switch (kind) {
+    case SerializedTypeKind::NULL_TYPE:
+      return std::make_unique<NullType>("");
+    case SerializedTypeKind::VALUE:
+      return std::make_unique<ValueType>("", "", false, -1, false, RegClass::INVALID);
+    case SerializedTypeKind::BITFIELD:
+      return std::make_unique<BitFieldType>("", "", -1, false);
+    case SerializedTypeKind::STRUCTURE:
+      return std::make_unique<StructureType>("", "");
+    case SerializedTypeKind::BASIC:
+      return std::make_unique<BasicType>("", "");
+    default:
+      throw std::runtime_error("Invalid type kind in TypeSystem::serialize");
+  }
+}
+}  // namespace
+
+/*!
+ * Save or load all types and forward declarations. Loading replaces everything in this type
+ * system. Types are saved in order of name, so the same type system always gives the same data.
+ */
+void TypeSystem::serialize(Serializer& ser) {
+  if (ser.is_saving()) {
+    std::vector<const std::string*> names;
+    for (auto& kv : m_types) {
+      names.push_back(&kv.first);
+    }
+    std::sort(names.begin(), names.end(),
+              [](const std::string* a, const std::string* b) { return *a < *b; });
+    ser.save_or_load<u32>(names.size());
+    for (auto name : names) {
+      auto& type = m_types.at(*name);
+      ser.save_or_load(get_serialized_kind(type.get()));
+      type->serialize(ser);
+    }
+
+    std::vector<std::pair<std::string, ForwardDeclareKind>> forward_declares(
+        m_forward_declared_types.begin(), m_forward_declared_types.end());
+    std::sort(forward_declares.begin(), forward_declares.end());
+    ser.save_or_load<u32>(forward_declares.size());
+    for (auto& fwd : forward_declares) {
+      ser.from_str(&fwd.first);
+      ser.from_pod(&fwd.second);
+    }
+  } else {
+    m_types.clear();
+    m_forward_declared_types.clear();
+    m_old_types.clear();
+
+    auto type_count = ser.save_or_load<u32>(0);
+    for (u32 i = 0; i < type_count; i++) {
+      auto type = make_empty_type(ser.save_or_load(SerializedTypeKind::NULL_TYPE));
+      type->serialize(ser);
+      auto name = type->get_name();
+      m_types[name] = std::move(type);
+    }
+
+    auto forward_declare_count = ser.save_or_load<u32>(0);
+    for (u32 i = 0; i < forward_declare_count; i++) {
+      std::string name;
+      ForwardDeclareKind kind;
+      ser.from_str(&name);
+      ser.from_pod(&kind);
+      m_forward_declared_types[name] = kind;
+    }
+    index_all_types();
+  }
+
+  ser.from_pod(&m_allow_redefinition);
+}
+
+/*!
+ * Hash of everything saved by serialize. Type systems with the same hash have the same types.
+ */
+u64 TypeSystem::get_hash() {
+  Serializer ser;
+  serialize(ser);
+  auto& data = ser.get_save_result();
+  return hash_util::bytes(data.data(), data.size());
+}
+
 /*!
  * Get the next free method ID of a type.
  */
@@ -990,6 +1216,7 @@ ValueType* TypeSystem::add_builtin_value_type(const std::string& parent,
  * Helper for inheritance of structure types when setting up builtin types.
  */
 void TypeSystem::builtin_structure_inherit(StructureType* st) {
+  clear_caches();
   st->inherit(get_type_of_type<StructureType>(st->get_parent()));
 }
 
@@ -1007,25 +1234,60 @@ bool TypeSystem::typecheck(const TypeSpec& expected,
                            const std::string& error_source_name,
                            bool print_on_error,
                            bool throw_on_error) const {
+  bool success = typecheck_memoized(expected, actual);
+  if (!success) {
+    if (print_on_error) {
+      if (error_source_name.empty()) {
+        fmt::print("[TypeSystem] Got type \"{}\" when expecting \"{}\"\n", actual.print(),
+                   expected.print());
+      } else {
+        fmt::print("[TypeSystem] For {}, got type \"{}\" when expecting \"{}\"\n",
+                   error_source_name, actual.print(), expected.print());
+      }
+    }
+
+    if (throw_on_error) {
+      throw std::runtime_error("typecheck failed");
+    }
+  }
+
+  return success;
+}
+
+/*!
+ * Typecheck without any error messages. The results are remembered in m_typecheck_cache, unless
+ * the lookup log is set (it needs to see every type that is used).
+ */
+bool TypeSystem::typecheck_memoized(const TypeSpec& expected, const TypeSpec& actual) const {
+  bool use_cache = !m_lookup_log;
+  if (use_cache) {
+    std::shared_lock<std::shared_mutex> lock(m_cache_mutex);
+    auto it = m_typecheck_cache.find({expected, actual});
+    if (it != m_typecheck_cache.end()) {
+      m_cache_stats.typecheck_hits++;
+      return it->second;
+    }
+  }
+
   bool success = true;
   // first, typecheck the base types:
-  if (!typecheck_base_types(expected.base_type(), actual.base_type())) {
+  if (!typecheck_base_types(expected, actual)) {
     success = false;
   }
 
   // next argument checks:
-  if (expected.m_arguments.size() == actual.m_arguments.size()) {
-    for (size_t i = 0; i < expected.m_arguments.size(); i++) {
+  if (expected.arg_count() == actual.arg_count()) {
+    for (size_t i = 0; i < expected.arg_count(); i++) {
       // don't print/throw because the error would be confusing. Better to fail only the
       // outer most check and print a single error message.
-      if (!typecheck(expected.m_arguments[i], actual.m_arguments[i], "", false, false)) {
+      if (!typecheck_memoized(expected.get_arg(i), actual.get_arg(i))) {
         success = false;
         break;
       }
     }
   } else {
     // different sizes of arguments.
-    if (expected.m_arguments.empty()) {
+    if (expected.arg_count() == 0) {
       // we expect zero arguments, but got some. The actual type is more specific, so this is fine.
     } else {
       // different sizes, and we expected arguments. No good!
@@ -1033,25 +1295,31 @@ bool TypeSystem::typecheck(const TypeSpec& expected,
     }
   }
 
-  if (!success) {
-    if (print_on_error) {
-      if (error_source_name.empty()) {
-        fmt::print("[TypeSystem] Got type \"{}\" when expecting \"{}\"\n", actual.print(),
-                   expected.print());
-      } else {
-        fmt::print("[TypeSystem] For {}, got type \"{}\" when expecting \"{}\"\n",
-                   error_source_name, actual.print(), expected.print());
-      }
-    }
-
-    if (throw_on_error) {
-      throw std::runtime_error("typecheck failed");
+  if (use_cache) {
+    m_cache_stats.typecheck_misses++;
+    std::unique_lock<std::shared_mutex> lock(m_cache_mutex);
+    if (m_typecheck_cache.size() >= MAX_CACHE_ENTRIES) {
+      m_typecheck_cache.clear();
     }
+    m_typecheck_cache.emplace(std::make_pair(expected, actual), success);
   }
-
   return success;
 }
 
+/*!
+ * Is actual of type expected? For base types. Uses the precomputed ancestors when both types are
+ * fully defined: expected is a parent of actual if it is at the same depth in actual's ancestors.
+ */
+bool TypeSystem::typecheck_base_types(const TypeSpec& expected, const TypeSpec& actual) const {
+  auto expected_up = get_ancestors(expected.base_type_id());
+  auto actual_up = get_ancestors(actual.base_type_id());
+  if (!expected_up || !actual_up) {
+    return typecheck_base_types(expected.base_type(), actual.base_type());
+  }
+  size_t depth = expected_up->size() - 1;
+  return depth < actual_up->size() && actual_up->at(depth) == expected.base_type_id();
+}
+
 /*!
  * Is actual of type expected? For base types.
  */
@@ -1098,6 +1366,33 @@ std::vector<std::string> TypeSystem::get_path_up_tree(const std::string& type) c
   return path;
 }
 
+/*!
+ * Lowest common ancestor of two base types. Uses the precomputed ancestors when both types are
+ * fully defined.
+ */
+std::string TypeSystem::lca_base(const TypeSpec& a, const TypeSpec& b) const {
+  if (a.base_type_id() == b.base_type_id()) {
+    return a.base_type();
+  }
+
+  if (a.base_type() == "none" || b.base_type() == "none") {
+    return "none";
+  }
+
+  auto a_up = get_ancestors(a.base_type_id());
+  auto b_up = get_ancestors(b.base_type_id());
+  if (!a_up || !b_up) {
+    return lca_base(a.base_type(), b.base_type());
+  }
+
+  size_t i = 0;
+  while (i < a_up->size() && i < b_up->size() && a_up->at(i) == b_up->at(i)) {
+    i++;
+  }
+  assert(i > 0);
+  return get_type_name(a_up->at(i - 1));
+}
+
 /*!
  * Lowest common ancestor of two base types.
  */
@@ -1138,18 +1433,42 @@ std::string TypeSystem::lca_base(const std::string& a, const std::string& b) con
  * (lca(a, b) lca(b, d)).
  */
 TypeSpec TypeSystem::lowest_common_ancestor(const TypeSpec& a, const TypeSpec& b) const {
-  auto result = make_typespec(lca_base(a.base_type(), b.base_type()));
-  if (result == TypeSpec("function") && a.m_arguments.size() == 2 && b.m_arguments.size() == 2 &&
-      (a.m_arguments.at(0) == TypeSpec("_varargs_") ||
-       b.m_arguments.at(0) == TypeSpec("_varargs_"))) {
+  // memoized like typecheck
+  bool use_cache = !m_lookup_log;
+  if (use_cache) {
+    std::shared_lock<std::shared_mutex> lock(m_cache_mutex);
+    auto it = m_lca_cache.find({a, b});
+    if (it != m_lca_cache.end()) {
+      m_cache_stats.lca_hits++;
+      return it->second;
+    }
+  }
+
+  auto result = lowest_common_ancestor_uncached(a, b);
+  if (use_cache) {
+    m_cache_stats.lca_misses++;
+    std::unique_lock<std::shared_mutex> lock(m_cache_mutex);
+    if (m_lca_cache.size() >= MAX_CACHE_ENTRIES) {
+      m_lca_cache.clear();
+    }
+    m_lca_cache.emplace(std::make_pair(a, b), result);
+  }
+  return result;
+}
+
+TypeSpec TypeSystem::lowest_common_ancestor_uncached(const TypeSpec& a, const TypeSpec& b) const {
+  auto result = make_typespec(lca_base(a, b));
+  if (result == TypeSpec("function") && a.arg_count() == 2 && b.arg_count() == 2 &&
+      (a.get_arg(0) == TypeSpec("_varargs_") || b.get_arg(0) == TypeSpec("_varargs_"))) {
     return TypeSpec("function");
   }
-  if (!a.m_arguments.empty() && !b.m_arguments.empty() &&
-      a.m_arguments.size() == b.m_arguments.size()) {
+  if (a.arg_count() != 0 && a.arg_count() == b.arg_count()) {
     // recursively add arguments
-    for (size_t i = 0; i < a.m_arguments.size(); i++) {
-      result.add_arg(lowest_common_ancestor(a.m_arguments.at(i), b.m_arguments.at(i)));
+    std::vector<TypeSpec> arguments;
+    for (size_t i = 0; i < a.arg_count(); i++) {
+      arguments.push_back(lowest_common_ancestor(a.get_arg(i), b.get_arg(i)));
     }
+    result = TypeSpec(result.base_type(), arguments);
   }
   return result;
 }
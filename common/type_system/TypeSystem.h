@@ -12,6 +12,9 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <optional>
 
@@ -169,6 +172,8 @@ class TypeSystem {
   void add_builtin_types();
 
   std::string print_all_type_information() const;
+  void serialize(Serializer& ser);
+  u64 get_hash();
   bool typecheck(const TypeSpec& expected,
                  const TypeSpec& actual,
                  const std::string& error_source_name = "",
@@ -201,7 +206,32 @@ class TypeSystem {
   TypeSpec lowest_common_ancestor_reg(const TypeSpec& a, const TypeSpec& b) const;
   TypeSpec lowest_common_ancestor(const std::vector<TypeSpec>& types) const;
 
+  /*!
+   * While set, the name of every type that is looked up or checked for existence is added to log.
+   * Used by the compiler to find which types a file depends on.
+   */
+  void set_lookup_log(std::unordered_set<std::string>* log) { m_lookup_log = log; }
+
+  /*!
+   * How often typecheck and lowest_common_ancestor found their result in the cache. Nested checks
+   * of type arguments are counted too.
+   */
+  struct CacheStats {
+    u64 typecheck_hits = 0;
+    u64 typecheck_misses = 0;
+    u64 lca_hits = 0;
+    u64 lca_misses = 0;
+  };
+  CacheStats get_cache_stats() const;
+  void reset_cache_stats();
+
  private:
+  void log_lookup(const std::string& name) const {
+    if (m_lookup_log) {
+      m_lookup_log->insert(name);
+    }
+  }
+
   bool reverse_deref(const ReverseDerefInputInfo& input,
                      std::vector<ReverseDerefInfo::DerefToken>* path,
                      bool* addr_of,
@@ -226,8 +256,26 @@ class TypeSystem {
                                 std::vector<FieldReverseLookupOutput::Token>* path,
                                 bool* addr_of,
                                 TypeSpec* result_type) const;
+  bool try_reverse_lookup_field(const FieldReverseLookupInput& input,
+                                const Field& field,
+                                const FieldLookupInfo& field_deref,
+                                int offset_into_field,
+                                std::vector<FieldReverseLookupOutput::Token>* path,
+                                bool* addr_of,
+                                TypeSpec* result_type) const;
+  struct ReverseFieldIndex;
+  std::shared_ptr<const ReverseFieldIndex> get_reverse_field_index(
+      const StructureType* type) const;
+  std::string lca_base(const TypeSpec& a, const TypeSpec& b) const;
   std::string lca_base(const std::string& a, const std::string& b) const;
+  bool typecheck_memoized(const TypeSpec& expected, const TypeSpec& actual) const;
+  bool typecheck_base_types(const TypeSpec& expected, const TypeSpec& actual) const;
   bool typecheck_base_types(const std::string& expected, const std::string& actual) const;
+  void index_type(const std::string& name);
+  void index_all_types();
+  const std::vector<u32>* get_ancestors(u32 id) const;
+  void clear_caches();
+  TypeSpec lowest_common_ancestor_uncached(const TypeSpec& a, const TypeSpec& b) const;
   int get_size_in_type(const Field& field) const;
   int get_alignment_in_type(const Field& field);
   Field lookup_field(const std::string& type_name, const std::string& field_name) const;
@@ -249,7 +297,38 @@ class TypeSystem {
   std::unordered_map<std::string, ForwardDeclareKind> m_forward_declared_types;
   std::vector<std::unique_ptr<Type>> m_old_types;
 
+  // by type name id (see get_type_name_id), the current Type, or nullptr if it isn't defined.
+  std::vector<Type*> m_types_by_id;
+  // by type name id, the ids of the type and its parents, starting from object. Empty if the type
+  // isn't fully defined or isn't a child of object.
+  std::vector<std::vector<u32>> m_ancestors_by_id;
+
+  // memoized typecheck and lowest_common_ancestor results, by (expected, actual) and (a, b).
+  struct TypeSpecPairHash {
+    size_t operator()(const std::pair<TypeSpec, TypeSpec>& x) const {
+      return TypeSpec::hash()(x.first) * 31 + TypeSpec::hash()(x.second);
+    }
+  };
+  static constexpr size_t MAX_CACHE_ENTRIES = 1 << 16;
+  // lookups take a shared lock, so threads only wait on each other to insert or clear.
+  mutable std::shared_mutex m_cache_mutex;
+  mutable std::unordered_map<std::pair<TypeSpec, TypeSpec>, bool, TypeSpecPairHash>
+      m_typecheck_cache;
+  mutable std::unordered_map<std::pair<TypeSpec, TypeSpec>, TypeSpec, TypeSpecPairHash>
+      m_lca_cache;
+  struct AtomicCacheStats {
+    std::atomic<u64> typecheck_hits{0};
+    std::atomic<u64> typecheck_misses{0};
+    std::atomic<u64> lca_hits{0};
+    std::atomic<u64> lca_misses{0};
+  };
+  mutable AtomicCacheStats m_cache_stats;
+  // built by try_reverse_lookup_other when first needed. nullptr if it couldn't be built.
+  mutable std::unordered_map<const StructureType*, std::shared_ptr<const ReverseFieldIndex>>
+      m_reverse_field_indices;
+
   bool m_allow_redefinition = false;
+  std::unordered_set<std::string>* m_lookup_log = nullptr;
 };
 
 TypeSpec coerce_to_reg_type(const TypeSpec& in);
@@ -11,15 +11,15 @@
 
 class BinaryReader {
  public:
-  BinaryReader(uint8_t* _buffer, uint32_t _size) : buffer(_buffer), size(_size) {}
+  BinaryReader(const uint8_t* _buffer, uint32_t _size) : buffer(_buffer), size(_size) {}
 
-  explicit BinaryReader(std::vector<uint8_t>& _buffer)
-      : buffer((uint8_t*)_buffer.data()), size(_buffer.size()) {}
+  explicit BinaryReader(const std::vector<uint8_t>& _buffer)
+      : buffer(_buffer.data()), size(_buffer.size()) {}
 
   template <typename T>
   T read() {
     assert(seek + sizeof(T) <= size);
-    T& obj = *(T*)(buffer + seek);
+    const T& obj = *(const T*)(buffer + seek);
     seek += sizeof(T);
     return obj;
   }
@@ -31,12 +31,12 @@ class BinaryReader {
 
   uint32_t bytes_left() const { return size - seek; }
 
-  uint8_t* here() { return buffer + seek; }
+  const uint8_t* here() { return buffer + seek; }
 
   uint32_t get_seek() { return seek; }
 
  private:
-  uint8_t* buffer;
+  const uint8_t* buffer;
   uint32_t size;
   uint32_t seek = 0;
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+/*!
+ * @file ByteSpan.h
+ * A read-only view of bytes owned by something else.
+ */
+
+#ifndef JAK_BYTESPAN_H
+#define JAK_BYTESPAN_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "common/common_types.h"
+
+/*!
+ * A pointer and a size. Has the read-only parts of the std::vector interface, so code that reads
+ * a std::vector<u8> can usually take a ByteSpan instead. The bytes must outlive the span.
+ */
+class ByteSpan {
+ public:
+  ByteSpan() = default;
+  ByteSpan(const u8* data, size_t size) : m_data(data), m_size(size) {}
+  ByteSpan(const std::vector<u8>& vec) : m_data(vec.data()), m_size(vec.size()) {}
+
+  const u8* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const u8* begin() const { return m_data; }
+  const u8* end() const { return m_data + m_size; }
+
+  const u8& at(size_t idx) const {
+    if (idx >= m_size) {
+      throw std::out_of_range("ByteSpan::at");
+    }
+    return m_data[idx];
+  }
+
+  const u8& operator[](size_t idx) const { return m_data[idx]; }
+
+ private:
+  const u8* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+#endif  // JAK_BYTESPAN_H
@@ -0,0 +1,133 @@
+/*!
+ * @file CacheFile.cpp
+ * Binary files that save the result of reading some source files.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include "CacheFile.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Hash.h"
+#include "common/util/MappedFile.h"
+#include "common/util/Serializer.h"
+#include "common/versions.h"
+#include "third-party/fmt/core.h"
+
+namespace cache_file {
+namespace {
+struct Header {
+  u32 magic;
+  u32 version;
+  u32 goal_version_major;
+  u32 goal_version_minor;
+  u64 key;
+  u64 data_hash;  // hash of everything after the header, to detect truncated or corrupted files.
+};
+
+/*!
+ * The same as hash_util::string of the contents of the file, without copying it.
+ */
+u64 hash_file(const std::string& path) {
+  MappedFile file(path);
+  u64 size = file.size();
+  return hash_util::bytes(file.data(), file.size(),
+                          hash_util::bytes(&size, sizeof(size), hash_util::FNV_OFFSET));
+}
+}  // namespace
+
+/*!
+ * Read a cache file. Returns false if there is no file, or if it is out of date: the magic,
+ * version or key don't match, or a source file has changed. Otherwise, data is set to the data
+ * that was saved.
+ */
+bool load(const std::string& file_name, u32 magic, u32 version, u64 key, std::vector<u8>* data) {
+  if (!std::filesystem::exists(file_name)) {
+    return false;
+  }
+
+  MappedFile file(file_name);
+  Header header;
+  if (file.size() < sizeof(Header)) {
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(Header));
+  if (header.magic != magic || header.version != version ||
+      header.goal_version_major != versions::GOAL_VERSION_MAJOR ||
+      header.goal_version_minor != versions::GOAL_VERSION_MINOR || header.key != key) {
+    return false;
+  }
+
+  auto payload = file.data() + sizeof(Header);
+  auto payload_size = file.size() - sizeof(Header);
+  if (hash_util::bytes(payload, payload_size) != header.data_hash) {
+    return false;
+  }
+
+  Serializer ser(payload, payload_size);
+  auto file_count = ser.save_or_load<u32>(0);
+  for (u32 i = 0; i < file_count; i++) {
+    std::string source_file;
+    ser.from_str(&source_file);
+    auto hash = ser.save_or_load<u64>(0);
+    if (!std::filesystem::exists(source_file) || hash_file(source_file) != hash) {
+      return false;
+    }
+  }
+
+  data->assign(payload + ser.get_seek(), payload + payload_size);
+  return true;
+}
+
+/*!
+ * Save a cache file. The source files are hashed now, so they should be the files that data was
+ * made from. Throws if the file can't be written.
+ */
+void save(const std::string& file_name,
+          u32 magic,
+          u32 version,
+          u64 key,
+          const std::vector<std::string>& source_files,
+          const std::vector<u8>& data) {
+  Serializer ser;
+  ser.save_or_load<u32>(source_files.size());
+  for (auto source_file : source_files) {
+    ser.from_str(&source_file);
+    ser.save_or_load(hash_file(source_file));
+  }
+  auto payload = ser.get_save_result();
+  payload.insert(payload.end(), data.begin(), data.end());
+
+  Header header;
+  header.magic = magic;
+  header.version = version;
+  header.goal_version_major = versions::GOAL_VERSION_MAJOR;
+  header.goal_version_minor = versions::GOAL_VERSION_MINOR;
+  header.key = key;
+  header.data_hash = hash_util::bytes(payload.data(), payload.size());
+
+  std::vector<u8> to_write(sizeof(Header));
+  memcpy(to_write.data(), &header, sizeof(Header));
+  to_write.insert(to_write.end(), payload.begin(), payload.end());
+
+  // write to a temporary file and rename it, so a program starting at the same time never sees a
+  // partially written file.
+  auto path = std::filesystem::path(file_name);
+  if (path.has_parent_path()) {
+    file_util::create_dir_if_needed(path.parent_path().string());
+  }
+  auto temp_name =
+      file_name + "." +
+      std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+  file_util::write_binary_file(temp_name, to_write.data(), to_write.size());
+  std::error_code ec;
+  std::filesystem::rename(temp_name, file_name, ec);
+  if (ec) {
+    std::error_code remove_ec;
+    std::filesystem::remove(temp_name, remove_ec);
+    throw std::runtime_error(fmt::format("Failed to rename {} to {}: {}", temp_name, file_name,
+                                         ec.message()));
+  }
+}
+}  // namespace cache_file
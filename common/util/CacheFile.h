@@ -0,0 +1,35 @@
+#pragma once
+
+/*!
+ * @file CacheFile.h
+ * Binary files that save the result of reading some source files, so the work can be skipped the
+ * next time.
+ *
+ * A cache file has a header with a magic number, the format version, the GOAL version, a key
+ * chosen by the user (like a hash of the built-in types) and a hash of the rest of the file. This
+ * is followed by the names and hashes of the source files, and then the saved data. The data is
+ * only used if all of these match.
+ */
+
+#ifndef JAK_CACHEFILE_H
+#define JAK_CACHEFILE_H
+
+#include <string>
+#include <vector>
+#include "common/common_types.h"
+
+namespace cache_file {
+bool load(const std::string& file_name,
+          u32 magic,
+          u32 version,
+          u64 key,
+          std::vector<u8>* data);
+void save(const std::string& file_name,
+          u32 magic,
+          u32 version,
+          u64 key,
+          const std::vector<std::string>& source_files,
+          const std::vector<u8>& data);
+}  // namespace cache_file
+
+#endif  // JAK_CACHEFILE_H
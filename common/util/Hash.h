@@ -0,0 +1,36 @@
+#pragma once
+
+/*!
+ * @file Hash.h
+ * Stable 64-bit hashing (FNV-1a). Unlike std::hash, the result is the same on every platform and
+ * every run, so it is safe to store in files.
+ */
+
+#include <string>
+#include <vector>
+#include "common/common_types.h"
+
+namespace hash_util {
+constexpr u64 FNV_OFFSET = 0xcbf29ce484222325;
+constexpr u64 FNV_PRIME = 0x100000001b3;
+
+inline u64 bytes(const void* data, size_t size, u64 seed = FNV_OFFSET) {
+  u64 result = seed;
+  auto* ptr = (const u8*)data;
+  for (size_t i = 0; i < size; i++) {
+    result ^= ptr[i];
+    result *= FNV_PRIME;
+  }
+  return result;
+}
+
+inline u64 string(const std::string& str, u64 seed = FNV_OFFSET) {
+  // include the length so ("ab", "c") and ("a", "bc") hash differently when chained.
+  u64 len = str.size();
+  return bytes(str.data(), str.size(), bytes(&len, sizeof(len), seed));
+}
+
+inline u64 combine(u64 seed, u64 value) {
+  return bytes(&value, sizeof(value), seed);
+}
+}  // namespace hash_util
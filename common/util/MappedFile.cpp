@@ -0,0 +1,54 @@
+/*!
+ * @file MappedFile.cpp
+ * Read-only access to the contents of a file without copying it.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "MappedFile.h"
+#include "FileUtil.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef __linux__
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("File " + path + " cannot be opened: " + std::string(strerror(errno)));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("File " + path + " cannot be read: " + std::string(strerror(errno)));
+  }
+  m_size = st.st_size;
+  if (m_size > 0) {
+    void* mem = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mem != MAP_FAILED) {
+      m_mapping = mem;
+      m_data = (const u8*)mem;
+    }
+  }
+  close(fd);
+  if (m_mapping || m_size == 0) {
+    return;
+  }
+  // couldn't map it (not a regular file?), fall back to reading it.
+#endif
+  m_buffer = file_util::read_binary_file(path);
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef __linux__
+  if (m_mapping) {
+    munmap(m_mapping, m_size);
+  }
+#endif
+}
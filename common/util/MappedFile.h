@@ -0,0 +1,39 @@
+#pragma once
+
+/*!
+ * @file MappedFile.h
+ * Read-only access to the contents of a file without copying it.
+ */
+
+#ifndef JAK_MAPPEDFILE_H
+#define JAK_MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/common_types.h"
+
+/*!
+ * The contents of a file. On Linux the file is memory mapped, so pages are only read when they are
+ * used, and are shared with the OS file cache. Elsewhere the file is read into memory.
+ * The data is valid until the MappedFile is destroyed.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const u8* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  std::string_view text() const { return std::string_view((const char*)m_data, m_size); }
+
+ private:
+  const u8* m_data = nullptr;
+  size_t m_size = 0;
+  void* m_mapping = nullptr;  // if mapped
+  std::vector<u8> m_buffer;  // if not mapped
+};
+
+#endif  // JAK_MAPPEDFILE_H
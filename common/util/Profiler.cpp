@@ -0,0 +1,208 @@
+/*!
+ * @file Profiler.cpp
+ * A simple hierarchical profiler.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include "Profiler.h"
+#include "common/util/FileUtil.h"
+#include "third-party/fmt/core.h"
+#include "third-party/json.hpp"
+
+namespace prof {
+
+namespace {
+struct Event {
+  const char* name = nullptr;
+  std::string detail;
+  std::vector<const char*> path;  // names of all enclosing zones on this thread, then this one.
+  std::vector<std::pair<const char*, s64>> counters;
+  int thread_id = 0;
+  s64 start_us = 0;
+  s64 duration_us = 0;
+};
+
+std::atomic<bool> g_enabled = {false};
+std::atomic<int> g_next_thread_id = {0};
+std::mutex g_mutex;
+std::vector<Event> g_events;
+std::chrono::steady_clock::time_point g_start_time;
+
+thread_local std::vector<const char*> t_zone_stack;
+thread_local int t_thread_id = -1;
+
+int get_thread_id() {
+  if (t_thread_id < 0) {
+    t_thread_id = g_next_thread_id++;
+  }
+  return t_thread_id;
+}
+
+s64 us_since(std::chrono::steady_clock::time_point start,
+             std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+struct SummaryNode {
+  int count = 0;
+  s64 total_us = 0;
+  std::map<std::string, s64> counters;
+  std::map<std::string, SummaryNode> children;
+};
+
+void print_summary_node(const std::string& name, const SummaryNode& node, int depth) {
+  std::string line = fmt::format("{:{}}{:<{}} {:8} {:10.2f} ms", "", depth * 2, name,
+                                 40 - depth * 2, node.count, node.total_us / 1000.);
+  for (auto& counter : node.counters) {
+    line += fmt::format("  {}: {}", counter.first, counter.second);
+  }
+  fmt::print("{}\n", line);
+
+  // slowest first
+  std::vector<std::pair<const std::string*, const SummaryNode*>> children;
+  for (auto& child : node.children) {
+    children.emplace_back(&child.first, &child.second);
+  }
+  std::stable_sort(children.begin(), children.end(), [](const auto& a, const auto& b) {
+    return a.second->total_us > b.second->total_us;
+  });
+  for (auto& child : children) {
+    print_summary_node(*child.first, *child.second, depth + 1);
+  }
+}
+}  // namespace
+
+/*!
+ * Start recording. Clears the results of the previous run.
+ */
+void start() {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  g_events.clear();
+  g_start_time = std::chrono::steady_clock::now();
+  g_enabled = true;
+}
+
+/*!
+ * Stop recording. Zones which are still open are not recorded.
+ */
+void stop() {
+  g_enabled = false;
+}
+
+bool is_enabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+/*!
+ * Write all recorded zones in the Chrome trace event format.
+ */
+void write_chrome_trace(const std::string& file_name) {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  auto events = nlohmann::json::array();
+  for (auto& e : g_events) {
+    nlohmann::json args = nlohmann::json::object();
+    if (!e.detail.empty()) {
+      args["detail"] = e.detail;
+    }
+    for (auto& counter : e.counters) {
+      args[counter.first] = counter.second;
+    }
+    events.push_back({{"name", e.name},
+                      {"cat", "goalc"},
+                      {"ph", "X"},
+                      {"ts", e.start_us},
+                      {"dur", e.duration_us},
+                      {"pid", 0},
+                      {"tid", e.thread_id},
+                      {"args", args}});
+  }
+
+  nlohmann::json trace = {{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+  file_util::write_text_file(file_name, trace.dump());
+}
+
+/*!
+ * Print the total time and count of each zone, as a tree of nested zones. Counters are summed.
+ */
+void print_summary() {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  SummaryNode root;
+  for (auto& e : g_events) {
+    SummaryNode* node = &root;
+    for (auto name : e.path) {
+      node = &node->children[name];
+    }
+    node->count++;
+    node->total_us += e.duration_us;
+    for (auto& counter : e.counters) {
+      node->counters[counter.first] += counter.second;
+    }
+  }
+
+  fmt::print("[Profiler] {} zones\n", g_events.size());
+  fmt::print("{:<40} {:>8} {:>13}\n", "zone", "count", "total");
+  std::vector<std::pair<const std::string*, const SummaryNode*>> top;
+  for (auto& child : root.children) {
+    top.emplace_back(&child.first, &child.second);
+  }
+  std::stable_sort(top.begin(), top.end(), [](const auto& a, const auto& b) {
+    return a.second->total_us > b.second->total_us;
+  });
+  for (auto& child : top) {
+    print_summary_node(*child.first, *child.second, 1);
+  }
+}
+
+Zone::Zone(const char* name) {
+  if (is_enabled()) {
+    m_active = true;
+    m_name = name;
+    t_zone_stack.push_back(name);
+    m_start = std::chrono::steady_clock::now();
+  }
+}
+
+void Zone::set_detail(const std::string& detail) {
+  if (m_active) {
+    m_detail = detail;
+  }
+}
+
+void Zone::counter(const char* name, s64 value) {
+  if (m_active) {
+    m_counters.emplace_back(name, value);
+  }
+}
+
+void Zone::end() {
+  if (!m_active) {
+    return;
+  }
+  m_active = false;
+
+  auto end_time = std::chrono::steady_clock::now();
+  assert(!t_zone_stack.empty() && t_zone_stack.back() == m_name);
+  if (!is_enabled()) {
+    t_zone_stack.pop_back();
+    return;
+  }
+
+  Event e;
+  e.path = t_zone_stack;
+  t_zone_stack.pop_back();
+  e.name = m_name;
+  e.detail = std::move(m_detail);
+  e.counters = std::move(m_counters);
+  e.thread_id = get_thread_id();
+
+  std::unique_lock<std::mutex> lock(g_mutex);
+  e.start_us = us_since(g_start_time, m_start);
+  e.duration_us = us_since(m_start, end_time);
+  g_events.push_back(std::move(e));
+}
+
+}  // namespace prof
@@ -0,0 +1,59 @@
+#pragma once
+
+/*!
+ * @file Profiler.h
+ * A simple hierarchical profiler.
+ *
+ * Code is instrumented with scoped zones:
+ *
+ *   prof::Zone zone("regalloc");
+ *   zone.set_detail(function_name);
+ *   ...
+ *   zone.counter("spills", spill_count);
+ *
+ * Zones nest, and may be used from any thread. While the profiler is stopped (the default), a zone
+ * costs a single check of a flag. If the detail is expensive to compute, check zone.active()
+ * first. The results can be written as a Chrome trace (open it in chrome://tracing or
+ * ui.perfetto.dev), or printed as a tree of total times.
+ *
+ * Zone and counter names must be string literals (or otherwise live forever).
+ */
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common/common_types.h"
+
+namespace prof {
+
+void start();
+void stop();
+bool is_enabled();
+void write_chrome_trace(const std::string& file_name);
+void print_summary();
+
+class Zone {
+ public:
+  explicit Zone(const char* name);
+  ~Zone() { end(); }
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+
+  // was the profiler running when this zone started? If not, the other functions do nothing.
+  bool active() const { return m_active; }
+  // extra information, like the name of a file or function.
+  void set_detail(const std::string& detail);
+  void counter(const char* name, s64 value);
+  // end the zone early.
+  void end();
+
+ private:
+  bool m_active = false;
+  const char* m_name = nullptr;
+  std::string m_detail;
+  std::vector<std::pair<const char*, s64>> m_counters;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+}  // namespace prof
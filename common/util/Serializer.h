@@ -0,0 +1,112 @@
+#pragma once
+
+/*!
+ * @file Serializer.h
+ * Save and load data to/from a binary buffer.
+ *
+ * The same function is used for saving and loading, so the two can't get out of sync:
+ *
+ *   void Thing::serialize(Serializer& ser) {
+ *     ser.from_pod(&m_count);
+ *     ser.from_str(&m_name);
+ *   }
+ *
+ * When saving, the values are appended to the buffer. When loading, they are overwritten with the
+ * values read from the buffer. Loading past the end of the buffer throws std::runtime_error.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "common/common_types.h"
+
+class Serializer {
+ public:
+  /*!
+   * Create a serializer for saving.
+   */
+  Serializer() = default;
+
+  /*!
+   * Create a serializer for loading from data. The data must outlive the Serializer.
+   */
+  Serializer(const u8* data, size_t size) : m_loading(true), m_load_data(data), m_size(size) {}
+
+  bool is_saving() const { return !m_loading; }
+  bool is_loading() const { return m_loading; }
+
+  void from_raw_data(void* data, size_t size) {
+    if (size == 0) {
+      return;
+    }
+    if (m_loading) {
+      if (m_seek + size > m_size) {
+        throw std::runtime_error("Serializer: read past the end of the data");
+      }
+      memcpy(data, m_load_data + m_seek, size);
+      m_seek += size;
+    } else {
+      auto* ptr = (const u8*)data;
+      m_save_data.insert(m_save_data.end(), ptr, ptr + size);
+    }
+  }
+
+  template <typename T>
+  void from_pod(T* obj) {
+    static_assert(std::is_trivially_copyable<T>::value, "from_pod requires a POD type");
+    from_raw_data(obj, sizeof(T));
+  }
+
+  /*!
+   * Save a value, or load and return a value. The argument is ignored when loading.
+   */
+  template <typename T>
+  T save_or_load(T value) {
+    from_pod(&value);
+    return value;
+  }
+
+  void from_str(std::string* str) {
+    auto size = save_or_load<u32>(str->size());
+    if (m_loading) {
+      if (m_seek + size > m_size) {
+        throw std::runtime_error("Serializer: read past the end of the data");
+      }
+      str->assign((const char*)m_load_data + m_seek, size);
+      m_seek += size;
+    } else {
+      from_raw_data(str->data(), size);
+    }
+  }
+
+  template <typename T>
+  void from_pod_vector(std::vector<T>* vec) {
+    static_assert(std::is_trivially_copyable<T>::value, "from_pod_vector requires a POD type");
+    auto size = save_or_load<u32>(vec->size());
+    if (m_loading) {
+      vec->resize(size);
+    }
+    from_raw_data(vec->data(), size * sizeof(T));
+  }
+
+  /*!
+   * Check that we are at the end of the data being loaded.
+   */
+  bool reached_end() const { return m_seek == m_size; }
+
+  /*!
+   * How many bytes have been loaded so far.
+   */
+  size_t get_seek() const { return m_seek; }
+
+  const std::vector<u8>& get_save_result() const { return m_save_data; }
+
+ private:
+  bool m_loading = false;
+  const u8* m_load_data = nullptr;
+  size_t m_size = 0;
+  size_t m_seek = 0;
+  std::vector<u8> m_save_data;
+};
@@ -0,0 +1,38 @@
+/*!
+ * @file StringTable.cpp
+ * Thread-safe string interning.
+ */
+
+#include <mutex>
+#include "StringTable.h"
+
+/*!
+ * Get the id of a string, adding it to the table if it's new.
+ */
+u32 StringTable::id(const std::string& str) {
+  {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_ids.find(str);
+    if (it != m_ids.end()) {
+      return it->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
+  auto it = m_ids.find(str);
+  if (it != m_ids.end()) {
+    return it->second;
+  }
+  auto new_id = u32(m_strings.size());
+  m_strings.push_back(str);
+  m_ids.emplace(str, new_id);
+  return new_id;
+}
+
+/*!
+ * Get the string with the given id. Throws if there is no such id.
+ */
+const std::string& StringTable::str(u32 id) const {
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+  return m_strings.at(id);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/*!
+ * @file StringTable.h
+ * Thread-safe string interning.
+ */
+
+#ifndef JAK_STRINGTABLE_H
+#define JAK_STRINGTABLE_H
+
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "common/common_types.h"
+
+/*!
+ * Gives each distinct string a small id, starting from 0. Strings are never removed, so ids and
+ * references to strings stay valid as long as the table. Lookups of existing strings only take a
+ * shared lock, so many threads can use the table at once.
+ */
+class StringTable {
+ public:
+  u32 id(const std::string& str);
+  const std::string& str(u32 id) const;
+
+ private:
+  mutable std::shared_mutex m_mutex;
+  std::unordered_map<std::string, u32> m_ids;
+  std::deque<std::string> m_strings;  // by id
+};
+
+#endif  // JAK_STRINGTABLE_H
@@ -0,0 +1,58 @@
+/*!
+ * @file ThreadPool.cpp
+ * A fixed-size pool of worker threads that run jobs from a shared queue.
+ */
+
+#include <cassert>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int thread_count) {
+  assert(thread_count > 0);
+  for (int i = 0; i < thread_count; i++) {
+    m_threads.emplace_back(&ThreadPool::worker, this);
+  }
+}
+
+/*!
+ * Finishes all queued jobs, then stops the workers.
+ */
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto& t : m_threads) {
+    t.join();
+  }
+}
+
+int ThreadPool::hardware_thread_count() {
+  int count = std::thread::hardware_concurrency();
+  return count > 0 ? count : 1;
+}
+
+void ThreadPool::push(std::function<void()> job) {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    assert(!m_stop);
+    m_jobs.push(std::move(job));
+  }
+  m_cv.notify_one();
+}
+
+void ThreadPool::worker() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+      if (m_jobs.empty()) {
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop();
+    }
+    job();
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*!
+ * @file ThreadPool.h
+ * A fixed-size pool of worker threads that run jobs from a shared queue.
+ */
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(int thread_count);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /*!
+   * Queue a job. The returned future holds the result, or the exception thrown by the job.
+   */
+  template <typename F>
+  auto submit(F&& f) -> std::future<decltype(f())> {
+    using Result = decltype(f());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+    auto result = task->get_future();
+    push([task]() { (*task)(); });
+    return result;
+  }
+
+  int thread_count() const { return int(m_threads.size()); }
+
+  static int hardware_thread_count();
+
+ private:
+  void push(std::function<void()> job);
+  void worker();
+
+  std::vector<std::thread> m_threads;
+  std::queue<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop = false;
+};
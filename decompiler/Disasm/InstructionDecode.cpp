@@ -1140,7 +1140,7 @@ Instruction decode_instruction(LinkedWord& word, LinkedObjectFile& file, int seg
     for (int j = 0; j < i.n_src; j++) {
       if (i.src[j].kind == InstructionAtom::IMM) {
         fixed = true;
-        i.src[j].set_sym(word.symbol_name);
+        i.src[j].set_sym(word.symbol_name());
       }
     }
     assert(fixed);
@@ -1152,7 +1152,7 @@ Instruction decode_instruction(LinkedWord& word, LinkedObjectFile& file, int seg
     for (int j = 0; j < i.n_src; j++) {
       if (i.src[j].kind == InstructionAtom::IMM) {
         fixed = true;
-        i.src[j].set_label(word.label_id);
+        i.src[j].set_label(word.label_id());
       }
     }
     assert(fixed);
@@ -1164,7 +1164,7 @@ Instruction decode_instruction(LinkedWord& word, LinkedObjectFile& file, int seg
     for (int j = 0; j < i.n_src; j++) {
       if (i.src[j].kind == InstructionAtom::IMM) {
         fixed = true;
-        i.src[j].set_label(word.label_id);
+        i.src[j].set_label(word.label_id());
       }
     }
     assert(fixed);
@@ -70,8 +70,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       auto& instr = instructions.at(idx);
       // storing stack pointer on the stack is done by some ASM kernel functions
       if (instr.kind == InstructionKind::SW && instr.get_src(0).get_reg() == make_gpr(Reg::SP)) {
-        printf("[Warning] %s Suspected ASM function based on this instruction in prologue: %s\n",
-               guessed_name.to_string().c_str(), instr.to_string(file.labels).c_str());
+        lg::warn("{} Suspected ASM function based on this instruction in prologue: {}",
+                 guessed_name.to_string(), instr.to_string(file.labels));
         warnings += ";; Flagged as ASM function because of " + instr.to_string(file.labels) + "\n";
         suspected_asm = true;
         return;
@@ -131,10 +131,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       // sometimes stack memory is zeroed immediately after gpr backups, and this fools the previous
       // check.
       if (store_reg == make_gpr(Reg::R0)) {
-        printf(
-            "[Warning] %s Stack Zeroing Detected in Function::analyze_prologue, prologue may be "
-            "wrong\n",
-            guessed_name.to_string().c_str());
+        lg::warn("{} Stack Zeroing Detected in Function::analyze_prologue, prologue may be wrong",
+                 guessed_name.to_string());
         warnings += ";; Stack Zeroing Detected, prologue may be wrong\n";
         expect_nothing_after_gprs = true;
         break;
@@ -144,9 +142,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       // avoid false positives here!
       if (store_reg == make_gpr(Reg::A0)) {
         suspected_asm = true;
-        printf(
-            "[Warning] %s Suspected ASM function because register $a0 was stored on the stack!\n",
-            guessed_name.to_string().c_str());
+        lg::warn("{} Suspected ASM function because register $a0 was stored on the stack!",
+                 guessed_name.to_string());
         warnings += ";; a0 on stack detected, flagging as asm\n";
         return;
       }
@@ -163,9 +160,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
         assert(this_offset == prologue.gpr_backup_offset + 16 * i);
         if (this_reg != get_expected_gpr_backup(i, n_gpr_backups)) {
           suspected_asm = true;
-          printf("[Warning] %s Suspected asm function that isn't flagged due to stack store %s\n",
-                 guessed_name.to_string().c_str(),
-                 instructions.at(idx + i).to_string(file.labels).c_str());
+          lg::warn("{} Suspected asm function that isn't flagged due to stack store {}",
+                   guessed_name.to_string(), instructions.at(idx + i).to_string(file.labels));
           warnings += ";; Suspected asm function due to stack store: " +
                       instructions.at(idx + i).to_string(file.labels) + "\n";
           return;
@@ -193,9 +189,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
           assert(this_offset == prologue.fpr_backup_offset + 4 * i);
           if (this_reg != get_expected_fpr_backup(i, n_fpr_backups)) {
             suspected_asm = true;
-            printf("[Warning] %s Suspected asm function that isn't flagged due to stack store %s\n",
-                   guessed_name.to_string().c_str(),
-                   instructions.at(idx + i).to_string(file.labels).c_str());
+            lg::warn("{} Suspected asm function that isn't flagged due to stack store {}",
+                     guessed_name.to_string(), instructions.at(idx + i).to_string(file.labels));
             warnings += ";; Suspected asm function due to stack store: " +
                         instructions.at(idx + i).to_string(file.labels) + "\n";
             return;
@@ -330,7 +325,7 @@ std::string Function::Prologue::to_string(int indent) const {
 void Function::check_epilogue(const LinkedObjectFile& file) {
   (void)file;
   if (!prologue.decoded || suspected_asm) {
-    printf("not decoded, or suspected asm, skipping epilogue\n");
+    lg::info("not decoded, or suspected asm, skipping epilogue");
     return;
   }
 
@@ -353,10 +348,8 @@ void Function::check_epilogue(const LinkedObjectFile& file) {
       idx--;
       assert(is_jr_ra(instructions.at(idx)));
       idx--;
-      printf(
-          "[Warning] %s Double Return Epilogue Hack!  This is probably an ASM function in "
-          "disguise\n",
-          guessed_name.to_string().c_str());
+      lg::warn("{} Double Return Epilogue Hack!  This is probably an ASM function in disguise",
+               guessed_name.to_string());
       warnings += ";; Double Return Epilogue - this is probably an ASM function\n";
     }
     // delay slot should be daddiu sp, sp, offset
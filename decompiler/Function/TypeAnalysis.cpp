@@ -1,6 +1,7 @@
 #include "decompiler/Function/Function.h"
 #include "decompiler/IR/IR.h"
 #include "third-party/fmt/core.h"
+#include "common/log/log.h"
 #include "decompiler/config.h"
 
 namespace decompiler {
@@ -27,7 +28,7 @@ void apply_hints(const std::vector<TypeHint>& hints, TypeState* state, Decompile
     try {
       state->get(hint.reg) = TP_Type::make_from_ts(dts.parse_type_spec(hint.type_name));
     } catch (std::exception& e) {
-      printf("failed to parse hint: %s\n", e.what());
+      lg::warn("failed to parse hint: {}", e.what());
       assert(false);
     }
   }
@@ -140,19 +141,21 @@ bool Function::run_type_analysis_ir2(const TypeSpec& my_type,
                                      LinkedObjectFile& file,
                                      const std::unordered_map<int, std::vector<TypeHint>>& hints) {
   (void)file;
-  // STEP 0 - set decompiler type system settings for this function. In config we can manually
+  // STEP 0 - set type propagation settings for this function. In config we can manually
   // specify some settings for type propagation to reduce the strictness of type propagation.
-  if (!dts.type_prop_settings.locked) {
-    dts.type_prop_settings.reset();
-    if (get_config().pair_functions_by_name.find(guessed_name.to_string()) !=
-        get_config().pair_functions_by_name.end()) {
-      dts.type_prop_settings.allow_pair = true;
-    }
+  // These go in the function's env, so the type system is not modified.
+  TypePropSettings settings;
+  if (dts.type_prop_settings.locked) {
+    settings = dts.type_prop_settings;
+  } else if (get_config().pair_functions_by_name.find(guessed_name.to_string()) !=
+             get_config().pair_functions_by_name.end()) {
+    settings.allow_pair = true;
   }
 
   if (guessed_name.kind == FunctionName::FunctionKind::METHOD) {
-    dts.type_prop_settings.current_method_type = guessed_name.type_name;
+    settings.current_method_type = guessed_name.type_name;
   }
+  ir2.env.set_type_prop_settings(settings);
 
   std::vector<TypeState> block_init_types, op_types;
   block_init_types.resize(basic_blocks.size());
@@ -193,7 +196,7 @@ bool Function::run_type_analysis_ir2(const TypeSpec& my_type,
         try {
           op_types.at(op_id) = op->propagate_types(*init_types, ir2.env, dts);
         } catch (std::runtime_error& e) {
-          fmt::print("Type prop fail on {}: {}\n", guessed_name.to_string(), e.what());
+          lg::warn("Type prop fail on {}: {}", guessed_name.to_string(), e.what());
           warnings += ";; Type prop attempted and failed.\n";
           ir2.env.set_types(block_init_types, op_types);
           return false;
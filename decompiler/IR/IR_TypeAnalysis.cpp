@@ -795,8 +795,8 @@ void IR_Call_Atomic::propagate_types(const TypeState& input,
         TP_Type::make_from_ts(dts.type_prop_settings.current_method_type);
     // update the call type
     call_type = in_tp.get_method_new_object_typespec();
-    call_type.get_arg(call_type.arg_count() - 1) =
-        TypeSpec(dts.type_prop_settings.current_method_type);
+    call_type.set_arg(call_type.arg_count() - 1,
+                      TypeSpec(dts.type_prop_settings.current_method_type));
     call_type_set = true;
     return;
   }
@@ -893,11 +893,11 @@ TP_Type IR_StaticAddress::get_expression_type(const TypeState& input,
     // it's a basic! probably.
     const auto& word = file.words_by_seg.at(label.target_segment).at((label.offset - 4) / 4);
     if (word.kind == LinkedWord::TYPE_PTR) {
-      if (word.symbol_name == "string") {
+      if (word.symbol_name() == "string") {
         return TP_Type::make_from_string(file.get_goal_string_by_label(label));
       } else {
         // otherwise, some other static basic.
-        return TP_Type::make_from_ts(TypeSpec(word.symbol_name));
+        return TP_Type::make_from_ts(TypeSpec(word.symbol_name()));
       }
     }
   } else if ((label.offset & 7) == PAIR_OFFSET) {
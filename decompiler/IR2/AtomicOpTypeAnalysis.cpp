@@ -118,11 +118,11 @@ TP_Type SimpleAtom::get_type(const TypeState& input,
         const auto& word =
             env.file->words_by_seg.at(label.target_segment).at((label.offset - 4) / 4);
         if (word.kind == LinkedWord::TYPE_PTR) {
-          if (word.symbol_name == "string") {
+          if (word.symbol_name() == "string") {
             return TP_Type::make_from_string(env.file->get_goal_string_by_label(label));
           } else {
             // otherwise, some other static basic.
-            return TP_Type::make_from_ts(TypeSpec(word.symbol_name));
+            return TP_Type::make_from_ts(TypeSpec(word.symbol_name()));
           }
         }
       } else if ((label.offset & 7) == PAIR_OFFSET) {
@@ -585,9 +585,9 @@ TP_Type LoadVarOp::get_src_type(const TypeState& input,
     auto rd = dts.ts.reverse_field_lookup(rd_in);
 
     // only error on failure if "pair" is disabled. otherwise it might be a pair.
-    if (!rd.success && !dts.type_prop_settings.allow_pair) {
-      printf("input type is %s, offset is %d, sign %d size %d\n", rd_in.base_type.print().c_str(),
-             rd_in.offset, rd_in.deref.value().sign_extend, rd_in.deref.value().size);
+    if (!rd.success && !env.type_prop_settings().allow_pair) {
+      lg::warn("input type is {}, offset is {}, sign {} size {}", rd_in.base_type.print(),
+               rd_in.offset, rd_in.deref.value().sign_extend, rd_in.deref.value().size);
       throw std::runtime_error(fmt::format("Could not get type of load: {}. Reverse Deref Failed.",
                                            to_form(env.file->labels, &env).print()));
     }
@@ -603,7 +603,7 @@ TP_Type LoadVarOp::get_src_type(const TypeState& input,
     }
 
     // rd failed, try as pair.
-    if (dts.type_prop_settings.allow_pair) {
+    if (env.type_prop_settings().allow_pair) {
       // we are strict here - only permit pair-type loads from object or pair.
       // object is permitted for stuff like association lists where the car is also a pair.
       if (m_kind == Kind::SIGNED && m_size == 4 &&
@@ -672,14 +672,14 @@ TypeState CallOp::propagate_types_internal(const TypeState& input,
 
   auto in_tp = input.get(Register(Reg::GPR, Reg::T9));
   if (in_tp.kind == TP_Type::Kind::OBJECT_NEW_METHOD &&
-      !dts.type_prop_settings.current_method_type.empty()) {
+      !env.type_prop_settings().current_method_type.empty()) {
     // calling object new method. Set the result to a new object of our type
     end_types.get(Register(Reg::GPR, Reg::V0)) =
-        TP_Type::make_from_ts(dts.type_prop_settings.current_method_type);
+        TP_Type::make_from_ts(env.type_prop_settings().current_method_type);
     // update the call type
     m_call_type = in_tp.get_method_new_object_typespec();
-    m_call_type.get_arg(m_call_type.arg_count() - 1) =
-        TypeSpec(dts.type_prop_settings.current_method_type);
+    m_call_type.set_arg(m_call_type.arg_count() - 1,
+                        TypeSpec(env.type_prop_settings().current_method_type));
     m_call_type_set = true;
     return end_types;
   }
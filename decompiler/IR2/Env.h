@@ -66,6 +66,15 @@ class Env {
   void set_types(const std::vector<TypeState>& block_init_types,
                  const std::vector<TypeState>& op_end_types);
 
+  /*!
+   * Settings for type propagation in this function. Kept here instead of in the type system so
+   * functions can be analyzed on several threads.
+   */
+  const TypePropSettings& type_prop_settings() const { return m_type_prop_settings; }
+  void set_type_prop_settings(const TypePropSettings& settings) {
+    m_type_prop_settings = settings;
+  }
+
   void set_local_vars(const VariableNames& names) {
     m_var_names = names;
     m_has_local_vars = true;
@@ -81,5 +90,6 @@ class Env {
   std::vector<TypeState> m_block_init_types;
   std::vector<TypeState> m_op_end_types;
   VariableNames m_var_names;
+  TypePropSettings m_type_prop_settings;
 };
 }  // namespace decompiler
\ No newline at end of file
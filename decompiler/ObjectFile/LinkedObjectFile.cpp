@@ -126,7 +126,7 @@ bool LinkedObjectFile::pointer_link_word(int source_segment,
   assert(dest_offset / 4 <= (int)words_by_seg.at(dest_segment).size());
 
   word.kind = LinkedWord::PTR;
-  word.label_id = get_label_id_for(dest_segment, dest_offset);
+  word.set_label_id(get_label_id_for(dest_segment, dest_offset));
   return true;
 }
 
@@ -144,7 +144,7 @@ void LinkedObjectFile::symbol_link_word(int source_segment,
     printf("bad symbol link word\n");
   }
   word.kind = kind;
-  word.symbol_name = name;
+  word.set_symbol_name(name);
 }
 
 /*!
@@ -156,7 +156,7 @@ void LinkedObjectFile::symbol_link_offset(int source_segment, int source_offset,
   auto& word = words_by_seg.at(source_segment).at(source_offset / 4);
   assert(word.kind == LinkedWord::PLAIN_DATA);
   word.kind = LinkedWord::SYM_OFFSET;
-  word.symbol_name = name;
+  word.set_symbol_name(name);
 }
 
 /*!
@@ -178,10 +178,10 @@ void LinkedObjectFile::pointer_link_split_word(int source_segment,
   assert(lo_word.kind == LinkedWord::PLAIN_DATA);
 
   hi_word.kind = LinkedWord::HI_PTR;
-  hi_word.label_id = get_label_id_for(dest_segment, dest_offset);
+  hi_word.set_label_id(get_label_id_for(dest_segment, dest_offset));
 
   lo_word.kind = LinkedWord::LO_PTR;
-  lo_word.label_id = hi_word.label_id;
+  lo_word.set_label_id(hi_word.label_id());
 }
 
 /*!
@@ -256,27 +256,27 @@ void LinkedObjectFile::append_word_to_string(std::string& dest, const LinkedWord
       sprintf(buff, "    .word 0x%x\n", word.data);
       break;
     case LinkedWord::PTR:
-      sprintf(buff, "    .word %s\n", labels.at(word.label_id).name.c_str());
+      sprintf(buff, "    .word %s\n", labels.at(word.label_id()).name.c_str());
       break;
     case LinkedWord::SYM_PTR:
-      sprintf(buff, "    .symbol %s\n", word.symbol_name.c_str());
+      sprintf(buff, "    .symbol %s\n", word.symbol_name().c_str());
       break;
     case LinkedWord::TYPE_PTR:
-      sprintf(buff, "    .type %s\n", word.symbol_name.c_str());
+      sprintf(buff, "    .type %s\n", word.symbol_name().c_str());
       break;
     case LinkedWord::EMPTY_PTR:
       sprintf(buff, "    .empty-list\n");  // ?
       break;
     case LinkedWord::HI_PTR:
       sprintf(buff, "    .ptr-hi 0x%x %s\n", word.data >> 16,
-              labels.at(word.label_id).name.c_str());
+              labels.at(word.label_id()).name.c_str());
       break;
     case LinkedWord::LO_PTR:
       sprintf(buff, "    .ptr-lo 0x%x %s\n", word.data >> 16,
-              labels.at(word.label_id).name.c_str());
+              labels.at(word.label_id()).name.c_str());
       break;
     case LinkedWord::SYM_OFFSET:
-      sprintf(buff, "    .sym-off 0x%x %s\n", word.data >> 16, word.symbol_name.c_str());
+      sprintf(buff, "    .sym-off 0x%x %s\n", word.data >> 16, word.symbol_name().c_str());
       break;
     default:
       throw std::runtime_error("nyi");
@@ -293,8 +293,8 @@ void LinkedObjectFile::find_code() {
     // single segment object files should never have any code.
     auto& seg = words_by_seg.front();
     for (auto& word : seg) {
-      if (!word.symbol_name.empty()) {
-        assert(word.symbol_name != "function");
+      if (!word.symbol_name().empty()) {
+        assert(word.symbol_name() != "function");
       }
     }
     offset_of_data_zone_by_seg.at(0) = 0;
@@ -313,7 +313,7 @@ void LinkedObjectFile::find_code() {
       size_t function_loc = -1;
       for (size_t j = words_by_seg.at(i).size(); j-- > 0;) {
         auto& word = words_by_seg.at(i).at(j);
-        if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "function") {
+        if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == "function") {
           function_loc = j;
           found_function = true;
           break;
@@ -352,7 +352,7 @@ void LinkedObjectFile::find_code() {
       // verify there are no functions after the data section starts
       for (size_t j = offset_of_data_zone_by_seg.at(i); j < words_by_seg.at(i).size(); j++) {
         auto& word = words_by_seg.at(i).at(j);
-        if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "function") {
+        if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == "function") {
           assert(false);
         }
       }
@@ -388,7 +388,7 @@ void LinkedObjectFile::find_functions() {
         bool found_function_tag_loc = false;
         for (; function_tag_loc-- > 0;) {
           auto& word = words_by_seg.at(seg).at(function_tag_loc);
-          if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "function") {
+          if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == "function") {
             found_function_tag_loc = true;
             break;
           }
@@ -760,7 +760,7 @@ std::string LinkedObjectFile::print_disassembly() {
       auto& word = words_by_seg[seg][i];
       append_word_to_string(result, word);
 
-      if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "string") {
+      if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == "string") {
         result += "; " + get_goal_string(seg, i) + "\n";
       }
     }
@@ -965,9 +965,9 @@ goos::Object LinkedObjectFile::to_form_script(int seg, int word_idx, std::vector
         assert((cdr_addr % 4) == 0);
         auto& cdr_word = words_by_seg.at(seg).at(cdr_addr / 4);
         // check for proper list
-        if (cdr_word.kind == LinkedWord::PTR && (labels.at(cdr_word.label_id).offset & 7) == 2) {
+        if (cdr_word.kind == LinkedWord::PTR && (labels.at(cdr_word.label_id()).offset & 7) == 2) {
           // yes, proper list. add another pair and link it in to the list.
-          goal_print_obj = labels.at(cdr_word.label_id).offset;
+          goal_print_obj = labels.at(cdr_word.label_id()).offset;
           fill.as_pair()->cdr = goos::PairObject::make_new(goos::EmptyListObject::make_new(),
                                                            goos::EmptyListObject::make_new());
           fill = fill.as_pair()->cdr;
@@ -999,7 +999,7 @@ bool LinkedObjectFile::is_string(int seg, int byte_idx) const {
     return false;
   }
   auto& type_word = words_by_seg.at(seg).at(type_tag_ptr / 4);
-  return type_word.kind == LinkedWord::TYPE_PTR && type_word.symbol_name == "string";
+  return type_word.kind == LinkedWord::TYPE_PTR && type_word.symbol_name() == "string";
 }
 
 /*!
@@ -1016,13 +1016,13 @@ goos::Object LinkedObjectFile::to_form_script_object(int seg,
       auto& word = words_by_seg.at(seg).at(byte_idx / 4);
       if (word.kind == LinkedWord::SYM_PTR) {
         // .symbol xxxx
-        result = pretty_print::to_symbol(word.symbol_name);
+        result = pretty_print::to_symbol(word.symbol_name());
       } else if (word.kind == LinkedWord::PLAIN_DATA) {
         // .word xxxxx
         result = pretty_print::to_symbol(std::to_string(word.data));
       } else if (word.kind == LinkedWord::PTR) {
         // might be a sub-list, or some other random pointer
-        auto offset = labels.at(word.label_id).offset;
+        auto offset = labels.at(word.label_id()).offset;
         if ((offset & 7) == 2) {
           // list!
           result = to_form_script(seg, offset / 4, seen);
@@ -1031,7 +1031,7 @@ goos::Object LinkedObjectFile::to_form_script_object(int seg,
             result = pretty_print::to_symbol(get_goal_string(seg, offset / 4 - 1));
           } else {
             // some random pointer, just print the label.
-            result = pretty_print::to_symbol(labels.at(word.label_id).name);
+            result = pretty_print::to_symbol(labels.at(word.label_id()).name);
           }
         }
       } else if (word.kind == LinkedWord::EMPTY_PTR) {
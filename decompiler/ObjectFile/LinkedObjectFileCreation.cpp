@@ -68,7 +68,7 @@ enum class SymbolLinkKind {
  * Handle symbol links for a single symbol in a V2/V4 object file.
  */
 static uint32_t c_symlink2(LinkedObjectFile& f,
-                           const std::vector<uint8_t>& data,
+                           const ByteSpan& data,
                            uint32_t code_ptr_offset,
                            uint32_t link_ptr_offset,
                            SymbolLinkKind kind,
@@ -148,7 +148,7 @@ static uint32_t c_symlink2(LinkedObjectFile& f,
  * Handle symbol links for a single symbol in a V3 object file.
  */
 static uint32_t c_symlink3(LinkedObjectFile& f,
-                           const std::vector<uint8_t>& data,
+                           const ByteSpan& data,
                            uint32_t code_ptr,
                            uint32_t link_ptr,
                            SymbolLinkKind kind,
@@ -224,7 +224,7 @@ static uint32_t align16(uint32_t in) {
  * frame and level data is ~10 MB.
  */
 static void link_v2_or_v4(LinkedObjectFile& f,
-                          const std::vector<uint8_t>& data,
+                          const ByteSpan& data,
                           const std::string& name,
                           DecompilerTypeSystem& dts) {
   const auto* header = (const LinkHeaderV4*)&data.at(0);
@@ -404,7 +404,7 @@ static void assert_string_empty_after(const char* str, int size) {
 }
 
 static void link_v5(LinkedObjectFile& f,
-                    const std::vector<uint8_t>& data,
+                    const ByteSpan& data,
                     const std::string& name,
                     DecompilerTypeSystem& dts) {
   auto header = (const LinkHeaderV5*)(&data.at(0));
@@ -607,7 +607,7 @@ static void link_v5(LinkedObjectFile& f,
 }
 
 static void link_v3(LinkedObjectFile& f,
-                    const std::vector<uint8_t>& data,
+                    const ByteSpan& data,
                     const std::string& name,
                     DecompilerTypeSystem& dts) {
   auto header = (const LinkHeaderV3*)(&data.at(0));
@@ -798,7 +798,7 @@ static void link_v3(LinkedObjectFile& f,
 /*!
  * Main function to generate LinkedObjectFiles from raw object data.
  */
-LinkedObjectFile to_linked_object_file(const std::vector<uint8_t>& data,
+LinkedObjectFile to_linked_object_file(const ByteSpan& data,
                                        const std::string& name,
                                        DecompilerTypeSystem& dts) {
   LinkedObjectFile result;
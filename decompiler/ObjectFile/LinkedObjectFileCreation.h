@@ -10,10 +10,11 @@
 #define NEXT_LINKEDOBJECTFILECREATION_H
 
 #include "LinkedObjectFile.h"
+#include "common/util/ByteSpan.h"
 
 namespace decompiler {
 class DecompilerTypeSystem;
-LinkedObjectFile to_linked_object_file(const std::vector<uint8_t>& data,
+LinkedObjectFile to_linked_object_file(const ByteSpan& data,
                                        const std::string& name,
                                        DecompilerTypeSystem& dts);
 }  // namespace decompiler
@@ -0,0 +1,54 @@
+/*!
+ * @file LinkedWord.cpp
+ * A word (4 bytes), possibly with some linking info.
+ */
+
+#include <stdexcept>
+#include "LinkedWord.h"
+#include "common/util/StringTable.h"
+
+namespace decompiler {
+
+static_assert(sizeof(LinkedWord) == 8, "LinkedWord should be packed");
+
+namespace {
+/*!
+ * All symbol names used by linked words. Words are linked on one thread, but their names are read
+ * from several.
+ */
+StringTable& table() {
+  static auto* table = new StringTable();
+  return *table;
+}
+}  // namespace
+
+uint32_t get_symbol_name_id(const std::string& name) {
+  return table().id(name);
+}
+
+const std::string& get_symbol_name(uint32_t id) {
+  return table().str(id);
+}
+
+void LinkedWord::set_label_id(int id) {
+  if (id >= int(NO_ID)) {
+    throw std::runtime_error("Label id too large for LinkedWord: " + std::to_string(id));
+  }
+  m_is_symbol = 0;
+  m_id = id < 0 ? NO_ID : uint32_t(id);
+}
+
+const std::string& LinkedWord::symbol_name() const {
+  static const std::string empty;
+  return (m_is_symbol && m_id != NO_ID) ? get_symbol_name(m_id) : empty;
+}
+
+void LinkedWord::set_symbol_name(const std::string& name) {
+  auto id = get_symbol_name_id(name);
+  if (id >= NO_ID) {
+    throw std::runtime_error("Too many symbol names in LinkedWord table");
+  }
+  m_is_symbol = 1;
+  m_id = id;
+}
+}  // namespace decompiler
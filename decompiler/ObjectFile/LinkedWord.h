@@ -12,11 +12,17 @@
 #include <string>
 
 namespace decompiler {
+/*!
+ * The object files of the whole game have tens of millions of words, so this is packed into 8
+ * bytes. A word links to either a label or a symbol, never both, so they share the id. Symbol
+ * names are interned in a table shared by all words (see get_symbol_name_id).
+ */
 class LinkedWord {
  public:
-  explicit LinkedWord(uint32_t _data) : data(_data) {}
+  explicit LinkedWord(uint32_t _data)
+      : data(_data), kind(PLAIN_DATA), m_is_symbol(0), m_id(NO_ID) {}
 
-  enum Kind {
+  enum Kind : uint32_t {
     PLAIN_DATA,  // just plain data
     PTR,         // pointer to a location
     HI_PTR,      // lower 16-bits of this data are the upper 16 bits of a pointer
@@ -25,13 +31,31 @@ class LinkedWord {
     EMPTY_PTR,   // this is a pointer to the empty list
     SYM_OFFSET,  // this is an offset of a symbol in the symbol table
     TYPE_PTR     // this is a pointer to a type
-  } kind = PLAIN_DATA;
+  };
 
   uint32_t data = 0;
-
-  int label_id = -1;
-  std::string symbol_name;
+  Kind kind : 4;
+
+  /*!
+   * The label this word points to, or -1.
+   */
+  int label_id() const { return (m_is_symbol || m_id == NO_ID) ? -1 : int(m_id); }
+  void set_label_id(int id);
+
+  /*!
+   * The symbol or type this word links to, or an empty string.
+   */
+  const std::string& symbol_name() const;
+  void set_symbol_name(const std::string& name);
+
+ private:
+  static constexpr uint32_t NO_ID = (1u << 27) - 1;
+  uint32_t m_is_symbol : 1;
+  uint32_t m_id : 27;  // label id or symbol name id
 };
+
+uint32_t get_symbol_name_id(const std::string& name);
+const std::string& get_symbol_name(uint32_t id);
 }  // namespace decompiler
 
 #endif  // JAK2_DISASSEMBLER_LINKEDWORD_H
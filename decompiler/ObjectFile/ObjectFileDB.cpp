@@ -114,7 +114,8 @@ ObjectFileDB::ObjectFileDB(const std::vector<std::string>& _dgos,
   Timer timer;
 
   lg::info("-Loading types...");
-  dts.parse_type_defs({"decompiler", "config", "all-types.gc"});
+  dts.load_type_defs({"decompiler", "config", "all-types.gc"},
+                     file_util::get_file_path({"out", "cache", "all-types.typedb"}));
 
   if (!obj_file_name_map_file.empty()) {
     lg::info("-Loading obj name map file...");
@@ -133,9 +134,10 @@ ObjectFileDB::ObjectFileDB(const std::vector<std::string>& _dgos,
 
   lg::info("-Loading {} plain object files...", object_files.size());
   for (auto& obj : object_files) {
-    auto data = file_util::read_binary_file(obj);
+    m_mapped_files.push_back(std::make_unique<MappedFile>(obj));
+    auto& file = *m_mapped_files.back();
     auto name = obj_filename_to_name(obj);
-    add_obj_from_dgo(name, name, data.data(), data.size(), "NO-XGO");
+    add_obj_from_dgo(name, name, file.data(), file.size(), "NO-XGO");
   }
 
   lg::info("-Loading {} streaming object files...", str_files.size());
@@ -148,8 +150,9 @@ ObjectFileDB::ObjectFileDB(const std::vector<std::string>& _dgos,
     for (int i = 0; i < reader.chunk_count(); i++) {
       // append the chunk ID to the full name
       std::string name = obj_name + fmt::format("+{}", i);
-      auto& data = reader.get_chunk(i);
-      add_obj_from_dgo(name, name, data.data(), data.size(), "NO-XGO");
+      // the reader's chunks go away with it, so new objects are copied.
+      auto& chunk = reader.get_chunk(i);
+      add_obj_from_dgo(name, name, chunk.data(), chunk.size(), "NO-XGO", true);
     }
   }
 
@@ -204,7 +207,7 @@ void assert_string_empty_after(const char* str, int size) {
 }  // namespace
 
 namespace {
-std::string get_object_file_name(const std::string& original_name, uint8_t* data, int size) {
+std::string get_object_file_name(const std::string& original_name, const uint8_t* data, int size) {
   const char art_group_text[] =
       "/src/next/data/art-group6/";  // todo, this may change in other games
   const char suffix[] = "-ag.go";
@@ -239,10 +242,21 @@ std::string get_object_file_name(const std::string& original_name, uint8_t* data
 
 constexpr int MAX_CHUNK_SIZE = 0x8000;
 /*!
- * Load the objects stored in the given DGO into the ObjectFileDB
+ * Keep a buffer of object data for as long as the ObjectFileDB exists.
+ */
+ByteSpan ObjectFileDB::keep_data(std::vector<u8>&& data) {
+  m_buffers.push_back(std::make_unique<std::vector<u8>>(std::move(data)));
+  return ByteSpan(*m_buffers.back());
+}
+
+/*!
+ * Load the objects stored in the given DGO into the ObjectFileDB.
+ * The DGO is memory mapped and the objects point into it, so nothing is copied. Compressed DGOs are
+ * decompressed into a buffer instead.
  */
 void ObjectFileDB::get_objs_from_dgo(const std::string& filename) {
-  auto dgo_data = file_util::read_binary_file(filename);
+  m_mapped_files.push_back(std::make_unique<MappedFile>(filename));
+  ByteSpan dgo_data(m_mapped_files.back()->data(), m_mapped_files.back()->size());
   stats.total_dgo_bytes += dgo_data.size();
 
   const char jak2_header[] = "oZlB";
@@ -257,7 +271,7 @@ void ObjectFileDB::get_objs_from_dgo(const std::string& filename) {
     if (lzo_init() != LZO_E_OK) {
       assert(false);
     }
-    BinaryReader compressed_reader(dgo_data);
+    BinaryReader compressed_reader(dgo_data.data(), dgo_data.size());
     // seek past oZlB
     compressed_reader.ffwd(4);
     auto decompressed_size = compressed_reader.read<uint32_t>();
@@ -293,10 +307,12 @@ void ObjectFileDB::get_objs_from_dgo(const std::string& filename) {
         compressed_reader.ffwd(1);
       }
     }
-    dgo_data = decompressed_data;
+    dgo_data = keep_data(std::move(decompressed_data));
+    // only the decompressed data is used.
+    m_mapped_files.pop_back();
   }
 
-  BinaryReader reader(dgo_data);
+  BinaryReader reader(dgo_data.data(), dgo_data.size());
   auto header = reader.read<DgoHeader>();
 
   auto dgo_base_name = file_util::base_name(filename);
@@ -304,6 +320,7 @@ void ObjectFileDB::get_objs_from_dgo(const std::string& filename) {
   assert_string_empty_after(header.name, 60);
 
   // get all obj files...
+  auto unique_objs_before = stats.unique_obj_files;
   for (uint32_t i = 0; i < header.size; i++) {
     auto obj_header = reader.read<DgoHeader>();
     assert(reader.bytes_left() >= obj_header.size);
@@ -325,16 +342,28 @@ void ObjectFileDB::get_objs_from_dgo(const std::string& filename) {
 
   // check we're at the end
   assert(0 == reader.bytes_left());
+
+  // if every object was a duplicate, nothing points into this DGO, so it can be closed.
+  if (stats.unique_obj_files == unique_objs_before) {
+    if (is_jak2) {
+      m_buffers.pop_back();
+    } else {
+      m_mapped_files.pop_back();
+    }
+  }
 }
 
 /*!
- * Add an object file to the ObjectFileDB
+ * Add an object file to the ObjectFileDB. Duplicates are found by hash, and only the first copy is
+ * kept. If copy_data is set, a new object's data is copied with keep_data. Otherwise the data isn't
+ * copied, so it must stay valid as long as the ObjectFileDB exists.
  */
 void ObjectFileDB::add_obj_from_dgo(const std::string& obj_name,
                                     const std::string& name_in_dgo,
                                     const uint8_t* obj_data,
                                     uint32_t obj_size,
-                                    const std::string& dgo_name) {
+                                    const std::string& dgo_name,
+                                    bool copy_data) {
   stats.total_obj_files++;
   assert(obj_size > 128);
   uint16_t version = *(const uint16_t*)(obj_data + 8);
@@ -366,8 +395,11 @@ void ObjectFileDB::add_obj_from_dgo(const std::string& obj_name,
 
   // nope, have to add a new one.
   ObjectFileData data;
-  data.data.resize(obj_size);
-  memcpy(data.data.data(), obj_data, obj_size);
+  if (copy_data) {
+    data.data = keep_data(std::vector<u8>(obj_data, obj_data + obj_size));
+  } else {
+    data.data = ByteSpan(obj_data, obj_size);
+  }
   data.record.hash = hash;
   data.record.name = obj_name;
   data.dgo_names.push_back(dgo_name);
@@ -11,12 +11,17 @@
 #define JAK2_DISASSEMBLER_OBJECTFILEDB_H
 
 #include <cassert>
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "LinkedObjectFile.h"
 #include "decompiler/util/DecompilerTypeSystem.h"
 #include "common/common_types.h"
+#include "common/util/ByteSpan.h"
+#include "common/util/MappedFile.h"
+#include "common/util/ThreadPool.h"
 
 namespace decompiler {
 /*!
@@ -32,7 +37,7 @@ struct ObjectFileRecord {
  * All of the data for a single object file
  */
 struct ObjectFileData {
-  std::vector<uint8_t> data;     // raw bytes
+  ByteSpan data;                 // raw bytes, owned by the ObjectFileDB
   LinkedObjectFile linked_data;  // data including linking annotations
   ObjectFileRecord record;       // name
   std::vector<std::string> dgo_names;
@@ -44,6 +49,8 @@ struct ObjectFileData {
   uint32_t reference_count = 0;  // number of times its used.
 };
 
+void run_jobs_in_parallel(const std::vector<std::function<void()>>& jobs, ThreadPool* pool);
+
 class ObjectFileDB {
  public:
   ObjectFileDB(const std::vector<std::string>& _dgos,
@@ -94,11 +101,13 @@ class ObjectFileDB {
  private:
   void load_map_file(const std::string& map_data);
   void get_objs_from_dgo(const std::string& filename);
+  ByteSpan keep_data(std::vector<u8>&& data);
   void add_obj_from_dgo(const std::string& obj_name,
                         const std::string& name_in_dgo,
                         const uint8_t* obj_data,
                         uint32_t obj_size,
-                        const std::string& dgo_name);
+                        const std::string& dgo_name,
+                        bool copy_data = false);
 
   /*!
    * Apply f to all ObjectFileData's. Does it in the right order.
@@ -151,6 +160,21 @@ class ObjectFileDB {
     });
   }
 
+  /*!
+   * Like for_each_function_def_order, but the functions are split between several threads (see
+   * run_in_parallel). f may only modify the function it is given, and must not modify dts.
+   */
+  template <typename Func>
+  void for_each_function_def_order_parallel(Func f) {
+    std::vector<std::function<void()>> jobs;
+    for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+      jobs.push_back([&f, &func, segment_id, &data]() { f(func, segment_id, data); });
+    });
+    run_in_parallel(jobs);
+  }
+
+  void run_in_parallel(const std::vector<std::function<void()>>& jobs);
+
   // Danger: after adding all object files, we assume that the vector never reallocates.
   std::unordered_map<std::string, std::vector<ObjectFileData>> obj_files_by_name;
   std::unordered_map<std::string, std::vector<ObjectFileRecord>> obj_files_by_dgo;
@@ -164,6 +188,12 @@ class ObjectFileDB {
     uint32_t unique_obj_files = 0;
     uint32_t unique_obj_bytes = 0;
   } stats;
+
+  std::unique_ptr<ThreadPool> m_thread_pool;
+
+  // the files and buffers that the ObjectFileData::data spans point into.
+  std::vector<std::unique_ptr<MappedFile>> m_mapped_files;
+  std::vector<std::unique_ptr<std::vector<u8>>> m_buffers;
 };
 }  // namespace decompiler
 
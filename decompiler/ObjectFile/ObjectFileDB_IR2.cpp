@@ -3,6 +3,9 @@
  * This runs the IR2 analysis passes.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include "ObjectFileDB.h"
 #include "common/log/log.h"
 #include "common/util/Timer.h"
@@ -12,9 +15,74 @@
 #include "decompiler/IR2/variable_naming.h"
 #include "decompiler/IR2/cfg_builder.h"
 #include "common/goos/PrettyPrinter.h"
+#include "decompiler/config.h"
 
 namespace decompiler {
 
+/*!
+ * Run the jobs on the calling thread and the threads of pool, which may be null. Each thread takes
+ * the next job that hasn't been started yet, so a thread that gets quick jobs runs more of them.
+ * Messages logged by each job are printed afterward, in the order of the jobs, so the output is the
+ * same for any number of threads. If a job throws, no jobs after it are started, but every job
+ * before it still runs. The exception of the first job that failed is rethrown.
+ */
+void run_jobs_in_parallel(const std::vector<std::function<void()>>& jobs, ThreadPool* pool) {
+  int helper_count = pool ? std::min(pool->thread_count(), int(jobs.size()) - 1) : 0;
+
+  std::vector<lg::LogBuffer> logs(jobs.size());
+  std::vector<std::exception_ptr> errors(jobs.size());
+  std::atomic<size_t> next_job(0);
+  // index of the first job that failed so far, or jobs.size(). Only ever decreases.
+  std::atomic<size_t> first_failed(jobs.size());
+  auto run_jobs = [&]() {
+    for (size_t i = next_job++; i < first_failed; i = next_job++) {
+      lg::set_thread_buffer(&logs[i]);
+      try {
+        jobs[i]();
+      } catch (...) {
+        errors[i] = std::current_exception();
+        size_t prev = first_failed;
+        while (i < prev && !first_failed.compare_exchange_weak(prev, i)) {
+        }
+      }
+      lg::set_thread_buffer(nullptr);
+    }
+  };
+
+  std::vector<std::future<void>> threads;
+  for (int i = 0; i < helper_count; i++) {
+    threads.push_back(pool->submit(run_jobs));
+  }
+  run_jobs();
+  for (auto& thread : threads) {
+    thread.get();
+  }
+
+  // every job before first_failed has run. Jobs after it may or may not have, so they are ignored.
+  for (size_t i = 0; i < first_failed; i++) {
+    logs[i].flush();
+  }
+  if (first_failed < jobs.size()) {
+    logs[first_failed].flush();
+    std::rethrow_exception(errors[first_failed]);
+  }
+}
+
+/*!
+ * Run the jobs on get_config().threads threads, see run_jobs_in_parallel.
+ */
+void ObjectFileDB::run_in_parallel(const std::vector<std::function<void()>>& jobs) {
+  int thread_count = get_config().threads;
+  if (thread_count <= 0) {
+    thread_count = ThreadPool::hardware_thread_count();
+  }
+  // the calling thread runs jobs too.
+  if (thread_count > 1 && (!m_thread_pool || m_thread_pool->thread_count() != thread_count - 1)) {
+    m_thread_pool = std::make_unique<ThreadPool>(thread_count - 1);
+  }
+  run_jobs_in_parallel(jobs, thread_count > 1 ? m_thread_pool.get() : nullptr);
+}
+
 /*!
  * Main IR2 analysis pass.
  * At this point, we assume that the files are loaded and we've run find_code to locate all
@@ -38,6 +106,10 @@ void ObjectFileDB::analyze_functions_ir2(const std::string& output_dir) {
   ir2_cfg_build_pass();
   lg::info("Writing results...");
   ir2_write_results(output_dir);
+
+  auto cache = dts.ts.get_cache_stats();
+  lg::info("Type system cache: typecheck {} hits, {} misses, lca {} hits, {} misses",
+           cache.typecheck_hits, cache.typecheck_misses, cache.lca_hits, cache.lca_misses);
 }
 
 /*!
@@ -144,20 +216,20 @@ void ObjectFileDB::ir2_top_level_pass() {
 void ObjectFileDB::ir2_basic_block_pass() {
   Timer timer;
   // Main Pass over each function...
-  int total_basic_blocks = 0;
-  int total_functions = 0;
-  int functions_with_one_block = 0;
+  std::atomic<int> total_basic_blocks(0);
+  std::atomic<int> total_functions(0);
+  std::atomic<int> functions_with_one_block(0);
   int inspect_methods = 0;
-  int suspected_asm = 0;
-  int failed_to_build_cfg = 0;
+  std::atomic<int> suspected_asm(0);
+  std::atomic<int> failed_to_build_cfg(0);
 
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     total_functions++;
     func.ir2.env.file = &data.linked_data;
 
     // first, find basic blocks.
     auto blocks = find_blocks_in_function(data.linked_data, segment_id, func);
-    total_basic_blocks += blocks.size();
+    total_basic_blocks += int(blocks.size());
     if (blocks.size() == 1) {
       functions_with_one_block++;
     }
@@ -183,14 +255,6 @@ void ObjectFileDB::ir2_basic_block_pass() {
                  func.guessed_name.to_string(), data.to_unique_name());
         failed_to_build_cfg++;
       }
-
-      // if we got an inspect method, inspect it.
-      if (func.is_inspect_method) {
-        auto result = inspect_inspect_method(func, func.method_of_type, dts, data.linked_data);
-        all_type_defs += ";; " + data.to_unique_name() + "\n";
-        all_type_defs += result.print_as_deftype() + "\n";
-        inspect_methods++;
-      }
     }
 
     if (func.suspected_asm) {
@@ -199,13 +263,25 @@ void ObjectFileDB::ir2_basic_block_pass() {
     }
   });
 
-  lg::info("Found {} basic blocks in {} functions in {:.2f} ms:", total_basic_blocks,
-           total_functions, timer.getMs());
-  lg::info(" {} functions ({:.2f}%) failed to build control flow graph", failed_to_build_cfg,
-           100.f * failed_to_build_cfg / total_functions);
-  lg::info(" {} functions ({:.2f}%) had exactly one basic block", functions_with_one_block,
+  // if we got an inspect method, inspect it. This adds to all_type_defs, so it isn't done in
+  // parallel.
+  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+    (void)segment_id;
+    if (!func.suspected_asm && func.is_inspect_method) {
+      auto result = inspect_inspect_method(func, func.method_of_type, dts, data.linked_data);
+      all_type_defs += ";; " + data.to_unique_name() + "\n";
+      all_type_defs += result.print_as_deftype() + "\n";
+      inspect_methods++;
+    }
+  });
+
+  lg::info("Found {} basic blocks in {} functions in {:.2f} ms:", total_basic_blocks.load(),
+           total_functions.load(), timer.getMs());
+  lg::info(" {} functions ({:.2f}%) failed to build control flow graph",
+           failed_to_build_cfg.load(), 100.f * failed_to_build_cfg / total_functions);
+  lg::info(" {} functions ({:.2f}%) had exactly one basic block", functions_with_one_block.load(),
            100.f * functions_with_one_block / total_functions);
-  lg::info(" {} functions ({:.2f}%) were ignored as assembly", suspected_asm,
+  lg::info(" {} functions ({:.2f}%) were ignored as assembly", suspected_asm.load(),
            100.f * suspected_asm / total_functions);
   lg::info(" {} functions ({:.2f}%) were inspect methods\n", inspect_methods,
            100.f * inspect_methods / total_functions);
@@ -217,10 +293,10 @@ void ObjectFileDB::ir2_basic_block_pass() {
  */
 void ObjectFileDB::ir2_atomic_op_pass() {
   Timer timer;
-  int total_functions = 0;
-  int attempted = 0;
-  int successful = 0;
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  std::atomic<int> total_functions(0);
+  std::atomic<int> attempted(0);
+  std::atomic<int> successful(0);
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     (void)segment_id;
     total_functions++;
     if (!func.suspected_asm) {
@@ -240,7 +316,7 @@ void ObjectFileDB::ir2_atomic_op_pass() {
   });
 
   lg::info("{}/{}/{} (successful/attempted/total) functions converted to Atomic Ops in {:.2f} ms",
-           successful, attempted, total_functions, timer.getMs());
+           successful.load(), attempted.load(), total_functions.load(), timer.getMs());
   lg::info("{:.2f}% were attempted, {:.2f}% of attempted succeeded\n",
            100.f * attempted / total_functions, 100.f * successful / attempted);
 }
@@ -253,12 +329,13 @@ void ObjectFileDB::ir2_atomic_op_pass() {
  */
 void ObjectFileDB::ir2_type_analysis_pass() {
   Timer timer;
-  int total_functions = 0;
-  int non_asm_functions = 0;
-  int attempted_functions = 0;
-  int successful_functions = 0;
+  std::atomic<int> total_functions(0);
+  std::atomic<int> non_asm_functions(0);
+  std::atomic<int> attempted_functions(0);
+  std::atomic<int> successful_functions(0);
+  const std::unordered_map<int, std::vector<TypeHint>> no_hints;
 
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     (void)segment_id;
     total_functions++;
     if (!func.suspected_asm) {
@@ -267,7 +344,10 @@ void ObjectFileDB::ir2_type_analysis_pass() {
       if (lookup_function_type(func.guessed_name, data.to_unique_name(), &ts)) {
         attempted_functions++;
         // try type analysis here.
-        auto hints = get_config().type_hints_by_function_by_idx[func.guessed_name.to_string()];
+        // find, not [], so the config isn't modified.
+        auto& all_hints = get_config().type_hints_by_function_by_idx;
+        auto hints_kv = all_hints.find(func.guessed_name.to_string());
+        auto& hints = hints_kv == all_hints.end() ? no_hints : hints_kv->second;
         if (func.run_type_analysis_ir2(ts, dts, data.linked_data, hints)) {
           successful_functions++;
           func.ir2.has_type_info = true;
@@ -281,15 +361,16 @@ void ObjectFileDB::ir2_type_analysis_pass() {
     }
   });
 
-  lg::info("{}/{}/{}/{} (success/attempted/non-asm/total) in {:.2f} ms\n", successful_functions,
-           attempted_functions, non_asm_functions, total_functions, timer.getMs());
+  lg::info("{}/{}/{}/{} (success/attempted/non-asm/total) in {:.2f} ms\n",
+           successful_functions.load(), attempted_functions.load(), non_asm_functions.load(),
+           total_functions.load(), timer.getMs());
 }
 
 void ObjectFileDB::ir2_register_usage_pass() {
   Timer timer;
 
-  int total_funcs = 0, analyzed_funcs = 0;
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  std::atomic<int> total_funcs(0), analyzed_funcs(0);
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     (void)segment_id;
     (void)data;
     total_funcs++;
@@ -300,15 +381,15 @@ void ObjectFileDB::ir2_register_usage_pass() {
     }
   });
 
-  lg::info("{}/{} functions had register usage analyzed in {:.2f} ms\n", analyzed_funcs,
-           total_funcs, timer.getMs());
+  lg::info("{}/{} functions had register usage analyzed in {:.2f} ms\n", analyzed_funcs.load(),
+           total_funcs.load(), timer.getMs());
 }
 
 void ObjectFileDB::ir2_variable_pass() {
   Timer timer;
-  int attempted = 0;
-  int successful = 0;
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  std::atomic<int> attempted(0);
+  std::atomic<int> successful(0);
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     (void)segment_id;
     (void)data;
     if (!func.suspected_asm && func.ir2.atomic_ops_succeeded && func.ir2.env.has_type_analysis()) {
@@ -324,16 +405,16 @@ void ObjectFileDB::ir2_variable_pass() {
       }
     }
   });
-  lg::info("{}/{} functions out of attempted passed variable pass in {:.2f} ms\n", successful,
-           attempted, timer.getMs());
+  lg::info("{}/{} functions out of attempted passed variable pass in {:.2f} ms\n",
+           successful.load(), attempted.load(), timer.getMs());
 }
 
 void ObjectFileDB::ir2_cfg_build_pass() {
   Timer timer;
-  int total = 0;
-  int attempted = 0;
-  int successful = 0;
-  for_each_function_def_order([&](Function& func, int segment_id, ObjectFileData& data) {
+  std::atomic<int> total(0);
+  std::atomic<int> attempted(0);
+  std::atomic<int> successful(0);
+  for_each_function_def_order_parallel([&](Function& func, int segment_id, ObjectFileData& data) {
     (void)segment_id;
     (void)data;
     total++;
@@ -347,7 +428,8 @@ void ObjectFileDB::ir2_cfg_build_pass() {
     }
   });
 
-  lg::info("{}/{}/{} cfg build in {:.2f} ms\n", successful, attempted, total, timer.getMs());
+  lg::info("{}/{}/{} cfg build in {:.2f} ms\n", successful.load(), attempted.load(), total.load(),
+           timer.getMs());
 }
 
 void ObjectFileDB::ir2_write_results(const std::string& output_dir) {
@@ -408,7 +490,7 @@ std::string ObjectFileDB::ir2_to_file(ObjectFileData& data) {
       auto& word = data.linked_data.words_by_seg[seg][i];
       data.linked_data.append_word_to_string(result, word);
 
-      if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "string") {
+      if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == "string") {
         result += "; " + data.linked_data.get_goal_string(seg, i) + "\n";
       }
     }
@@ -44,6 +44,7 @@ struct Config {
   std::unordered_map<std::string, std::unordered_map<int, std::string>>
       anon_function_types_by_obj_by_id;
   bool run_ir2 = false;
+  int threads = 0;  // for the IR2 passes. 0 uses one per hardware thread.
 };
 
 Config& get_config();
@@ -12,7 +12,7 @@ class LinkedWordReader {
   explicit LinkedWordReader(const std::vector<LinkedWord>* words) : m_words(words) {}
   const std::string& get_type_tag() {
     if (m_words->at(m_offset).kind == LinkedWord::TYPE_PTR) {
-      auto& result = m_words->at(m_offset).symbol_name;
+      auto& result = m_words->at(m_offset).symbol_name();
       m_offset++;
       return result;
     } else {
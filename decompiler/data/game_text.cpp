@@ -20,7 +20,7 @@ T get_word(const LinkedWord& word) {
 
 DecompilerLabel get_label(ObjectFileData& data, const LinkedWord& word) {
   assert(word.kind == LinkedWord::PTR);
-  return data.linked_data.labels.at(word.label_id);
+  return data.linked_data.labels.at(word.label_id());
 }
 
 int align16(int in) {
@@ -54,7 +54,7 @@ GameTextResult process_game_text(ObjectFileData& data) {
 
   // type tage for game-text-info
   if (words.at(offset).kind != LinkedWord::TYPE_PTR ||
-      words.front().symbol_name != "game-text-info") {
+      words.front().symbol_name() != "game-text-info") {
     assert(false);
   }
   read_words.at(offset)++;
@@ -435,16 +435,16 @@ int label_to_word_offset(DecompilerLabel l, bool basic) {
 
 std::string get_type_tag(const LinkedWord& word) {
   assert(word.kind == LinkedWord::TYPE_PTR);
-  return word.symbol_name;
+  return word.symbol_name();
 }
 
 bool is_type_tag(const LinkedWord& word, const std::string& type) {
-  return word.kind == LinkedWord::TYPE_PTR && word.symbol_name == type;
+  return word.kind == LinkedWord::TYPE_PTR && word.symbol_name() == type;
 }
 
 DecompilerLabel get_label(ObjectFileData& data, const LinkedWord& word) {
   assert(word.kind == LinkedWord::PTR);
-  return data.linked_data.labels.at(word.label_id);
+  return data.linked_data.labels.at(word.label_id());
 }
 
 template <typename T>
@@ -597,7 +597,7 @@ TexturePage read_texture_page(ObjectFileData& data,
 
   for (int i = 0; i < tpage.length; i++) {
     if (words.at(offset).kind == LinkedWord::SYM_PTR) {
-      if (words.at(offset).symbol_name == "#f") {
+      if (words.at(offset).symbol_name() == "#f") {
         tpage.data.emplace_back();
         Texture null_tex;
         null_tex.null_texture = true;
@@ -3,6 +3,9 @@
 #include "common/type_system/deftype.h"
 #include "decompiler/Disasm/Register.h"
 #include "common/log/log.h"
+#include "common/util/CacheFile.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Serializer.h"
 #include "TP_Type.h"
 
 namespace decompiler {
@@ -82,7 +85,88 @@ void DecompilerTypeSystem::parse_type_defs(const std::vector<std::string>& file_
   });
 }
 
+namespace {
+constexpr u32 TYPE_DB_MAGIC = 0x42445954;  // "TYDB"
+constexpr u32 TYPE_DB_VERSION = 1;
+}  // namespace
+
+/*!
+ * Like parse_type_defs, but loads the result from a binary type database instead if the file hasn't
+ * changed since the database was saved. Otherwise the file is parsed and the database is saved.
+ */
+void DecompilerTypeSystem::load_type_defs(const std::vector<std::string>& file_path,
+                                          const std::string& db_file_name) {
+  // the database replaces all types and symbols, so it can only be used if we haven't added any
+  // yet. The hash of the types we start with is used as the key.
+  bool can_use_db = symbols.empty() && symbol_types.empty();
+  u64 key = can_use_db ? ts.get_hash() : 0;
+
+  std::vector<u8> data;
+  if (can_use_db && cache_file::load(db_file_name, TYPE_DB_MAGIC, TYPE_DB_VERSION, key, &data)) {
+    Serializer ser(data.data(), data.size());
+    serialize(ser);
+    if (!ser.reached_end()) {
+      throw std::runtime_error("Type database was not fully loaded");
+    }
+    return;
+  }
+
+  parse_type_defs(file_path);
+  if (can_use_db) {
+    try {
+      Serializer ser;
+      serialize(ser);
+      cache_file::save(db_file_name, TYPE_DB_MAGIC, TYPE_DB_VERSION, key,
+                       {file_util::get_file_path(file_path)}, ser.get_save_result());
+    } catch (std::exception& e) {
+      lg::warn("Failed to save type database {}: {}", db_file_name, e.what());
+    }
+  }
+}
+
+/*!
+ * Save or load the types and symbols. Loading replaces all of them.
+ */
+void DecompilerTypeSystem::serialize(Serializer& ser) {
+  ts.serialize(ser);
+
+  auto symbol_count = ser.save_or_load<u32>(symbol_add_order.size());
+  if (ser.is_loading()) {
+    symbols.clear();
+    symbol_types.clear();
+    symbol_add_order.resize(symbol_count);
+  }
+
+  for (auto& name : symbol_add_order) {
+    ser.from_str(&name);
+    TypeSpec type;
+    bool has_type = false;
+    if (ser.is_saving()) {
+      auto kv = symbol_types.find(name);
+      if (kv != symbol_types.end()) {
+        has_type = true;
+        type = kv->second;
+      }
+    }
+    ser.from_pod(&has_type);
+    if (has_type) {
+      type.serialize(ser);
+    }
+
+    if (ser.is_loading()) {
+      symbols.insert(name);
+      if (has_type) {
+        symbol_types[name] = type;
+      }
+    }
+  }
+}
+
+/*!
+ * Parse a type from a string. Can be used from several threads.
+ */
 TypeSpec DecompilerTypeSystem::parse_type_spec(const std::string& str) {
+  std::lock_guard<std::mutex> lock(m_reader_mutex);
   auto read = m_reader.read_from_string(str);
   auto data = cdr(read);
   return parse_typespec(&ts, car(data));
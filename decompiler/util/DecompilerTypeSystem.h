@@ -1,13 +1,13 @@
 #ifndef JAK_DECOMPILERTYPESYSTEM_H
 #define JAK_DECOMPILERTYPESYSTEM_H
 
+#include <mutex>
 #include "common/type_system/TypeSystem.h"
 #include "decompiler/Disasm/Register.h"
+#include "decompiler/util/TP_Type.h"
 #include "common/goos/Reader.h"
 
 namespace decompiler {
-class TP_Type;
-struct TypeState;
 
 class DecompilerTypeSystem {
  public:
@@ -32,6 +32,8 @@ class DecompilerTypeSystem {
 
   void add_symbol(const std::string& name, const TypeSpec& type_spec);
   void parse_type_defs(const std::vector<std::string>& file_path);
+  void load_type_defs(const std::vector<std::string>& file_path, const std::string& db_file_name);
+  void serialize(Serializer& ser);
   TypeSpec parse_type_spec(const std::string& str);
   void add_type_flags(const std::string& name, u64 flags);
   void add_type_parent(const std::string& child, const std::string& parent);
@@ -42,18 +44,12 @@ class DecompilerTypeSystem {
   bool tp_lca(TypeState* combined, const TypeState& add);
   int get_format_arg_count(const std::string& str) const;
   int get_format_arg_count(const TP_Type& type) const;
-  struct {
-    bool locked = false;
-    bool allow_pair;
-    std::string current_method_type;
-    void reset() {
-      allow_pair = false;
-      current_method_type.clear();
-    }
-  } type_prop_settings;
+  // used by the old IR type analysis, and by tests. IR2 copies these to the function's Env.
+  TypePropSettings type_prop_settings;
 
  private:
   goos::Reader m_reader;
+  std::mutex m_reader_mutex;
 };
 }  // namespace decompiler
 
@@ -197,5 +197,19 @@ struct TypeState {
   }
 };
 
+/*!
+ * Settings for type propagation in a single function. In config we can manually specify some
+ * settings to reduce the strictness of type propagation.
+ */
+struct TypePropSettings {
+  bool locked = false;  // if set, don't replace these settings with the ones from config.
+  bool allow_pair = false;
+  std::string current_method_type;
+  void reset() {
+    allow_pair = false;
+    current_method_type.clear();
+  }
+};
+
 u32 regs_to_gpr_mask(const std::vector<Register>& regs);
 }  // namespace decompiler
\ No newline at end of file
@@ -135,6 +135,12 @@
   `(seval (defgmacro ,name ,args ,@body))
   )
 
+;; goal macro to define a goal macro that has no side effects, and always expands the same
+;; arguments to the same code. With the cache-macro-expansions setting, expansions are reused.
+(defgmacro defmacro-pure (name args &rest body)
+  `(seval (set-macro-pure! (defgmacro ,name ,args ,@body)))
+  )
+
 ;; goal macro to define a goos macro
 (defgmacro defsmacro (name args &rest body)
   `(seval (defsmacro ,name ,args ,@body))
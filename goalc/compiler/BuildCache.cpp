@@ -0,0 +1,96 @@
+/*!
+ * @file BuildCache.cpp
+ * On-disk cache of object files generated by asm-file.
+ */
+
+#include <cassert>
+#include "BuildCache.h"
+#include "common/util/CacheFile.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Hash.h"
+#include "third-party/fmt/core.h"
+
+namespace {
+constexpr u32 CACHE_MAGIC = 0x43424f47;  // "GOBC"
+constexpr u32 CACHE_VERSION = 5;
+}  // namespace
+
+void BuildDependencies::add_expansion(const std::string& text) {
+  expansion_hash = hash_util::string(text, expansion_hash);
+}
+
+void BuildDependencies::merge(const BuildDependencies& other) {
+  types.insert(other.types.begin(), other.types.end());
+  symbols.insert(other.symbols.begin(), other.symbols.end());
+  constants.insert(other.constants.begin(), other.constants.end());
+  enums.insert(other.enums.begin(), other.enums.end());
+  inline_functions.insert(other.inline_functions.begin(), other.inline_functions.end());
+  expansion_hash = hash_util::combine(expansion_hash, other.expansion_hash);
+}
+
+BuildCache::BuildCache() = default;
+
+std::string BuildCache::cache_file_name(const std::string& obj_name) const {
+  return file_util::get_file_path({"out", "cache", obj_name + ".oc"});
+}
+
+/*!
+ * Get the cached object file for obj_name, if it was stored with the same key. A file that was
+ * only partially written is a miss. Updates the hit/miss statistics.
+ */
+bool BuildCache::lookup(const std::string& obj_name, u64 key, std::vector<u8>* data) {
+  if (cache_file::load(cache_file_name(obj_name), CACHE_MAGIC, CACHE_VERSION, key, data)) {
+    m_hits++;
+    return true;
+  }
+
+  m_misses.push_back(obj_name);
+  return false;
+}
+
+/*!
+ * Store an object file in the cache, replacing the previous version. Only touches the cache file
+ * for this object, so it's safe to call from a build worker. Failing to store is only a warning.
+ */
+void BuildCache::store(const std::string& obj_name, u64 key, const std::vector<u8>& data) const {
+  try {
+    cache_file::save(cache_file_name(obj_name), CACHE_MAGIC, CACHE_VERSION, key, {}, data);
+  } catch (std::exception& e) {
+    fmt::print("[Build Cache] Failed to store {}: {}\n", obj_name, e.what());
+  }
+}
+
+void BuildCache::print_report() const {
+  int total = m_hits + int(m_misses.size());
+  if (total == 0) {
+    return;
+  }
+  fmt::print("[Build Cache] {} files, {} hits, {} misses ({:.1f}% hit rate)\n", total, m_hits,
+             m_misses.size(), 100.f * m_hits / total);
+  for (auto& name : m_misses) {
+    fmt::print("  compiled: {}\n", name);
+  }
+}
+
+void BuildCache::reset_stats() {
+  m_hits = 0;
+  m_misses.clear();
+}
+
+void BuildCache::begin_file() {
+  m_deps.emplace_back();
+}
+
+/*!
+ * Finish tracking a file and get its dependencies. If this file was compiled from inside another
+ * file, the dependencies are also added to the outer file.
+ */
+BuildDependencies BuildCache::end_file() {
+  assert(!m_deps.empty());
+  auto result = std::move(m_deps.back());
+  m_deps.pop_back();
+  if (!m_deps.empty()) {
+    m_deps.back().merge(result);
+  }
+  return result;
+}
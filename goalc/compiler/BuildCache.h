@@ -0,0 +1,75 @@
+#pragma once
+
+/*!
+ * @file BuildCache.h
+ * On-disk cache of object files generated by asm-file.
+ *
+ * While a file is compiled, the compiler records every type, global symbol, constant, enum and
+ * inline function the file reads, and hashes every macro expansion. The cache key of the object is
+ * the hash of the source plus the current definitions of all of these. If the key matches the
+ * cached object, register allocation and code generation can be skipped.
+ *
+ * The front end always runs, because later files need the types, symbols and macros defined
+ * by this one.
+ */
+
+#ifndef JAK_BUILDCACHE_H
+#define JAK_BUILDCACHE_H
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "common/common_types.h"
+
+/*!
+ * Everything a single file read from the compiler's global state during compilation.
+ */
+struct BuildDependencies {
+  std::unordered_set<std::string> types;
+  std::unordered_set<std::string> symbols;
+  std::unordered_set<std::string> constants;
+  std::unordered_set<std::string> enums;
+  std::unordered_set<std::string> inline_functions;
+  u64 expansion_hash = 0;  // hash of all macro expansions and #cond choices, in order.
+
+  void add_expansion(const std::string& text);
+  void merge(const BuildDependencies& other);
+};
+
+class BuildCache {
+ public:
+  BuildCache();
+  bool lookup(const std::string& obj_name, u64 key, std::vector<u8>* data);
+  void store(const std::string& obj_name, u64 key, const std::vector<u8>& data) const;
+  void print_report() const;
+  void reset_stats();
+  int hit_count() const { return m_hits; }
+  int miss_count() const { return int(m_misses.size()); }
+
+  // dependency tracking. Files can be nested (asm-file inside of an asm-file), so this is a stack.
+  void begin_file();
+  BuildDependencies end_file();
+  BuildDependencies* deps() { return m_deps.empty() ? nullptr : &m_deps.back(); }
+
+  // record that the file being compiled read something. Does nothing if no file is tracked.
+  void note_symbol(const std::string& name) { note(&BuildDependencies::symbols, name); }
+  void note_constant(const std::string& name) { note(&BuildDependencies::constants, name); }
+  void note_enum(const std::string& name) { note(&BuildDependencies::enums, name); }
+  void note_inline_function(const std::string& name) {
+    note(&BuildDependencies::inline_functions, name);
+  }
+
+ private:
+  std::string cache_file_name(const std::string& obj_name) const;
+  void note(std::unordered_set<std::string> BuildDependencies::*set, const std::string& name) {
+    if (!m_deps.empty()) {
+      (m_deps.back().*set).insert(name);
+    }
+  }
+
+  std::vector<BuildDependencies> m_deps;
+  int m_hits = 0;
+  std::vector<std::string> m_misses;
+};
+
+#endif  // JAK_BUILDCACHE_H
@@ -11,16 +11,23 @@
 #include "CodeGenerator.h"
 #include "goalc/emitter/IGen.h"
 #include "IR.h"
+#include "common/util/Profiler.h"
 
 using namespace emitter;
 
-CodeGenerator::CodeGenerator(FileEnv* env, DebugInfo* debug_info)
-    : m_fe(env), m_debug_info(debug_info) {}
+CodeGenerator::CodeGenerator(FileEnv* env,
+                             DebugInfo* debug_info,
+                             const emitter::ObjectGeneratorSettings& settings)
+    : m_gen(settings), m_fe(env), m_debug_info(debug_info) {}
 
 /*!
  * Generate an object file.
  */
 std::vector<u8> CodeGenerator::run() {
+  prof::Zone zone("codegen");
+  zone.set_detail(m_fe->name());
+  zone.counter("functions", m_fe->functions().size());
+  zone.counter("statics", m_fe->statics().size());
   std::unordered_set<std::string> function_names;
 
   // first, add each function to the ObjectGenerator (but don't add any data)
@@ -46,7 +53,9 @@ std::vector<u8> CodeGenerator::run() {
   }
 
   // generate a v3 object. TODO - support for v4 "data" objects.
-  return m_gen.generate_data_v3().to_vector();
+  auto result = m_gen.generate_data_v3().to_vector();
+  zone.counter("bytes", result.size());
+  return result;
 }
 
 void CodeGenerator::do_function(FunctionEnv* env, int f_idx) {
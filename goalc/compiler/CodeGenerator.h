@@ -17,7 +17,9 @@ class DebugInfo;
 
 class CodeGenerator {
  public:
-  CodeGenerator(FileEnv* env, DebugInfo* debug_info);
+  CodeGenerator(FileEnv* env,
+                DebugInfo* debug_info,
+                const emitter::ObjectGeneratorSettings& settings = {});
   std::vector<u8> run();
 
  private:
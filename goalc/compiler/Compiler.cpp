@@ -4,20 +4,49 @@
 #include "goalc/regalloc/allocate.h"
 #include "third-party/fmt/core.h"
 #include "CompilerException.h"
+#include "common/util/Profiler.h"
+#include "common/util/Timer.h"
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
 using namespace goos;
 
-Compiler::Compiler() : m_debugger(&m_listener) {
+namespace {
+emitter::ObjectGeneratorSettings object_generator_settings(const CompilerSettings& settings) {
+  emitter::ObjectGeneratorSettings result;
+  result.peephole = !settings.disable_peephole;
+  result.relax_jumps = !settings.disable_branch_relaxation;
+  return result;
+}
+}  // namespace
+
+/*!
+ * Create a compiler and compile goal-lib.gc. If use_snapshot is set, the state after compiling
+ * goal-lib.gc is loaded from a snapshot instead if possible, and a new snapshot is saved if not.
+ */
+Compiler::Compiler(bool use_snapshot) : m_debugger(&m_listener) {
   m_listener.add_debugger(&m_debugger);
   m_ts.add_builtin_types();
   m_global_env = std::make_unique<GlobalEnv>();
   m_none = std::make_unique<None>(m_ts.make_typespec("none"));
 
+  u64 builtin_hash = 0;
+  if (use_snapshot) {
+    builtin_hash = builtin_types_hash();
+    if (load_snapshot(builtin_hash)) {
+      m_loaded_snapshot = true;
+      return;
+    }
+  }
+
   // todo - compile library
   Object library_code = m_goos.reader.read_from_file({"goal_src", "goal-lib.gc"});
   compile_object_file("goal-lib", library_code, false);
+
+  if (use_snapshot) {
+    save_snapshot(builtin_hash);
+  }
 }
 
 void Compiler::execute_repl() {
@@ -150,7 +179,11 @@ Val* Compiler::compile_error_guard(const goos::Object& code, Env* env) {
 }
 
 void Compiler::color_object_file(FileEnv* env) {
+  prof::Zone color_zone("color");
+  color_zone.counter("functions", env->functions().size());
   for (auto& f : env->functions()) {
+    prof::Zone function_zone("regalloc");
+    function_zone.set_detail(f->name());
     AllocationInput input;
     input.is_asm_function = f->is_asm_func;
     for (auto& i : f->code()) {
@@ -161,6 +194,7 @@ void Compiler::color_object_file(FileEnv* env) {
     input.max_vars = f->max_vars();
     input.constraints = f->constraints();
     input.stack_slots_for_stack_vars = f->stack_slots_used_for_stack_vars();
+    input.coalesce_moves = !m_settings.disable_move_coalescing;
 
     if (m_settings.debug_print_regalloc) {
       input.debug_settings.print_input = true;
@@ -169,15 +203,55 @@ void Compiler::color_object_file(FileEnv* env) {
       input.debug_settings.allocate_log_level = 2;
     }
 
-    f->set_allocations(allocate_registers(input));
+    Timer regalloc_timer;
+    auto allocations = allocate_registers(input);
+    if (m_settings.regalloc_benchmark) {
+      double live_set_ms = regalloc_timer.getMs();
+      input.reference_conflict_check = true;
+      Timer reference_timer;
+      auto reference = allocate_registers(input);
+      double reference_ms = reference_timer.getMs();
+      bool match = same_allocation(allocations, reference);
+
+      std::unique_lock<std::mutex> lock(m_regalloc_benchmark.mutex);
+      m_regalloc_benchmark.functions++;
+      m_regalloc_benchmark.instructions += input.instructions.size();
+      m_regalloc_benchmark.live_set_ms += live_set_ms;
+      m_regalloc_benchmark.reference_ms += reference_ms;
+      if (!match) {
+        m_regalloc_benchmark.mismatches++;
+        print_compiler_warning("Register allocation of {} doesn't match the reference.\n",
+                               f->name());
+      }
+    }
+
+    if (function_zone.active()) {
+      s64 spill_ops = 0;
+      for (auto& op : allocations.stack_ops) {
+        spill_ops += op.ops.size();
+      }
+      function_zone.counter("ir", input.instructions.size());
+      function_zone.counter("spill-slots", allocations.stack_slots_for_spills);
+      function_zone.counter("spill-ops", spill_ops);
+      function_zone.counter("moves", allocations.moves);
+      function_zone.counter("moves-eliminated", allocations.moves_eliminated);
+    }
+    f->set_allocations(allocations);
   }
 }
 
 std::vector<u8> Compiler::codegen_object_file(FileEnv* env) {
+  return codegen_object_file(env, &m_debugger.get_debug_info_for_object(env->name()));
+}
+
+/*!
+ * Generate an object file, recording debug info into the given DebugInfo.
+ * This doesn't touch the debugger, so it is safe to run on a build worker thread.
+ */
+std::vector<u8> Compiler::codegen_object_file(FileEnv* env, DebugInfo* debug_info) {
   try {
-    auto debug_info = &m_debugger.get_debug_info_for_object(env->name());
     debug_info->clear();
-    CodeGenerator gen(env, debug_info);
+    CodeGenerator gen(env, debug_info, object_generator_settings(m_settings));
     bool ok = true;
     auto result = gen.run();
     for (auto& f : env->functions()) {
@@ -197,7 +271,7 @@ bool Compiler::codegen_and_disassemble_object_file(FileEnv* env,
                                                    std::string* asm_out) {
   auto debug_info = &m_debugger.get_debug_info_for_object(env->name());
   debug_info->clear();
-  CodeGenerator gen(env, debug_info);
+  CodeGenerator gen(env, debug_info, object_generator_settings(m_settings));
   *data_out = gen.run();
   bool ok = true;
   *asm_out = debug_info->disassemble_all_functions(&ok);
@@ -4,14 +4,19 @@
 #define JAK_COMPILER_H
 
 #include <functional>
+#include <future>
+#include <mutex>
 #include <optional>
 #include "common/type_system/TypeSystem.h"
+#include "common/util/ThreadPool.h"
 #include "Env.h"
 #include "goalc/listener/Listener.h"
 #include "common/goos/Interpreter.h"
 #include "goalc/compiler/IR.h"
 #include "goalc/debugger/Debugger.h"
 #include "CompilerSettings.h"
+#include "BuildCache.h"
+#include "MacroExpansionCache.h"
 #include "third-party/fmt/core.h"
 #include "third-party/fmt/color.h"
 #include "CompilerException.h"
@@ -21,7 +26,7 @@ enum MathMode { MATH_INT, MATH_BINT, MATH_FLOAT, MATH_INVALID };
 
 class Compiler {
  public:
-  Compiler();
+  explicit Compiler(bool use_snapshot = false);
   void execute_repl();
   goos::Interpreter& get_goos() { return m_goos; }
   FileEnv* compile_object_file(const std::string& name, goos::Object code, bool allow_emit);
@@ -43,6 +48,17 @@ class Compiler {
   listener::Listener& listener() { return m_listener; }
   void poke_target() { m_listener.send_poke(); }
   bool connect_to_target();
+  bool loaded_snapshot() const { return m_loaded_snapshot; }
+  const BuildCache& get_build_cache() const { return m_build_cache; }
+  const MacroExpansionCache& get_macro_cache() const { return m_macro_cache; }
+  const std::unordered_map<std::string, TypeSpec>& get_symbol_types() const {
+    return m_symbol_types;
+  }
+  const std::unordered_map<std::string, GoalEnum>& get_enums() const { return m_enums; }
+  const std::unordered_map<std::shared_ptr<goos::SymbolObject>, goos::Object>&
+  get_global_constants() const {
+    return m_global_constants;
+  }
 
  private:
   bool get_true_or_false(const goos::Object& form, const goos::Object& boolean);
@@ -54,6 +70,7 @@ class Compiler {
                           const goos::Object& rest,
                           Env* env);
   Val* compile_pair(const goos::Object& code, Env* env);
+  Val* compile_sequence(const goos::Object& forms, Env* env, bool profile_forms);
   Val* compile_integer(const goos::Object& code, Env* env);
   Val* compile_integer(s64 value, Env* env);
   Val* compile_char(const goos::Object& code, Env* env);
@@ -78,6 +95,9 @@ class Compiler {
   SymbolVal* compile_get_sym_obj(const std::string& name, Env* env);
   void color_object_file(FileEnv* env);
   std::vector<u8> codegen_object_file(FileEnv* env);
+  std::vector<u8> codegen_object_file(FileEnv* env, DebugInfo* debug_info);
+  void wait_for_build_jobs();
+  u64 build_cache_key(const std::string& filename, const BuildDependencies& deps);
   bool codegen_and_disassemble_object_file(FileEnv* env,
                                            std::vector<u8>* data_out,
                                            std::string* asm_out);
@@ -117,6 +137,8 @@ class Compiler {
 
   TypeSpec parse_typespec(const goos::Object& src);
   bool is_local_symbol(const goos::Object& obj, Env* env);
+  bool is_auto_inline_candidate(const LambdaVal* lambda);
+  bool can_auto_inline(const LambdaVal* lambda, Env* env);
   emitter::HWRegKind get_preferred_reg_kind(const TypeSpec& ts);
   Val* compile_real_function_call(const goos::Object& form,
                                   RegVal* function,
@@ -153,6 +175,40 @@ class Compiler {
   std::unordered_map<std::shared_ptr<goos::SymbolObject>, LambdaVal*> m_inlineable_functions;
   CompilerSettings m_settings;
   bool m_throw_on_define_extern_redefinition = false;
+
+  // register allocation and codegen of files compiled inside of a with-build-jobs
+  struct PendingBuildJob {
+    std::string obj_file_name;
+    std::vector<std::pair<std::string, float>> timing;
+    float front_end_ms = 0;
+    std::future<std::vector<std::pair<std::string, float>>> back_end_timing;
+  };
+  std::unique_ptr<ThreadPool> m_build_pool;
+  std::vector<PendingBuildJob> m_pending_build_jobs;
+  // files of the asm-files in a with-build-jobs, read ahead of time on the workers. By file name.
+  std::unordered_map<std::string, std::future<goos::LocalRead>> m_read_ahead_files;
+  BuildCache m_build_cache;
+  MacroExpansionCache m_macro_cache;
+
+  // with the regalloc-benchmark setting, each function is also allocated with the reference
+  // conflict check, to compare the time and result.
+  struct RegAllocBenchmark {
+    std::mutex mutex;
+    int functions = 0;
+    int instructions = 0;
+    int mismatches = 0;
+    double reference_ms = 0;
+    double live_set_ms = 0;
+  };
+  RegAllocBenchmark m_regalloc_benchmark;
+
+  // snapshot of the state after compiling goal-lib.gc, for faster startup.
+  bool m_loaded_snapshot = false;
+  u64 builtin_types_hash();
+  void serialize_state(Serializer& ser);
+  bool load_snapshot(u64 builtin_hash);
+  void save_snapshot(u64 builtin_hash);
+
   MathMode get_math_mode(const TypeSpec& ts);
   bool is_number(const TypeSpec& ts);
   bool is_float(const TypeSpec& ts);
@@ -163,6 +219,13 @@ class Compiler {
   Val* number_to_float(const goos::Object& form, Val* in, Env* env);
   Val* number_to_binteger(const goos::Object& form, Val* in, Env* env);
   Val* to_math_type(const goos::Object& form, Val* in, MathMode mode, Env* env);
+  Val* compile_integer_constant(s64 value, const TypeSpec& ts, Env* env);
+  Val* compile_float_constant(float value, Env* env);
+  Val* compile_float_math(const goos::Object& form,
+                          const goos::Arguments& args,
+                          Val* first_val,
+                          FloatMathKind kind,
+                          Env* env);
   bool is_none(Val* in);
   emitter::Register parse_register(const goos::Object& code);
   u64 enum_lookup(const goos::Object& form,
@@ -316,6 +379,15 @@ class Compiler {
   Val* compile_set_config(const goos::Object& form, const goos::Object& rest, Env* env);
   Val* compile_in_package(const goos::Object& form, const goos::Object& rest, Env* env);
   Val* compile_build_dgo(const goos::Object& form, const goos::Object& rest, Env* env);
+  Val* compile_with_build_jobs(const goos::Object& form, const goos::Object& rest, Env* env);
+  Val* compile_build_cache_report(const goos::Object& form, const goos::Object& rest, Env* env);
+  Val* compile_regalloc_benchmark_report(const goos::Object& form,
+                                         const goos::Object& rest,
+                                         Env* env);
+  Val* compile_with_profiler(const goos::Object& form, const goos::Object& rest, Env* env);
+  Val* compile_macro_expansion_cache_report(const goos::Object& form,
+                                            const goos::Object& rest,
+                                            Env* env);
 
   // ControlFlow
   Condition compile_condition(const goos::Object& condition, Env* env, bool invert);
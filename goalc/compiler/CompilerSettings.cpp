@@ -10,7 +10,14 @@ CompilerSettings::CompilerSettings() {
   m_settings["disable-math-const-prop"].kind = SettingKind::BOOL;
   m_settings["disable-math-const-prop"].boolp = &disable_math_const_prop;
 
+  link(disable_move_coalescing, "disable-move-coalescing");
+  link(disable_branch_relaxation, "disable-branch-relaxation");
+  link(disable_peephole, "disable-peephole");
+  link(auto_inline, "auto-inline");
   link(print_timing, "print-timing");
+  link(use_build_cache, "build-cache");
+  link(regalloc_benchmark, "regalloc-benchmark");
+  link(cache_macro_expansions, "cache-macro-expansions");
 }
 
 void CompilerSettings::set(const std::string& name, const goos::Object& value) {
@@ -13,8 +13,15 @@ class CompilerSettings {
   bool debug_print_ir = false;
   bool debug_print_regalloc = false;
   bool disable_math_const_prop = false;
+  bool disable_move_coalescing = false;
+  bool disable_branch_relaxation = false;
+  bool disable_peephole = false;
+  bool auto_inline = false;
   bool emit_move_after_return = true;
   bool print_timing = false;
+  bool use_build_cache = false;
+  bool regalloc_benchmark = false;
+  bool cache_macro_expansions = false;
 
   void set(const std::string& name, const goos::Object& value);
 
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <memory>
+#include <unordered_set>
 #include <vector>
 #include "common/type_system/TypeSpec.h"
 #include "goalc/regalloc/allocate.h"
@@ -205,6 +206,8 @@ class FunctionEnv : public DeclareEnv {
   std::vector<UnresolvedGoto> unresolved_gotos;
   std::vector<UnresolvedConditionalGoto> unresolved_cond_gotos;
   std::unordered_map<std::string, RegVal*> params;
+  bool auto_inline = false;  // small enough to inline without being asked to (auto-inline setting)
+  std::unordered_set<std::string> global_symbols;  // symbols used which weren't local variables
 
  protected:
   void resolve_gotos();
@@ -0,0 +1,265 @@
+/*!
+ * @file MacroExpansionCache.cpp
+ * Cache of GOAL macro expansions.
+ */
+
+#include <cstring>
+#include "MacroExpansionCache.h"
+#include "common/util/Hash.h"
+#include "third-party/fmt/core.h"
+
+namespace {
+// arguments larger than this are rarely repeated, so aren't worth hashing and storing.
+constexpr int MAX_ARG_NODES = 256;
+
+using ArgMap = std::unordered_map<const goos::HeapObject*, goos::Object>;
+
+/*!
+ * Hash the arguments to a macro. Returns false if they have more than MAX_ARG_NODES objects.
+ */
+bool hash_args(const goos::Object& obj, u64* hash, int* nodes) {
+  if (++(*nodes) > MAX_ARG_NODES) {
+    return false;
+  }
+  *hash = hash_util::combine(*hash, (u64)obj.type);
+  switch (obj.type) {
+    case goos::ObjectType::INTEGER:
+      *hash = hash_util::combine(*hash, obj.integer_obj.value);
+      return true;
+    case goos::ObjectType::FLOAT:
+      *hash = hash_util::bytes(&obj.float_obj.value, sizeof(double), *hash);
+      return true;
+    case goos::ObjectType::CHAR:
+      *hash = hash_util::combine(*hash, obj.char_obj.value);
+      return true;
+    case goos::ObjectType::STRING:
+      *hash = hash_util::string(obj.as_string()->data, *hash);
+      return true;
+    case goos::ObjectType::EMPTY_LIST:
+      return true;
+    case goos::ObjectType::PAIR: {
+      auto pair = obj.as_pair();
+      return hash_args(pair->car, hash, nodes) && hash_args(pair->cdr, hash, nodes);
+    }
+    case goos::ObjectType::ARRAY:
+      for (auto& elt : obj.as_array()->data) {
+        if (!hash_args(elt, hash, nodes)) {
+          return false;
+        }
+      }
+      return true;
+    default:
+      // symbols are interned, other objects are compared by identity.
+      *hash = hash_util::combine(*hash, (u64)obj.heap_obj.get());
+      return true;
+  }
+}
+
+/*!
+ * Are these arguments the same? Unlike Object::operator==, floats must have the same bits, so 0.0
+ * and -0.0 are different.
+ */
+bool same_args(const goos::Object& a, const goos::Object& b) {
+  if (a.type != b.type) {
+    return false;
+  }
+  switch (a.type) {
+    case goos::ObjectType::INTEGER:
+      return a.integer_obj.value == b.integer_obj.value;
+    case goos::ObjectType::FLOAT:
+      return memcmp(&a.float_obj.value, &b.float_obj.value, sizeof(double)) == 0;
+    case goos::ObjectType::CHAR:
+      return a.char_obj.value == b.char_obj.value;
+    case goos::ObjectType::STRING:
+      return a.as_string()->data == b.as_string()->data;
+    case goos::ObjectType::EMPTY_LIST:
+      return true;
+    case goos::ObjectType::PAIR: {
+      auto pa = a.as_pair();
+      auto pb = b.as_pair();
+      return same_args(pa->car, pb->car) && same_args(pa->cdr, pb->cdr);
+    }
+    case goos::ObjectType::ARRAY: {
+      auto& da = a.as_array()->data;
+      auto& db = b.as_array()->data;
+      if (da.size() != db.size()) {
+        return false;
+      }
+      for (size_t i = 0; i < da.size(); i++) {
+        if (!same_args(da[i], db[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return a.heap_obj == b.heap_obj;
+  }
+}
+
+/*!
+ * Map each list, string and array in the cached arguments to the same one in the new arguments.
+ */
+void map_args(const goos::Object& cached, const goos::Object& current, ArgMap* map) {
+  switch (cached.type) {
+    case goos::ObjectType::STRING:
+      map->emplace(cached.heap_obj.get(), current);
+      break;
+    case goos::ObjectType::PAIR:
+      map->emplace(cached.heap_obj.get(), current);
+      map_args(cached.as_pair()->car, current.as_pair()->car, map);
+      map_args(cached.as_pair()->cdr, current.as_pair()->cdr, map);
+      break;
+    case goos::ObjectType::ARRAY: {
+      map->emplace(cached.heap_obj.get(), current);
+      auto& cached_data = cached.as_array()->data;
+      auto& current_data = current.as_array()->data;
+      for (size_t i = 0; i < cached_data.size(); i++) {
+        map_args(cached_data[i], current_data[i], map);
+      }
+    } break;
+    default:
+      break;
+  }
+}
+
+/*!
+ * Copy a cached expansion, replacing the parts that came from the cached arguments with the same
+ * parts of the new arguments. The compiler uses these to find the source code of errors. The
+ * parts of the expansion that don't contain any arguments are shared with the cached expansion.
+ */
+goos::Object copy_expansion(const goos::Object& obj, const ArgMap& args) {
+  if (!obj.heap_obj) {
+    return obj;
+  }
+  auto arg = args.find(obj.heap_obj.get());
+  if (arg != args.end()) {
+    return arg->second;
+  }
+
+  if (obj.is_pair()) {
+    // expansions can have long lists, so only recurse on the car.
+    std::vector<goos::Object> elts;
+    bool changed = false;
+    goos::Object current = obj;
+    while (current.is_pair() && args.find(current.heap_obj.get()) == args.end()) {
+      auto& car = current.as_pair()->car;
+      elts.push_back(copy_expansion(car, args));
+      changed = changed || elts.back().heap_obj != car.heap_obj;
+      current = current.as_pair()->cdr;
+    }
+    auto result = copy_expansion(current, args);
+    if (!changed && result.heap_obj == current.heap_obj) {
+      return obj;
+    }
+    for (auto it = elts.rbegin(); it != elts.rend(); ++it) {
+      result = goos::PairObject::make_new(*it, result);
+    }
+    return result;
+  }
+
+  if (obj.is_array()) {
+    auto& data = obj.as_array()->data;
+    std::vector<goos::Object> elts;
+    bool changed = false;
+    for (auto& elt : data) {
+      elts.push_back(copy_expansion(elt, args));
+      changed = changed || elts.back().heap_obj != elt.heap_obj;
+    }
+    return changed ? goos::ArrayObject::make_new(std::move(elts)) : obj;
+  }
+
+  return obj;
+}
+}  // namespace
+
+/*!
+ * Expand a use of a macro, or get the expansion from the cache. The head is the name used to find
+ * the macro, rest is the arguments, and expand_macro should run the macro.
+ */
+goos::Object MacroExpansionCache::expand(goos::Interpreter& goos,
+                                         const goos::Object& head,
+                                         const goos::Object& macro_obj,
+                                         const goos::Object& rest,
+                                         const std::function<goos::Object()>& expand_macro) {
+  auto& entry = m_macros[head.heap_obj.get()];
+  if (!entry_is_current(goos, entry, macro_obj)) {
+    if (!entry.expansions.empty()) {
+      m_invalidations++;
+    }
+    entry.macro = macro_obj;
+    entry.used_macros.clear();
+    entry.expansions.clear();
+    entry.pure = goos.macro_is_pure(*macro_obj.as_macro(), &entry.used_macros);
+  }
+
+  if (!entry.pure) {
+    m_impure++;
+    return expand_macro();
+  }
+
+  u64 hash = hash_util::FNV_OFFSET;
+  int nodes = 0;
+  if (!hash_args(rest, &hash, &nodes)) {
+    m_too_large++;
+    return expand_macro();
+  }
+
+  auto range = entry.expansions.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (same_args(it->second.args, rest)) {
+      m_hits++;
+      ArgMap args;
+      map_args(it->second.args, rest, &args);
+      return copy_expansion(it->second.result, args);
+    }
+  }
+
+  // if this throws, nothing is cached.
+  auto result = expand_macro();
+  m_misses++;
+  entry.expansions.emplace(hash, Expansion{rest, result});
+  return result;
+}
+
+/*!
+ * Can the expansions in this entry be used for this macro? Not if the macro, or any macro used to
+ * decide if it is pure, has been redefined.
+ */
+bool MacroExpansionCache::entry_is_current(goos::Interpreter& goos,
+                                           const MacroEntry& entry,
+                                           const goos::Object& macro_obj) const {
+  if (entry.macro.heap_obj != macro_obj.heap_obj) {
+    return false;
+  }
+  if (!entry.pure && macro_obj.as_macro()->pure) {
+    return false;  // marked pure after it was checked.
+  }
+  auto global_env = goos.global_environment.as_env();
+  for (auto& used : entry.used_macros) {
+    auto value = global_env->find_var(used.first.as_symbol());
+    if (!value || value->heap_obj != used.second.heap_obj) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MacroExpansionCache::print_report() const {
+  int total = m_hits + m_misses + m_impure + m_too_large;
+  if (total == 0) {
+    return;
+  }
+  fmt::print(
+      "[Macro Cache] {} expansions, {} hits, {} misses ({:.1f}% hit rate), {} not pure, {} too "
+      "large, {} invalidations\n",
+      total, m_hits, m_misses, 100.f * m_hits / total, m_impure, m_too_large, m_invalidations);
+}
+
+void MacroExpansionCache::reset_stats() {
+  m_hits = 0;
+  m_misses = 0;
+  m_impure = 0;
+  m_too_large = 0;
+  m_invalidations = 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/*!
+ * @file MacroExpansionCache.h
+ * Cache of GOAL macro expansions.
+ *
+ * Many macros are used over and over with the same arguments. If a macro is pure (it has no side
+ * effects, and the expansion only depends on the arguments), the expansion can be reused instead of
+ * running the GOOS interpreter again. A macro is pure if it was defined with defmacro-pure, or if
+ * Interpreter::macro_is_pure can prove it. The arguments are compared by value, not by identity.
+ *
+ * The cached expansions of a macro are thrown away when it, or any macro its purity depends on, is
+ * redefined.
+ */
+
+#ifndef JAK_MACROEXPANSIONCACHE_H
+#define JAK_MACROEXPANSIONCACHE_H
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "common/common_types.h"
+#include "common/goos/Interpreter.h"
+
+class MacroExpansionCache {
+ public:
+  goos::Object expand(goos::Interpreter& goos,
+                      const goos::Object& head,
+                      const goos::Object& macro_obj,
+                      const goos::Object& rest,
+                      const std::function<goos::Object()>& expand_macro);
+  void print_report() const;
+  void reset_stats();
+  int hit_count() const { return m_hits; }
+
+ private:
+  struct Expansion {
+    goos::Object args;
+    goos::Object result;
+  };
+
+  struct MacroEntry {
+    goos::Object macro;
+    bool pure = false;
+    std::vector<std::pair<goos::Object, goos::Object>> used_macros;  // name, macro
+    std::unordered_multimap<u64, Expansion> expansions;              // by hash of args
+  };
+
+  bool entry_is_current(goos::Interpreter& goos,
+                        const MacroEntry& entry,
+                        const goos::Object& macro_obj) const;
+
+  std::unordered_map<const goos::HeapObject*, MacroEntry> m_macros;  // by name symbol
+
+  int m_hits = 0;
+  int m_misses = 0;
+  int m_impure = 0;     // uses of macros that can't be cached
+  int m_too_large = 0;  // uses with arguments that are too large to be worth hashing
+  int m_invalidations = 0;
+};
+
+#endif  // JAK_MACROEXPANSIONCACHE_H
@@ -0,0 +1,127 @@
+/*!
+ * @file Snapshot.cpp
+ * Save and load the state of the compiler after goal-lib.gc has been compiled.
+ *
+ * Starting the compiler requires reading and compiling goal-lib.gc and everything it includes.
+ * The resulting types, GOOS environments, global symbol types, constants and enums can be saved to
+ * a snapshot, which is loaded on the next start instead.
+ *
+ * The snapshot is a cache file (see CacheFile.h). It is only used if every file read during startup
+ * is unchanged and the compiler version and built-in types match. Increase SNAPSHOT_VERSION when
+ * the saved data changes.
+ */
+
+#include "goalc/compiler/Compiler.h"
+#include "common/goos/ObjectSerializer.h"
+#include "common/util/CacheFile.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Serializer.h"
+
+namespace {
+constexpr u32 SNAPSHOT_MAGIC = 0x534c4f47;  // "GOLS"
+constexpr u32 SNAPSHOT_VERSION = 2;
+
+std::string snapshot_file_name() {
+  return file_util::get_file_path({"out", "cache", "goal-lib.snapshot"});
+}
+
+/*!
+ * Save or load an unordered_map. The entry function is called with pointers to the key and value.
+ */
+template <typename K, typename V, typename F>
+void serialize_map(Serializer& ser, std::unordered_map<K, V>* map, F&& entry_func) {
+  auto count = ser.save_or_load<u32>(map->size());
+  if (ser.is_saving()) {
+    for (auto& kv : *map) {
+      K key = kv.first;
+      entry_func(&key, &kv.second);
+    }
+  } else {
+    map->clear();
+    for (u32 i = 0; i < count; i++) {
+      K key;
+      V value;
+      entry_func(&key, &value);
+      (*map)[key] = std::move(value);
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * Hash of the types added by add_builtin_types. These are created by the compiler itself, so a
+ * snapshot from a compiler with different built-in types can't be used.
+ */
+u64 Compiler::builtin_types_hash() {
+  return m_ts.get_hash();
+}
+
+/*!
+ * Save or load everything that compiling goal-lib.gc can modify.
+ */
+void Compiler::serialize_state(Serializer& ser) {
+  m_ts.serialize(ser);
+
+  goos::ObjectSerializer obj_ser(&ser, &m_goos.reader.symbolTable);
+  m_goos.serialize_state(obj_ser);
+
+  serialize_map(ser, &m_symbol_types, [&](std::string* name, TypeSpec* ts) {
+    ser.from_str(name);
+    ts->serialize(ser);
+  });
+
+  serialize_map(ser, &m_global_constants,
+                [&](std::shared_ptr<goos::SymbolObject>* sym, goos::Object* value) {
+                  obj_ser.from_symbol(sym);
+                  obj_ser.from_object(value);
+                });
+
+  serialize_map(ser, &m_enums, [&](std::string* name, GoalEnum* e) {
+    ser.from_str(name);
+    e->base_type.serialize(ser);
+    ser.from_pod(&e->is_bitfield);
+    serialize_map(ser, &e->entries, [&](std::string* entry_name, s64* value) {
+      ser.from_str(entry_name);
+      ser.from_pod(value);
+    });
+  });
+}
+
+/*!
+ * Try to load the snapshot. Returns false, without modifying the compiler, if there is no snapshot,
+ * or if it is out of date.
+ */
+bool Compiler::load_snapshot(u64 builtin_hash) {
+  std::vector<u8> data;
+  if (!cache_file::load(snapshot_file_name(), SNAPSHOT_MAGIC, SNAPSHOT_VERSION, builtin_hash,
+                        &data)) {
+    return false;
+  }
+
+  // the data hash matched, so this can only fail if the snapshot code is wrong.
+  Serializer ser(data.data(), data.size());
+  serialize_state(ser);
+  if (!ser.reached_end()) {
+    throw std::runtime_error("Compiler snapshot was not fully loaded");
+  }
+  return true;
+}
+
+/*!
+ * Save a snapshot of the compiler state. Failing to save is only a warning.
+ */
+void Compiler::save_snapshot(u64 builtin_hash) {
+  if (!m_inlineable_functions.empty()) {
+    // these refer to compiled code, which isn't part of the snapshot.
+    return;
+  }
+
+  try {
+    Serializer ser;
+    serialize_state(ser);
+    cache_file::save(snapshot_file_name(), SNAPSHOT_MAGIC, SNAPSHOT_VERSION, builtin_hash,
+                     m_goos.reader.db.get_file_names(), ser.get_save_result());
+  } catch (std::exception& e) {
+    print_compiler_warning("Failed to save compiler snapshot: {}\n", e.what());
+  }
+}
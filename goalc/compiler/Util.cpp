@@ -156,6 +156,7 @@ bool Compiler::is_local_symbol(const goos::Object& obj, Env* env) {
   }
 
   // check global constants
+  m_build_cache.note_constant(obj.as_symbol()->name);
   if (m_global_constants.find(obj.as_symbol()) != m_global_constants.end()) {
     return true;
   }
@@ -205,6 +206,7 @@ bool Compiler::try_getting_constant_integer(const goos::Object& in, int64_t* out
     auto head = in.as_pair()->car;
     if (head.is_symbol()) {
       auto head_sym = head.as_symbol();
+      m_build_cache.note_enum(head_sym->name);
       auto enum_kv = m_enums.find(head_sym->name);
       if (enum_kv != m_enums.end()) {
         bool success;
@@ -218,6 +220,7 @@ bool Compiler::try_getting_constant_integer(const goos::Object& in, int64_t* out
   }
 
   if (in.is_symbol()) {
+    m_build_cache.note_constant(in.as_symbol()->name);
     auto global_constant = m_global_constants.find(in.as_symbol());
     if (global_constant != m_global_constants.end()) {
       // recursively get constant integer, so we can have constants set to constants, etc.
@@ -235,6 +235,7 @@ class IntegerConstantVal : public Val {
   IntegerConstantVal(TypeSpec ts, s64 value) : Val(std::move(ts)), m_value(value) {}
   std::string print() const override { return "integer-constant-" + std::to_string(m_value); }
   RegVal* to_reg(Env* fe) override;
+  s64 value() const { return m_value; }
 
  protected:
   s64 m_value = -1;
@@ -245,6 +246,7 @@ class FloatConstantVal : public Val {
   FloatConstantVal(TypeSpec ts, StaticFloat* value) : Val(std::move(ts)), m_value(value) {}
   std::string print() const override { return "float-constant-" + m_value->print(); }
   RegVal* to_reg(Env* fe) override;
+  float value() const { return m_value->value; }
 
  protected:
   StaticFloat* m_value = nullptr;
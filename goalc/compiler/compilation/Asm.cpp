@@ -189,6 +189,7 @@ Val* Compiler::compile_asm_load_sym(const goos::Object& form, const goos::Object
       form, args, {{}, {goos::ObjectType::SYMBOL}},
       {{"sext", {false, goos::ObjectType::SYMBOL}}, {"color", {false, goos::ObjectType::SYMBOL}}});
   auto& sym_name = args.unnamed.at(1).as_symbol()->name;
+  m_build_cache.note_symbol(sym_name);
   auto sym_kv = m_symbol_types.find(sym_name);
   if (sym_kv == m_symbol_types.end()) {
     throw_compiler_error(form, "Cannot find a symbol named {}.", sym_name);
@@ -137,6 +137,11 @@ static const std::unordered_map<
 
         // BUILDER (build-dgo/build-cgo?)
         {"build-dgos", &Compiler::compile_build_dgo},
+        {"with-build-jobs", &Compiler::compile_with_build_jobs},
+        {"build-cache-report", &Compiler::compile_build_cache_report},
+        {"regalloc-benchmark-report", &Compiler::compile_regalloc_benchmark_report},
+        {"macro-expansion-cache-report", &Compiler::compile_macro_expansion_cache_report},
+        {"with-profiler", &Compiler::compile_with_profiler},
 
         // UTIL
         {"set-config!", &Compiler::compile_set_config},
@@ -189,6 +194,7 @@ Val* Compiler::compile_pair(const goos::Object& code, Env* env) {
       return compile_goos_macro(code, macro_obj, rest, env);
     }
 
+    m_build_cache.note_enum(head_sym->name);
     auto enum_kv = m_enums.find(head_sym->name);
     if (enum_kv != m_enums.end()) {
       return compile_enum_lookup(code, enum_kv->second, rest, env);
@@ -242,6 +248,7 @@ SymbolVal* Compiler::compile_get_sym_obj(const std::string& name, Env* env) {
 Val* Compiler::compile_get_symbol_value(const goos::Object& form,
                                         const std::string& name,
                                         Env* env) {
+  m_build_cache.note_symbol(name);
   auto existing_symbol = m_symbol_types.find(name);
   if (existing_symbol == m_symbol_types.end()) {
     throw_compiler_error(
@@ -284,6 +291,9 @@ Val* Compiler::compile_symbol(const goos::Object& form, Env* env) {
     return lexical;
   }
 
+  m_build_cache.note_constant(name);
+  m_build_cache.note_symbol(name);
+  get_parent_env_of_type<FunctionEnv>(env)->global_symbols.insert(name);
   auto global_constant = m_global_constants.find(form.as_symbol());
   auto existing_symbol = m_symbol_types.find(form.as_symbol()->name);
 
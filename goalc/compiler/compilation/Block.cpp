@@ -3,16 +3,47 @@
  * Compiler implementation for blocks / gotos / labels
  */
 
+#include <optional>
+
 #include "goalc/compiler/Compiler.h"
 #include "goalc/compiler/IR.h"
+#include "common/util/Profiler.h"
 
 using namespace goos;
 
+/*!
+ * Compile each form in a list, and return the value of the last one. With profile_forms, each form
+ * gets its own profiler zone.
+ */
+Val* Compiler::compile_sequence(const goos::Object& forms, Env* env, bool profile_forms) {
+  Val* result = get_none();
+  for_each_in_list(forms, [&](const Object& o) {
+    std::optional<prof::Zone> zone;
+    if (profile_forms) {
+      zone.emplace("top-level-form");
+    }
+    if (zone && zone->active() && o.is_pair()) {
+      // like "defun vector-dot"
+      auto& head = o.as_pair()->car;
+      auto& second = o.as_pair()->cdr;
+      zone->set_detail(second.is_pair() ? head.print() + " " + second.as_pair()->car.print()
+                                        : head.print());
+    }
+    result = compile_error_guard(o, env);
+    if (!dynamic_cast<None*>(result)) {
+      result = result->to_reg(env);
+    }
+  });
+  return result;
+}
+
 /*!
  * Compile "top-level" form, which is equivalent to a begin.
+ * Each form gets its own profiler zone.
  */
 Val* Compiler::compile_top_level(const goos::Object& form, const goos::Object& rest, Env* env) {
-  return compile_begin(form, rest, env);
+  (void)form;
+  return compile_sequence(rest, env, true);
 }
 
 /*!
@@ -21,14 +52,7 @@ Val* Compiler::compile_top_level(const goos::Object& form, const goos::Object& r
  */
 Val* Compiler::compile_begin(const goos::Object& form, const goos::Object& rest, Env* env) {
   (void)form;
-  Val* result = get_none();
-  for_each_in_list(rest, [&](const Object& o) {
-    result = compile_error_guard(o, env);
-    if (!dynamic_cast<None*>(result)) {
-      result = result->to_reg(env);
-    }
-  });
-  return result;
+  return compile_sequence(rest, env, false);
 }
 
 /*!
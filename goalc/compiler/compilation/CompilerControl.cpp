@@ -3,6 +3,7 @@
  * Compiler implementation for forms which actually control the compiler.
  */
 
+#include <algorithm>
 #include <filesystem>
 #include "goalc/compiler/Compiler.h"
 #include "goalc/compiler/IR.h"
@@ -11,6 +12,16 @@
 #include "common/util/FileUtil.h"
 #include "goalc/data_compiler/game_text.h"
 #include "goalc/data_compiler/game_count.h"
+#include "common/util/Hash.h"
+#include "common/util/Profiler.h"
+#include "common/versions.h"
+
+namespace {
+void write_object_file(const std::string& obj_file_name, const std::vector<u8>& data) {
+  file_util::write_binary_file(file_util::get_file_path({"out", "obj", obj_file_name + ".o"}),
+                               data.data(), data.size());
+}
+}  // namespace
 
 /*!
  * Exit the compiler. Disconnects the listener and tells the target to reset itself.
@@ -107,9 +118,22 @@ Val* Compiler::compile_asm_file(const goos::Object& form, const goos::Object& re
     i++;
   });
 
+  prof::Zone file_zone("asm-file");
+  file_zone.set_detail(filename);
+
   // READ
   Timer reader_timer;
-  auto code = m_goos.reader.read_from_file({filename});
+  prof::Zone read_zone("read");
+  goos::Object code;
+  auto read_ahead = m_read_ahead_files.find(filename);
+  if (read_ahead != m_read_ahead_files.end()) {
+    auto read = std::move(read_ahead->second);
+    m_read_ahead_files.erase(read_ahead);
+    code = m_goos.reader.merge_symbols(read.get());
+  } else {
+    code = m_goos.reader.read_from_file({filename});
+  }
+  read_zone.end();
   timing.emplace_back("read", reader_timer.getMs());
 
   Timer compile_timer;
@@ -125,10 +149,92 @@ Val* Compiler::compile_asm_file(const goos::Object& form, const goos::Object& re
   obj_file_name = obj_file_name.substr(0, obj_file_name.find_last_of('.'));
 
   // COMPILE
-  auto obj_file = compile_object_file(obj_file_name, code, !no_code);
+  // the build cache is only used when the object is just written. A loaded or disassembled object
+  // needs debug info, which only comes from running codegen.
+  bool use_cache = m_settings.use_build_cache && color && !load && !disassemble;
+  auto finish_dependency_tracking = [&]() {
+    auto deps = m_build_cache.end_file();
+    m_ts.set_lookup_log(m_build_cache.deps() ? &m_build_cache.deps()->types : nullptr);
+    return deps;
+  };
+
+  if (use_cache) {
+    m_build_cache.begin_file();
+    m_ts.set_lookup_log(&m_build_cache.deps()->types);
+  }
+
+  FileEnv* obj_file = nullptr;
+  prof::Zone compile_zone("compile");
+  try {
+    obj_file = compile_object_file(obj_file_name, code, !no_code);
+  } catch (...) {
+    if (use_cache) {
+      finish_dependency_tracking();
+    }
+    throw;
+  }
+  compile_zone.end();
   timing.emplace_back("compile", compile_timer.getMs());
 
-  if (color) {
+  // CHECK CACHE
+  u64 cache_key = 0;
+  bool cache_hit = false;
+  std::vector<u8> cached_data;
+  if (use_cache) {
+    Timer cache_timer;
+    prof::Zone cache_zone("cache-lookup");
+    cache_key = build_cache_key(filename, finish_dependency_tracking());
+    cache_hit = m_build_cache.lookup(obj_file_name, cache_key, &cached_data);
+    timing.emplace_back("cache", cache_timer.getMs());
+    if (!cache_hit) {
+      file_util::create_dir_if_needed(file_util::get_file_path({"out", "cache"}));
+    }
+  }
+
+  if (cache_hit) {
+    if (write) {
+      file_util::create_dir_if_needed(file_util::get_file_path({"out", "obj"}));
+      write_object_file(obj_file_name, cached_data);
+    }
+  } else if (color && m_build_pool && !load && !disassemble &&
+             !m_settings.debug_print_regalloc) {
+    // Register allocation and codegen only read this file's FileEnv, so they can run on a worker
+    // while the next file goes through the front end. The debug info entry and output directory
+    // are created here so the worker doesn't touch any shared state.
+    auto debug_info = &m_debugger.get_debug_info_for_object(obj_file->name());
+    if (write) {
+      file_util::create_dir_if_needed(file_util::get_file_path({"out", "obj"}));
+    }
+
+    PendingBuildJob job;
+    job.obj_file_name = obj_file_name;
+    job.timing = timing;
+    job.front_end_ms = total_timer.getMs();
+    job.back_end_timing = m_build_pool->submit([this, obj_file, debug_info, write, obj_file_name,
+                                                use_cache, cache_key]() {
+      prof::Zone back_end_zone("back-end");
+      back_end_zone.set_detail(obj_file_name);
+      std::vector<std::pair<std::string, float>> back_end_timing;
+      Timer color_timer;
+      color_object_file(obj_file);
+      back_end_timing.emplace_back("color", color_timer.getMs());
+
+      Timer codegen_timer;
+      auto data = codegen_object_file(obj_file, debug_info);
+      back_end_timing.emplace_back("codegen", codegen_timer.getMs());
+
+      if (write) {
+        write_object_file(obj_file_name, data);
+      }
+
+      if (use_cache) {
+        m_build_cache.store(obj_file_name, cache_key, data);
+      }
+      return back_end_timing;
+    });
+    m_pending_build_jobs.push_back(std::move(job));
+    return get_none();
+  } else if (color) {
     // register allocation
     Timer color_timer;
     color_object_file(obj_file);
@@ -158,8 +264,11 @@ Val* Compiler::compile_asm_file(const goos::Object& form, const goos::Object& re
     // save file
     if (write) {
       file_util::create_dir_if_needed(file_util::get_file_path({"out", "obj"}));
-      file_util::write_binary_file(file_util::get_file_path({"out", "obj", obj_file_name + ".o"}),
-                                   (void*)data.data(), data.size());
+      write_object_file(obj_file_name, data);
+    }
+
+    if (use_cache) {
+      m_build_cache.store(obj_file_name, cache_key, data);
     }
   } else {
     if (load) {
@@ -187,6 +296,294 @@ Val* Compiler::compile_asm_file(const goos::Object& form, const goos::Object& re
   return get_none();
 }
 
+/*!
+ * Wait for all files queued by asm-file inside of a with-build-jobs to finish register allocation
+ * and codegen. Timing is printed in the order the files were compiled. If any file failed, the
+ * first error is rethrown after all workers are done.
+ */
+void Compiler::wait_for_build_jobs() {
+  std::exception_ptr first_error = nullptr;
+  for (auto& job : m_pending_build_jobs) {
+    try {
+      auto back_end_timing = job.back_end_timing.get();
+      if (m_settings.print_timing) {
+        float total = job.front_end_ms;
+        printf("F: %36s ", job.obj_file_name.c_str());
+        for (auto& e : back_end_timing) {
+          job.timing.push_back(e);
+          total += e.second;
+        }
+        job.timing.emplace_back("total", total);
+        for (auto& e : job.timing) {
+          printf(" %12s %4.0f", e.first.c_str(), e.second);
+        }
+        printf("\n");
+      }
+    } catch (...) {
+      if (!first_error) {
+        first_error = std::current_exception();
+      }
+    }
+  }
+  m_pending_build_jobs.clear();
+
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+/*!
+ * Compute the build cache key for an object file. This is a hash of the source, and the current
+ * definition of everything the file read while compiling. Must be called right after the file
+ * is compiled, before anything else changes these definitions.
+ */
+u64 Compiler::build_cache_key(const std::string& filename, const BuildDependencies& deps) {
+  // sort, so the key doesn't depend on the order of the hash tables.
+  std::vector<std::string> entries;
+
+  for (auto& name : deps.types) {
+    if (m_ts.fully_defined_type_exists(name)) {
+      entries.push_back("type " + name + " " + m_ts.lookup_type(name)->print());
+    } else if (m_ts.partially_defined_type_exists(name)) {
+      entries.push_back("type " + name + " forward-declared");
+    } else {
+      entries.push_back("type " + name + " undefined");
+    }
+  }
+
+  for (auto& name : deps.symbols) {
+    auto kv = m_symbol_types.find(name);
+    entries.push_back("symbol " + name + " " +
+                      (kv == m_symbol_types.end() ? "undefined" : kv->second.print()));
+  }
+
+  for (auto& name : deps.constants) {
+    auto kv = m_global_constants.find(m_goos.intern(name).as_symbol());
+    entries.push_back("constant " + name + " " +
+                      (kv == m_global_constants.end() ? "undefined" : kv->second.print()));
+  }
+
+  for (auto& name : deps.enums) {
+    auto kv = m_enums.find(name);
+    std::string entry = "enum " + name;
+    if (kv == m_enums.end()) {
+      entry += " undefined";
+    } else {
+      entry += fmt::format(" {} {}", kv->second.base_type.print(), kv->second.is_bitfield);
+      std::vector<std::string> values;
+      for (auto& e : kv->second.entries) {
+        values.push_back(fmt::format(" ({} {})", e.first, e.second));
+      }
+      std::sort(values.begin(), values.end());
+      for (auto& v : values) {
+        entry += v;
+      }
+    }
+    entries.push_back(entry);
+  }
+
+  for (auto& name : deps.inline_functions) {
+    auto kv = m_inlineable_functions.find(m_goos.intern(name).as_symbol());
+    std::string entry = "inline " + name;
+    if (kv == m_inlineable_functions.end()) {
+      entry += " undefined";
+    } else {
+      auto& lambda = kv->second->lambda;
+      for (auto& param : lambda.params) {
+        entry += " " + param.name + " " + param.type.print();
+      }
+      entry += " " + lambda.body.print();
+      if (kv->second->func) {
+        auto& settings = kv->second->func->settings;
+        entry += fmt::format(" {} {} {}", settings.allow_inline, settings.inline_by_default,
+                             kv->second->func->auto_inline);
+      }
+    }
+    entries.push_back(entry);
+  }
+
+  std::sort(entries.begin(), entries.end());
+
+  u64 key = hash_util::string(file_util::read_text_file(file_util::get_file_path({filename})));
+  key = hash_util::combine(key, versions::GOAL_VERSION_MAJOR);
+  key = hash_util::combine(key, versions::GOAL_VERSION_MINOR);
+  key = hash_util::combine(key, m_settings.disable_math_const_prop);
+  key = hash_util::combine(key, m_settings.disable_move_coalescing);
+  key = hash_util::combine(key, m_settings.disable_branch_relaxation);
+  key = hash_util::combine(key, m_settings.disable_peephole);
+  key = hash_util::combine(key, m_settings.auto_inline);
+  key = hash_util::combine(key, m_settings.emit_move_after_return);
+  key = hash_util::combine(key, deps.expansion_hash);
+  for (auto& entry : entries) {
+    key = hash_util::string(entry, key);
+  }
+  return key;
+}
+
+/*!
+ * Print how many files were found in the build cache since the last report, and which ones had to
+ * be compiled.
+ */
+Val* Compiler::compile_build_cache_report(const goos::Object& form,
+                                          const goos::Object& rest,
+                                          Env* env) {
+  (void)env;
+  auto args = get_va(form, rest);
+  va_check(form, args, {}, {});
+  m_build_cache.print_report();
+  m_build_cache.reset_stats();
+  return get_none();
+}
+
+/*!
+ * Print the total time spent in register allocation with and without the reference conflict check
+ * since the last report. See the regalloc-benchmark setting.
+ */
+Val* Compiler::compile_regalloc_benchmark_report(const goos::Object& form,
+                                                 const goos::Object& rest,
+                                                 Env* env) {
+  (void)env;
+  auto args = get_va(form, rest);
+  va_check(form, args, {}, {});
+  wait_for_build_jobs();
+
+  std::unique_lock<std::mutex> lock(m_regalloc_benchmark.mutex);
+  auto& bench = m_regalloc_benchmark;
+  fmt::print("[RegAlloc Benchmark] {} functions, {} instructions\n", bench.functions,
+             bench.instructions);
+  fmt::print("  reference:  {:10.2f} ms\n", bench.reference_ms);
+  fmt::print("  live sets:  {:10.2f} ms ({:.2f}x faster)\n", bench.live_set_ms,
+             bench.live_set_ms > 0 ? bench.reference_ms / bench.live_set_ms : 0.);
+  if (bench.mismatches) {
+    fmt::print(fg(fmt::color::red), "  {} functions didn't match the reference!\n",
+               bench.mismatches);
+  } else {
+    fmt::print("  all functions matched the reference.\n");
+  }
+
+  bench.functions = 0;
+  bench.instructions = 0;
+  bench.mismatches = 0;
+  bench.reference_ms = 0;
+  bench.live_set_ms = 0;
+  return get_none();
+}
+
+/*!
+ * Print how many macro expansions were found in the macro expansion cache since the last report.
+ */
+Val* Compiler::compile_macro_expansion_cache_report(const goos::Object& form,
+                                                    const goos::Object& rest,
+                                                    Env* env) {
+  (void)env;
+  auto args = get_va(form, rest);
+  va_check(form, args, {}, {});
+  m_macro_cache.print_report();
+  m_macro_cache.reset_stats();
+  return get_none();
+}
+
+/*!
+ * Compile the body with a pool of worker threads for register allocation and codegen.
+ * Files are still compiled in order, so headers are processed before the files that use them, but
+ * the back end of each file overlaps with the front end of the files after it. The files of the
+ * asm-files directly in the body are read ahead of time on the workers.
+ * Each object file is identical to the one generated by a serial build.
+ * With 1 job, this is the same as begin.
+ */
+Val* Compiler::compile_with_build_jobs(const goos::Object& form,
+                                       const goos::Object& rest,
+                                       Env* env) {
+  int64_t jobs = 0;
+  if (!try_getting_constant_integer(pair_car(rest), &jobs, env) || jobs < 1) {
+    throw_compiler_error(form, "with-build-jobs must have a positive integer number of jobs");
+  }
+
+  if (m_build_pool) {
+    throw_compiler_error(form, "with-build-jobs cannot be nested");
+  }
+
+  if (jobs > 1) {
+    m_build_pool = std::make_unique<ThreadPool>(jobs);
+    // start reading the files of the asm-files in the body. These jobs are queued first, so the
+    // files are read while the first ones are compiled.
+    for_each_in_list(pair_cdr(rest), [&](const goos::Object& o) {
+      if (!o.is_pair() || !pair_car(o).is_symbol() || symbol_string(pair_car(o)) != "asm-file" ||
+          !pair_cdr(o).is_pair() || !pair_car(pair_cdr(o)).is_string()) {
+        return;
+      }
+      auto filename = as_string(pair_car(pair_cdr(o)));
+      if (m_read_ahead_files.find(filename) == m_read_ahead_files.end()) {
+        m_read_ahead_files[filename] = m_build_pool->submit([this, filename]() {
+          prof::Zone read_zone("read-ahead");
+          read_zone.set_detail(filename);
+          return m_goos.reader.read_from_file_local({filename});
+        });
+      }
+    });
+  }
+
+  try {
+    for_each_in_list(pair_cdr(rest), [&](const goos::Object& o) { compile_error_guard(o, env); });
+    wait_for_build_jobs();
+  } catch (...) {
+    // let the workers finish before the FileEnvs they are using can go away.
+    m_build_pool.reset();
+    m_pending_build_jobs.clear();
+    m_read_ahead_files.clear();
+    throw;
+  }
+
+  m_build_pool.reset();
+  // files that weren't compiled, because an asm-file didn't run.
+  m_read_ahead_files.clear();
+  return get_none();
+}
+
+/*!
+ * Compile forms with the profiler running. Afterward, write a Chrome trace of everything that
+ * happened to the given file, and print a summary. If the file is #f, this is the same as begin.
+ */
+Val* Compiler::compile_with_profiler(const goos::Object& form,
+                                     const goos::Object& rest,
+                                     Env* env) {
+  if (!rest.is_pair()) {
+    throw_compiler_error(form, "with-profiler must have a file name for the trace");
+  }
+
+  auto& file_arg = pair_car(rest);
+  if (file_arg.is_symbol() && symbol_string(file_arg) == "#f") {
+    for_each_in_list(pair_cdr(rest), [&](const goos::Object& o) { compile_error_guard(o, env); });
+    return get_none();
+  }
+
+  if (!file_arg.is_string()) {
+    throw_compiler_error(form, "with-profiler must have a file name for the trace");
+  }
+  auto file_name = file_util::get_file_path({as_string(file_arg)});
+
+  if (prof::is_enabled()) {
+    throw_compiler_error(form, "with-profiler cannot be nested");
+  }
+
+  prof::start();
+  try {
+    for_each_in_list(pair_cdr(rest), [&](const goos::Object& o) { compile_error_guard(o, env); });
+    // include the back end of any files still being built.
+    wait_for_build_jobs();
+  } catch (...) {
+    prof::stop();
+    throw;
+  }
+  prof::stop();
+
+  file_util::create_dir_if_needed(std::filesystem::path(file_name).parent_path().string());
+  prof::write_chrome_trace(file_name);
+  prof::print_summary();
+  fmt::print("[Profiler] Wrote trace to {}\n", file_name);
+  return get_none();
+}
+
 /*!
  * Connect the compiler to a target. Takes an optional IP address / port, defaults to
  * 127.0.0.1 and 8112, which is the local computer and the default port for the DECI2 over IP
@@ -294,6 +691,9 @@ Val* Compiler::compile_build_dgo(const goos::Object& form, const goos::Object& r
   (void)env;
   auto args = get_va(form, rest);
   va_check(form, args, {goos::ObjectType::STRING}, {});
+  // the objects in the DGO may still be getting written by build workers.
+  wait_for_build_jobs();
+  prof::Zone zone("build-dgos");
   auto dgo_desc = pair_cdr(m_goos.reader.read_from_file({args.unnamed.at(0).as_string()->data}));
 
   for_each_in_list(dgo_desc, [&](const goos::Object& dgo) {
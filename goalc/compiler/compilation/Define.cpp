@@ -29,14 +29,23 @@ Val* Compiler::compile_define(const goos::Object& form, const goos::Object& rest
   auto compiled_val = compile_error_guard(val, env);
   auto as_lambda = dynamic_cast<LambdaVal*>(compiled_val);
   if (as_lambda) {
-    // there are two cases in which we save a function body that is passed to a define:
+    // there are three cases in which we save a function body that is passed to a define:
     // 1. It generated code [so went through the compiler] and the allow_inline flag is set.
     // 2. It didn't generate code [so explicitly with :inline-only lambdas]
-    // The third case - immediate lambdas - don't get passed to a define,
+    // 3. It generated code, and is small enough to be inlined automatically.
+    // The fourth case - immediate lambdas - don't get passed to a define,
     //   so this won't cause those to live for longer than they should
     if ((as_lambda->func && as_lambda->func->settings.allow_inline) || !as_lambda->func) {
       m_inlineable_functions[sym.as_symbol()] = as_lambda;
+    } else if (m_settings.auto_inline && is_auto_inline_candidate(as_lambda)) {
+      as_lambda->func->auto_inline = true;
+      m_inlineable_functions[sym.as_symbol()] = as_lambda;
+    } else {
+      // don't inline an old version of a function that was redefined.
+      m_inlineable_functions.erase(sym.as_symbol());
     }
+  } else {
+    m_inlineable_functions.erase(sym.as_symbol());
   }
 
   auto in_gpr = compiled_val->to_gpr(fe);
@@ -35,8 +35,75 @@ const goos::Object& get_lambda_body(const goos::Object& def) {
     }
   }
 }
+
+/*!
+ * Can this IR appear in a function that is inlined automatically? Function calls aren't allowed, so
+ * these functions can't be recursive, and inlining can't make the caller much bigger. Things that
+ * would be different for every inlined copy, or that depend on the function's stack frame, are
+ * also not allowed.
+ */
+bool allowed_in_auto_inline(const IR* ir) {
+  return !dynamic_cast<const IR_FunctionCall*>(ir) && !dynamic_cast<const IR_FunctionAddr*>(ir) &&
+         !dynamic_cast<const IR_StaticVarAddr*>(ir) && !dynamic_cast<const IR_AsmRet*>(ir) &&
+         !dynamic_cast<const IR_JumpReg*>(ir) && !dynamic_cast<const IR_AsmPush*>(ir) &&
+         !dynamic_cast<const IR_AsmPop*>(ir) && !dynamic_cast<const IR_AsmSub*>(ir) &&
+         !dynamic_cast<const IR_AsmAdd*>(ir);
+}
+
+// functions with more IR than this are not inlined automatically.
+constexpr int AUTO_INLINE_MAX_IR = 10;
 }  // namespace
 
+/*!
+ * Should this function be inlined automatically when the auto-inline setting is on? This is only
+ * done for small functions that don't call anything.
+ */
+bool Compiler::is_auto_inline_candidate(const LambdaVal* lambda) {
+  auto func = lambda->func;
+  if (!func || func->is_asm_func || func->asm_func_saved_regs || func->settings.print_asm) {
+    return false;
+  }
+
+  int ir_count = 0;
+  for (auto& ir : func->code()) {
+    if (!allowed_in_auto_inline(ir.get())) {
+      return false;
+    }
+    if (!dynamic_cast<const IR_Null*>(ir.get()) && !dynamic_cast<const IR_ValueReset*>(ir.get()) &&
+        !dynamic_cast<const IR_Return*>(ir.get())) {
+      ir_count++;
+    }
+  }
+  return ir_count <= AUTO_INLINE_MAX_IR;
+}
+
+/*!
+ * Can an automatically inlined function be inlined here? The body is compiled in the caller's
+ * environment, so it can't be inlined if one of the global symbols it uses is a local variable
+ * here.
+ */
+bool Compiler::can_auto_inline(const LambdaVal* lambda, Env* env) {
+  if (!m_settings.auto_inline) {
+    return false;
+  }
+
+  for (auto& name : lambda->func->global_symbols) {
+    auto sym = m_goos.intern(name);
+    auto mlet_env = get_parent_env_of_type<SymbolMacroEnv>(env);
+    while (mlet_env) {
+      if (mlet_env->macros.find(sym.as_symbol()) != mlet_env->macros.end()) {
+        return false;
+      }
+      mlet_env = get_parent_env_of_type<SymbolMacroEnv>(mlet_env->parent());
+    }
+
+    if (env->lexical_lookup(sym)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 /*!
  * The (inline my-func) form is like my-func, except my-func will be inlined instead of called,
  * when used in a function call. This only works for immediaate function calls, you can't "save"
@@ -50,6 +117,7 @@ Val* Compiler::compile_inline(const goos::Object& form, const goos::Object& rest
   auto args = get_va(form, rest);
   va_check(form, args, {goos::ObjectType::SYMBOL}, {});
 
+  m_build_cache.note_inline_function(args.unnamed.at(0).as_symbol()->name);
   auto kv = m_inlineable_functions.find(args.unnamed.at(0).as_symbol());
   if (kv == m_inlineable_functions.end()) {
     throw_compiler_error(form, "Cannot inline {} because the function's code could not be found.",
@@ -237,6 +305,7 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
   if (uneval_head.is_symbol()) {
     // we can only auto-inline the function if its name is explicitly given.
     // look it up:
+    m_build_cache.note_inline_function(uneval_head.as_symbol()->name);
     auto kv = m_inlineable_functions.find(uneval_head.as_symbol());
     if (kv != m_inlineable_functions.end()) {
       // it's inlinable.  However, we do not always inline an inlinable function by default
@@ -245,9 +314,13 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
           kv->second->func->settings
               .inline_by_default ||  // inline when possible, so we should inline
           (kv->second->func->settings.allow_inline &&
-           get_inline_preference(env))) {  // inline is allowed, and we prefer it locally
+           get_inline_preference(env)) ||  // inline is allowed, and we prefer it locally
+          (kv->second->func->auto_inline &&
+           can_auto_inline(kv->second, env))) {  // small, and safe to inline here
         auto_inline = true;
         head = kv->second;
+        // if this function is inlined into another, the name must still refer to this function.
+        fe->global_symbols.insert(uneval_head.as_symbol()->name);
       }
     }
   }
@@ -256,6 +329,7 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
   if (!auto_inline) {
     // if auto-inlining failed, we must get the thing to call in a different way.
     if (uneval_head.is_symbol()) {
+      m_build_cache.note_symbol(symbol_string(uneval_head));
       if (is_local_symbol(uneval_head, env) ||
           m_symbol_types.find(symbol_string(uneval_head)) != m_symbol_types.end()) {
         // the local environment (mlets, lexicals, constants, globals) defines this symbol.
@@ -337,8 +411,9 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
       inlined_compile_env = fe->alloc_env<LabelEnv>(lexical_env);
     }
 
-    // check arg types
-    if (!head->type().arg_count()) {
+    // check arg types. immediate lambdas (lets) have no code and no return type, so only check
+    // functions.
+    if (head_as_lambda->func) {
       if (head->type().arg_count() - 1 != eval_args.size()) {
         throw_compiler_error(form,
                              "Expected {} arguments for an inlined lambda with type {} but got {}.",
@@ -352,11 +427,17 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
       }
     }
 
+    // automatically inlined functions should do exactly the same thing as a call, so they use the
+    // declared argument and return types.
+    bool use_declared_types =
+        auto_inline && head_as_lambda->func && head_as_lambda->func->auto_inline;
+
     // copy args...
     for (uint32_t i = 0; i < eval_args.size(); i++) {
       // note, inlined functions will get a more specific type if possible
       // todo, is this right?
-      auto type = eval_args.at(i)->type();
+      auto type =
+          use_declared_types ? head_as_lambda->lambda.params.at(i).type : eval_args.at(i)->type();
       auto copy = env->make_ireg(type, m_ts.lookup_type(type)->get_preferred_reg_class());
       env->emit(std::make_unique<IR_RegSet>(copy, eval_args.at(i)));
       copy->mark_as_settable();
@@ -407,10 +488,15 @@ Val* Compiler::compile_function_or_method_call(const goos::Object& form, Env* en
 
       inlined_compile_env->emit(std::make_unique<IR_Null>());
       inlined_block_env->end_label.idx = inlined_block_env->end_label.func->code().size();
-      return inlined_block_env->return_value;
+      result = inlined_block_env->return_value;
+    } else {
+      inlined_compile_env->emit(std::make_unique<IR_Null>());
     }
 
-    inlined_compile_env->emit(std::make_unique<IR_Null>());
+    if (use_declared_types && !dynamic_cast<None*>(result) &&
+        result->type() != head->type().last_arg()) {
+      result = fe->alloc_val<AliasVal>(head->type().last_arg(), result);
+    }
     return result;
   } else {
     // not an inlined/immediate, it's a real function call.
@@ -1,5 +1,6 @@
 #include "goalc/compiler/Compiler.h"
 #include "third-party/fmt/core.h"
+#include "common/util/Profiler.h"
 
 using namespace goos;
 
@@ -32,15 +33,27 @@ Val* Compiler::compile_goos_macro(const goos::Object& o,
                                   const goos::Object& rest,
                                   Env* env) {
   auto macro = macro_obj.as_macro();
-  Arguments args = m_goos.get_args(o, rest, macro->args);
-  auto mac_env_obj = EnvironmentObject::make_new();
-  auto mac_env = mac_env_obj.as_env();
-  mac_env->parent_env = m_goos.global_environment.as_env();
-  m_goos.set_args_in_env(o, args, macro->args, mac_env);
-  m_goos.goal_to_goos.enclosing_method_type =
-      get_parent_env_of_type<FunctionEnv>(env)->method_of_type_name;
-  auto goos_result = m_goos.eval_list_return_last(macro->body, macro->body, mac_env);
-  m_goos.goal_to_goos.reset();
+  prof::Zone expand_zone("macro-expand");
+  expand_zone.set_detail(macro->name);
+  auto expand = [&]() {
+    Arguments args = m_goos.get_args(o, rest, macro->args);
+    auto mac_env_obj = EnvironmentObject::make_new();
+    auto mac_env = mac_env_obj.as_env();
+    mac_env->parent_env = m_goos.global_environment.as_env();
+    m_goos.set_args_in_env(o, args, macro->args, mac_env);
+    m_goos.goal_to_goos.enclosing_method_type =
+        get_parent_env_of_type<FunctionEnv>(env)->method_of_type_name;
+    auto result = m_goos.eval_body(*macro, mac_env);
+    m_goos.goal_to_goos.reset();
+    return result;
+  };
+  auto goos_result = m_settings.cache_macro_expansions
+                         ? m_macro_cache.expand(m_goos, o.as_pair()->car, macro_obj, rest, expand)
+                         : expand();
+  if (auto deps = m_build_cache.deps()) {
+    deps->add_expansion(goos_result.print());
+  }
+  expand_zone.end();
   return compile_error_guard(goos_result, env);
 }
 
@@ -64,6 +77,9 @@ Val* Compiler::compile_gscond(const goos::Object& form, const goos::Object& rest
       // check condition:
       Object condition_result =
           m_goos.eval_with_rewind(current_case.as_pair()->car, m_goos.global_environment.as_env());
+      if (auto deps = m_build_cache.deps()) {
+        deps->add_expansion(condition_result.print());
+      }
       if (m_goos.truthy(condition_result)) {
         if (current_case.as_pair()->cdr.is_empty_list()) {
           return get_none();
@@ -1,5 +1,160 @@
+#include <cmath>
 #include "goalc/compiler/Compiler.h"
 
+namespace {
+
+/*!
+ * Get the value of an integer constant, looking through casts. Returns false if it isn't one.
+ */
+bool get_integer_constant(Val* in, s64* value) {
+  while (auto alias = dynamic_cast<AliasVal*>(in)) {
+    in = alias->base;
+  }
+  auto constant = dynamic_cast<IntegerConstantVal*>(in);
+  if (!constant) {
+    return false;
+  }
+  *value = constant->value();
+  return true;
+}
+
+/*!
+ * Get the value of a float constant, looking through casts. Returns false if it isn't one.
+ */
+bool get_float_constant(Val* in, float* value) {
+  while (auto alias = dynamic_cast<AliasVal*>(in)) {
+    in = alias->base;
+  }
+  auto constant = dynamic_cast<FloatConstantVal*>(in);
+  if (!constant) {
+    return false;
+  }
+  *value = constant->value();
+  return true;
+}
+
+/*!
+ * Convert to a gpr, unless it's an integer constant that may be folded later.
+ */
+Val* to_gpr_or_constant(Val* in, bool fold, Env* env) {
+  s64 value;
+  if (fold && get_integer_constant(in, &value)) {
+    return in;
+  }
+  return in->to_gpr(env);
+}
+
+/*!
+ * If the low 32-bits of value are 2^k, get k. The 32-bit multiply and divide only look at these.
+ */
+bool is_power_of_two_32(s64 value, int* log2) {
+  u32 v = value;
+  if (!v || (v & (v - 1))) {
+    return false;
+  }
+  *log2 = 0;
+  while (v > 1) {
+    v >>= 1;
+    (*log2)++;
+  }
+  return true;
+}
+
+// These match what the code for IMUL_32, IDIV_32 and IMOD_32 does at runtime.
+
+s64 imul32(s64 a, s64 b) {
+  return s32(u32(a) * u32(b));
+}
+
+bool can_idiv32(s64 a, s64 b) {
+  // these would crash at runtime, so leave them alone.
+  return s32(b) != 0 && !(s32(a) == INT32_MIN && s32(b) == -1);
+}
+
+s64 idiv32(s64 a, s64 b) {
+  return s32(a) / s32(b);
+}
+
+s64 imod32(s64 a, s64 b) {
+  return s32(a) % s32(b);
+}
+
+/*!
+ * Sign extend the low 32-bits of x, in place.
+ */
+void sign_extend_32(RegVal* x, Env* env) {
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SHL_64, x, 32));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SAR_64, x, 32));
+}
+
+/*!
+ * Get 2^log2 - 1 if x is negative, or 0 otherwise. Adding this to x before shifting it right by
+ * log2 rounds towards zero, like idiv.
+ */
+RegVal* compile_division_bias(RegVal* x, int log2, Env* env) {
+  auto bias = env->make_gpr(x->type());
+  env->emit(std::make_unique<IR_RegSet>(bias, x));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SAR_64, bias, 63));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SHR_64, bias, 64 - log2));
+  return bias;
+}
+
+bool is_normal_or_zero(float value) {
+  return std::isnormal(value) || value == 0;
+}
+
+/*!
+ * Do float math at compile time. Returns false if the result could be different at runtime, which
+ * can only happen with denormals, infinities and NaNs.
+ */
+bool fold_float_math(FloatMathKind kind, float a, float b, float* result) {
+  float value;
+  switch (kind) {
+    case FloatMathKind::ADD_SS:
+      value = a + b;
+      break;
+    case FloatMathKind::SUB_SS:
+      value = a - b;
+      break;
+    case FloatMathKind::MUL_SS:
+      value = a * b;
+      break;
+    case FloatMathKind::DIV_SS:
+      if (b == 0) {
+        return false;
+      }
+      value = a / b;
+      break;
+    default:
+      return false;
+  }
+
+  if (!is_normal_or_zero(a) || !is_normal_or_zero(b) || !is_normal_or_zero(value)) {
+    return false;
+  }
+  *result = value;
+  return true;
+}
+
+/*!
+ * If value is a power of two, get 1 / value. Dividing by value and multiplying by this give exactly
+ * the same result.
+ */
+bool get_exact_reciprocal(float value, float* reciprocal) {
+  int exponent;
+  if (!std::isnormal(value) || std::abs(std::frexp(value, &exponent)) != 0.5f) {
+    return false;
+  }
+  float result = 1.f / value;
+  if (!std::isnormal(result)) {
+    return false;
+  }
+  *reciprocal = result;
+  return true;
+}
+
+}  // namespace
+
 MathMode Compiler::get_math_mode(const TypeSpec& ts) {
   if (m_ts.typecheck(m_ts.make_typespec("binteger"), ts, "", false, false)) {
     return MATH_BINT;
@@ -63,6 +218,10 @@ Val* Compiler::number_to_binteger(const goos::Object& form, Val* in, Env* env) {
   } else if (is_float(ts)) {
     throw_compiler_error(form, "Cannot convert {} (a float) to an integer yet.", in->print());
   } else if (is_integer(ts)) {
+    s64 value;
+    if (!m_settings.disable_math_const_prop && get_integer_constant(in, &value)) {
+      return compile_integer_constant(u64(value) << 3, m_ts.make_typespec("binteger"), env);
+    }
     auto fe = get_parent_env_of_type<FunctionEnv>(env);
     RegVal* input = in->to_reg(env);
     auto sa = fe->make_gpr(m_ts.make_typespec("int"));
@@ -106,6 +265,74 @@ Val* Compiler::to_math_type(const goos::Object& form, Val* in, MathMode mode, En
   return nullptr;
 }
 
+/*!
+ * Get an integer constant with the given type. Emits no code.
+ */
+Val* Compiler::compile_integer_constant(s64 value, const TypeSpec& ts, Env* env) {
+  auto fe = get_parent_env_of_type<FunctionEnv>(env);
+  return fe->alloc_val<IntegerConstantVal>(ts, value);
+}
+
+/*!
+ * Get a float constant, stored in the same segment as the function.
+ */
+Val* Compiler::compile_float_constant(float value, Env* env) {
+  auto segment = get_parent_env_of_type<FunctionEnv>(env)->segment;
+  if (segment == TOP_LEVEL_SEGMENT) {
+    segment = MAIN_SEGMENT;
+  }
+  return compile_float(value, env, segment);
+}
+
+/*!
+ * Compile float math with at least two arguments. Constants at the start are folded, but float
+ * math isn't associative, so constants after the first variable are not. Dividing by a power of two
+ * is done as a multiply.
+ */
+Val* Compiler::compile_float_math(const goos::Object& form,
+                                  const goos::Arguments& args,
+                                  Val* first_val,
+                                  FloatMathKind kind,
+                                  Env* env) {
+  bool fold = !m_settings.disable_math_const_prop;
+  float constant = 0;
+  bool folded = false;
+  RegVal* result = nullptr;
+  if (!fold || !get_float_constant(first_val, &constant)) {
+    result = env->make_fpr(first_val->type());
+    env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
+  }
+
+  for (size_t i = 1; i < args.unnamed.size(); i++) {
+    auto val = to_math_type(form, compile_error_guard(args.unnamed.at(i), env), MATH_FLOAT, env);
+    float value;
+    bool is_constant = fold && get_float_constant(val, &value);
+    if (!result && is_constant && fold_float_math(kind, constant, value, &constant)) {
+      folded = true;
+      continue;
+    }
+
+    if (!result) {
+      result = env->make_fpr(first_val->type());
+      env->emit(std::make_unique<IR_RegSet>(
+          result, (folded ? compile_float_constant(constant, env) : first_val)->to_fpr(env)));
+    }
+
+    float reciprocal;
+    if (kind == FloatMathKind::DIV_SS && is_constant && get_exact_reciprocal(value, &reciprocal)) {
+      env->emit(std::make_unique<IR_FloatMath>(
+          FloatMathKind::MUL_SS, result, compile_float_constant(reciprocal, env)->to_fpr(env)));
+    } else {
+      env->emit(std::make_unique<IR_FloatMath>(kind, result, val->to_fpr(env)));
+    }
+  }
+
+  if (!result) {
+    return compile_float_constant(constant, env);
+  }
+  return result;
+}
+
 Val* Compiler::compile_add(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   if (!args.named.empty() || args.unnamed.empty()) {
@@ -116,33 +343,50 @@ Val* Compiler::compile_add(const goos::Object& form, const goos::Object& rest, E
   auto first_val = compile_error_guard(args.unnamed.at(0), env);
   auto first_type = first_val->type();
   auto math_type = get_math_mode(first_type);
+  bool fold = !m_settings.disable_math_const_prop;
   switch (math_type) {
     case MATH_INT:
     case MATH_BINT: {
-      auto result = env->make_gpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_val->to_gpr(env)));
+      // constants are added together and added at the end, so (+ 1 x 2) is x + 3.
+      RegVal* result = nullptr;
+      u64 constant = 0;
+      for (size_t i = 0; i < args.unnamed.size(); i++) {
+        auto val = i == 0 ? first_val
+                          : to_math_type(form, compile_error_guard(args.unnamed.at(i), env),
+                                         math_type, env);
+        s64 value;
+        if (fold && get_integer_constant(val, &value)) {
+          constant += value;
+          continue;
+        }
 
-      for (size_t i = 1; i < args.unnamed.size(); i++) {
-        env->emit(std::make_unique<IR_IntegerMath>(
-            IntegerMathKind::ADD_64, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                ->to_gpr(env)));
+        if (!result) {
+          result = env->make_gpr(first_type);
+          env->emit(std::make_unique<IR_RegSet>(result, val->to_gpr(env)));
+        } else {
+          env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::ADD_64, result,
+                                                     val->to_gpr(env)));
+        }
       }
-      return result;
-    }
-
-    case MATH_FLOAT: {
-      auto result = env->make_fpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
 
-      for (size_t i = 1; i < args.unnamed.size(); i++) {
-        env->emit(std::make_unique<IR_FloatMath>(
-            FloatMathKind::ADD_SS, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                ->to_fpr(env)));
+      if (!result) {
+        return compile_integer_constant(constant, first_type, env);
+      }
+      if (constant) {
+        env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::ADD_64, result,
+                                                   compile_integer(constant, env)->to_gpr(env)));
       }
       return result;
     }
+
+    case MATH_FLOAT:
+      if (args.unnamed.size() == 1) {
+        auto result = env->make_fpr(first_type);
+        env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
+        return result;
+      }
+      return compile_float_math(form, args, first_val, FloatMathKind::ADD_SS, env);
+
     case MATH_INVALID:
       throw_compiler_error(form, "Cannot do math on a {}.", first_type.print());
       break;
@@ -163,32 +407,70 @@ Val* Compiler::compile_mul(const goos::Object& form, const goos::Object& rest, E
   auto first_val = compile_error_guard(args.unnamed.at(0), env);
   auto first_type = first_val->type();
   auto math_type = get_math_mode(first_type);
+  bool fold = !m_settings.disable_math_const_prop;
   switch (math_type) {
     case MATH_INT: {
       // todo, signed vs unsigned?
-      auto result = env->make_gpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_val->to_gpr(env)));
+      // constants are multiplied together and multiplied at the end, so (* 2 x 4) is x * 8.
+      RegVal* result = nullptr;
+      int variable_count = 0;
+      s64 constant = 1;
+      for (size_t i = 0; i < args.unnamed.size(); i++) {
+        auto val = i == 0 ? first_val
+                          : to_math_type(form, compile_error_guard(args.unnamed.at(i), env),
+                                         math_type, env);
+        s64 value;
+        if (fold && get_integer_constant(val, &value)) {
+          constant = imul32(constant, value);
+          continue;
+        }
 
-      for (size_t i = 1; i < args.unnamed.size(); i++) {
-        env->emit(std::make_unique<IR_IntegerMath>(
-            IntegerMathKind::IMUL_32, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                ->to_gpr(env)));
+        variable_count++;
+        if (!result) {
+          result = env->make_gpr(first_type);
+          env->emit(std::make_unique<IR_RegSet>(result, val->to_gpr(env)));
+        } else {
+          env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::IMUL_32, result,
+                                                     val->to_gpr(env)));
+        }
       }
-      return result;
-    }
-    case MATH_FLOAT: {
-      auto result = env->make_fpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
 
-      for (size_t i = 1; i < args.unnamed.size(); i++) {
-        env->emit(std::make_unique<IR_FloatMath>(
-            FloatMathKind::MUL_SS, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                ->to_fpr(env)));
+      if (!result) {
+        if (args.unnamed.size() == 1) {
+          // nothing is multiplied, so it isn't truncated to 32-bits.
+          return first_val;
+        }
+        return compile_integer_constant(constant, first_type, env);
+      }
+
+      if (fold) {
+        int log2;
+        if (constant == 0) {
+          return compile_integer_constant(0, first_type, env);
+        } else if (is_power_of_two_32(constant, &log2)) {
+          // (* x) isn't truncated, and a multiply by 1 after imul is already 32-bits.
+          bool folded = int(args.unnamed.size()) > variable_count;
+          if (folded && (log2 > 0 || variable_count == 1)) {
+            // shift the low 32-bits to the top, then back down to sign extend.
+            env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SHL_64, result, 32 + log2));
+            env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SAR_64, result, 32));
+          }
+          return result;
+        }
+        env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::IMUL_32, result,
+                                                   compile_integer(constant, env)->to_gpr(env)));
       }
       return result;
     }
+
+    case MATH_FLOAT:
+      if (args.unnamed.size() == 1) {
+        auto result = env->make_fpr(first_type);
+        env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
+        return result;
+      }
+      return compile_float_math(form, args, first_val, FloatMathKind::MUL_SS, env);
+
     case MATH_INVALID:
       throw_compiler_error(form, "Cannot do math on a {}.", first_type.print());
       break;
@@ -289,53 +571,72 @@ Val* Compiler::compile_sub(const goos::Object& form, const goos::Object& rest, E
   auto first_val = compile_error_guard(args.unnamed.at(0), env);
   auto first_type = first_val->type();
   auto math_type = get_math_mode(first_type);
+  bool fold = !m_settings.disable_math_const_prop;
   switch (math_type) {
     case MATH_INT:
       if (args.unnamed.size() == 1) {
+        s64 value;
+        if (fold && get_integer_constant(first_val, &value)) {
+          return compile_integer_constant(-u64(value), first_type, env);
+        }
         auto result = compile_integer(0, env)->to_gpr(env);
-        env->emit(std::make_unique<IR_IntegerMath>(
-            IntegerMathKind::SUB_64, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(0), env), math_type, env)
-                ->to_gpr(env)));
+        env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SUB_64, result,
+                                                   first_val->to_gpr(env)));
         return result;
       } else {
-        auto result = env->make_gpr(first_type);
-        env->emit(std::make_unique<IR_RegSet>(
-            result, to_math_type(form, compile_error_guard(args.unnamed.at(0), env), math_type, env)
-                        ->to_gpr(env)));
+        // constants are added up and subtracted at the end, so (- x 1 2) is x - 3.
+        RegVal* result = nullptr;
+        u64 constant = 0;  // added to the result
+        for (size_t i = 0; i < args.unnamed.size(); i++) {
+          auto val = i == 0 ? first_val
+                            : to_math_type(form, compile_error_guard(args.unnamed.at(i), env),
+                                           math_type, env);
+          s64 value;
+          if (fold && get_integer_constant(val, &value)) {
+            constant += i == 0 ? value : -u64(value);
+            continue;
+          }
+
+          if (i == 0) {
+            result = env->make_gpr(first_type);
+            env->emit(std::make_unique<IR_RegSet>(result, val->to_gpr(env)));
+          } else {
+            if (!result) {
+              // the first value was a constant
+              result = env->make_gpr(first_type);
+              env->emit(std::make_unique<IR_RegSet>(result,
+                                                    compile_integer(constant, env)->to_gpr(env)));
+              constant = 0;
+            }
+            env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SUB_64, result,
+                                                       val->to_gpr(env)));
+          }
+        }
 
-        for (size_t i = 1; i < args.unnamed.size(); i++) {
+        if (!result) {
+          return compile_integer_constant(constant, first_type, env);
+        }
+        if (constant) {
           env->emit(std::make_unique<IR_IntegerMath>(
-              IntegerMathKind::SUB_64, result,
-              to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                  ->to_gpr(env)));
+              IntegerMathKind::SUB_64, result, compile_integer(-constant, env)->to_gpr(env)));
         }
         return result;
       }
 
     case MATH_FLOAT:
       if (args.unnamed.size() == 1) {
+        float value, negated;
+        if (fold && get_float_constant(first_val, &value) &&
+            fold_float_math(FloatMathKind::SUB_SS, 0, value, &negated)) {
+          return compile_float_constant(negated, env);
+        }
         auto result =
             compile_float(0, env, get_parent_env_of_type<FunctionEnv>(env)->segment)->to_fpr(env);
-        env->emit(std::make_unique<IR_FloatMath>(
-            FloatMathKind::SUB_SS, result,
-            to_math_type(form, compile_error_guard(args.unnamed.at(0), env), math_type, env)
-                ->to_fpr(env)));
-        return result;
-      } else {
-        auto result = env->make_fpr(first_type);
-        env->emit(std::make_unique<IR_RegSet>(
-            result, to_math_type(form, compile_error_guard(args.unnamed.at(0), env), math_type, env)
-                        ->to_fpr(env)));
-
-        for (size_t i = 1; i < args.unnamed.size(); i++) {
-          env->emit(std::make_unique<IR_FloatMath>(
-              FloatMathKind::SUB_SS, result,
-              to_math_type(form, compile_error_guard(args.unnamed.at(i), env), math_type, env)
-                  ->to_fpr(env)));
-        }
+        env->emit(std::make_unique<IR_FloatMath>(FloatMathKind::SUB_SS, result,
+                                                 first_val->to_fpr(env)));
         return result;
       }
+      return compile_float_math(form, args, first_val, FloatMathKind::SUB_SS, env);
 
     case MATH_INVALID:
       throw_compiler_error(form, "Cannot do math on a {}.", first_type.print());
@@ -356,35 +657,59 @@ Val* Compiler::compile_div(const goos::Object& form, const goos::Object& rest, E
   auto first_val = compile_error_guard(args.unnamed.at(0), env);
   auto first_type = first_val->type();
   auto math_type = get_math_mode(first_type);
+  bool fold = !m_settings.disable_math_const_prop;
   switch (math_type) {
     case MATH_INT: {
       auto fe = get_parent_env_of_type<FunctionEnv>(env);
-      auto first_thing = first_val->to_gpr(env);
-      auto result = env->make_gpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_thing));
+      s64 dividend, divisor;
+      bool constant_dividend = fold && get_integer_constant(first_val, &dividend);
+      RegVal* result = nullptr;
+      int result_set_idx = -1;
+      if (!constant_dividend) {
+        auto first_thing = first_val->to_gpr(env);
+        result = env->make_gpr(first_type);
+        env->emit(std::make_unique<IR_RegSet>(result, first_thing));
+        result_set_idx = fe->code().size();
+      }
+
+      auto second =
+          to_math_type(form, compile_error_guard(args.unnamed.at(1), env), math_type, env);
+      int log2;
+      if (fold && get_integer_constant(second, &divisor)) {
+        if (constant_dividend && can_idiv32(dividend, divisor)) {
+          return compile_integer_constant(idiv32(dividend, divisor), first_type, env);
+        }
+
+        if (!constant_dividend && is_power_of_two_32(divisor, &log2) && log2 < 31) {
+          sign_extend_32(result, env);
+          if (log2 > 0) {
+            env->emit(std::make_unique<IR_IntegerMath>(
+                IntegerMathKind::ADD_64, result, compile_division_bias(result, log2, env)));
+            env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SAR_64, result, log2));
+          }
+          return result;
+        }
+      }
+
+      if (!result) {
+        result = env->make_gpr(first_type);
+        env->emit(std::make_unique<IR_RegSet>(result, first_val->to_gpr(env)));
+        result_set_idx = fe->code().size();
+      }
 
       IRegConstraint result_rax_constraint;
-      result_rax_constraint.instr_idx = fe->code().size();
+      result_rax_constraint.instr_idx = result_set_idx;
       result_rax_constraint.ireg = result->ireg();
       result_rax_constraint.desired_register = emitter::RAX;
       fe->constrain(result_rax_constraint);
 
-      env->emit(std::make_unique<IR_IntegerMath>(
-          IntegerMathKind::IDIV_32, result,
-          to_math_type(form, compile_error_guard(args.unnamed.at(1), env), math_type, env)
-              ->to_gpr(env)));
+      env->emit(
+          std::make_unique<IR_IntegerMath>(IntegerMathKind::IDIV_32, result, second->to_gpr(env)));
       return result;
     }
 
-    case MATH_FLOAT: {
-      auto result = env->make_fpr(first_type);
-      env->emit(std::make_unique<IR_RegSet>(result, first_val->to_fpr(env)));
-      env->emit(std::make_unique<IR_FloatMath>(
-          FloatMathKind::DIV_SS, result,
-          to_math_type(form, compile_error_guard(args.unnamed.at(1), env), math_type, env)
-              ->to_fpr(env)));
-      return result;
-    }
+    case MATH_FLOAT:
+      return compile_float_math(form, args, first_val, FloatMathKind::DIV_SS, env);
 
     case MATH_INVALID:
       throw_compiler_error(form, "Cannot do math on a {}.", first_type.print());
@@ -505,8 +830,9 @@ Val* Compiler::compile_fixed_shift(const goos::Object& form,
 Val* Compiler::compile_mod(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   va_check(form, args, {{}, {}}, {});
-  auto first = compile_error_guard(args.unnamed.at(0), env)->to_gpr(env);
-  auto second = compile_error_guard(args.unnamed.at(1), env)->to_gpr(env);
+  bool fold = !m_settings.disable_math_const_prop;
+  auto first = to_gpr_or_constant(compile_error_guard(args.unnamed.at(0), env), fold, env);
+  auto second = to_gpr_or_constant(compile_error_guard(args.unnamed.at(1), env), fold, env);
   auto fenv = get_parent_env_of_type<FunctionEnv>(env);
 
   if (get_math_mode(first->type()) != MathMode::MATH_INT ||
@@ -515,8 +841,32 @@ Val* Compiler::compile_mod(const goos::Object& form, const goos::Object& rest, E
                          second->type().print());
   }
 
+  s64 dividend, divisor;
+  int log2;
+  if (fold && get_integer_constant(second, &divisor)) {
+    if (get_integer_constant(first, &dividend) && can_idiv32(dividend, divisor)) {
+      return compile_integer_constant(imod32(dividend, divisor), first->type(), env);
+    }
+
+    if (is_power_of_two_32(divisor, &log2) && log2 < 31) {
+      if (log2 == 0) {
+        return compile_integer_constant(0, first->type(), env);
+      }
+      // x - ((x / 2^k) << k), with the divide done like compile_div.
+      auto result = env->make_gpr(first->type());
+      env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
+      sign_extend_32(result, env);
+      auto rounded = compile_division_bias(result, log2, env);
+      env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::ADD_64, rounded, result));
+      env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SAR_64, rounded, log2));
+      env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SHL_64, rounded, log2));
+      env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::SUB_64, result, rounded));
+      return result;
+    }
+  }
+
   auto result = env->make_gpr(first->type());
-  env->emit(std::make_unique<IR_RegSet>(result, first));
+  env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
 
   IRegConstraint con;
   con.ireg = result->ireg();
@@ -524,71 +874,96 @@ Val* Compiler::compile_mod(const goos::Object& form, const goos::Object& rest, E
   con.desired_register = emitter::RAX;
 
   fenv->constrain(con);
-  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::IMOD_32, result, second));
+  env->emit(
+      std::make_unique<IR_IntegerMath>(IntegerMathKind::IMOD_32, result, second->to_gpr(env)));
   return result;
 }
 
 Val* Compiler::compile_logand(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   va_check(form, args, {{}, {}}, {});
-  auto first = compile_error_guard(args.unnamed.at(0), env)->to_gpr(env);
-  auto second = compile_error_guard(args.unnamed.at(1), env)->to_gpr(env);
+  bool fold = !m_settings.disable_math_const_prop;
+  auto first = to_gpr_or_constant(compile_error_guard(args.unnamed.at(0), env), fold, env);
+  auto second = to_gpr_or_constant(compile_error_guard(args.unnamed.at(1), env), fold, env);
   if (get_math_mode(first->type()) != MathMode::MATH_INT ||
       get_math_mode(second->type()) != MathMode::MATH_INT) {
     throw_compiler_error(form, "Cannot logand a {} by a {}.", first->type().print(),
                          second->type().print());
   }
 
+  s64 a, b;
+  if (get_integer_constant(first, &a) && get_integer_constant(second, &b)) {
+    return compile_integer_constant(a & b, first->type(), env);
+  }
+
   auto result = env->make_gpr(first->type());
-  env->emit(std::make_unique<IR_RegSet>(result, first));
-  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::AND_64, result, second));
+  env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::AND_64, result, second->to_gpr(env)));
   return result;
 }
 
 Val* Compiler::compile_logior(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   va_check(form, args, {{}, {}}, {});
-  auto first = compile_error_guard(args.unnamed.at(0), env)->to_gpr(env);
-  auto second = compile_error_guard(args.unnamed.at(1), env)->to_gpr(env);
+  bool fold = !m_settings.disable_math_const_prop;
+  auto first = to_gpr_or_constant(compile_error_guard(args.unnamed.at(0), env), fold, env);
+  auto second = to_gpr_or_constant(compile_error_guard(args.unnamed.at(1), env), fold, env);
   if (get_math_mode(first->type()) != MathMode::MATH_INT ||
       get_math_mode(second->type()) != MathMode::MATH_INT) {
     throw_compiler_error(form, "Cannot logior a {} by a {}.", first->type().print(),
                          second->type().print());
   }
 
+  s64 a, b;
+  if (get_integer_constant(first, &a) && get_integer_constant(second, &b)) {
+    return compile_integer_constant(a | b, first->type(), env);
+  }
+
   auto result = env->make_gpr(first->type());
-  env->emit(std::make_unique<IR_RegSet>(result, first));
-  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::OR_64, result, second));
+  env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::OR_64, result, second->to_gpr(env)));
   return result;
 }
 
 Val* Compiler::compile_logxor(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   va_check(form, args, {{}, {}}, {});
-  auto first = compile_error_guard(args.unnamed.at(0), env)->to_gpr(env);
-  auto second = compile_error_guard(args.unnamed.at(1), env)->to_gpr(env);
+  bool fold = !m_settings.disable_math_const_prop;
+  auto first = to_gpr_or_constant(compile_error_guard(args.unnamed.at(0), env), fold, env);
+  auto second = to_gpr_or_constant(compile_error_guard(args.unnamed.at(1), env), fold, env);
   if (get_math_mode(first->type()) != MathMode::MATH_INT ||
       get_math_mode(second->type()) != MathMode::MATH_INT) {
     throw_compiler_error(form, "Cannot logxor a {} by a {}.", first->type().print(),
                          second->type().print());
   }
 
+  s64 a, b;
+  if (get_integer_constant(first, &a) && get_integer_constant(second, &b)) {
+    return compile_integer_constant(a ^ b, first->type(), env);
+  }
+
   auto result = env->make_gpr(first->type());
-  env->emit(std::make_unique<IR_RegSet>(result, first));
-  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::XOR_64, result, second));
+  env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
+  env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::XOR_64, result, second->to_gpr(env)));
   return result;
 }
 
 Val* Compiler::compile_lognot(const goos::Object& form, const goos::Object& rest, Env* env) {
   auto args = get_va(form, rest);
   va_check(form, args, {{}}, {});
-  auto first = compile_error_guard(args.unnamed.at(0), env)->to_gpr(env);
+  bool fold = !m_settings.disable_math_const_prop;
+  auto first = to_gpr_or_constant(compile_error_guard(args.unnamed.at(0), env), fold, env);
   if (get_math_mode(first->type()) != MathMode::MATH_INT) {
     throw_compiler_error(form, "Cannot lognot a {}.", first->type().print());
   }
 
+  s64 value;
+  if (get_integer_constant(first, &value)) {
+    return compile_integer_constant(~value, first->type(), env);
+  }
+
   auto result = env->make_gpr(first->type());
-  env->emit(std::make_unique<IR_RegSet>(result, first));
+  env->emit(std::make_unique<IR_RegSet>(result, first->to_gpr(env)));
   env->emit(std::make_unique<IR_IntegerMath>(IntegerMathKind::NOT_64, result, nullptr));
   return result;
-}
\ No newline at end of file
+}
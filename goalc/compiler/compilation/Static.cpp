@@ -378,6 +378,7 @@ StaticResult Compiler::compile_static(const goos::Object& form, Env* env) {
     }
 
     // as a constant
+    m_build_cache.note_constant(name);
     auto kv = m_global_constants.find(form.as_symbol());
     if (kv != m_global_constants.end()) {
       // expand constant and compile again.
@@ -1881,6 +1881,29 @@ class IGen {
     return instr;
   }
 
+  /*!
+   * Convert a jump with a 32-bit offset (jmp_32 or a conditional jump above) to the same jump with
+   * an 8-bit offset. Returns false if the instruction isn't one of these jumps.
+   */
+  static bool jump_32_to_8(const Instruction& long_jump, Instruction* short_jump) {
+    if (long_jump.get_imm_size() != 4) {
+      return false;
+    }
+
+    if (long_jump.op == 0xe9 && !long_jump.op2_set) {
+      // jmp rel32 -> jmp rel8
+      *short_jump = Instruction(0xeb);
+    } else if (long_jump.op == 0x0f && long_jump.op2_set && (long_jump.op2 & 0xf0) == 0x80 &&
+               !long_jump.op3_set) {
+      // 0f 8x rel32 -> 7x rel8, with the same condition code.
+      *short_jump = Instruction(0x70 | (long_jump.op2 & 0x0f));
+    } else {
+      return false;
+    }
+    short_jump->set(Imm(1, 0));
+    return true;
+  }
+
   //;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
   //   FLOAT MATH
   //;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
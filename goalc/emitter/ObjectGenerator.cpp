@@ -4,7 +4,8 @@
  *
  * There are 5 steps:
  * 1. The user adds static data / instructions and specifies links.
- * 2. The functions and static data are laid out in memory
+ * 2. The instructions are optimized, jumps are shortened where possible, then the functions and
+ *    static data are laid out in memory
  * 3. The user specified links are updated according to the memory layout, and jumps are patched
  * 4. The link table is generated for each segment
  * 5. All segments and link tables are put into a final object file, along with a header.
@@ -14,9 +15,12 @@
  */
 
 #include "ObjectGenerator.h"
+#include "IGen.h"
+#include "Peephole.h"
 #include "goalc/debugger/DebugInfo.h"
 #include "common/goal_constants.h"
 #include "common/versions.h"
+#include "common/util/Profiler.h"
 
 namespace emitter {
 
@@ -24,8 +28,26 @@ namespace emitter {
  * Build an object file with the v3 format.
  */
 ObjectFileData ObjectGenerator::generate_data_v3() {
+  prof::Zone zone("generate-data");
   ObjectFileData out;
 
+  // optimize instructions and pick jump sizes (step 2, part 0)
+  if (m_settings.peephole) {
+    std::vector<int> changes_by_rule;
+    for (int seg = N_SEG; seg-- > 0;) {
+      run_peephole(seg, &changes_by_rule);
+    }
+    for (size_t i = 0; i < changes_by_rule.size(); i++) {
+      zone.counter(peephole_rules().at(i).name, changes_by_rule[i]);
+    }
+  }
+
+  if (m_settings.relax_jumps) {
+    for (int seg = N_SEG; seg-- > 0;) {
+      relax_jumps(seg);
+    }
+  }
+
   // do functions (step 2, part 1)
   for (int seg = N_SEG; seg-- > 0;) {
     auto& data = m_data_by_seg.at(seg);
@@ -103,6 +125,16 @@ ObjectFileData ObjectGenerator::generate_data_v3() {
   out.header = generate_header_v3();
   out.segment_data = std::move(m_data_by_seg);
   out.link_tables = std::move(m_link_by_seg);
+
+  if (zone.active()) {
+    s64 data_bytes = 0, link_bytes = 0;
+    for (int seg = 0; seg < N_SEG; seg++) {
+      data_bytes += out.segment_data[seg].size();
+      link_bytes += out.link_tables[seg].size();
+    }
+    zone.counter("data-bytes", data_bytes);
+    zone.counter("link-bytes", link_bytes);
+  }
   return out;
 }
 
@@ -356,7 +388,6 @@ void ObjectGenerator::handle_temp_jump_links(int seg) {
     assert(link.jump_instr.seg == seg);
     assert(link.dest.seg == seg);
     const auto& jump_instr = function.instructions.at(link.jump_instr.instr_id);
-    assert(jump_instr.get_imm_size() == 4);
 
     // 1). patch = instruction location + location of imm in instruction.
     int patch_location = function.instruction_to_byte_in_data.at(link.jump_instr.instr_id) +
@@ -369,7 +400,130 @@ void ObjectGenerator::handle_temp_jump_links(int seg) {
     int dest_rip =
         function.instruction_to_byte_in_data.at(function.ir_to_instruction.at(link.dest.ir_id));
 
-    patch_data<s32>(seg, patch_location, dest_rip - source_rip);
+    int offset = dest_rip - source_rip;
+    if (jump_instr.get_imm_size() == 1) {
+      // relax_jumps only picks the short version if the offset fits.
+      assert(offset >= INT8_MIN && offset <= INT8_MAX);
+      patch_data<s8>(seg, patch_location, offset);
+    } else {
+      assert(jump_instr.get_imm_size() == 4);
+      patch_data<s32>(seg, patch_location, offset);
+    }
+  }
+}
+
+/*!
+ * Run the peephole optimizer on each function in the segment. Instructions which will be patched
+ * during linking are not modified, and jump links are updated if the destination changes.
+ */
+void ObjectGenerator::run_peephole(int seg, std::vector<int>* changes_by_rule) {
+  auto& functions = m_function_data_by_seg.at(seg);
+  std::vector<PeepholeFunction> peephole_functions;
+  peephole_functions.reserve(functions.size());
+  for (auto& function : functions) {
+    peephole_functions.emplace_back(&function.instructions, &function.ir_to_instruction);
+  }
+
+  for (const auto& link : m_jump_temp_links_by_seg.at(seg)) {
+    peephole_functions.at(link.jump_instr.func_id)
+        .add_jump(link.jump_instr.instr_id, link.dest.ir_id);
+  }
+  for (const auto& links : m_symbol_instr_temp_links_by_seg.at(seg)) {
+    for (const auto& link : links.second) {
+      peephole_functions.at(link.rec.func_id).add_linked_instruction(link.rec.instr_id);
+    }
+  }
+  for (const auto& link : m_rip_func_temp_links_by_seg.at(seg)) {
+    peephole_functions.at(link.instr.func_id).add_linked_instruction(link.instr.instr_id);
+  }
+  for (const auto& link : m_rip_data_temp_links_by_seg.at(seg)) {
+    peephole_functions.at(link.instr.func_id).add_linked_instruction(link.instr.instr_id);
+  }
+
+  for (size_t func_id = 0; func_id < functions.size(); func_id++) {
+    auto& function = functions.at(func_id);
+    if (!emitter::run_peephole(peephole_functions.at(func_id), changes_by_rule)) {
+      continue;
+    }
+    // the debug info has its own copy of the instructions, used by the disassembler.
+    for (size_t i = 0; i < function.instructions.size(); i++) {
+      function.debug->instructions.at(i).instruction = function.instructions.at(i);
+    }
+  }
+
+  for (auto& link : m_jump_temp_links_by_seg.at(seg)) {
+    link.dest.ir_id =
+        peephole_functions.at(link.jump_instr.func_id).jump_dest_ir(link.jump_instr.instr_id);
+  }
+}
+
+/*!
+ * Replace jumps with their 8-bit offset versions, where the destination is close enough.
+ * This must happen before the functions are laid out.
+ *
+ * Shortening one jump can bring the destination of another jump in range, and a jump which doesn't
+ * fit makes the code around it longer. So this starts with every jump short, then makes the ones
+ * that don't fit long, and repeats until none change. Jumps only ever go from short to long, so
+ * this always finishes.
+ */
+void ObjectGenerator::relax_jumps(int seg) {
+  auto& functions = m_function_data_by_seg.at(seg);
+
+  // the jumps of each function, as (link index, long version of the jump)
+  std::vector<std::vector<std::pair<int, Instruction>>> jumps_by_function(functions.size());
+  const auto& links = m_jump_temp_links_by_seg.at(seg);
+  for (int i = 0; i < int(links.size()); i++) {
+    const auto& link = links.at(i);
+    auto& function = functions.at(link.jump_instr.func_id);
+    auto& instr = function.instructions.at(link.jump_instr.instr_id);
+    Instruction short_jump(0);
+    if (IGen::jump_32_to_8(instr, &short_jump)) {
+      jumps_by_function.at(link.jump_instr.func_id).emplace_back(i, instr);
+      instr = short_jump;
+    }
+  }
+
+  std::vector<int> instruction_offsets;
+  for (size_t func_id = 0; func_id < functions.size(); func_id++) {
+    auto& function = functions.at(func_id);
+    auto& jumps = jumps_by_function.at(func_id);
+    if (jumps.empty()) {
+      continue;
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      // offsets from the start of the function. The extra entry is the end of the function.
+      instruction_offsets.resize(function.instructions.size() + 1);
+      int offset = 0;
+      for (size_t i = 0; i < function.instructions.size(); i++) {
+        instruction_offsets[i] = offset;
+        offset += function.instructions[i].length();
+      }
+      instruction_offsets.back() = offset;
+
+      for (auto& jump : jumps) {
+        const auto& link = links.at(jump.first);
+        auto& instr = function.instructions.at(link.jump_instr.instr_id);
+        if (instr.get_imm_size() != 1) {
+          continue;
+        }
+        int source_rip = instruction_offsets.at(link.jump_instr.instr_id + 1);
+        int dest_rip = instruction_offsets.at(function.ir_to_instruction.at(link.dest.ir_id));
+        int diff = dest_rip - source_rip;
+        if (diff < INT8_MIN || diff > INT8_MAX) {
+          instr = jump.second;
+          changed = true;
+        }
+      }
+    }
+
+    // the debug info has its own copy of the instructions, used by the disassembler.
+    for (auto& jump : jumps) {
+      int instr_id = links.at(jump.first).jump_instr.instr_id;
+      function.debug->instructions.at(instr_id).instruction = function.instructions.at(instr_id);
+    }
   }
 }
 
@@ -55,9 +55,17 @@ struct StaticRecord {
   int static_id = -1;
 };
 
+/*!
+ * Optimizations done by the ObjectGenerator. These can be turned off for debugging.
+ */
+struct ObjectGeneratorSettings {
+  bool peephole = true;
+  bool relax_jumps = true;
+};
+
 class ObjectGenerator {
  public:
-  ObjectGenerator() = default;
+  explicit ObjectGenerator(const ObjectGeneratorSettings& settings = {}) : m_settings(settings) {}
   ObjectFileData generate_data_v3();
 
   FunctionRecord add_function_to_seg(int seg,
@@ -96,6 +104,9 @@ class ObjectGenerator {
   void handle_temp_rip_func_links(int seg);
   void handle_temp_static_ptr_links(int seg);
 
+  void run_peephole(int seg, std::vector<int>* changes_by_rule);
+  void relax_jumps(int seg);
+
   void emit_link_table(int seg);
   void emit_link_type_pointer(int seg);
   void emit_link_symbol(int seg);
@@ -215,6 +226,7 @@ class ObjectGenerator {
   seg_vector<PointerLink> m_pointer_links_by_seg;
 
   std::vector<FunctionRecord> m_all_function_records;
+  ObjectGeneratorSettings m_settings;
 };
 }  // namespace emitter
 
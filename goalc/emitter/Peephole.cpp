@@ -0,0 +1,279 @@
+/*!
+ * @file Peephole.cpp
+ * Peephole optimizer for the x86 instructions of a function.
+ */
+
+#include <cassert>
+#include <cstring>
+#include "Peephole.h"
+#include "IGen.h"
+
+namespace emitter {
+
+PeepholeFunction::PeepholeFunction(std::vector<Instruction>* instructions,
+                                   const std::vector<int>* ir_to_instruction)
+    : m_instructions(instructions),
+      m_ir_to_instruction(ir_to_instruction),
+      m_is_jump_target(instructions->size(), false),
+      m_is_linked(instructions->size(), false),
+      m_jump_dest_ir(instructions->size(), -1) {}
+
+/*!
+ * Add a jump from the instruction to the first instruction of the given IR.
+ */
+void PeepholeFunction::add_jump(int instr_idx, int dest_ir) {
+  m_jump_dest_ir.at(instr_idx) = dest_ir;
+  m_is_jump_target.at(m_ir_to_instruction->at(dest_ir)) = true;
+}
+
+/*!
+ * Mark an instruction which will be patched by the linker. These must not be changed.
+ */
+void PeepholeFunction::add_linked_instruction(int instr_idx) {
+  m_is_linked.at(instr_idx) = true;
+}
+
+/*!
+ * Get the index of the next instruction after idx that isn't null, or -1 if there isn't one.
+ */
+int PeepholeFunction::next(int idx) const {
+  for (int i = idx + 1; i < size(); i++) {
+    if (!m_instructions->at(i).is_null) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*!
+ * Is any instruction in [first, last] the destination of a jump?
+ */
+bool PeepholeFunction::any_jump_target(int first, int last) const {
+  for (int i = first; i <= last; i++) {
+    if (m_is_jump_target.at(i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * Get the index of the first instruction that is actually run after jumping, or -1 if there isn't
+ * one.
+ */
+int PeepholeFunction::jump_dest_instr(int idx) const {
+  int dest = m_ir_to_instruction->at(jump_dest_ir(idx));
+  if (!m_instructions->at(dest).is_null) {
+    return dest;
+  }
+  return next(dest);
+}
+
+void PeepholeFunction::set_jump_dest_ir(int idx, int dest_ir) {
+  assert(is_jump(idx));
+  // the old destination is still marked as a jump target, which is just more conservative.
+  add_jump(idx, dest_ir);
+}
+
+/*!
+ * Remove an instruction. It stays in the function as a null instruction.
+ */
+void PeepholeFunction::remove(int idx) {
+  assert(!is_linked(idx));
+  assert(!is_jump(idx));
+  m_instructions->at(idx) = IGen::null();
+}
+
+namespace {
+
+bool same_bytes(const Instruction& a, const Instruction& b) {
+  u8 a_bytes[128], b_bytes[128];
+  auto a_count = a.emit(a_bytes);
+  auto b_count = b.emit(b_bytes);
+  return a_count == b_count && !memcmp(a_bytes, b_bytes, a_count);
+}
+
+/*!
+ * Is this a mov of a 64-bit gpr to memory?
+ */
+bool is_store64_gpr64(const Instruction& instr) {
+  return !instr.is_null && instr.n_vex == 0 && instr.set_rex && (instr.m_rex & 0b1000) &&
+         instr.op == 0x89 && !instr.op2_set && instr.set_modrm && (instr.m_modrm >> 6) != 3;
+}
+
+/*!
+ * If this is a mov_gpr64_gpr64, get the registers (as hw ids).
+ */
+bool is_mov_gpr64_gpr64(const Instruction& instr, int* dst, int* src) {
+  if (instr.is_null || instr.n_vex != 0 || !instr.set_rex || !(instr.m_rex & 0b1000) ||
+      instr.op != 0x89 || instr.op2_set || !instr.set_modrm || (instr.m_modrm >> 6) != 3 ||
+      instr.set_sib || instr.set_disp_imm || instr.set_imm) {
+    return false;
+  }
+  *dst = (instr.m_modrm & 0b111) | ((instr.m_rex & 0b0001) << 3);
+  *src = ((instr.m_modrm >> 3) & 0b111) | ((instr.m_rex & 0b0100) << 1);
+  return true;
+}
+
+/*!
+ * mov [addr], rax
+ * mov rax, [addr]  <- removed, rax already has this value.
+ * This often happens when a spilled variable is stored and loaded again by the next IR.
+ */
+bool remove_reload_after_store(PeepholeFunction& f, int idx) {
+  const auto& store = f.at(idx);
+  if (!is_store64_gpr64(store) || f.is_linked(idx)) {
+    return false;
+  }
+
+  int load_idx = f.next(idx);
+  if (load_idx < 0 || f.any_jump_target(idx + 1, load_idx) || f.is_linked(load_idx)) {
+    return false;
+  }
+
+  auto expected_load = store;
+  expected_load.op = 0x8b;
+  if (!same_bytes(expected_load, f.at(load_idx))) {
+    return false;
+  }
+
+  f.remove(load_idx);
+  return true;
+}
+
+/*!
+ * mov rax, rbx  <- removed, rax is overwritten before it is used.
+ * mov rax, rcx
+ */
+bool remove_overwritten_move(PeepholeFunction& f, int idx) {
+  int first_dst, first_src;
+  if (!is_mov_gpr64_gpr64(f.at(idx), &first_dst, &first_src) || f.is_linked(idx)) {
+    return false;
+  }
+
+  int next_idx = f.next(idx);
+  int next_dst, next_src;
+  if (next_idx < 0 || f.any_jump_target(idx + 1, next_idx) ||
+      !is_mov_gpr64_gpr64(f.at(next_idx), &next_dst, &next_src)) {
+    return false;
+  }
+
+  if (next_dst != first_dst || next_src == first_dst) {
+    return false;
+  }
+
+  f.remove(idx);
+  return true;
+}
+
+/*!
+ * mov rax, [rsp + 8] with a 32-bit displacement -> mov rax, [rsp + 8] with an 8-bit displacement.
+ * This works on any instruction with a memory operand, as the ModRM byte works the same way for all
+ * of them.
+ */
+bool use_short_displacement(PeepholeFunction& f, int idx) {
+  auto& instr = f.at(idx);
+  if (instr.is_null || f.is_linked(idx) || !instr.set_modrm || (instr.m_modrm >> 6) != 2) {
+    return false;
+  }
+
+  // some instructions store the displacement as the immediate. This is fine because they have no
+  // other immediate, and it is emitted in the same place.
+  Imm* disp = nullptr;
+  if (instr.set_disp_imm) {
+    disp = &instr.disp;
+  } else if (instr.set_imm) {
+    disp = &instr.imm;
+  }
+
+  if (!disp || disp->size != 4) {
+    return false;
+  }
+
+  s32 value = disp->value;
+  if (value < INT8_MIN || value > INT8_MAX) {
+    return false;
+  }
+
+  instr.m_modrm = (instr.m_modrm & 0b00111111) | 0b01000000;
+  *disp = Imm(1, value);
+  return true;
+}
+
+/*!
+ * jne L1         -> jne L2
+ * ...
+ * L1: jmp L2
+ */
+bool jump_to_final_destination(PeepholeFunction& f, int idx) {
+  if (!f.is_jump(idx)) {
+    return false;
+  }
+
+  int dest = f.jump_dest_instr(idx);
+  if (dest < 0 || !f.is_jump(dest)) {
+    return false;
+  }
+
+  const auto& dest_instr = f.at(dest);
+  if (dest_instr.op != 0xe9 || dest_instr.op2_set) {
+    // conditional.
+    return false;
+  }
+
+  int final_dest_ir = f.jump_dest_ir(dest);
+  if (final_dest_ir == f.jump_dest_ir(idx)) {
+    return false;
+  }
+  f.set_jump_dest_ir(idx, final_dest_ir);
+  return true;
+}
+
+}  // namespace
+
+/*!
+ * All peephole rules, in the order they are tried.
+ */
+const std::vector<PeepholeRuleInfo>& peephole_rules() {
+  static const std::vector<PeepholeRuleInfo> rules = {
+      {"remove-reload-after-store", remove_reload_after_store},
+      {"remove-overwritten-move", remove_overwritten_move},
+      {"use-short-displacement", use_short_displacement},
+      {"jump-to-final-destination", jump_to_final_destination}};
+  return rules;
+}
+
+/*!
+ * Run all rules on the function. Returns the number of changes made. If changes_by_rule is set,
+ * the number of changes made by each rule is added to it.
+ */
+int run_peephole(PeepholeFunction& f, std::vector<int>* changes_by_rule) {
+  const auto& rules = peephole_rules();
+  if (changes_by_rule) {
+    changes_by_rule->resize(rules.size());
+  }
+
+  // a change can make another rule apply to an earlier instruction, so do a few passes.
+  constexpr int MAX_PASSES = 4;
+  int total_changes = 0;
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    int changes = 0;
+    for (int idx = 0; idx < f.size(); idx++) {
+      for (size_t rule_idx = 0; rule_idx < rules.size(); rule_idx++) {
+        if (rules[rule_idx].rule(f, idx)) {
+          changes++;
+          if (changes_by_rule) {
+            changes_by_rule->at(rule_idx)++;
+          }
+        }
+      }
+    }
+    total_changes += changes;
+    if (!changes) {
+      break;
+    }
+  }
+  return total_changes;
+}
+
+}  // namespace emitter
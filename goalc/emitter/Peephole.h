@@ -0,0 +1,67 @@
+#pragma once
+
+/*!
+ * @file Peephole.h
+ * Peephole optimizer for the x86 instructions of a function.
+ *
+ * This runs after codegen, before the function is laid out in memory. Each rule looks at one
+ * instruction and the ones right after it. Removed instructions are replaced with IGen::null(), so
+ * instruction indices (and the IR -> instruction map, links, and debug info) stay valid.
+ */
+
+#ifndef JAK_PEEPHOLE_H
+#define JAK_PEEPHOLE_H
+
+#include <vector>
+#include "Instruction.h"
+
+namespace emitter {
+
+/*!
+ * The instructions of a single function, plus what the optimizer needs to know about control flow
+ * and linking.
+ */
+class PeepholeFunction {
+ public:
+  PeepholeFunction(std::vector<Instruction>* instructions,
+                   const std::vector<int>* ir_to_instruction);
+
+  void add_jump(int instr_idx, int dest_ir);
+  void add_linked_instruction(int instr_idx);
+
+  int size() const { return int(m_instructions->size()); }
+  Instruction& at(int idx) { return m_instructions->at(idx); }
+  int next(int idx) const;
+  bool any_jump_target(int first, int last) const;
+  bool is_linked(int idx) const { return m_is_linked.at(idx); }
+  bool is_jump(int idx) const { return m_jump_dest_ir.at(idx) >= 0; }
+  int jump_dest_ir(int idx) const { return m_jump_dest_ir.at(idx); }
+  int jump_dest_instr(int idx) const;
+  void set_jump_dest_ir(int idx, int dest_ir);
+  void remove(int idx);
+
+ private:
+  std::vector<Instruction>* m_instructions = nullptr;
+  const std::vector<int>* m_ir_to_instruction = nullptr;
+  std::vector<bool> m_is_jump_target;
+  std::vector<bool> m_is_linked;
+  std::vector<int> m_jump_dest_ir;  // -1 if not a jump.
+};
+
+/*!
+ * A peephole rule. It may change or remove the instruction at idx, and the instructions after it.
+ * Returns true if anything was changed.
+ */
+using PeepholeRule = bool (*)(PeepholeFunction& f, int idx);
+
+struct PeepholeRuleInfo {
+  const char* name;
+  PeepholeRule rule;
+};
+
+const std::vector<PeepholeRuleInfo>& peephole_rules();
+int run_peephole(PeepholeFunction& f, std::vector<int>* changes_by_rule = nullptr);
+
+}  // namespace emitter
+
+#endif  // JAK_PEEPHOLE_H
@@ -0,0 +1,279 @@
+/*!
+ * @file goos_bench.cpp
+ * Benchmark for the GOOS reader and macro expander.
+ *
+ * Reads every file in goal_src and expands every GOAL macro use (recursively) without compiling
+ * anything. Prints the time taken and the peak memory use. Run with -no-pool to allocate GOOS
+ * objects with the normal allocator instead of the pools in ObjectHeap.h, or with -no-bytecode to
+ * evaluate macros without compiling them to bytecode, for comparison. With -read-jobs n, the files
+ * are read on n threads (see Reader::read_from_files).
+ *
+ * With -pretty-print, it instead pretty prints a single form containing all of goal_src and the
+ * decompiler's type definitions a few times over (several MB of text), to a string and to a file.
+ *
+ *   goos-bench [-no-pool] [-no-bytecode] [-read-jobs n] [-pretty-print] [-iterations n]
+ */
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+#include "goalc/compiler/Compiler.h"
+#include "common/goos/ObjectHeap.h"
+#include "common/goos/PrettyPrinter.h"
+#include "common/log/log.h"
+#include "common/util/FileUtil.h"
+#include "common/util/ThreadPool.h"
+#include "common/util/Timer.h"
+
+namespace {
+
+struct ExpandStats {
+  int forms = 0;
+  int expansions = 0;
+  int errors = 0;  // macro uses that couldn't be expanded without compiling.
+};
+
+/*!
+ * Peak resident set size of this process, in MB. Returns -1 if unknown.
+ */
+double peak_rss_mb() {
+#ifdef __linux__
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return usage.ru_maxrss / 1024.;  // ru_maxrss is in kB
+  }
+#endif
+  return -1;
+}
+
+std::vector<std::vector<std::string>> find_source_files() {
+  std::vector<std::vector<std::string>> result;
+  auto root = std::filesystem::path(file_util::get_file_path({"goal_src"}));
+  for (auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".gc") {
+      std::vector<std::string> path = {"goal_src"};
+      for (auto& part : std::filesystem::relative(entry.path(), root)) {
+        path.push_back(part.string());
+      }
+      result.push_back(path);
+    }
+  }
+  return result;
+}
+
+/*!
+ * Expand a single macro use, the same way the compiler does.
+ */
+goos::Object expand_macro(goos::Interpreter& goos,
+                          const goos::Object& form,
+                          const goos::Object& macro_obj) {
+  auto macro = macro_obj.as_macro();
+  auto rest = form.as_pair()->cdr;
+  auto args = goos.get_args(form, rest, macro->args);
+  auto mac_env_obj = goos::EnvironmentObject::make_new();
+  auto mac_env = mac_env_obj.as_env();
+  mac_env->parent_env = goos.global_environment.as_env();
+  goos.set_args_in_env(form, args, macro->args, mac_env);
+  return goos.eval_body(*macro, mac_env);
+}
+
+/*!
+ * Expand all macros in form and its children. Returns the expanded form.
+ */
+goos::Object expand_all(goos::Interpreter& goos, const goos::Object& form, ExpandStats* stats) {
+  if (!form.is_pair()) {
+    return form;
+  }
+  stats->forms++;
+
+  auto head = form.as_pair()->car;
+  if (head.is_symbol()) {
+    auto& name = head.as_symbol()->name;
+    if (name == "quote" || name == "quasiquote") {
+      return form;
+    }
+
+    if (name == "seval") {
+      // GOOS code, which may define new macros. Evaluate it like the compiler does.
+      auto current = form.as_pair()->cdr;
+      while (current.is_pair()) {
+        try {
+          goos.eval(current.as_pair()->car, goos.global_environment.as_env());
+        } catch (std::runtime_error&) {
+          stats->errors++;
+        }
+        current = current.as_pair()->cdr;
+      }
+      return form;
+    }
+
+    auto macro = goos.goal_env.as_env()->find_var(head.as_symbol());
+    if (macro && macro->is_macro()) {
+      goos::Object expanded;
+      try {
+        expanded = expand_macro(goos, form, *macro);
+      } catch (std::runtime_error&) {
+        stats->errors++;
+        return form;
+      }
+      stats->expansions++;
+      return expand_all(goos, expanded, stats);
+    }
+  }
+
+  // not a macro, expand the elements of the list.
+  std::vector<goos::Object> elts;
+  auto current = form;
+  while (current.is_pair()) {
+    elts.push_back(expand_all(goos, current.as_pair()->car, stats));
+    current = current.as_pair()->cdr;
+  }
+  auto result = current;
+  for (auto it = elts.rbegin(); it != elts.rend(); ++it) {
+    result = goos::PairObject::make_new(*it, result);
+  }
+  return result;
+}
+
+/*!
+ * Pretty print the code in goal_src and the decompiler's type definitions, as one big list.
+ */
+int bench_pretty_print(int iterations) {
+  constexpr int COPIES = 4;
+  auto& reader = pretty_print::get_pretty_printer_reader();
+  auto files = find_source_files();
+  files.push_back({"decompiler", "config", "all-types.gc"});
+  std::vector<goos::Object> forms;
+  for (auto& file : files) {
+    auto code = reader.read_from_file(file);
+    for (auto form = code.as_pair()->cdr; form.is_pair(); form = form.as_pair()->cdr) {
+      forms.push_back(form.as_pair()->car);
+    }
+  }
+  std::vector<goos::Object> copies(COPIES, pretty_print::build_list(forms));
+  auto all_code = pretty_print::build_list(copies);
+
+  double best_string = 0, best_file = 0;
+  size_t size = 0;
+  for (int iter = 0; iter < iterations; iter++) {
+    Timer string_timer;
+    size = pretty_print::to_string(all_code).size();
+    double string_ms = string_timer.getMs();
+
+    FILE* fp = tmpfile();
+    if (!fp) {
+      printf("failed to create a temporary file\n");
+      return 1;
+    }
+    Timer file_timer;
+    pretty_print::to_file(fp, all_code);
+    double file_ms = file_timer.getMs();
+    fclose(fp);
+
+    printf("  iteration %d: to_string %.1f ms, to_file %.1f ms\n", iter, string_ms, file_ms);
+    if (iter == 0 || string_ms < best_string) {
+      best_string = string_ms;
+    }
+    if (iter == 0 || file_ms < best_file) {
+      best_file = file_ms;
+    }
+  }
+
+  printf("%d forms, %.1f MB of text\n", COPIES * (int)forms.size(), size / (1024. * 1024.));
+  printf("best: to_string %.1f ms, to_file %.1f ms\n", best_string, best_file);
+  printf("peak RSS %.1f MB\n", peak_rss_mb());
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 3;
+  bool use_bytecode = true;
+  int read_jobs = 1;
+  bool pretty_print = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string("-no-pool") == argv[i]) {
+      goos::heap::set_pool_enabled(false);
+    } else if (std::string("-no-bytecode") == argv[i]) {
+      use_bytecode = false;
+    } else if (std::string("-read-jobs") == argv[i] && i < argc - 1) {
+      read_jobs = std::stoi(argv[++i]);
+    } else if (std::string("-pretty-print") == argv[i]) {
+      pretty_print = true;
+    } else if (std::string("-iterations") == argv[i] && i < argc - 1) {
+      iterations = std::stoi(argv[++i]);
+    } else {
+      printf(
+          "usage: goos-bench [-no-pool] [-no-bytecode] [-read-jobs n] [-pretty-print] "
+          "[-iterations n]\n");
+      return 1;
+    }
+  }
+
+  lg::set_stdout_level(lg::level::warn);
+  lg::initialize();
+
+  if (pretty_print) {
+    return bench_pretty_print(iterations);
+  }
+
+  // the compiler defines the GOAL macros from goal-lib.
+  Compiler compiler;
+  auto& goos = compiler.get_goos();
+  goos.set_bytecode_enabled(use_bytecode);
+  goos.disable_printfs();
+  auto files = find_source_files();
+  std::unique_ptr<ThreadPool> read_pool;
+  if (read_jobs > 1) {
+    read_pool = std::make_unique<ThreadPool>(read_jobs);
+  }
+  printf("pool %s, bytecode %s, %d read jobs, %d files, peak RSS after startup %.1f MB\n",
+         goos::heap::pool_enabled() ? "enabled" : "disabled", use_bytecode ? "enabled" : "disabled",
+         read_jobs, (int)files.size(), peak_rss_mb());
+
+  double best_read = 0, best_expand = 0;
+  ExpandStats stats;
+  for (int iter = 0; iter < iterations; iter++) {
+    // keep everything alive until the end of the iteration, like the compiler does.
+    std::vector<goos::Object> code, expanded;
+    stats = ExpandStats();
+
+    Timer read_timer;
+    if (read_pool) {
+      code = goos.reader.read_from_files(files, *read_pool);
+    } else {
+      for (auto& file : files) {
+        code.push_back(goos.reader.read_from_file(file));
+      }
+    }
+    double read_ms = read_timer.getMs();
+
+    Timer expand_timer;
+    for (auto& c : code) {
+      expanded.push_back(expand_all(goos, c, &stats));
+    }
+    double expand_ms = expand_timer.getMs();
+
+    printf("  iteration %d: read %.1f ms, expand %.1f ms\n", iter, read_ms, expand_ms);
+    if (iter == 0 || read_ms < best_read) {
+      best_read = read_ms;
+    }
+    if (iter == 0 || expand_ms < best_expand) {
+      best_expand = expand_ms;
+    }
+  }
+
+  auto pool_stats = goos::heap::get_pool_stats();
+  printf("%d forms, %d expansions, %d failed expansions\n", stats.forms, stats.expansions,
+         stats.errors);
+  printf("best: read %.1f ms, expand %.1f ms\n", best_read, best_expand);
+  printf("peak RSS %.1f MB, pool chunks %.1f MB\n", peak_rss_mb(),
+         pool_stats.chunk_bytes / (1024. * 1024.));
+  return 0;
+}
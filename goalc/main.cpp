@@ -24,6 +24,7 @@ int main(int argc, char** argv) {
 
   std::string argument;
   bool verbose = false;
+  bool use_snapshot = true;
   for (int i = 1; i < argc; i++) {
     if (std::string("-v") == argv[i]) {
       verbose = true;
@@ -33,12 +34,16 @@ int main(int argc, char** argv) {
     if (std::string("-cmd") == argv[i] && i < argc - 1) {
       argument = argv[++i];
     }
+
+    if (std::string("-no-snapshot") == argv[i]) {
+      use_snapshot = false;
+    }
   }
   setup_logging(verbose);
 
   lg::info("OpenGOAL Compiler {}.{}", versions::GOAL_VERSION_MAJOR, versions::GOAL_VERSION_MINOR);
 
-  Compiler compiler;
+  Compiler compiler(use_snapshot);
 
   if (argument.empty()) {
     compiler.execute_repl();
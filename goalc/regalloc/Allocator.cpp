@@ -111,11 +111,8 @@ void compute_live_ranges(RegAllocCache* cache, const AllocationInput& in) {
     // and liveliness analysis
     assert(block.live.size() == block.instr_idx.size());
     for (uint32_t i = 0; i < block.live.size(); i++) {
-      for (int j = 0; j < block.live[i].size(); j++) {
-        if (block.live[i][j]) {
-          cache->live_ranges.at(j).add_live_instruction(block.instr_idx.at(i));
-        }
-      }
+      block.live[i].for_each(
+          [&](int j) { cache->live_ranges.at(j).add_live_instruction(block.instr_idx.at(i)); });
     }
   }
 
@@ -192,6 +189,19 @@ void analyze_liveliness(RegAllocCache* cache, const AllocationInput& in) {
       }
     }
   }
+
+  // and where each register is clobbered or excluded, so ranges can be checked without looking at
+  // every instruction.
+  cache->reg_clobbered.assign(emitter::RegisterInfo::N_REGS, InstrSet(in.instructions.size()));
+  cache->reg_excluded.assign(emitter::RegisterInfo::N_REGS, InstrSet(in.instructions.size()));
+  for (u32 i = 0; i < in.instructions.size(); i++) {
+    for (auto clobber : in.instructions.at(i).clobber) {
+      cache->reg_clobbered.at(clobber.id()).insert(i);
+    }
+    for (auto exclusive : in.instructions.at(i).exclude) {
+      cache->reg_excluded.at(exclusive.id()).insert(i);
+    }
+  }
 }
 
 void RegAllocBasicBlock::analyze_liveliness_phase1(const std::vector<RegAllocInstr>& instructions) {
@@ -404,12 +414,106 @@ bool check_constrained_alloc(RegAllocCache* cache, const AllocationInput& in) {
 
 namespace {
 
+/*!
+ * Record that var's assignment at instr uses a register, if var is live there.
+ */
+void mark_occupied(int var, int instr, RegAllocCache* cache) {
+  auto& lr = cache->live_ranges.at(var);
+  auto& ass = lr.get(instr);
+  if (ass.reg != -1 && lr.is_live_at_instr(instr)) {
+    cache->reg_occupied.at(ass.reg.id()).insert(instr);
+  }
+}
+
 /*!
  * Assign variable to register. Don't check if its safe. If it's already assigned, and this would
  * change that assignment, throw.
  */
 void assign_var_no_check(int var, Assignment ass, RegAllocCache* cache) {
-  cache->live_ranges.at(var).assign_no_overwrite(ass);
+  auto& lr = cache->live_ranges.at(var);
+  lr.assign_no_overwrite(ass);
+  for (int instr = lr.min; instr <= lr.max; instr++) {
+    mark_occupied(var, instr, cache);
+  }
+}
+
+/*!
+ * Does assigning var to ass at instr conflict with another variable live at instr?
+ */
+bool conflicts_with_other_var_at(int var,
+                                 int instr,
+                                 Assignment ass,
+                                 RegAllocCache* cache,
+                                 const AllocationInput& in,
+                                 bool debug_print) {
+  auto& lr = cache->live_ranges.at(var);
+  for (int other_idx : cache->live_ranges_by_instr.at(instr)) {
+    auto& other_lr = cache->live_ranges.at(other_idx);
+    if (other_lr.var == var) {
+      continue;
+    }
+    // LR's overlap
+    if (/*(instr != other_lr.max) && */ other_lr.conflicts_at(instr, ass)) {
+      bool allowed_by_move_eliminator = false;
+      if (move_eliminator) {
+        if (enable_fancy_coloring) {
+          if (lr.dies_next_at_instr(instr) && other_lr.becomes_live_at_instr(instr) &&
+              (allow_read_write_same_reg || in.instructions.at(instr).is_move)) {
+            allowed_by_move_eliminator = true;
+          }
+
+          if (lr.becomes_live_at_instr(instr) && other_lr.dies_next_at_instr(instr) &&
+              (allow_read_write_same_reg || in.instructions.at(instr).is_move)) {
+            allowed_by_move_eliminator = true;
+          }
+        } else {
+          // case to allow rename (from us to them)
+          if (instr == lr.max && instr == other_lr.min && in.instructions.at(instr).is_move) {
+            allowed_by_move_eliminator = true;
+          }
+
+          if (instr == lr.min && instr == other_lr.min && in.instructions.at(instr).is_move) {
+            allowed_by_move_eliminator = true;
+          }
+        }
+      }
+
+      if (!allowed_by_move_eliminator) {
+        if (debug_print) {
+          printf("at idx %d, %s conflicts\n", instr, other_lr.print_assignment().c_str());
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*!
+ * Find the first instruction in [min, max] where reg is in the set, or -1.
+ * With the reference check, scan every instruction and call the slow check.
+ */
+template <typename T>
+int find_first_in_range(const std::vector<InstrSet>& sets,
+                        emitter::Register reg,
+                        int min,
+                        int max,
+                        bool reference,
+                        T&& slow_check) {
+  if (reference) {
+    for (int instr = min; instr <= max; instr++) {
+      if (slow_check(instr)) {
+        return instr;
+      }
+    }
+    return -1;
+  }
+
+  if (reg == -1) {
+    return -1;
+  }
+  int result = sets.at(reg.id()).find_next(min);
+  return result <= max ? result : -1;
 }
 
 /*!
@@ -423,84 +527,72 @@ bool can_var_be_assigned(int var,
   // our live range:
   auto& lr = cache->live_ranges.at(var);
   // check against all other live ranges:
-  for (int instr = lr.min; instr <= lr.max; instr++) {
-    for (int other_idx : cache->live_ranges_by_instr.at(instr)) {
-      auto& other_lr = cache->live_ranges.at(other_idx);
-      if (other_lr.var == var) {
-        continue;
-      }
-      // LR's overlap
-      if (/*(instr != other_lr.max) && */ other_lr.conflicts_at(instr, ass)) {
-        bool allowed_by_move_eliminator = false;
-        if (move_eliminator) {
-          if (enable_fancy_coloring) {
-            if (lr.dies_next_at_instr(instr) && other_lr.becomes_live_at_instr(instr) &&
-                (allow_read_write_same_reg || in.instructions.at(instr).is_move)) {
-              allowed_by_move_eliminator = true;
-            }
-
-            if (lr.becomes_live_at_instr(instr) && other_lr.dies_next_at_instr(instr) &&
-                (allow_read_write_same_reg || in.instructions.at(instr).is_move)) {
-              allowed_by_move_eliminator = true;
-            }
-          } else {
-            // case to allow rename (from us to them)
-            if (instr == lr.max && instr == other_lr.min && in.instructions.at(instr).is_move) {
-              allowed_by_move_eliminator = true;
-            }
-
-            if (instr == lr.min && instr == other_lr.min && in.instructions.at(instr).is_move) {
-              allowed_by_move_eliminator = true;
-            }
-          }
-        }
-
-        if (!allowed_by_move_eliminator) {
-          if (debug_trace >= 1) {
-            printf("at idx %d, %s conflicts\n", instr, other_lr.print_assignment().c_str());
-          }
-
-          return false;
-        }
+  if (cache->reference_conflict_check) {
+    for (int instr = lr.min; instr <= lr.max; instr++) {
+      if (conflicts_with_other_var_at(var, instr, ass, cache, in, debug_trace >= 1)) {
+        return false;
+      }
+    }
+  } else if (ass.reg != -1) {
+    // we only need to look where something else is already in this register.
+    auto& occupied = cache->reg_occupied.at(ass.reg.id());
+    for (int instr = occupied.find_next(lr.min); instr != -1 && instr <= lr.max;
+         instr = occupied.find_next(instr + 1)) {
+      if (conflicts_with_other_var_at(var, instr, ass, cache, in, debug_trace >= 1)) {
+        return false;
       }
     }
   }
 
   // can clobber on the last one or first one - check that we don't interfere with a clobber
-  for (int instr = lr.min + 1; instr <= lr.max - 1; instr++) {
-    for (auto clobber : in.instructions.at(instr).clobber) {
-      if (ass.occupies_reg(clobber)) {
-        if (debug_trace >= 1) {
-          printf("at idx %d clobber\n", instr);
+  int clobber_idx = find_first_in_range(
+      cache->reg_clobbered, ass.reg, lr.min + 1, lr.max - 1, cache->reference_conflict_check,
+      [&](int instr) {
+        for (auto clobber : in.instructions.at(instr).clobber) {
+          if (ass.occupies_reg(clobber)) {
+            return true;
+          }
         }
-
         return false;
-      }
+      });
+  if (clobber_idx != -1) {
+    if (debug_trace >= 1) {
+      printf("at idx %d clobber\n", clobber_idx);
     }
+
+    return false;
   }
 
-  for (int instr = lr.min; instr <= lr.max; instr++) {
-    for (auto exclusive : in.instructions.at(instr).exclude) {
-      if (ass.occupies_reg(exclusive)) {
-        if (debug_trace >= 1) {
-          printf("at idx %d exclusive conflict\n", instr);
+  int exclude_idx = find_first_in_range(
+      cache->reg_excluded, ass.reg, lr.min, lr.max, cache->reference_conflict_check,
+      [&](int instr) {
+        for (auto exclusive : in.instructions.at(instr).exclude) {
+          if (ass.occupies_reg(exclusive)) {
+            return true;
+          }
         }
-
         return false;
-      }
+      });
+  if (exclude_idx != -1) {
+    if (debug_trace >= 1) {
+      printf("at idx %d exclusive conflict\n", exclude_idx);
     }
+
+    return false;
   }
 
   // check we don't violate any others.
-  for (int instr = lr.min; instr <= lr.max; instr++) {
-    if (lr.has_constraint && lr.assignment.at(instr - lr.min).is_assigned()) {
-      if (!(ass.occupies_same_reg(lr.assignment.at(instr - lr.min)))) {
-        if (debug_trace >= 1) {
-          printf("at idx %d self bad (%s) (%s)\n", instr,
-                 lr.assignment.at(instr - lr.min).to_string().c_str(), ass.to_string().c_str());
-        }
+  if (lr.has_constraint) {
+    for (int instr = lr.min; instr <= lr.max; instr++) {
+      if (lr.assignment.at(instr - lr.min).is_assigned()) {
+        if (!(ass.occupies_same_reg(lr.assignment.at(instr - lr.min)))) {
+          if (debug_trace >= 1) {
+            printf("at idx %d self bad (%s) (%s)\n", instr,
+                   lr.assignment.at(instr - lr.min).to_string().c_str(), ass.to_string().c_str());
+          }
 
-        return false;
+          return false;
+        }
       }
     }
   }
@@ -515,44 +607,10 @@ bool assignment_ok_at(int var,
                       const AllocationInput& in,
                       int debug_trace) {
   auto& lr = cache->live_ranges.at(var);
-  for (auto other_idx : cache->live_ranges_by_instr.at(idx)) {
-    auto& other_lr = cache->live_ranges.at(other_idx);
-    if (other_lr.var == var) {
-      continue;
-    }
-
-    if (/*(idx != other_lr.max) &&*/ other_lr.conflicts_at(idx, ass)) {
-      bool allowed_by_move_eliminator = false;
-      if (move_eliminator) {
-        if (enable_fancy_coloring) {
-          if (lr.dies_next_at_instr(idx) && other_lr.becomes_live_at_instr(idx) &&
-              (allow_read_write_same_reg || in.instructions.at(idx).is_move)) {
-            allowed_by_move_eliminator = true;
-          }
-
-          if (lr.becomes_live_at_instr(idx) && other_lr.dies_next_at_instr(idx) &&
-              (allow_read_write_same_reg || in.instructions.at(idx).is_move)) {
-            allowed_by_move_eliminator = true;
-          }
-        } else {
-          // case to allow rename (from us to them)
-          if (idx == lr.max && idx == other_lr.min && in.instructions.at(idx).is_move) {
-            allowed_by_move_eliminator = true;
-          }
-
-          if (idx == lr.min && idx == other_lr.min && in.instructions.at(idx).is_move) {
-            allowed_by_move_eliminator = true;
-          }
-        }
-      }
-
-      if (!allowed_by_move_eliminator) {
-        if (debug_trace >= 2) {
-          printf("at idx %d, %s conflicts\n", idx, other_lr.print_assignment().c_str());
-        }
-        return false;
-      }
-    }
+  bool maybe_occupied = cache->reference_conflict_check ||
+                        (ass.reg != -1 && cache->reg_occupied.at(ass.reg.id()).contains(idx));
+  if (maybe_occupied && conflicts_with_other_var_at(var, idx, ass, cache, in, debug_trace >= 2)) {
+    return false;
   }
 
   // check we aren't violating a clobber
@@ -776,6 +834,7 @@ bool try_spill_coloring(int var, RegAllocCache* cache, const AllocationInput& in
       }  // end need temp reg
       spill_assignment.stack_slot = get_stack_slot_for_var(var, cache);
       lr.assignment.at(instr - lr.min) = spill_assignment;
+      mark_occupied(var, instr, cache);
       bonus.reg = spill_assignment.reg;
       bonus.slot = spill_assignment.stack_slot;
     }  // end not constrained
@@ -800,10 +859,117 @@ bool in_vec(const std::vector<T>& vec, const T& obj) {
   return false;
 }
 
+/*!
+ * Remove variables from a coalesce group.
+ */
+template <typename F>
+void remove_from_coalesce_group(int group_idx, RegAllocCache* cache, F&& should_remove) {
+  auto& group = cache->coalesce_groups.at(group_idx);
+  std::vector<int> kept;
+  for (auto member : group) {
+    if (should_remove(member)) {
+      cache->coalesce_group.at(member) = -1;
+    } else {
+      kept.push_back(member);
+    }
+  }
+  group = kept;
+}
+
+/*!
+ * Try to put all variables in var's coalesce group in the same register, so the moves between
+ * them can be eliminated. If there is no register that works for all of them, the group is split
+ * up and the variables are colored one at a time as usual.
+ *
+ * Constrained variables are colored first, so a group with a constraint is tried at the first
+ * constrained variable. If that fails, the unconstrained variables are tried again as a smaller
+ * group when it's their turn.
+ */
+bool try_coalesced_allocation(int var,
+                              RegAllocCache* cache,
+                              const AllocationInput& in,
+                              int debug_trace) {
+  int group_idx = cache->coalesce_group.at(var);
+  if (group_idx == -1) {
+    return false;
+  }
+
+  auto& group = cache->coalesce_groups.at(group_idx);
+  bool has_constraint = false;
+  for (auto member : group) {
+    assert(!cache->was_colored.at(member));
+    if (cache->live_ranges.at(member).has_constraint) {
+      has_constraint = true;
+    }
+  }
+
+  if (group.size() > 1) {
+    // constraints first, then the usual order. Don't spread a constraint to a register that we
+    // wouldn't normally allocate, like a special register from an rlet.
+    std::vector<Assignment> candidates;
+    auto& all_reg_order = get_default_alloc_order_for_var(var, cache, true);
+    for (auto member : group) {
+      auto& hint = cache->live_ranges.at(member).best_hint;
+      if (hint.is_assigned() && in_vec(all_reg_order, hint.reg)) {
+        candidates.push_back(hint);
+      }
+    }
+    for (auto reg : get_default_alloc_order_for_var(var, cache, false)) {
+      Assignment ass;
+      ass.kind = Assignment::Kind::REGISTER;
+      ass.reg = reg;
+      candidates.push_back(ass);
+    }
+
+    for (auto& ass : candidates) {
+      bool ok = true;
+      for (auto member : group) {
+        if (!can_var_be_assigned(member, ass, cache, in, debug_trace)) {
+          ok = false;
+          break;
+        }
+      }
+
+      if (ok) {
+        // the members don't interfere with each other, so assigning one doesn't stop the others.
+        for (auto member : group) {
+          assign_var_no_check(member, ass, cache);
+          cache->was_colored.at(member) = true;
+          cache->coalesce_group.at(member) = -1;
+        }
+        if (debug_trace >= 1) {
+          printf("coalesced %d vars with var %d in %s\n", int(group.size()), var,
+                 ass.to_string().c_str());
+        }
+        group.clear();
+        return true;
+      }
+    }
+
+    if (debug_trace >= 1) {
+      printf("couldn't coalesce %d vars with var %d\n", int(group.size()), var);
+    }
+  }
+
+  if (has_constraint) {
+    // try again without the constrained ones.
+    remove_from_coalesce_group(group_idx, cache, [&](int member) {
+      return cache->live_ranges.at(member).has_constraint;
+    });
+  } else {
+    remove_from_coalesce_group(group_idx, cache, [&](int) { return true; });
+  }
+  return false;
+}
+
 bool do_allocation_for_var(int var,
                            RegAllocCache* cache,
                            const AllocationInput& in,
                            int debug_trace) {
+  if (try_coalesced_allocation(var, cache, in, debug_trace)) {
+    return true;
+  }
+
   // first, let's see if there's a hint...
   auto& lr = cache->live_ranges.at(var);
   bool colored = false;
@@ -874,9 +1040,119 @@ bool do_allocation_for_var(int var,
   }
 }
 
+/*!
+ * Do two variables need different registers? Like in can_var_be_assigned, two variables can share
+ * a register at an instruction where one dies and the other becomes live.
+ */
+bool vars_interfere(LiveInfo& a, LiveInfo& b) {
+  int overlap_min = std::max(a.min, b.min);
+  int overlap_max = std::min(a.max, b.max);
+  for (int instr = overlap_min; instr <= overlap_max; instr++) {
+    if (a.is_live_at_instr(instr) && b.is_live_at_instr(instr)) {
+      bool a_to_b = a.dies_next_at_instr(instr) && b.becomes_live_at_instr(instr);
+      bool b_to_a = b.dies_next_at_instr(instr) && a.becomes_live_at_instr(instr);
+      if (!a_to_b && !b_to_a) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*!
+ * Group variables connected by moves that could share a register. This is conservative: groups
+ * are only joined if no two variables in them interfere, and at most one of the groups contains a
+ * constrained variable. Each group is colored together by try_coalesced_allocation, which only
+ * uses a register that is free for all of them without spilling. Otherwise the variables are
+ * colored one at a time, like without coalescing.
+ */
+void find_coalesce_groups(RegAllocCache* cache, const AllocationInput& in) {
+  cache->coalesce_group.assign(cache->max_var, -1);
+  cache->coalesce_groups.clear();
+
+  auto has_constraint = [&](const std::vector<int>& group) {
+    for (auto var : group) {
+      if (cache->live_ranges.at(var).has_constraint) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (auto& instr : in.instructions) {
+    if (!instr.is_move || instr.read.size() != 1 || instr.write.size() != 1) {
+      continue;
+    }
+    int src = instr.read.front().id;
+    int dst = instr.write.front().id;
+    if (src == dst || !cache->live_ranges.at(src).seen || !cache->live_ranges.at(dst).seen) {
+      continue;
+    }
+
+    // make sure both are in a group.
+    for (auto var : {src, dst}) {
+      if (cache->coalesce_group.at(var) == -1) {
+        cache->coalesce_group.at(var) = cache->coalesce_groups.size();
+        cache->coalesce_groups.push_back({var});
+      }
+    }
+
+    int src_group = cache->coalesce_group.at(src);
+    int dst_group = cache->coalesce_group.at(dst);
+    if (src_group == dst_group) {
+      continue;
+    }
+
+    auto& a = cache->coalesce_groups.at(src_group);
+    auto& b = cache->coalesce_groups.at(dst_group);
+    if (has_constraint(a) && has_constraint(b)) {
+      continue;
+    }
+
+    bool interfere = false;
+    for (auto a_var : a) {
+      for (auto b_var : b) {
+        if (vars_interfere(cache->live_ranges.at(a_var), cache->live_ranges.at(b_var))) {
+          interfere = true;
+          break;
+        }
+      }
+      if (interfere) {
+        break;
+      }
+    }
+
+    if (!interfere) {
+      // merge b into a
+      for (auto b_var : b) {
+        cache->coalesce_group.at(b_var) = src_group;
+        a.push_back(b_var);
+      }
+      b.clear();
+    }
+  }
+}
+
 }  // namespace
 
 bool run_allocator(RegAllocCache* cache, const AllocationInput& in, int debug_trace) {
+  if (in.coalesce_moves) {
+    find_coalesce_groups(cache, in);
+  } else {
+    cache->coalesce_group.assign(cache->max_var, -1);
+  }
+
+  // find where registers are already used because of constraints
+  cache->reg_occupied.assign(emitter::RegisterInfo::N_REGS, InstrSet(in.instructions.size()));
+  for (uint32_t i = 0; i < cache->live_ranges.size(); i++) {
+    auto& lr = cache->live_ranges.at(i);
+    if (lr.seen) {
+      for (int instr = lr.min; instr <= lr.max; instr++) {
+        mark_occupied(i, instr, cache);
+      }
+    }
+  }
+
   // here we allocate
   std::vector<int> allocation_order;
   for (uint32_t i = 0; i < cache->live_ranges.size(); i++) {
@@ -892,6 +1168,10 @@ bool run_allocator(RegAllocCache* cache, const AllocationInput& in, int debug_tr
   }
 
   for (int var : allocation_order) {
+    if (cache->was_colored.at(var)) {
+      // already colored as part of a coalesce group.
+      continue;
+    }
     if (!do_allocation_for_var(var, cache, in, debug_trace)) {
       return false;
     }
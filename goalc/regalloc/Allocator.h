@@ -5,6 +5,7 @@
 
 #include <vector>
 #include "IRegSet.h"
+#include "InstrSet.h"
 #include <unordered_map>
 #include "IRegister.h"
 #include "allocate.h"
@@ -40,6 +41,19 @@ struct RegAllocCache {
   bool is_asm_func = false;
 
   std::vector<std::vector<int>> live_ranges_by_instr;
+
+  // for each hardware register, the instructions where a live variable is assigned to it.
+  // only filled in during run_allocator.
+  std::vector<InstrSet> reg_occupied;
+  // for each hardware register, the instructions which clobber/exclude it.
+  std::vector<InstrSet> reg_clobbered;
+  std::vector<InstrSet> reg_excluded;
+  // variables connected by moves which will be colored together if possible.
+  // coalesce_group[var] is the index of the var's group in coalesce_groups, or -1.
+  std::vector<int> coalesce_group;
+  std::vector<std::vector<int>> coalesce_groups;
+  // check for conflicts by scanning every instruction instead. Slow, only for testing.
+  bool reference_conflict_check = false;
 };
 
 void find_basic_blocks(RegAllocCache* cache, const AllocationInput& in);
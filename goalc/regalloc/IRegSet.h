@@ -17,6 +17,10 @@
 #include <cassert>
 #include "common/common_types.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 class IRegSet {
  public:
   IRegSet() = default;
@@ -87,6 +91,21 @@ class IRegSet {
 
   bool operator!=(const IRegSet& other) const { return !((*this) == other); }
 
+  /*!
+   * Call f with each ireg in the set, in increasing order.
+   */
+  template <typename F>
+  void for_each(F&& f) const {
+    for (size_t word = 0; word < m_data.size(); word++) {
+      u64 bits = m_data[word];
+      while (bits) {
+        int bit = count_trailing_zeros(bits);
+        f(int(word * 64 + bit));
+        bits &= bits - 1;
+      }
+    }
+  }
+
   void resize(int bits) {
     if (bits > m_bits) {
       auto new_vector_size = (bits + 63) / 64;
@@ -129,6 +148,16 @@ class IRegSet {
   }
 
  private:
+  static int count_trailing_zeros(u64 x) {
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanForward64(&result, x);
+    return result;
+#else
+    return __builtin_ctzll(x);
+#endif
+  }
+
   std::vector<u64> m_data;
   int m_bits = 0;
 };
\ No newline at end of file
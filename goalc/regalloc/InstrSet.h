@@ -0,0 +1,146 @@
+#pragma once
+/*!
+ * @file InstrSet.h
+ * A set of instruction indices, used by the register allocator to record where each hardware
+ * register is in use.
+ *
+ * The main query is "what is the first instruction in the set that is >= idx?", which is used to
+ * check if a register is free over a range of instructions. This is a bitset with a bit per
+ * instruction, plus summary levels where each bit records if a word of the level below is non-zero.
+ * The query looks at one word per level, so it takes log64(size) steps instead of scanning the
+ * whole range.
+ *
+ * The size is set when the set is created. Values can only be added.
+ */
+
+#include <array>
+#include <vector>
+#include <cassert>
+#include "common/common_types.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+class InstrSet {
+ public:
+  InstrSet() = default;
+
+  /*!
+   * Create an empty set that can hold values in [0, size).
+   */
+  explicit InstrSet(int size) : m_size(size) {
+    int bits = size;
+    int words = 0;
+    do {
+      assert(m_level_count < MAX_LEVELS);
+      m_level_offsets[m_level_count] = words;
+      m_level_sizes[m_level_count] = (bits + 63) / 64;
+      words += m_level_sizes[m_level_count];
+      bits = m_level_sizes[m_level_count];
+      m_level_count++;
+    } while (bits > 1);
+    m_data.resize(words);
+  }
+
+  /*!
+   * Add the given instruction to the set.
+   */
+  void insert(int x) {
+    assert(x >= 0 && x < m_size);
+    for (int level = 0; level < m_level_count; level++) {
+      auto& word = m_data[m_level_offsets[level] + x / 64];
+      u64 mask = (1ull << (x % 64));
+      if (word & mask) {
+        // the levels above have already been updated.
+        return;
+      }
+      word |= mask;
+      x /= 64;
+    }
+  }
+
+  /*!
+   * Is the given instruction in the set?
+   */
+  bool contains(int x) const {
+    if (x < 0 || x >= m_size) {
+      return false;
+    }
+    return m_data[x / 64] & (1ull << (x % 64));
+  }
+
+  /*!
+   * Get the smallest value in the set which is >= x, or -1 if there isn't one.
+   */
+  int find_next(int x) const {
+    if (x < 0) {
+      x = 0;
+    }
+    if (x >= m_size) {
+      return -1;
+    }
+
+    // go up until we find a word with a set bit at or after x.
+    int level = 0;
+    s64 pos = x;
+    for (;;) {
+      if (level == m_level_count) {
+        return -1;
+      }
+      auto word_idx = pos / 64;
+      if (word_idx >= m_level_sizes[level]) {
+        return -1;
+      }
+      u64 word = m_data[m_level_offsets[level] + word_idx] & (~0ull << (pos % 64));
+      if (word) {
+        pos = word_idx * 64 + count_trailing_zeros(word);
+        break;
+      }
+      // nothing left in this word, try the next word, using the summary bit for it.
+      pos = word_idx + 1;
+      level++;
+    }
+
+    // then go down, taking the first set bit each time.
+    while (level > 0) {
+      level--;
+      pos = pos * 64 + count_trailing_zeros(m_data[m_level_offsets[level] + pos]);
+    }
+    return (int)pos;
+  }
+
+  /*!
+   * Is any value in [min, max] in the set?
+   */
+  bool any_in_range(int min, int max) const {
+    if (min > max) {
+      return false;
+    }
+    auto next = find_next(min);
+    return next >= 0 && next <= max;
+  }
+
+  int size() const { return m_size; }
+
+ private:
+  static int count_trailing_zeros(u64 x) {
+    assert(x);
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanForward64(&result, x);
+    return result;
+#else
+    return __builtin_ctzll(x);
+#endif
+  }
+
+  // level 0 has a bit per instruction. level i has a bit per word of level i - 1.
+  // all levels are stored in m_data, starting with level 0.
+  static constexpr int MAX_LEVELS = 6;
+  std::vector<u64> m_data;
+  std::array<int, MAX_LEVELS> m_level_offsets = {};
+  std::array<int, MAX_LEVELS> m_level_sizes = {};
+  int m_level_count = 0;
+  int m_size = 0;
+};
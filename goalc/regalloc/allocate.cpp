@@ -3,6 +3,7 @@
  * Runs the register allocator.
  */
 
+#include <algorithm>
 #include "third-party/fmt/core.h"
 #include "allocate.h"
 #include "Allocator.h"
@@ -118,6 +119,11 @@ void print_result(const AllocationInput& in, const AllocationResult& result) {
            result.stack_ops.at(i).print().c_str());
   }
 }
+
+bool same_assignment(const Assignment& a, const Assignment& b) {
+  return a.kind == b.kind && a.reg == b.reg && a.stack_slot == b.stack_slot &&
+         a.spilled == b.spilled;
+}
 }  // namespace
 
 /*!
@@ -127,6 +133,7 @@ AllocationResult allocate_registers(const AllocationInput& input) {
   AllocationResult result;
   RegAllocCache cache;
   cache.is_asm_func = input.is_asm_function;
+  cache.reference_conflict_check = input.reference_conflict_check;
 
   // if desired, print input for debugging.
   if (input.debug_settings.print_input) {
@@ -164,17 +171,6 @@ AllocationResult allocate_registers(const AllocationInput& input) {
   result.stack_slots_for_spills = cache.current_stack_slot;
   result.stack_slots_for_vars = input.stack_slots_for_stack_vars;
 
-  // copy over the assignment result
-  result.assignment.resize(cache.max_var);
-  for (size_t i = 0; i < result.assignment.size(); i++) {
-    auto& x = result.assignment[i];
-    x.resize(input.instructions.size());
-    const auto& lr = cache.live_ranges.at(i);
-    for (int j = lr.min; j <= lr.max; j++) {
-      x.at(j) = lr.get(j);
-    }
-  }
-
   // check for use of saved registers
   for (auto sr : emitter::gRegInfo.get_all_saved()) {
     bool uses_sr = false;
@@ -193,6 +189,21 @@ AllocationResult allocate_registers(const AllocationInput& input) {
       result.used_saved_regs.push_back(sr);
     }
   }
+
+  // count moves which codegen can remove.
+  for (size_t i = 0; i < input.instructions.size(); i++) {
+    auto& instr = input.instructions.at(i);
+    if (instr.is_move && instr.read.size() == 1 && instr.write.size() == 1) {
+      result.moves++;
+      auto& src = cache.live_ranges.at(instr.read.front().id).get(i);
+      auto& dst = cache.live_ranges.at(instr.write.front().id).get(i);
+      if (src.kind == Assignment::Kind::REGISTER && dst.kind == Assignment::Kind::REGISTER &&
+          src.reg == dst.reg) {
+        result.moves_eliminated++;
+      }
+    }
+  }
+
   result.ass_as_ranges = std::move(cache.live_ranges);
   result.stack_ops = std::move(cache.stack_ops);
 
@@ -257,4 +268,40 @@ std::string RegAllocInstr::print() const {
   }
   result += ")";
   return result;
-}
\ No newline at end of file
+}
+
+/*!
+ * Do two register allocations of the same function give the same code?
+ */
+bool same_allocation(const AllocationResult& a, const AllocationResult& b) {
+  if (a.ok != b.ok || a.stack_slots_for_spills != b.stack_slots_for_spills ||
+      a.stack_slots_for_vars != b.stack_slots_for_vars ||
+      a.needs_aligned_stack_for_spills != b.needs_aligned_stack_for_spills ||
+      a.used_saved_regs != b.used_saved_regs || a.ass_as_ranges.size() != b.ass_as_ranges.size() ||
+      a.stack_ops.size() != b.stack_ops.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.ass_as_ranges.size(); i++) {
+    auto& lr_a = a.ass_as_ranges[i];
+    auto& lr_b = b.ass_as_ranges[i];
+    if (lr_a.seen != lr_b.seen || lr_a.min != lr_b.min || lr_a.max != lr_b.max ||
+        !std::equal(lr_a.assignment.begin(), lr_a.assignment.end(), lr_b.assignment.begin(),
+                    lr_b.assignment.end(), same_assignment)) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < a.stack_ops.size(); i++) {
+    auto& ops_a = a.stack_ops[i].ops;
+    auto& ops_b = b.stack_ops[i].ops;
+    if (!std::equal(ops_a.begin(), ops_a.end(), ops_b.begin(), ops_b.end(),
+                    [](const StackOp::Op& x, const StackOp::Op& y) {
+                      return x.slot == y.slot && x.reg == y.reg && x.reg_class == y.reg_class &&
+                             x.load == y.load && x.store == y.store;
+                    })) {
+      return false;
+    }
+  }
+  return true;
+}
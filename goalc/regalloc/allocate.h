@@ -64,14 +64,15 @@ struct RegAllocInstr {
  * Result of the allocate_registers algorithm
  */
 struct AllocationResult {
-  bool ok = false;                                  // did it work?
-  std::vector<std::vector<Assignment>> assignment;  // variable, instruction
-  std::vector<LiveInfo> ass_as_ranges;              // another format, maybe easier?
-  std::vector<emitter::Register> used_saved_regs;   // which saved regs get clobbered?
-  int stack_slots_for_spills = 0;                   // how many space on the stack do we need?
+  bool ok = false;                                 // did it work?
+  std::vector<LiveInfo> ass_as_ranges;             // assignment of each variable, by instruction
+  std::vector<emitter::Register> used_saved_regs;  // which saved regs get clobbered?
+  int stack_slots_for_spills = 0;                  // how many space on the stack do we need?
   int stack_slots_for_vars = 0;
   std::vector<StackOp> stack_ops;  // additional instructions to spill/restore
   bool needs_aligned_stack_for_spills = false;
+  int moves = 0;             // how many moves between registers of the same kind
+  int moves_eliminated = 0;  // how many of those are from a register to itself
 
   // we put the variables before the spills so the variables are 16-byte aligned.
 
@@ -98,6 +99,11 @@ struct AllocationInput {
   std::vector<std::string> debug_instruction_names;  // optional, for debug prints
   int stack_slots_for_stack_vars = 0;
   bool is_asm_function = false;
+  // check for conflicts by scanning each instruction of a live range, instead of using the
+  // per-register instruction sets. Much slower, but gives the same result. For benchmarking.
+  bool reference_conflict_check = false;
+  // try to give both sides of a move the same register, so the move can be removed.
+  bool coalesce_moves = true;
 
   struct {
     bool print_input = false;
@@ -117,5 +123,6 @@ struct AllocationInput {
 };
 
 AllocationResult allocate_registers(const AllocationInput& input);
+bool same_allocation(const AllocationResult& a, const AllocationResult& b);
 
 #endif  // JAK_ALLOCATE_H
@@ -1,4 +1,7 @@
+#include <filesystem>
 #include <memory>
+#include <regex>
+#include <thread>
 #include "gtest/gtest.h"
 #include "decompiler/Disasm/InstructionParser.h"
 #include "decompiler/Disasm/DecompilerLabel.h"
@@ -7,6 +10,10 @@
 #include "decompiler/IR2/variable_naming.h"
 #include "decompiler/IR2/cfg_builder.h"
 #include "common/goos/PrettyPrinter.h"
+#include "common/log/log.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Serializer.h"
+#include "common/util/ThreadPool.h"
 
 using namespace decompiler;
 
@@ -41,7 +48,7 @@ class DecompilerRegressionTest : public ::testing::Test {
       // add string type tag:
       LinkedWord type_tag(0);
       type_tag.kind = LinkedWord::Kind::TYPE_PTR;
-      type_tag.symbol_name = "string";
+      type_tag.set_symbol_name("string");
       file.words_by_seg.at(1).push_back(type_tag);
       int string_start = 4 * int(file.words_by_seg.at(1).size());
 
@@ -75,16 +82,12 @@ class DecompilerRegressionTest : public ::testing::Test {
     }
   };
 
-  std::unique_ptr<TestData> make_function(
+  /*!
+   * Parse a function and convert it to atomic ops, without running type analysis.
+   */
+  std::unique_ptr<TestData> make_atomic_ops(
       const std::string& code,
-      const TypeSpec& function_type,
-      bool allow_pairs = false,
-      const std::string& method_name = "",
       const std::vector<std::pair<std::string, std::string>>& strings = {}) {
-    dts->type_prop_settings.locked = true;
-    dts->type_prop_settings.reset();
-    dts->type_prop_settings.allow_pair = allow_pairs;
-    dts->type_prop_settings.current_method_type = method_name;
     auto program = parser->parse_program(code);
     //  printf("prg:\n%s\n\n", program.print().c_str());
     auto test = std::make_unique<TestData>(program.instructions.size());
@@ -106,6 +109,20 @@ class DecompilerRegressionTest : public ::testing::Test {
     auto ops = convert_function_to_atomic_ops(test->func, program.labels);
     test->func.ir2.atomic_ops = std::make_shared<FunctionAtomicOps>(std::move(ops));
     test->func.ir2.atomic_ops_succeeded = true;
+    return test;
+  }
+
+  std::unique_ptr<TestData> make_function(
+      const std::string& code,
+      const TypeSpec& function_type,
+      bool allow_pairs = false,
+      const std::string& method_name = "",
+      const std::vector<std::pair<std::string, std::string>>& strings = {}) {
+    dts->type_prop_settings.locked = true;
+    dts->type_prop_settings.reset();
+    dts->type_prop_settings.allow_pair = allow_pairs;
+    dts->type_prop_settings.current_method_type = method_name;
+    auto test = make_atomic_ops(code, strings);
 
     if (test->func.run_type_analysis_ir2(function_type, *dts, test->file, {})) {
       test->func.ir2.has_type_info = true;
@@ -1022,4 +1039,137 @@ TEST_F(DecompilerRegressionTest, TypeOf) {
       "  (set! v0-0 (call!))\n"
       "  )";
   test(func, type, expected, false);
-}
\ No newline at end of file
+}
+
+TEST_F(DecompilerRegressionTest, TypeDatabase) {
+  auto db_file = (std::filesystem::temp_directory_path() / "test-all-types.typedb").string();
+  std::filesystem::remove(db_file);
+  Serializer expected;
+  dts->serialize(expected);
+
+  // parse and save, then load the saved database, then replace a corrupted database.
+  for (int i = 0; i < 3; i++) {
+    if (i == 2) {
+      u8 garbage[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+      file_util::write_binary_file(db_file, garbage, sizeof(garbage));
+    }
+    DecompilerTypeSystem loaded;
+    loaded.load_type_defs({"decompiler", "config", "all-types.gc"}, db_file);
+    EXPECT_TRUE(std::filesystem::exists(db_file));
+    Serializer actual;
+    loaded.serialize(actual);
+    EXPECT_TRUE(expected.get_save_result() == actual.get_save_result());
+    EXPECT_EQ(dts->dump_symbol_types(), loaded.dump_symbol_types());
+  }
+  std::filesystem::remove(db_file);
+}
+
+namespace {
+/*!
+ * Run jobs that log their index, with job fail_idx throwing. If later_jobs_fail is set, every job
+ * after fail_idx throws too, right away, so they fail before the earlier jobs are done. Returns the
+ * messages printed, without their times, and the error.
+ */
+std::pair<std::string, std::string> run_logging_jobs(ThreadPool* pool,
+                                                     int fail_idx,
+                                                     bool later_jobs_fail = false) {
+  std::vector<std::function<void()>> jobs;
+  for (int i = 0; i < 32; i++) {
+    jobs.push_back([i, fail_idx, later_jobs_fail]() {
+      if (later_jobs_fail && i > fail_idx) {
+        throw std::runtime_error(fmt::format("job {} failed", i));
+      }
+      // earlier jobs are slower, so they finish out of order.
+      std::this_thread::sleep_for(std::chrono::microseconds(50 * (32 - i)));
+      lg::warn("job {} start", i);
+      if (i == fail_idx) {
+        throw std::runtime_error(fmt::format("job {} failed", i));
+      }
+      lg::warn("job {} end", i);
+    });
+  }
+
+  std::string error;
+  testing::internal::CaptureStdout();
+  try {
+    run_jobs_in_parallel(jobs, pool);
+  } catch (std::runtime_error& e) {
+    error = e.what();
+  }
+  auto log = testing::internal::GetCapturedStdout();
+  return {std::regex_replace(log, std::regex("\\[[0-9: -]+\\] "), ""), error};
+}
+}  // namespace
+
+TEST(DecompilerLinkedWord, LabelIdRange) {
+  // the id is packed into 27 bits, and the largest value means "no label".
+  constexpr int max_id = (1 << 27) - 2;
+  LinkedWord word(0);
+  word.set_label_id(max_id);
+  EXPECT_EQ(word.label_id(), max_id);
+  EXPECT_THROW(word.set_label_id(max_id + 1), std::runtime_error);
+  EXPECT_THROW(word.set_label_id(1 << 27), std::runtime_error);
+  EXPECT_EQ(word.label_id(), max_id);
+  word.set_label_id(-1);
+  EXPECT_EQ(word.label_id(), -1);
+}
+
+TEST(DecompilerParallel, SameLogsForAnyThreadCount) {
+  ThreadPool pool(3);
+  auto serial = run_logging_jobs(nullptr, -1);
+  EXPECT_NE(serial.first.find("job 31 end"), std::string::npos);
+  EXPECT_EQ(serial.second, "");
+  EXPECT_EQ(run_logging_jobs(&pool, -1), serial);
+
+  // the jobs before the failure are logged, then the error is rethrown.
+  auto serial_fail = run_logging_jobs(nullptr, 20);
+  EXPECT_NE(serial_fail.first.find("job 20 start"), std::string::npos);
+  EXPECT_EQ(serial_fail.first.find("job 20 end"), std::string::npos);
+  EXPECT_EQ(serial_fail.first.find("job 21"), std::string::npos);
+  EXPECT_EQ(serial_fail.second, "job 20 failed");
+  EXPECT_EQ(run_logging_jobs(&pool, 20), serial_fail);
+
+  // later jobs failing first must not stop the jobs before them from running.
+  EXPECT_EQ(run_logging_jobs(nullptr, 20, true), serial_fail);
+  ThreadPool big_pool(15);
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(run_logging_jobs(&pool, 20, true), serial_fail);
+    EXPECT_EQ(run_logging_jobs(&big_pool, 20, true), serial_fail);
+  }
+}
+
+TEST_F(DecompilerRegressionTest, ParallelTypeAnalysisFailure) {
+  // loads from an object can't be typed. The error message prints the op, which interns symbols
+  // in the pretty printer's symbol table from every thread at once.
+  dts->type_prop_settings.locked = true;
+  dts->type_prop_settings.reset();
+  std::vector<std::unique_ptr<TestData>> tests;
+  for (int i = 0; i < 64; i++) {
+    tests.push_back(make_atomic_ops(fmt::format(
+        "    sll r0, r0, 0\n"
+        "    lw v0, {}(a0)\n"
+        "    jr ra\n"
+        "    daddu sp, sp, r0",
+        4 * (i + 1))));
+  }
+
+  auto type = dts->parse_type_spec("(function object object)");
+  std::vector<int> results(tests.size(), -1);
+  std::vector<std::function<void()>> jobs;
+  for (size_t i = 0; i < tests.size(); i++) {
+    jobs.push_back([&, i]() {
+      results[i] = tests[i]->func.run_type_analysis_ir2(type, *dts, tests[i]->file, {});
+    });
+  }
+
+  ThreadPool pool(7);
+  testing::internal::CaptureStdout();
+  run_jobs_in_parallel(jobs, &pool);
+  auto log = testing::internal::GetCapturedStdout();
+
+  for (size_t i = 0; i < tests.size(); i++) {
+    EXPECT_EQ(results[i], 0);
+    EXPECT_EQ(tests[i]->func.warnings, ";; Type prop attempted and failed.\n");
+    EXPECT_NE(log.find(fmt::format("(l.w (+ a0 {}))", 4 * (i + 1))), std::string::npos) << i;
+  }
+}
@@ -245,4 +245,8 @@ TEST_F(ArithmeticTests, Subtraction) {
 TEST_F(ArithmeticTests, Multiplication2) {
   runner.run_static_test(env, testCategory, "multiply32.static.gc", {"-1234478448\n"});
   runner.run_static_test(env, testCategory, "multiply64.static.gc", {"93270638141856400\n"});
-}
\ No newline at end of file
+}
+
+TEST_F(ArithmeticTests, ConstantFolding) {
+  runner.run_static_test(env, testCategory, "constant-folding.static.gc", {"4886718306\n"});
+}
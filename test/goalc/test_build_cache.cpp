@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+#include "goalc/compiler/Compiler.h"
+#include "goalc/compiler/BuildCache.h"
+#include "common/util/FileUtil.h"
+
+TEST(BuildCache, StoreAndLookup) {
+  file_util::create_dir_if_needed(file_util::get_file_path({"out", "cache"}));
+  BuildCache cache;
+  std::vector<u8> data = {1, 2, 3, 0, 255};
+  cache.store("build-cache-test-data", 1234, data);
+
+  std::vector<u8> loaded;
+  EXPECT_TRUE(cache.lookup("build-cache-test-data", 1234, &loaded));
+  EXPECT_EQ(loaded, data);
+  EXPECT_FALSE(cache.lookup("build-cache-test-data", 1235, &loaded));
+  EXPECT_FALSE(cache.lookup("build-cache-test-missing", 1234, &loaded));
+  EXPECT_EQ(cache.hit_count(), 1);
+  EXPECT_EQ(cache.miss_count(), 2);
+}
+
+TEST(BuildCache, TruncatedEntryMisses) {
+  BuildCache cache;
+  std::vector<u8> data(1000, 12);
+  cache.store("build-cache-test-truncated", 1234, data);
+
+  // like a compile that was interrupted while writing the object.
+  auto file_name = file_util::get_file_path({"out", "cache", "build-cache-test-truncated.oc"});
+  auto stored = file_util::read_binary_file(file_name);
+  file_util::write_binary_file(file_name, stored.data(), stored.size() - 1);
+
+  std::vector<u8> loaded;
+  EXPECT_FALSE(cache.lookup("build-cache-test-truncated", 1234, &loaded));
+  EXPECT_EQ(cache.miss_count(), 1);
+}
+
+namespace {
+/*!
+ * Compile the test file with the build cache. Returns true if it was a cache hit.
+ */
+bool compile_with_cache(Compiler& compiler) {
+  int hits = compiler.get_build_cache().hit_count();
+  compiler.run_front_end_on_string(
+      "(asm-file \"test/goalc/source_generated/build-cache-test.gc\" :color)");
+  return compiler.get_build_cache().hit_count() > hits;
+}
+}  // namespace
+
+TEST(BuildCache, DependencyChangesKey) {
+  file_util::write_text_file(
+      file_util::get_file_path({"test", "goalc", "source_generated", "build-cache-test.gc"}),
+      "(defun build-cache-test-fn ((x build-cache-test-type))\n"
+      "  (build-cache-test-macro BUILD_CACHE_TEST_CONST))\n");
+
+  Compiler compiler;
+  compiler.run_front_end_on_string("(set-config! build-cache #t)");
+  compiler.run_front_end_on_string("(deftype build-cache-test-type (basic) ((a int32)))");
+  compiler.run_front_end_on_string("(defmacro build-cache-test-macro (x) `(+ ,x 1))");
+  compiler.run_front_end_on_string("(defconstant BUILD_CACHE_TEST_CONST 12)");
+
+  // the first builds may hit, if an earlier run left the same object in the cache. The second build
+  // also checks the function against its old definition, so it reads more types than the first.
+  compile_with_cache(compiler);
+  compile_with_cache(compiler);
+  EXPECT_TRUE(compile_with_cache(compiler));
+
+  // changing something the file doesn't use keeps the key.
+  compiler.run_front_end_on_string("(defconstant BUILD_CACHE_TEST_UNUSED 1)");
+  compiler.run_front_end_on_string("(defmacro build-cache-test-unused (x) x)");
+  EXPECT_TRUE(compile_with_cache(compiler));
+
+  // changing a constant, a macro or a type the file uses is a miss, then a hit again.
+  compiler.run_front_end_on_string("(defconstant BUILD_CACHE_TEST_CONST 13)");
+  EXPECT_FALSE(compile_with_cache(compiler));
+  EXPECT_TRUE(compile_with_cache(compiler));
+
+  compiler.run_front_end_on_string("(defmacro build-cache-test-macro (x) `(+ ,x 2))");
+  EXPECT_FALSE(compile_with_cache(compiler));
+  EXPECT_TRUE(compile_with_cache(compiler));
+
+  // defining a new method changes the type.
+  compiler.run_front_end_on_string(
+      "(defmethod new build-cache-test-type ((allocation symbol) (type-to-make type)) "
+      "(object-new))");
+  EXPECT_FALSE(compile_with_cache(compiler));
+  EXPECT_TRUE(compile_with_cache(compiler));
+}
@@ -1,5 +1,6 @@
 #include <thread>
 #include <chrono>
+#include <map>
 
 #include "gtest/gtest.h"
 #include "game/runtime.h"
@@ -8,4 +9,44 @@
 
 TEST(CompilerAndRuntime, ConstructCompiler) {
   Compiler compiler;
-}
\ No newline at end of file
+}
+
+namespace {
+std::string compile_and_print_ir(Compiler& compiler, const std::string& src) {
+  auto code = compiler.get_goos().reader.read_from_string(src);
+  auto file = compiler.compile_object_file("test-code", code, true);
+  std::string result;
+  for (auto& func : file->functions()) {
+    for (auto& ir : func->code()) {
+      result += ir->print();
+      result += '\n';
+    }
+  }
+  return result;
+}
+
+std::map<std::string, std::string> print_constants(const Compiler& compiler) {
+  std::map<std::string, std::string> result;
+  for (auto& kv : compiler.get_global_constants()) {
+    result[kv.first->name] = kv.second.print();
+  }
+  return result;
+}
+}  // namespace
+
+TEST(CompilerAndRuntime, ConstructCompilerFromSnapshot) {
+  // the first compiler may or may not load a snapshot, but leaves an up-to-date one.
+  { Compiler compiler(true); }
+  Compiler from_snapshot(true);
+  EXPECT_TRUE(from_snapshot.loaded_snapshot());
+  Compiler fresh;
+  EXPECT_FALSE(fresh.loaded_snapshot());
+
+  EXPECT_EQ(from_snapshot.get_symbol_types(), fresh.get_symbol_types());
+  EXPECT_EQ(from_snapshot.get_enums(), fresh.get_enums());
+  EXPECT_EQ(print_constants(from_snapshot), print_constants(fresh));
+
+  // uses macros from goal-lib.gc and the type of _format from kernel-defs.gc
+  std::string src = "(when (< 1 2) (_format #t \"~D~%\" (+ 1 2)))";
+  EXPECT_EQ(compile_and_print_ir(from_snapshot, src), compile_and_print_ir(fresh, src));
+}
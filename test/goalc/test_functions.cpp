@@ -87,8 +87,11 @@ TEST_F(FunctionTests, InlineIsInline) {
     EXPECT_EQ(dynamic_cast<IR_FunctionCall*>(x.get()), nullptr);
     auto as_im = dynamic_cast<IR_IntegerMath*>(x.get());
     if (as_im) {
-      EXPECT_EQ(as_im->get_kind(), IntegerMathKind::IMUL_32);
-      got_mult = true;
+      // (* 4 x) is done with a shift left then a shift right.
+      EXPECT_NE(as_im->get_kind(), IntegerMathKind::IMUL_32);
+      if (as_im->get_kind() == IntegerMathKind::SHL_64) {
+        got_mult = true;
+      }
     }
   }
   EXPECT_TRUE(got_mult);
@@ -107,7 +110,8 @@ TEST_F(FunctionTests, AllowInline) {
       got_call++;
     }
     auto as_im = dynamic_cast<IR_IntegerMath*>(x.get());
-    if (as_im && as_im->get_kind() == IntegerMathKind::IMUL_32) {
+    // (* 4 x) is done with a shift left then a shift right.
+    if (as_im && as_im->get_kind() == IntegerMathKind::SHL_64) {
       got_mult++;
     }
   }
@@ -115,6 +119,21 @@ TEST_F(FunctionTests, AllowInline) {
   EXPECT_EQ(got_call, 1);
 }
 
+TEST_F(FunctionTests, AutoInline) {
+  runner.run_static_test(env, testCategory, "auto-inline.static.gc", {"27\n"});
+  auto code = compiler.get_goos().reader.read_from_file(
+      {"test/goalc/source_templates/functions/auto-inline.static.gc"});
+  auto compiled = compiler.compile_object_file("test-code", code, true);
+  int got_call = 0;
+  for (auto& x : compiled->top_level_function().code()) {
+    if (dynamic_cast<IR_FunctionCall*>(x.get())) {
+      got_call++;
+    }
+  }
+  // only the call with the local variable isn't inlined.
+  EXPECT_EQ(got_call, 1);
+}
+
 TEST_F(FunctionTests, ReturnNone) {
   runner.run_static_test(env, testCategory, "function-returning-none.static.gc", {"1\n"});
 }
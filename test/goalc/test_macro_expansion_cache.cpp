@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+#include "goalc/compiler/Compiler.h"
+#include "goalc/compiler/MacroExpansionCache.h"
+
+using namespace goos;
+
+namespace {
+// helper to evaluate a string as a goos expression.
+std::string e(Interpreter& interp, const std::string& in) {
+  return interp.eval(interp.reader.read_from_string(in), interp.global_environment.as_env())
+      .print();
+}
+
+/*!
+ * Expands uses of GOOS macros through a MacroExpansionCache, counting how many times a macro is
+ * actually run.
+ */
+struct CachedExpander {
+  Interpreter i;
+  MacroExpansionCache cache;
+  int runs = 0;
+
+  // read a use of a macro. The reader returns (top-level form).
+  Object read(const std::string& code) {
+    return i.reader.read_from_string(code).as_pair()->cdr.as_pair()->car;
+  }
+
+  Object expand(const Object& form) {
+    auto head = form.as_pair()->car;
+    auto rest = form.as_pair()->cdr;
+    Object macro_obj;
+    EXPECT_TRUE(i.get_global_variable_by_name(head.as_symbol()->name, &macro_obj));
+    return cache.expand(i, head, macro_obj, rest, [&]() {
+      runs++;
+      auto macro = macro_obj.as_macro();
+      auto args = i.get_args(form, rest, macro->args);
+      auto mac_env_obj = EnvironmentObject::make_new();
+      auto mac_env = mac_env_obj.as_env();
+      mac_env->parent_env = i.global_environment.as_env();
+      i.set_args_in_env(form, args, macro->args, mac_env);
+      return i.eval_body(*macro, mac_env);
+    });
+  }
+
+  std::string expand(const std::string& code) { return expand(read(code)).print(); }
+};
+}  // namespace
+
+TEST(MacroExpansionCache, HitsAndMisses) {
+  CachedExpander x;
+  e(x.i, "(defsmacro template (a b) `(+ ,a ,(car b)))");
+
+  EXPECT_EQ(x.expand("(template 1 (2 3))"), "(+ 1 2)");
+  EXPECT_EQ(x.runs, 1);
+  // the same arguments, read again, hit.
+  EXPECT_EQ(x.expand("(template 1 (2 3))"), "(+ 1 2)");
+  EXPECT_EQ(x.runs, 1);
+  // different arguments miss.
+  EXPECT_EQ(x.expand("(template 1 (2 4))"), "(+ 1 2)");
+  EXPECT_EQ(x.runs, 2);
+  EXPECT_EQ(x.expand("(template 1.0 (2 3))"), "(+ 1.000000 2)");
+  EXPECT_EQ(x.runs, 3);
+  EXPECT_EQ(x.expand("(template \"1\" (2 3))"), "(+ \"1\" 2)");
+  EXPECT_EQ(x.runs, 4);
+  // 0.0 and -0.0 are different.
+  EXPECT_EQ(x.expand("(template 0.0 (2))"), "(+ 0.000000 2)");
+  EXPECT_EQ(x.expand("(template -0.0 (2))"), "(+ -0.000000 2)");
+  EXPECT_EQ(x.runs, 6);
+
+  // macros that can't be proven pure are always run.
+  e(x.i, "(defsmacro uses-gensym (a) `(,a ,(gensym)))");
+  x.expand("(uses-gensym 1)");
+  x.expand("(uses-gensym 1)");
+  EXPECT_EQ(x.runs, 8);
+}
+
+TEST(MacroExpansionCache, CopiesSourceLocations) {
+  CachedExpander x;
+  e(x.i, "(defsmacro template (a b) `(+ ,a ,(car b) (quote (const 1))))");
+
+  auto first = x.read("(template (foo 1) ((bar 2)))");
+  auto second = x.read("\n(template (foo 1) ((bar 2)))");
+  auto first_result = x.expand(first);
+  auto second_result = x.expand(second);
+  EXPECT_EQ(x.runs, 1);
+  EXPECT_EQ(first_result.print(), second_result.print());
+
+  // the parts that came from the arguments are the objects read the second time, so errors in
+  // them point to the second use.
+  auto args = second.as_pair()->cdr;
+  auto result_args = second_result.as_pair()->cdr;
+  auto foo = args.as_pair()->car;
+  auto bar = args.as_pair()->cdr.as_pair()->car.as_pair()->car;
+  EXPECT_EQ(result_args.as_pair()->car.heap_obj, foo.heap_obj);
+  EXPECT_EQ(result_args.as_pair()->cdr.as_pair()->car.heap_obj, bar.heap_obj);
+  EXPECT_NE(x.i.reader.db.get_info_for(result_args.as_pair()->car).find("line: 2"),
+            std::string::npos);
+
+  // the parts that came from the macro are shared with the cached expansion.
+  auto first_const = first_result.as_pair()->cdr.as_pair()->cdr.as_pair()->cdr.as_pair()->car;
+  auto second_const = result_args.as_pair()->cdr.as_pair()->cdr.as_pair()->car;
+  EXPECT_EQ(first_const.heap_obj, second_const.heap_obj);
+}
+
+TEST(MacroExpansionCache, Invalidation) {
+  CachedExpander x;
+  e(x.i, "(defsmacro template (a) `(+ ,a 1))");
+  x.expand("(template 1)");
+  x.expand("(template 1)");
+  EXPECT_EQ(x.runs, 1);
+
+  // redefining the macro drops its expansions.
+  e(x.i, "(defsmacro template (a) `(- ,a 1))");
+  EXPECT_EQ(x.expand("(template 1)"), "(- 1 1)");
+  EXPECT_EQ(x.runs, 2);
+  x.expand("(template 1)");
+  EXPECT_EQ(x.runs, 2);
+
+  // so does redefining a macro used to prove it pure.
+  e(x.i, "(defsmacro uses-if (a) (if (null? a) '(quote empty) `(quote ,(cdr a))))");
+  EXPECT_EQ(x.expand("(uses-if ())"), "(quote empty)");
+  x.expand("(uses-if ())");
+  EXPECT_EQ(x.runs, 3);
+  e(x.i, "(defsmacro if (c a b) `(cond (,c ,a) (#t ,b)))");
+  EXPECT_EQ(x.expand("(uses-if ())"), "(quote empty)");
+  EXPECT_EQ(x.runs, 4);
+
+  // a macro that can't be proven pure is cached once it is marked pure.
+  e(x.i, "(defsmacro uses-function (a) (first a))");
+  x.expand("(uses-function (1 2))");
+  x.expand("(uses-function (1 2))");
+  EXPECT_EQ(x.runs, 6);
+  e(x.i, "(set-macro-pure! uses-function)");
+  x.expand("(uses-function (1 2))");
+  x.expand("(uses-function (1 2))");
+  EXPECT_EQ(x.runs, 7);
+}
+
+namespace {
+std::string compile_and_print_ir(Compiler& compiler, const std::string& src) {
+  auto code = compiler.get_goos().reader.read_from_string(src);
+  auto file = compiler.compile_object_file("test-code", code, true);
+  std::string result;
+  for (auto& func : file->functions()) {
+    for (auto& ir : func->code()) {
+      result += ir->print();
+      result += '\n';
+    }
+  }
+  return result;
+}
+}  // namespace
+
+TEST(MacroExpansionCache, CompilerCachedExpansion) {
+  std::string macro = "(defmacro-pure macro-cache-test (a b) `(+ ,a (* ,b 3)))";
+  std::string src = "(let ((x 1)) (macro-cache-test x (macro-cache-test x 2)))";
+
+  Compiler uncached;
+  uncached.run_front_end_on_string(macro);
+  auto expected = compile_and_print_ir(uncached, src);
+  EXPECT_EQ(uncached.get_macro_cache().hit_count(), 0);
+
+  Compiler cached;
+  cached.run_front_end_on_string("(set-config! cache-macro-expansions #t)");
+  cached.run_front_end_on_string(macro);
+  EXPECT_EQ(compile_and_print_ir(cached, src), expected);
+  int hits = cached.get_macro_cache().hit_count();
+  // the second time, the expansions come from the cache.
+  EXPECT_EQ(compile_and_print_ir(cached, src), expected);
+  EXPECT_GT(cached.get_macro_cache().hit_count(), hits);
+}
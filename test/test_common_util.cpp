@@ -1,12 +1,127 @@
-#include "common/util/FileUtil.h"
-#include "gtest/gtest.h"
-#include <string>
-#include <vector>
-
-TEST(FileUtil, valid_path) {
-  std::vector<std::string> test = {"cabbage", "banana", "apple"};
-  std::string sampleString = file_util::get_file_path(test);
-  // std::cout << sampleString << std::endl;
-
-  EXPECT_TRUE(true);
-}
+#include "common/util/ByteSpan.h"
+#include "common/util/CacheFile.h"
+#include "common/util/FileUtil.h"
+#include "common/util/Profiler.h"
+#include "common/util/StringTable.h"
+#include "common/util/ThreadPool.h"
+#include "gtest/gtest.h"
+#include "third-party/json.hpp"
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+TEST(FileUtil, valid_path) {
+  std::vector<std::string> test = {"cabbage", "banana", "apple"};
+  std::string sampleString = file_util::get_file_path(test);
+  // std::cout << sampleString << std::endl;
+
+  EXPECT_TRUE(true);
+}
+
+TEST(ByteSpan, ReadsLikeAVector) {
+  std::vector<u8> vec = {1, 2, 3};
+  ByteSpan span(vec);
+  EXPECT_EQ(span.size(), 3u);
+  EXPECT_EQ(span.data(), vec.data());
+  EXPECT_EQ(span.at(2), 3);
+  EXPECT_THROW(span.at(3), std::out_of_range);
+  EXPECT_EQ(std::vector<u8>(span.begin(), span.end()), vec);
+  EXPECT_TRUE(ByteSpan().empty());
+}
+
+TEST(ThreadPool, RunsAllJobs) {
+  std::atomic<int> sum = 0;
+  std::vector<std::future<int>> results;
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < 100; i++) {
+      results.push_back(pool.submit([&sum, i]() {
+        sum += i;
+        return i * 2;
+      }));
+    }
+  }
+  EXPECT_EQ(sum, 4950);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(results.at(i).get(), i * 2);
+  }
+}
+
+TEST(ThreadPool, PropagatesExceptions) {
+  ThreadPool pool(2);
+  auto result = pool.submit([]() -> int { throw std::runtime_error("job failed"); });
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(Profiler, RecordsNestedZones) {
+  {
+    // not started, so nothing is recorded.
+    prof::Zone zone("ignored");
+    EXPECT_FALSE(zone.active());
+  }
+
+  prof::start();
+  {
+    prof::Zone outer("outer");
+    outer.set_detail("outer-detail");
+    EXPECT_TRUE(outer.active());
+    for (int i = 0; i < 3; i++) {
+      prof::Zone inner("inner");
+      inner.counter("count", 2);
+    }
+  }
+  prof::stop();
+
+  auto file_name = (std::filesystem::temp_directory_path() / "profiler-test.json").string();
+  prof::write_chrome_trace(file_name);
+  auto trace = nlohmann::json::parse(file_util::read_text_file(file_name));
+  std::filesystem::remove(file_name);
+
+  auto& events = trace.at("traceEvents");
+  ASSERT_EQ(events.size(), 4);
+  int inner_count = 0;
+  for (auto& e : events) {
+    EXPECT_EQ(e.at("ph"), "X");
+    if (e.at("name") == "inner") {
+      inner_count++;
+      EXPECT_EQ(e.at("args").at("count"), 2);
+    } else {
+      EXPECT_EQ(e.at("name"), "outer");
+      EXPECT_EQ(e.at("args").at("detail"), "outer-detail");
+    }
+  }
+  EXPECT_EQ(inner_count, 3);
+}
+
+TEST(StringTable, Interning) {
+  StringTable table;
+  EXPECT_EQ(table.id("a"), 0u);
+  EXPECT_EQ(table.id("b"), 1u);
+  EXPECT_EQ(table.id("a"), 0u);
+  auto& b = table.str(1);
+  for (int i = 0; i < 1000; i++) {
+    table.id(std::to_string(i));
+  }
+  // references stay valid as the table grows.
+  EXPECT_EQ(&table.str(1), &b);
+  EXPECT_EQ(b, "b");
+  EXPECT_ANY_THROW(table.str(5000));
+}
+
+TEST(CacheFile, SaveFailureThrows) {
+  // a directory can't be replaced by the file, so the rename fails.
+  auto dir = std::filesystem::temp_directory_path() / "cache-file-test";
+  std::filesystem::create_directories(dir / "not-empty");
+  EXPECT_THROW(cache_file::save(dir.string(), 1, 1, 1, {}, {1, 2, 3}), std::runtime_error);
+
+  // the temporary file was removed.
+  int temp_files = 0;
+  for (auto& entry : std::filesystem::directory_iterator(dir.parent_path())) {
+    if (entry.path().filename().string().rfind("cache-file-test.", 0) == 0) {
+      temp_files++;
+    }
+  }
+  EXPECT_EQ(temp_files, 0);
+  std::filesystem::remove_all(dir);
+}
@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include "goalc/emitter/CodeTester.h"
 #include "goalc/emitter/IGen.h"
+#include "goalc/emitter/Peephole.h"
+#include "goalc/emitter/ObjectGenerator.h"
 
 using namespace emitter;
 
@@ -618,6 +620,197 @@ TEST(EmitterIntegerMath, jumps) {
             "000000000F83000000000F82000000000F8700000000");
 }
 
+TEST(EmitterIntegerMath, short_jumps) {
+  CodeTester tester;
+  tester.init_code_buffer(256);
+
+  std::vector<Instruction> long_jumps = {
+      IGen::jmp_32(), IGen::je_32(),  IGen::jne_32(), IGen::jle_32(), IGen::jge_32(), IGen::jl_32(),
+      IGen::jg_32(),  IGen::jbe_32(), IGen::jae_32(), IGen::jb_32(),  IGen::ja_32()};
+
+  for (auto& long_jump : long_jumps) {
+    Instruction short_jump(0);
+    EXPECT_TRUE(IGen::jump_32_to_8(long_jump, &short_jump));
+    EXPECT_EQ(1, short_jump.get_imm_size());
+    EXPECT_EQ(1, short_jump.offset_of_imm());
+    tester.emit(short_jump);
+  }
+
+  EXPECT_EQ(tester.dump_to_hex_string(true), "EB00740075007E007D007C007F007600730072007700");
+
+  Instruction not_a_jump(0);
+  EXPECT_FALSE(IGen::jump_32_to_8(IGen::ret(), &not_a_jump));
+}
+
+namespace {
+/*!
+ * An IR of a test function: a jump to another IR (if jump_to isn't -1), then padding bytes.
+ */
+struct JumpTestIr {
+  int jump_to = -1;
+  int padding = 0;
+};
+
+/*!
+ * Generate a function from the IRs, followed by a ret. Returns the code of the function and the
+ * offset of each IR in it.
+ */
+std::vector<u8> generate_jump_test(const std::vector<JumpTestIr>& irs, std::vector<int>* offsets) {
+  ObjectGeneratorSettings settings;
+  settings.peephole = false;
+  ObjectGenerator gen(settings);
+  FunctionDebugInfo debug;
+  auto func = gen.add_function_to_seg(MAIN_SEGMENT, &debug);
+  for (auto& test_ir : irs) {
+    auto ir = gen.add_ir(func, "");
+    if (test_ir.jump_to >= 0) {
+      auto jump = gen.add_instr(IGen::jmp_32(), ir);
+      gen.link_instruction_jump(jump, gen.get_future_ir_record(func, test_ir.jump_to));
+    }
+    for (int i = 0; i < test_ir.padding; i++) {
+      gen.add_instr(IGen::ret(), ir);
+    }
+  }
+  gen.add_instr(IGen::ret(), gen.add_ir(func, ""));
+
+  auto data = gen.generate_data_v3();
+  offsets->assign(irs.size() + 1, -1);
+  for (auto& instr : debug.instructions) {
+    if (offsets->at(instr.ir_idx) == -1) {
+      offsets->at(instr.ir_idx) = instr.offset;
+    }
+  }
+  auto& seg_data = data.segment_data.at(MAIN_SEGMENT);
+  return std::vector<u8>(seg_data.begin() + debug.offset_in_seg,
+                         seg_data.begin() + debug.offset_in_seg + debug.length);
+}
+
+/*!
+ * Check the jump at the start of the IR at offset: it should be short or long, and go to dest.
+ */
+void check_jump(const std::vector<u8>& code, int offset, bool is_short, int dest) {
+  if (is_short) {
+    EXPECT_EQ(code.at(offset), 0xeb);
+    EXPECT_EQ(offset + 2 + (s8)code.at(offset + 1), dest);
+  } else {
+    EXPECT_EQ(code.at(offset), 0xe9);
+    s32 rel;
+    memcpy(&rel, code.data() + offset + 1, sizeof(s32));
+    EXPECT_EQ(offset + 5 + rel, dest);
+  }
+}
+}  // namespace
+
+TEST(EmitterObjectGenerator, ForwardJumpRange) {
+  std::vector<int> offsets;
+  // jump over 127 bytes: the largest forward offset that fits
+  auto code = generate_jump_test({{2, 0}, {-1, 127}}, &offsets);
+  check_jump(code, offsets.at(0), true, offsets.at(2));
+  EXPECT_EQ(offsets.at(2), 2 + 127);
+
+  code = generate_jump_test({{2, 0}, {-1, 128}}, &offsets);
+  check_jump(code, offsets.at(0), false, offsets.at(2));
+  EXPECT_EQ(offsets.at(2), 5 + 128);
+}
+
+TEST(EmitterObjectGenerator, BackwardJumpRange) {
+  std::vector<int> offsets;
+  // jump back over 126 bytes and itself: -128, the largest backward offset that fits
+  auto code = generate_jump_test({{-1, 126}, {0, 0}}, &offsets);
+  check_jump(code, offsets.at(1), true, offsets.at(0));
+  EXPECT_EQ(offsets.at(0) - (offsets.at(1) + 2), -128);
+
+  code = generate_jump_test({{-1, 127}, {0, 0}}, &offsets);
+  check_jump(code, offsets.at(1), false, offsets.at(0));
+  EXPECT_EQ(offsets.at(0) - (offsets.at(1) + 5), -132);
+}
+
+TEST(EmitterObjectGenerator, ShortJumpBringsOtherInRange) {
+  std::vector<int> offsets;
+  // the backward jump at IR 2 only fits because the forward jump at IR 0 is short.
+  auto code = generate_jump_test({{3, 124}, {0, 0}, {-1, 0}}, &offsets);
+  check_jump(code, offsets.at(0), true, offsets.at(3));
+  check_jump(code, offsets.at(1), true, offsets.at(0));
+  EXPECT_EQ(offsets.at(0) - (offsets.at(1) + 2), -128);
+
+  // with 2 more bytes after it, the forward jump doesn't fit, so the backward jump doesn't either.
+  code = generate_jump_test({{3, 124}, {0, 0}, {-1, 2}}, &offsets);
+  check_jump(code, offsets.at(0), false, offsets.at(3));
+  check_jump(code, offsets.at(1), false, offsets.at(0));
+  EXPECT_EQ(offsets.at(3), 5 + 124 + 5 + 2);
+}
+
+namespace {
+std::string peephole_hex(const std::vector<Instruction>& instructions) {
+  CodeTester tester;
+  tester.init_code_buffer(256);
+  for (auto& instr : instructions) {
+    tester.emit(instr);
+  }
+  return tester.dump_to_hex_string(true);
+}
+}  // namespace
+
+TEST(EmitterPeephole, reload_after_store) {
+  std::vector<Instruction> instrs = {IGen::store64_gpr64_plus_s32(RSP, 1000, RAX),
+                                     IGen::load64_gpr64_plus_s32(RAX, 1000, RSP),
+                                     IGen::load64_gpr64_plus_s32(RBX, 1000, RSP)};
+  std::vector<int> ir_to_instr = {0, 1};
+  PeepholeFunction f(&instrs, &ir_to_instr);
+  EXPECT_EQ(1, run_peephole(f));
+  EXPECT_TRUE(instrs.at(1).is_null);
+  EXPECT_EQ(peephole_hex(instrs), peephole_hex({IGen::store64_gpr64_plus_s32(RSP, 1000, RAX),
+                                                IGen::load64_gpr64_plus_s32(RBX, 1000, RSP)}));
+
+  // can't remove the load if we can jump to it.
+  std::vector<Instruction> instrs2 = {IGen::store64_gpr64_plus_s32(RSP, 1000, RAX),
+                                      IGen::load64_gpr64_plus_s32(RAX, 1000, RSP),
+                                      IGen::jmp_32()};
+  PeepholeFunction f2(&instrs2, &ir_to_instr);
+  f2.add_jump(2, 1);
+  EXPECT_EQ(0, run_peephole(f2));
+}
+
+TEST(EmitterPeephole, overwritten_move) {
+  std::vector<Instruction> instrs = {IGen::mov_gpr64_gpr64(RAX, RBX), IGen::null(),
+                                     IGen::mov_gpr64_gpr64(RAX, R12),
+                                     IGen::mov_gpr64_gpr64(R12, RAX)};
+  std::vector<int> ir_to_instr = {0};
+  PeepholeFunction f(&instrs, &ir_to_instr);
+  EXPECT_EQ(1, run_peephole(f));
+  EXPECT_EQ(peephole_hex(instrs), peephole_hex({IGen::mov_gpr64_gpr64(RAX, R12),
+                                                IGen::mov_gpr64_gpr64(R12, RAX)}));
+}
+
+TEST(EmitterPeephole, short_displacement) {
+  std::vector<Instruction> instrs = {
+      IGen::load32_xmm32_gpr64_plus_s32(XMM3, RBX, -12),
+      IGen::load64_gpr64_gpr64_plus_gpr64_plus_s32(RAX, R13, RSI, 127),
+      IGen::load64_gpr64_gpr64_plus_gpr64_plus_s32(RAX, R13, RSI, 128),
+      IGen::load64_gpr64_plus_s32(RAX, 8, R14)};
+  std::vector<int> ir_to_instr = {0};
+  PeepholeFunction f(&instrs, &ir_to_instr);
+  f.add_linked_instruction(3);
+  EXPECT_EQ(2, run_peephole(f));
+  EXPECT_EQ(peephole_hex(instrs),
+            peephole_hex({IGen::load32_xmm32_gpr64_plus_s8(XMM3, RBX, -12),
+                          IGen::load64_gpr64_gpr64_plus_gpr64_plus_s8(RAX, R13, RSI, 127),
+                          IGen::load64_gpr64_gpr64_plus_gpr64_plus_s32(RAX, R13, RSI, 128),
+                          IGen::load64_gpr64_plus_s32(RAX, 8, R14)}));
+}
+
+TEST(EmitterPeephole, jump_to_final_destination) {
+  std::vector<Instruction> instrs = {IGen::jne_32(), IGen::null(), IGen::null(), IGen::jmp_32(),
+                                     IGen::ret()};
+  std::vector<int> ir_to_instr = {0, 2, 4};
+  PeepholeFunction f(&instrs, &ir_to_instr);
+  f.add_jump(0, 1);
+  f.add_jump(3, 2);
+  EXPECT_EQ(1, run_peephole(f));
+  EXPECT_EQ(2, f.jump_dest_ir(0));
+  EXPECT_EQ(2, f.jump_dest_ir(3));
+}
+
 TEST(EmitterIntegerMath, null) {
   auto instr = IGen::null();
   EXPECT_EQ(0, instr.emit(nullptr));
@@ -3,8 +3,11 @@
  * Tests for the GOOS macro language.
  */
 
+#include <thread>
+
 #include "gtest/gtest.h"
 #include "common/goos/Interpreter.h"
+#include "common/goos/ObjectSerializer.h"
 
 using namespace goos;
 
@@ -1227,6 +1230,31 @@ TEST(GoosSpecialForms, Set) {
   }
 }
 
+TEST(GoosSpecialForms, ArgumentFrames) {
+  Interpreter i;
+  // all kinds of arguments are visible
+  e(i, "(desfun frame-test (a b &key (c 3) &key (d 4) &rest r) `(,a ,b ,c ,d ,r))");
+  EXPECT_EQ(e(i, "(frame-test 1 2)"), "(1 2 3 4 ())");
+  EXPECT_EQ(e(i, "(frame-test 1 2 :d 5 6 7)"), "(1 2 3 5 (6 7))");
+
+  // define of an argument replaces the argument, define of something else stays local
+  e(i, "(define y 1)");
+  EXPECT_EQ(e(i, "((lambda (x) (define x 12) (define y 13) (+ x y)) 1)"), "25");
+  EXPECT_EQ(e(i, "y"), "1");
+
+  // closures keep their own frame
+  e(i, "(desfun make-counter (n) (lambda () (set! n (+ n 1)) n))");
+  e(i, "(define c1 (make-counter 10))");
+  e(i, "(define c2 (make-counter 20))");
+  EXPECT_EQ(e(i, "(c1)"), "11");
+  EXPECT_EQ(e(i, "(c1)"), "12");
+  EXPECT_EQ(e(i, "(c2)"), "21");
+
+  // macro arguments
+  e(i, "(defsmacro frame-mac (x &key (y 2)) `(+ ,x ,y))");
+  EXPECT_EQ(e(i, "(frame-mac 1 :y 5)"), "6");
+}
+
 TEST(GoosSpecialForms, Quote) {
   Interpreter i;
   e(i, "(define x 'y)");
@@ -1299,4 +1327,246 @@ TEST(GoosBuiltins, Format) {
 TEST(GoosBuiltins, Error) {
   Interpreter i;
   EXPECT_ANY_THROW(e(i, "(error \"hi\")"));
-}
\ No newline at end of file
+}
+
+TEST(GoosObjectSerializer, RoundTrip) {
+  Interpreter i;
+  e(i, "(define shared-list '(1 2.5 #\\a \"str\" sym #(3 4)))");
+  e(i, "(define other-ref shared-list)");
+  e(i, "(desfun add-n (x &key (n 2)) (+ x n))");
+  e(i, "(defsmacro twice (x) `(begin ,x ,x))");
+  e(i, "(define counter ((lambda (n) (lambda () (set! n (+ n 1)) n)) 5))");
+
+  Serializer saver;
+  {
+    ObjectSerializer obj_ser(&saver, &i.reader.symbolTable);
+    i.serialize_state(obj_ser);
+  }
+
+  Interpreter loaded;
+  Serializer loader(saver.get_save_result().data(), saver.get_save_result().size());
+  ObjectSerializer obj_ser(&loader, &loaded.reader.symbolTable);
+  loaded.serialize_state(obj_ser);
+  EXPECT_TRUE(loader.reached_end());
+
+  EXPECT_EQ(e(loaded, "shared-list"), e(i, "shared-list"));
+  // sharing is kept
+  EXPECT_EQ(e(loaded, "(eq? shared-list other-ref)"), "#t");
+  // symbols are interned in the new symbol table
+  EXPECT_EQ(e(loaded, "(eq? (car (cdr (cdr (cdr (cdr shared-list))))) 'sym)"), "#t");
+  EXPECT_EQ(e(loaded, "(add-n 1)"), "3");
+  EXPECT_EQ(e(loaded, "(add-n 1 :n 5)"), "6");
+  EXPECT_EQ(e(loaded, "(twice (define y 3))"), "3");
+  // closed-over arguments are kept
+  EXPECT_EQ(e(loaded, "(counter)"), "6");
+
+  // the global environment still contains itself
+  Object global_env;
+  EXPECT_TRUE(loaded.get_global_variable_by_name("*global-env*", &global_env));
+  EXPECT_EQ(global_env.heap_obj, loaded.global_environment.heap_obj);
+}
+
+TEST(GoosObjectHeap, PoolAndNormalObjects) {
+  Interpreter i;
+  // objects from the pool and from the normal allocator can be mixed and freed in any order.
+  heap::set_pool_enabled(false);
+  e(i, "(define normal-list '(1 2 3))");
+  heap::set_pool_enabled(true);
+  EXPECT_EQ(e(i, "(define pooled-list (cons 0 normal-list))"), "(0 1 2 3)");
+  e(i, "(set! normal-list '())");
+  EXPECT_EQ(e(i, "pooled-list"), "(0 1 2 3)");
+
+  // freed blocks are reused
+  auto a = PairObject::make_new(Object::make_integer(1), Object::make_integer(2));
+  auto a_ptr = a.heap_obj.get();
+  a = Object::make_integer(0);
+  auto b = PairObject::make_new(Object::make_integer(3), Object::make_integer(4));
+  EXPECT_EQ(b.heap_obj.get(), a_ptr);
+  EXPECT_EQ(b.print(), "(3 . 4)");
+}
+
+TEST(GoosObjectHeap, ThreadPoolsAreReused) {
+  auto use_objects_on_thread = []() {
+    std::thread thread([]() {
+      std::vector<Object> objects;
+      for (int i = 0; i < 20000; i++) {
+        objects.push_back(PairObject::make_new(Object::make_integer(i), Object::make_integer(i)));
+      }
+    });
+    thread.join();
+  };
+
+  // the free lists and chunk of an exited thread are used by the next thread.
+  use_objects_on_thread();
+  auto chunks = heap::get_pool_stats().chunk_count;
+  EXPECT_GT(heap::get_pool_stats().depot_free_lists, 0u);
+  for (int i = 0; i < 10; i++) {
+    use_objects_on_thread();
+  }
+  EXPECT_EQ(heap::get_pool_stats().chunk_count, chunks);
+}
+
+namespace {
+/*!
+ * Evaluate each expression in order, and return the result or the error message of each.
+ */
+std::vector<std::string> eval_all(Interpreter& interp, const std::vector<std::string>& exprs) {
+  std::vector<std::string> result;
+  for (auto& expr : exprs) {
+    try {
+      result.push_back(e(interp, expr));
+    } catch (std::runtime_error& err) {
+      result.push_back(std::string("error: ") + err.what());
+    }
+  }
+  return result;
+}
+}  // namespace
+
+TEST(GoosBytecode, SameAsEval) {
+  std::vector<std::string> exprs = {
+      "(factorial 10)",
+      "(desfun fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+      "(fib 15)",
+      // cond without a body, and falling off the end
+      "(desfun cond-test (x) (cond ((= x 1) 'one) ((eq? x 'a)) ((= x 3) 'a 'three)))",
+      "(cond-test 1)",
+      "(cond-test 'a)",
+      "(cond-test 3)",
+      "(cond-test 4)",
+      "((lambda (x) (and x 1 2)) #t)",
+      "((lambda (x) (and 1 x 2)) #f)",
+      "((lambda (x) (or #f x)) 12)",
+      "((lambda (x) (or #f x)) #f)",
+      // while, set!, define
+      "(desfun sum-to (n) (define total 0) "
+      "(while (> n 0) (set! total (+ total n)) (set! n (- n 1))) total)",
+      "(sum-to 100)",
+      "((lambda () (while #f 1)))",
+      // closures and lambdas created in compiled code
+      "(desfun adder (n) (lambda (x) (+ x n)))",
+      "((adder 3) 4)",
+      "(desfun apply-twice (f x) (f (f x)))",
+      "(apply-twice (adder 10) 1)",
+      // arguments found by lexical address, and variables that shadow them at runtime
+      "(desfun counter (n) (lambda (step) (set! n (+ n step)) n))",
+      "((lambda (c) (c 1) (c 2)) (counter 10))",
+      "((lambda (x) ((lambda () (define x 2) x))) 1)",
+      "((lambda (x) ((lambda () (set! x 5))) x) 1)",
+      "((lambda (x) ((lambda (y) (define x y) ((lambda () x))) 3)) 1)",
+      "((lambda (x) ((lambda (y) (define x y) ((lambda () (set! x 4) x))) 3)) 1)",
+      // quasiquote
+      "(desfun qq-test (x &rest y) `(a ,x (b ,@y (c ,x)) ,@y))",
+      "(qq-test 1 2 3)",
+      "(qq-test 1)",
+      "((lambda (x) `(a ,@x)) 1)",
+      "((lambda (x) `(a ,@(cdr x) ,(car x))) '(1 2 3))",
+      // keyword and rest arguments
+      "(desfun key-test (a &key (b 2) &rest c) `(,a ,b ,c))",
+      "(key-test 1)",
+      "((lambda () (key-test 1 :b 3 4 5)))",
+      "((lambda () (key-test)))",
+      "((lambda (x) (x 1 2)) (lambda (a &rest b) b))",
+      "((lambda (x) (x 1 2)) (lambda (a) a))",
+      "((lambda (x) (x)) (lambda (a) a))",
+      "((lambda (x) (x 1)) 12)",
+      // macros used in compiled code
+      "(defsmacro my-unless (c &rest body) `(if ,c #f (begin ,@body)))",
+      "((lambda (x) (my-unless x 1 2)) #f)",
+      "((lambda (x) (my-unless x 1 2)) #t)",
+      // errors
+      "((lambda () undefined-variable))",
+      "((lambda () (set! undefined-variable 1)))",
+      "((lambda () (quote)))",
+      "((lambda () (lambda)))",
+      "((lambda () (cond 1)))",
+      "((lambda () (car 1)))",
+      "((lambda () (begin :key 1)))",
+      "((lambda () 1 . 2))",
+      "((lambda () ((lambda (x &key) x) 1)))",
+  };
+
+  Interpreter bytecode, tree;
+  tree.set_bytecode_enabled(false);
+  bytecode.disable_printfs();
+  tree.disable_printfs();
+  auto bytecode_results = eval_all(bytecode, exprs);
+  auto tree_results = eval_all(tree, exprs);
+  ASSERT_EQ(bytecode_results.size(), tree_results.size());
+  for (size_t i = 0; i < exprs.size(); i++) {
+    EXPECT_EQ(bytecode_results[i], tree_results[i]) << exprs[i];
+  }
+  EXPECT_EQ(bytecode_results.at(0), "3628800");
+  EXPECT_EQ(bytecode_results.at(2), "610");
+}
+
+TEST(GoosBytecode, MacrosAreCompiled) {
+  Interpreter i;
+  e(i, "(desfun test-fn (x) x)");
+  Object desfun;
+  EXPECT_TRUE(i.get_global_variable_by_name("desfun", &desfun));
+  auto& code = desfun.as_macro()->bytecode;
+  ASSERT_TRUE(code);
+  // desfun is just a quasiquote, so nothing should fall back to eval.
+  EXPECT_EQ(code->print().find("eval-form"), std::string::npos) << code->print();
+}
+
+TEST(GoosBytecode, LexicalAddressing) {
+  Interpreter i;
+  e(i, "(define *global* 100)");
+  e(i, "(desfun make-adder (a b) (lambda (c) (set! a (+ a c)) (+ a b c *global*)))");
+  e(i, "(define adder (make-adder 1 2))");
+  EXPECT_EQ(e(i, "(adder 3)"), "109");
+  EXPECT_EQ(e(i, "(adder 3)"), "112");
+
+  // the arguments are found by (depth, slot), the global by name.
+  Object adder;
+  EXPECT_TRUE(i.get_global_variable_by_name("adder", &adder));
+  auto code = adder.as_lambda()->bytecode->print();
+  EXPECT_NE(code.find("set-local 1 0 "), std::string::npos) << code;
+  EXPECT_NE(code.find("load-local 1 1 "), std::string::npos) << code;
+  EXPECT_NE(code.find("load-local 0 0 "), std::string::npos) << code;
+  auto global_end = code.find("; *global*");
+  auto global_start = code.rfind('\n', global_end) + 1;
+  auto global_line = code.substr(global_start, global_end - global_start);
+  EXPECT_NE(global_line.find(" load "), std::string::npos) << code;
+}
+
+TEST(GoosBytecode, MacroPurity) {
+  Interpreter i;
+  e(i, "(define *global* 1)");
+  e(i, "(defsmacro template (a b) `(+ ,a ,(car b)))");
+  e(i, "(defsmacro uses-if (a) (if (null? a) '(quote empty) `(quote ,(cdr a))))");
+  e(i, "(defsmacro uses-gensym (a) `(,a ,(gensym)))");
+  e(i, "(defsmacro uses-global (a) `(+ ,a ,*global*))");
+  e(i, "(defsmacro uses-define (a) (define b a) b)");
+  e(i, "(defsmacro uses-function (a) (first a))");
+  e(i, "(set-macro-pure! (defsmacro marked (a) (first a)))");
+
+  auto is_pure = [&](const std::string& name, std::vector<std::string>* used_names = nullptr) {
+    Object macro;
+    EXPECT_TRUE(i.get_global_variable_by_name(name, &macro));
+    std::vector<std::pair<Object, Object>> used;
+    bool result = i.macro_is_pure(*macro.as_macro(), &used);
+    if (used_names) {
+      for (auto& u : used) {
+        used_names->push_back(u.first.print());
+      }
+    }
+    return result;
+  };
+
+  EXPECT_TRUE(is_pure("template"));
+  std::vector<std::string> used;
+  EXPECT_TRUE(is_pure("uses-if", &used));
+  EXPECT_EQ(used, std::vector<std::string>({"if"}));
+  EXPECT_FALSE(is_pure("uses-gensym"));
+  EXPECT_FALSE(is_pure("uses-global"));
+  EXPECT_FALSE(is_pure("uses-define"));
+  EXPECT_FALSE(is_pure("uses-function"));
+  EXPECT_TRUE(is_pure("marked"));
+
+  // checking doesn't change the result.
+  EXPECT_EQ(e(i, "(uses-if (1 2))"), "(2)");
+  EXPECT_EQ(e(i, "(uses-if ())"), "empty");
+}
@@ -59,4 +59,52 @@ TEST(PrettyPrinter, ReadAgainVeryShortLines) {
                            ->car;
   auto printed_gcommon2 = pretty_print::to_string(gcommon_code);
   EXPECT_TRUE(gcommon_code == gcommon_code2);
-}
\ No newline at end of file
+}
+
+TEST(PrettyPrinter, SpecialBreaks) {
+  // break after the arguments of a defun and after strings.
+  EXPECT_EQ(ppr("(defun foo ((a int) (b int)) \"doc\" (format #t \"hi ~A~%\" a) (+ a b))"),
+            "(defun foo ((a int) (b int))\n"
+            "  \"doc\"\n"
+            "  (format #t \"hi ~A~%\"\n"
+            "   a\n"
+            "   )\n"
+            "  (+ a b)\n"
+            "  )");
+}
+
+TEST(PrettyPrinter, ToFile) {
+  auto gcommon_code = pretty_print::get_pretty_printer_reader().read_from_file(
+      {"goal_src", "kernel", "gcommon.gc"});
+  FILE* fp = tmpfile();
+  ASSERT_TRUE(fp);
+  pretty_print::to_file(fp, gcommon_code);
+  std::string printed(ftell(fp), '\0');
+  rewind(fp);
+  EXPECT_EQ(fread(printed.data(), 1, printed.size(), fp), printed.size());
+  fclose(fp);
+  EXPECT_EQ(printed, pretty_print::to_string(gcommon_code));
+}
+
+TEST(PrettyPrinter, VeryLargeForm) {
+  // like the static data the decompiler prints. This should only take a few ms.
+  std::vector<Object> words;
+  for (int i = 0; i < 20000; i++) {
+    words.push_back(Object::make_integer(i));
+  }
+  auto word_list = pretty_print::build_list(words);
+  auto data = pretty_print::build_list("data", pretty_print::build_list(word_list, word_list));
+  auto printed = pretty_print::to_string(data);
+  EXPECT_EQ(printed.substr(0, 17), "(data\n  ((0\n    1");
+  size_t line_start = 0;
+  int long_lines = 0;
+  while (line_start < printed.size()) {
+    auto line_end = std::min(printed.find('\n', line_start), printed.size());
+    if (line_end - line_start > 80) {
+      long_lines++;
+    }
+    line_start = line_end + 1;
+  }
+  EXPECT_EQ(long_lines, 0);
+  EXPECT_TRUE(read(printed) == data);
+}
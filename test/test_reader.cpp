@@ -4,9 +4,11 @@
  * For some reason this runs at ~5 fps in CLion IDE.
  */
 
+#include <filesystem>
 #include "gtest/gtest.h"
 #include "common/goos/Reader.h"
 #include "common/util/FileUtil.h"
+#include "common/util/ThreadPool.h"
 
 using namespace goos;
 
@@ -148,6 +150,9 @@ TEST(GoosReader, Float) {
   EXPECT_TRUE(check_first_float(reader.read_from_string("-000.0"), 0));
   EXPECT_TRUE(check_first_float(reader.read_from_string("-000.0000"), 0));
 
+  // longer than the buffer used for parsing.
+  EXPECT_TRUE(check_first_float(reader.read_from_string("1." + std::string(100, '0')), 1));
+
   EXPECT_TRUE(check_first_symbol(reader.read_from_string("1e0"), "1e0"));
   EXPECT_ANY_THROW(reader.read_from_string("."));
 }
@@ -298,6 +303,12 @@ TEST(GoosReader, Comments) {
   }
 }
 
+TEST(GoosReader, WindowsLineEndings) {
+  Reader reader;
+  EXPECT_EQ(reader.read_from_string("(1 2)\r\n(a\r\nb) ; comment\r\nc\r\n").print(),
+            "(top-level (1 2) (a b) c)");
+}
+
 TEST(GoosReader, Char) {
   Reader reader;
   auto r = [&](std::string s) { return reader.read_from_string(s); };
@@ -354,3 +365,78 @@ TEST(GoosReader, TextDb) {
                          ", line: 5\n(1 2 3 4)\n";
   EXPECT_EQ(expected, reader.db.get_info_for(result));
 }
+
+TEST(GoosReader, TextDbDoesntKeepObjects) {
+  Reader reader;
+  std::weak_ptr<HeapObject> weak;
+  {
+    auto result = reader.read_from_string("(1 (2 3))");
+    weak = result.heap_obj;
+    EXPECT_EQ(reader.db.get_info_for(result.as_pair()->cdr.as_pair()->car),
+              "text from Program string, line: 1\n(1 (2 3))\n");
+  }
+  EXPECT_TRUE(weak.expired());
+
+  // reading an unchanged file again doesn't add another copy.
+  for (int i = 0; i < 3; i++) {
+    reader.read_from_file({"test", "test_data", "test_reader_file0.gc"});
+  }
+  EXPECT_EQ(reader.db.get_file_names().size(), 1u);
+}
+
+TEST(GoosReader, TextDbDropsUnusedText) {
+  Reader reader;
+  auto kept = reader.read_from_string("(kept (1 2))");
+  for (int i = 0; i < 1000; i++) {
+    reader.read_from_string("(dropped " + std::to_string(i) + ")");
+  }
+  EXPECT_LT(reader.db.fragment_count(), 100u);
+  EXPECT_EQ(reader.db.get_info_for(kept.as_pair()->cdr.as_pair()->car),
+            "text from Program string, line: 1\n(kept (1 2))\n");
+
+  // old versions of a file are dropped, but the file is still listed.
+  file_util::create_dir_if_needed(file_util::get_file_path({"out"}));
+  auto file_name = file_util::get_file_path({"out", "text-db-test.gc"});
+  for (int i = 0; i < 1000; i++) {
+    file_util::write_text_file(file_name, "(version " + std::to_string(i) + ")");
+    reader.read_from_file({"out", "text-db-test.gc"});
+  }
+  std::filesystem::remove(file_name);
+  EXPECT_LT(reader.db.fragment_count(), 100u);
+  EXPECT_EQ(reader.db.get_file_names().size(), 1u);
+}
+
+TEST(GoosReader, FileTextKeepsText) {
+  auto file_name = (std::filesystem::temp_directory_path() / "file-text-test.gc").string();
+  file_util::write_text_file(file_name, "(first line)\n(second line)\n");
+  FileText text(file_name);
+
+  // errors show the text that was read, even if the file changes or gets shorter.
+  file_util::write_text_file(file_name, "(");
+  EXPECT_EQ(text.get_line_containing_offset(14), "(second line)");
+  std::filesystem::remove(file_name);
+  EXPECT_EQ(text.get_line_idx(14), 1);
+}
+
+TEST(GoosReader, ReadFilesInParallel) {
+  std::vector<std::vector<std::string>> files = {{"goal_src", "kernel", "gcommon.gc"},
+                                                 {"goal_src", "kernel", "gkernel.gc"},
+                                                 {"goal_src", "kernel", "gstring.gc"},
+                                                 {"test", "test_data", "test_reader_file0.gc"}};
+  Reader reader;
+  ThreadPool pool(3);
+  auto parallel_code = reader.read_from_files(files, pool);
+  ASSERT_EQ(parallel_code.size(), files.size());
+
+  // symbols are compared by identity, so this only works if the symbols were merged correctly.
+  for (size_t i = 0; i < files.size(); i++) {
+    EXPECT_TRUE(parallel_code[i] == reader.read_from_file(files[i]));
+  }
+
+  // errors can be found in the text.
+  auto form = parallel_code[3].as_pair()->cdr.as_pair()->car;
+  EXPECT_EQ(reader.db.get_info_for(form),
+            "text from " +
+                file_util::get_file_path({"test", "test_data", "test_reader_file0.gc"}) +
+                ", line: 5\n(1 2 3 4)\n");
+}
@@ -0,0 +1,259 @@
+/*!
+ * @file test_regalloc.cpp
+ * Tests for the register allocator.
+ */
+
+#include <random>
+#include <set>
+
+#include "gtest/gtest.h"
+#include "goalc/regalloc/allocate.h"
+#include "goalc/regalloc/InstrSet.h"
+
+using namespace emitter;
+
+namespace {
+IRegister gpr(int id) {
+  IRegister result;
+  result.reg_class = RegClass::GPR_64;
+  result.id = id;
+  return result;
+}
+
+RegAllocInstr instr(std::vector<int> write, std::vector<int> read, bool is_move = false) {
+  RegAllocInstr result;
+  for (auto id : write) {
+    result.write.push_back(gpr(id));
+  }
+  for (auto id : read) {
+    result.read.push_back(gpr(id));
+  }
+  result.is_move = is_move;
+  return result;
+}
+
+IRegConstraint constraint(int id, int instr_idx, Register reg) {
+  IRegConstraint result;
+  result.ireg = gpr(id);
+  result.instr_idx = instr_idx;
+  result.desired_register = reg;
+  return result;
+}
+
+int reg_at(const AllocationResult& result, int var, int instr_idx) {
+  auto& ass = result.ass_as_ranges.at(var).get(instr_idx);
+  EXPECT_EQ(ass.kind, Assignment::Kind::REGISTER);
+  return ass.reg.id();
+}
+}  // namespace
+
+TEST(RegAllocCoalesce, MoveWithoutInterference) {
+  AllocationInput in;
+  in.add_instruction(instr({0}, {}));
+  in.add_instruction(instr({1}, {0}, true));
+  in.add_instruction(instr({2}, {}));
+  in.add_instruction(instr({}, {1, 2}));
+  in.max_vars = 3;
+
+  auto result = allocate_registers(in);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(reg_at(result, 0, 1), reg_at(result, 1, 1));
+  EXPECT_NE(reg_at(result, 1, 3), reg_at(result, 2, 3));
+  EXPECT_EQ(result.moves, 1);
+  EXPECT_EQ(result.moves_eliminated, 1);
+}
+
+TEST(RegAllocCoalesce, InterferingVarsNotMerged) {
+  AllocationInput in;
+  in.add_instruction(instr({0}, {}));
+  // both are still live after the move, so they need different registers.
+  in.add_instruction(instr({1}, {0}, true));
+  in.add_instruction(instr({0}, {0}));
+  in.add_instruction(instr({}, {0, 1}));
+  in.max_vars = 2;
+
+  auto result = allocate_registers(in);
+  ASSERT_TRUE(result.ok);
+  for (int i = 1; i <= 3; i++) {
+    EXPECT_NE(reg_at(result, 0, i), reg_at(result, 1, i));
+  }
+  EXPECT_EQ(result.moves_eliminated, 0);
+}
+
+TEST(RegAllocCoalesce, ConstraintInGroup) {
+  AllocationInput in;
+  in.add_instruction(instr({0}, {}));
+  in.add_instruction(instr({1}, {0}, true));
+  in.add_instruction(instr({2}, {1}, true));
+  in.add_instruction(instr({}, {2}));
+  in.constraints.push_back(constraint(2, 3, RDX));
+  in.max_vars = 3;
+
+  // the whole group goes in the constrained register.
+  auto result = allocate_registers(in);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(reg_at(result, 2, 3), RDX);
+  EXPECT_EQ(reg_at(result, 0, 1), RDX);
+  EXPECT_EQ(reg_at(result, 1, 2), RDX);
+  EXPECT_EQ(result.moves_eliminated, 2);
+}
+
+TEST(RegAllocCoalesce, TwoConstraintsNotMerged) {
+  AllocationInput in;
+  in.add_instruction(instr({0}, {}));
+  in.add_instruction(instr({1}, {0}, true));
+  in.add_instruction(instr({}, {1}));
+  in.constraints.push_back(constraint(0, 0, RSI));
+  in.constraints.push_back(constraint(1, 2, RDX));
+  in.max_vars = 2;
+
+  // the constraints win over removing the move.
+  auto result = allocate_registers(in);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(reg_at(result, 0, 0), RSI);
+  EXPECT_EQ(reg_at(result, 1, 2), RDX);
+  EXPECT_EQ(result.moves_eliminated, 0);
+}
+
+TEST(RegAllocInstrSet, Empty) {
+  for (int size : {0, 1, 64, 5000}) {
+    InstrSet set(size);
+    EXPECT_EQ(set.find_next(0), -1);
+    EXPECT_EQ(set.find_next(size - 1), -1);
+    EXPECT_FALSE(set.contains(0));
+    EXPECT_FALSE(set.any_in_range(0, size - 1));
+  }
+}
+
+TEST(RegAllocInstrSet, WordBoundary) {
+  InstrSet set(200);
+  set.insert(63);
+  EXPECT_EQ(set.find_next(0), 63);
+  EXPECT_EQ(set.find_next(63), 63);
+  EXPECT_EQ(set.find_next(64), -1);
+  EXPECT_FALSE(set.any_in_range(0, 62));
+  EXPECT_TRUE(set.any_in_range(63, 63));
+  EXPECT_FALSE(set.any_in_range(64, 199));
+
+  set.insert(64);
+  EXPECT_EQ(set.find_next(64), 64);
+  EXPECT_TRUE(set.contains(63));
+  EXPECT_TRUE(set.contains(64));
+  EXPECT_FALSE(set.contains(65));
+}
+
+TEST(RegAllocInstrSet, LevelBoundary) {
+  // a word of the second level covers 4096 instructions.
+  InstrSet set(10000);
+  set.insert(4095);
+  EXPECT_EQ(set.find_next(0), 4095);
+  EXPECT_EQ(set.find_next(4095), 4095);
+  EXPECT_EQ(set.find_next(4096), -1);
+
+  set.insert(4096);
+  EXPECT_EQ(set.find_next(4096), 4096);
+  EXPECT_EQ(set.find_next(4097), -1);
+
+  // the last element, found from the other second level word.
+  set.insert(9999);
+  EXPECT_EQ(set.find_next(4097), 9999);
+  EXPECT_EQ(set.find_next(9999), 9999);
+  EXPECT_EQ(set.find_next(10000), -1);
+  EXPECT_TRUE(set.any_in_range(4097, 9999));
+  EXPECT_FALSE(set.any_in_range(4097, 9998));
+}
+
+TEST(RegAllocInstrSet, SameAsStdSet) {
+  std::mt19937 rng(1234);
+  for (int size : {1, 63, 64, 65, 4095, 4096, 4097, 64 * 64 * 64 + 1}) {
+    for (int count : {1, 10, 1000}) {
+      InstrSet set(size);
+      std::set<int> expected;
+      for (int i = 0; i < count; i++) {
+        int x = rng() % size;
+        set.insert(x);
+        expected.insert(x);
+      }
+      set.insert(size - 1);
+      expected.insert(size - 1);
+
+      for (int x = 0; x < size; x++) {
+        auto it = expected.lower_bound(x);
+        ASSERT_EQ(set.find_next(x), it == expected.end() ? -1 : *it) << size << " " << x;
+        ASSERT_EQ(set.contains(x), expected.count(x) > 0);
+      }
+    }
+  }
+}
+
+namespace {
+/*!
+ * Make a function with loops, moves, clobbers and constraints. The clobbers and constraints make
+ * many of the variables spill.
+ */
+AllocationInput random_function(std::mt19937& rng, int instr_count, int var_count) {
+  AllocationInput in;
+  in.max_vars = var_count;
+  std::vector<int> defined;
+  auto random_defined = [&]() { return defined.at(rng() % defined.size()); };
+
+  for (int i = 0; i < instr_count; i++) {
+    RegAllocInstr instr;
+    int kind = rng() % 8;
+    if (defined.empty() || kind == 0) {
+      int var = rng() % var_count;
+      instr.write.push_back(gpr(var));
+      defined.push_back(var);
+      if (rng() % 8 == 0) {
+        in.constraints.push_back(constraint(var, i, Register(rng() % 4)));
+      }
+    } else if (kind == 1) {
+      int var = rng() % var_count;
+      instr.read.push_back(gpr(random_defined()));
+      instr.write.push_back(gpr(var));
+      instr.is_move = true;
+      defined.push_back(var);
+    } else if (kind == 2) {
+      instr.read.push_back(gpr(random_defined()));
+      instr.clobber.push_back(Register(rng() % 16));
+    } else if (kind == 3) {
+      instr.read.push_back(gpr(random_defined()));
+      instr.jumps.push_back(rng() % (i + 1));
+    } else {
+      instr.read.push_back(gpr(random_defined()));
+      instr.read.push_back(gpr(random_defined()));
+      if (rng() % 2) {
+        int var = rng() % var_count;
+        instr.write.push_back(gpr(var));
+        defined.push_back(var);
+      }
+    }
+    in.add_instruction(instr);
+  }
+
+  // keep some variables live to the end.
+  RegAllocInstr last;
+  for (int i = 0; i < 4 && !defined.empty(); i++) {
+    last.read.push_back(gpr(random_defined()));
+  }
+  in.add_instruction(last);
+  return in;
+}
+}  // namespace
+
+TEST(RegAllocConflictCheck, SameAsReference) {
+  std::mt19937 rng(5678);
+  int ok_count = 0;
+  for (int i = 0; i < 200; i++) {
+    auto in = random_function(rng, 20 + rng() % 150, 4 + rng() % 12);
+    in.coalesce_moves = i % 2;
+    auto fast = allocate_registers(in);
+    in.reference_conflict_check = true;
+    auto reference = allocate_registers(in);
+    EXPECT_TRUE(same_allocation(fast, reference)) << i;
+    if (fast.ok) {
+      ok_count++;
+    }
+  }
+  EXPECT_GT(ok_count, 100);
+}
@@ -1,8 +1,11 @@
+#include <thread>
+
 #include "gtest/gtest.h"
 #include "common/type_system/TypeSystem.h"
 #include "common/goos/Reader.h"
 #include "common/type_system/deftype.h"
 #include "common/goos/ParseHelpers.h"
+#include "common/util/Serializer.h"
 
 TEST(TypeSystem, Construction) {
   // test that we can add all builtin types without any type errors
@@ -80,6 +83,93 @@ TEST(TypeSystem, TypeSpecEquality) {
   EXPECT_FALSE(pointer_to_string == pointer_to_function);
 }
 
+TEST(TypeSystem, TypeSpecInterning) {
+  // the same typespec built in different ways should be the same entry in the table
+  TypeSpec a("pointer", {TypeSpec("int32")});
+  TypeSpec b("pointer");
+  b.add_arg(TypeSpec("int32"));
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(TypeSpec::hash()(a), TypeSpec::hash()(b));
+  EXPECT_EQ(&a.get_arg(0), &b.get_arg(0));
+  EXPECT_EQ(a.base_type_id(), TypeSpec("pointer").base_type_id());
+  EXPECT_EQ(get_type_name(a.base_type_id()), "pointer");
+
+  b.set_arg(0, TypeSpec("string"));
+  EXPECT_NE(a, b);
+  EXPECT_EQ(b.print(), "(pointer string)");
+  EXPECT_EQ(TypeSpec().print(), "");
+}
+
+TEST(TypeSystem, TypeCheckPartialAndNewTypes) {
+  TypeSystem ts;
+  ts.add_builtin_types();
+
+  // types that aren't fully defined yet are checked as basic/structure
+  ts.forward_declare_type_as_basic("test-basic");
+  EXPECT_TRUE(ts.typecheck(ts.make_typespec("basic"), ts.make_typespec("test-basic")));
+  EXPECT_FALSE(ts.typecheck(ts.make_typespec("string"), ts.make_typespec("test-basic"), "", false,
+                            false));
+
+  // once it is defined, its real parents are used
+  ts.add_type("test-basic", std::make_unique<BasicType>("string", "test-basic"));
+  EXPECT_TRUE(ts.typecheck(ts.make_typespec("string"), ts.make_typespec("test-basic")));
+  EXPECT_FALSE(ts.typecheck(ts.make_typespec("test-basic"), ts.make_typespec("string"), "", false,
+                            false));
+  EXPECT_EQ(
+      ts.lowest_common_ancestor(ts.make_typespec("test-basic"), ts.make_typespec("type")).print(),
+      "basic");
+}
+
+TEST(TypeSystem, TypeCheckCache) {
+  TypeSystem ts;
+  ts.add_builtin_types();
+  ts.reset_cache_stats();
+
+  auto string_ptr = ts.make_pointer_typespec("string");
+  auto basic_ptr = ts.make_pointer_typespec("basic");
+  EXPECT_TRUE(ts.typecheck(basic_ptr, string_ptr));
+  EXPECT_TRUE(ts.typecheck(basic_ptr, string_ptr));
+  EXPECT_EQ(ts.lowest_common_ancestor(string_ptr, ts.make_pointer_typespec("type")).print(),
+            "(pointer basic)");
+  EXPECT_EQ(ts.lowest_common_ancestor(string_ptr, ts.make_pointer_typespec("type")).print(),
+            "(pointer basic)");
+
+  auto stats = ts.get_cache_stats();
+  EXPECT_EQ(stats.typecheck_hits, 1u);
+  EXPECT_EQ(stats.typecheck_misses, 2u);  // the pointer and its argument
+  EXPECT_EQ(stats.lca_hits, 1u);
+  EXPECT_EQ(stats.lca_misses, 2u);
+
+  // adding a type forgets the results
+  ts.add_type("test-basic", std::make_unique<BasicType>("string", "test-basic"));
+  EXPECT_TRUE(ts.typecheck(basic_ptr, string_ptr));
+  EXPECT_EQ(ts.get_cache_stats().typecheck_hits, 1u);
+}
+
+TEST(TypeSystem, TypeCheckCacheThreads) {
+  TypeSystem ts;
+  ts.add_builtin_types();
+  auto string_ptr = ts.make_pointer_typespec("string");
+  auto basic_ptr = ts.make_pointer_typespec("basic");
+  EXPECT_TRUE(ts.typecheck(basic_ptr, string_ptr));
+  ts.reset_cache_stats();
+
+  // every check is a hit, and no hit is lost when threads count at the same time.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 1000; j++) {
+        EXPECT_TRUE(ts.typecheck(basic_ptr, string_ptr));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(ts.get_cache_stats().typecheck_hits, 8000u);
+  EXPECT_EQ(ts.get_cache_stats().typecheck_misses, 0u);
+}
+
 TEST(TypeSystem, RuntimeTypes) {
   TypeSystem ts;
   ts.add_builtin_types();
@@ -404,6 +494,54 @@ TEST(TypeSystem, DecompLookupsMethod) {
   EXPECT_EQ(result.tokens.at(1).idx, 2);
 }
 
+TEST(TypeSystem, ReverseFieldIndexMatchesFieldSearch) {
+  TypeSystem ts;
+  ts.add_builtin_types();
+  std::unordered_set<std::string> log;
+
+  std::vector<std::optional<DerefKind>> derefs = {std::nullopt};
+  for (int size : {1, 2, 4, 8, 16}) {
+    for (bool sign_extend : {false, true}) {
+      DerefKind dk;
+      dk.size = size;
+      dk.sign_extend = sign_extend;
+      dk.reg_kind = RegClass::GPR_64;
+      derefs.push_back(dk);
+    }
+  }
+
+  for (auto& type : {"type", "string", "symbol", "function", "pair", "kheap", "array",
+                     "vu-function", "link-block", "connectable", "file-stream"}) {
+    for (int offset = -8; offset < 128; offset++) {
+      for (int stride : {0, 4}) {
+        for (auto& deref : derefs) {
+          FieldReverseLookupInput input;
+          input.base_type = ts.make_typespec(type);
+          input.offset = offset;
+          input.stride = stride;
+          input.deref = deref;
+
+          // the lookup log disables the index.
+          auto indexed = ts.reverse_field_lookup(input);
+          ts.set_lookup_log(&log);
+          auto searched = ts.reverse_field_lookup(input);
+          ts.set_lookup_log(nullptr);
+
+          EXPECT_EQ(indexed.success, searched.success);
+          if (indexed.success && searched.success) {
+            EXPECT_EQ(indexed.addr_of, searched.addr_of);
+            EXPECT_EQ(indexed.result_type, searched.result_type);
+            ASSERT_EQ(indexed.tokens.size(), searched.tokens.size());
+            for (size_t i = 0; i < indexed.tokens.size(); i++) {
+              EXPECT_EQ(indexed.tokens[i].print(), searched.tokens[i].print());
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 TEST(Deftype, deftype) {
   TypeSystem ts;
   ts.add_builtin_types();
@@ -447,4 +585,31 @@ TEST(Deftype, deftype) {
   EXPECT_EQ(f4.is_inline(), true);
 }
 
+TEST(TypeSystem, SerializeRoundTrip) {
+  TypeSystem ts;
+  ts.add_builtin_types();
+  ts.forward_declare_type_as_basic("not-yet-defined");
+
+  Serializer saver;
+  ts.serialize(saver);
+  auto& data = saver.get_save_result();
+
+  TypeSystem loaded;
+  Serializer loader(data.data(), data.size());
+  loaded.serialize(loader);
+  EXPECT_TRUE(loader.reached_end());
+
+  for (auto name : {"object", "basic", "int32", "string", "structure", "pointer", "function"}) {
+    EXPECT_EQ(*ts.lookup_type(name), *loaded.lookup_type(name)) << name;
+  }
+  EXPECT_EQ(ts.lookup_method("basic", "new").type, loaded.lookup_method("basic", "new").type);
+  EXPECT_TRUE(loaded.partially_defined_type_exists("not-yet-defined"));
+  EXPECT_FALSE(loaded.fully_defined_type_exists("not-yet-defined"));
+
+  // saving the loaded type system should give exactly the same data.
+  Serializer saver2;
+  loaded.serialize(saver2);
+  EXPECT_EQ(data, saver2.get_save_result());
+}
+
 // TODO - a big test to make sure all the builtin types are what we expect.